@@ -2,6 +2,18 @@ find_package(MHD REQUIRED)
 find_package(PCRE2 COMPONENTS 8)
 find_package(CARES QUIET REQUIRED)
 find_package(fmt REQUIRED)
+find_package(ZLIB)
+find_package(ZSTD QUIET)
+find_package(Brotli QUIET)
+find_package(GnuTLS QUIET)
 
 set(ENABLE_PCRE2_8 ${PCRE2_FOUND})
 set(ENABLE_CARES ${CARES_FOUND})
+set(ENABLE_ZLIB ${ZLIB_FOUND})
+set(ENABLE_ZSTD ${ZSTD_FOUND})
+set(ENABLE_BROTLI ${Brotli_FOUND})
+
+# SNI, session tickets and ALPN of TLS, the GnuTLS of libmicrohttpd is used without it
+if (TARGET GnuTLS::GnuTLS)
+    set(ENABLE_GNUTLS ON)
+endif ()
@@ -0,0 +1,29 @@
+find_package(PkgConfig QUIET)
+include(FindPackageHandleStandardArgs)
+pkg_check_modules(PC_BROTLI QUIET libbrotlienc)
+
+find_path(BROTLI_INCLUDE_DIR NAMES brotli/encode.h HINTS ${PC_BROTLI_INCLUDEDIR} ${PC_BROTLI_INCLUDE_DIRS})
+
+# the decoder is only needed by the tests
+foreach (_lib IN ITEMS enc dec common)
+    find_library(BROTLI_${_lib}_LIBRARY NAMES brotli${_lib} HINTS ${PC_BROTLI_LIBDIR} ${PC_BROTLI_LIBRARY_DIRS})
+    mark_as_advanced(BROTLI_${_lib}_LIBRARY)
+endforeach ()
+
+if (PC_BROTLI_VERSION)
+    set(BROTLI_VERSION_STRING ${PC_BROTLI_VERSION})
+endif ()
+
+mark_as_advanced(BROTLI_INCLUDE_DIR)
+find_package_handle_standard_args(Brotli REQUIRED_VARS BROTLI_enc_LIBRARY BROTLI_dec_LIBRARY BROTLI_common_LIBRARY
+                                  BROTLI_INCLUDE_DIR VERSION_VAR BROTLI_VERSION_STRING)
+
+if (Brotli_FOUND AND NOT TARGET Brotli::common)
+    foreach (_lib IN ITEMS common enc dec)
+        add_library(Brotli::${_lib} UNKNOWN IMPORTED)
+        set_target_properties(Brotli::${_lib} PROPERTIES INTERFACE_INCLUDE_DIRECTORIES ${BROTLI_INCLUDE_DIR}
+                                                         IMPORTED_LOCATION ${BROTLI_${_lib}_LIBRARY})
+    endforeach ()
+    set_target_properties(Brotli::enc PROPERTIES INTERFACE_LINK_LIBRARIES Brotli::common)
+    set_target_properties(Brotli::dec PROPERTIES INTERFACE_LINK_LIBRARIES Brotli::common)
+endif ()
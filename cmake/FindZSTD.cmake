@@ -0,0 +1,21 @@
+find_package(PkgConfig QUIET)
+include(FindPackageHandleStandardArgs)
+pkg_check_modules(PC_ZSTD QUIET libzstd)
+
+find_path(ZSTD_INCLUDE_DIR NAMES zstd.h HINTS ${PC_ZSTD_INCLUDEDIR} ${PC_ZSTD_INCLUDE_DIRS})
+
+find_library(ZSTD_LIBRARY NAMES zstd libzstd HINTS ${PC_ZSTD_LIBDIR} ${PC_ZSTD_LIBRARY_DIRS})
+
+if (PC_ZSTD_VERSION)
+    set(ZSTD_VERSION_STRING ${PC_ZSTD_VERSION})
+endif ()
+
+mark_as_advanced(ZSTD_INCLUDE_DIR ZSTD_LIBRARY)
+find_package_handle_standard_args(ZSTD REQUIRED_VARS ZSTD_LIBRARY ZSTD_INCLUDE_DIR
+                                  VERSION_VAR ZSTD_VERSION_STRING)
+
+if (ZSTD_FOUND AND NOT TARGET ZSTD::ZSTD)
+    add_library(ZSTD::ZSTD UNKNOWN IMPORTED)
+    set_target_properties(ZSTD::ZSTD PROPERTIES INTERFACE_INCLUDE_DIRECTORIES ${ZSTD_INCLUDE_DIR}
+                                                IMPORTED_LOCATION ${ZSTD_LIBRARY})
+endif ()
@@ -3,10 +3,12 @@
 
 #include <cppmhd/core.h>
 #include <cppmhd/entity.h>
+#include <cppmhd/observer.h>
 #include <cppmhd/router.h>
 
 #include <functional>
 #include <string>
+#include <vector>
 
 CPPMHD_NAMESPACE_BEGIN
 
@@ -19,8 +21,14 @@ enum CPPMHD_Error {
 
     CPPMHD_LISTEN_FAILED = 2,
 
-    CPPMHD_ROUTER_TREE_BUILD_FAILED
+    CPPMHD_ROUTER_TREE_BUILD_FAILED,
 
+    CPPMHD_ACCESS_LOG_OPEN_FAILED,
+
+    CPPMHD_WEBSOCKET_START_FAILED,
+
+    // a certificate or key can not be loaded, or libmicrohttpd is built without TLS
+    CPPMHD_TLS_FAILED
 };
 
 enum class HttpError {
@@ -41,8 +49,186 @@ enum class HttpError {
     HOST_FIELD_INCORRECT
 };
 
+enum class AccessLogFormat {
+    // one JSON object per line
+    JSON,
+    // length-prefixed fixed-size records, see lib/src/accesslog.h for the layout
+    BINARY
+};
+
+struct AccessLogOptions {
+    // file the access log is appended to. the access log is disabled when empty
+    std::string path;
+
+    AccessLogFormat format{AccessLogFormat::JSON};
+
+    // fraction of requests recorded, from 0 to 1
+    double sampleRate{1.0};
+
+    // bytes buffered per server thread, records are dropped when the writer falls behind
+    size_t bufferSize{256 * 1024};
+};
+
+// limits applied by every server thread (one MHD daemon each, see App::threadCount). requests over a limit get a
+// preallocated 503 with Retry-After, which bypasses the error handler
+struct AdmissionOptions {
+    // open connections, new connections over the limit are closed right after accept. 0 for no limit
+    uint32_t maxConnections{0};
+
+    // requests between their first byte and the response completed. 0 for no limit
+    uint32_t maxInflight{0};
+
+    // CoDel: when no request completed within targetDelay for a whole interval, the server is overloaded and sheds
+    // requests at an increasing rate until one does. 0 disables it
+    uint32_t targetDelayMs{0};
+    uint32_t intervalMs{100};
+
+    // seconds, sent in the Retry-After header of the 503
+    uint32_t retryAfter{1};
+};
+
+enum class RateLimitKey {
+    // the client address. a client with an empty bucket also has its new connections closed right after accept
+    CLIENT_ADDRESS,
+    // the value of the request header `name', eg: an API key
+    HEADER,
+    // the route parameter `name', checked after routing
+    ROUTE_PARAM
+};
+
+// token buckets shared by all server threads. requests over the rate get a preallocated 429 with Retry-After, which
+// bypasses the error handler. requests without the header or the route parameter are keyed by the client address
+struct RateLimitOptions {
+    // requests per second of each key, 0 disables the rate limiter
+    double rate{0};
+
+    // requests a key may make at once, up to 65535. 0 for the rate rounded up
+    uint32_t burst{0};
+
+    RateLimitKey key{RateLimitKey::CLIENT_ADDRESS};
+
+    std::string name;
+
+    // keys tracked at once, the ones seen least recently are dropped first
+    size_t capacity{65536};
+
+    // seconds, sent in the Retry-After header of the 429
+    uint32_t retryAfter{1};
+};
+
+struct MetricsOptions {
+    // serve request counters and latency histograms in the Prometheus text format
+    bool enable{false};
+
+    // route of the scrape endpoint, GET only
+    std::string path{"/metrics"};
+};
+
+// compresses the bodies of responses for the encodings in Accept-Encoding. gzip and deflate need zlib, br and zstd
+// need brotli and zstd when cppmhd is built. a response with a Content-Encoding of its own is sent as it is
+struct CompressionOptions {
+    bool enable{false};
+
+    // bytes, smaller bodies are not worth compressing
+    size_t minSize{1024};
+
+    // prefixes of the Content-Type of compressible responses, without parameters
+    std::vector<std::string> types{CPPMHD_HTTP_MIME_TEXT_PLAIN,
+                                   CPPMHD_HTTP_MIME_TEXT_HTML,
+                                   "text/css",
+                                   "text/javascript",
+                                   CPPMHD_HTTP_MIME_APPLICATION_JSON,
+                                   "application/javascript",
+                                   CPPMHD_HTTP_MIME_APPLICATION_XML,
+                                   "image/svg+xml"};
+
+    // from 1 (fast) to 9 (small), the same number for every encoding
+    int level{6};
+
+    // bytes, larger bodies that are not persistent are compressed while they are sent, with chunked encoding
+    size_t streamSize{256 * 1024};
+
+    // bytes of compressed persistent bodies (HttpResponse::body with persistent set) kept, so a hot response is
+    // compressed once per encoding. such a body must not change while the app runs. 0 disables the cache
+    size_t cacheSize{16 * 1024 * 1024};
+};
+
+// keeps the responses of the routes opted in with HttpController::cachePolicy
+struct ResponseCacheOptions {
+    // bytes of bodies and headers, the least recently used responses are dropped beyond it
+    size_t capacity{64 * 1024 * 1024};
+
+    // the keys are spread over them, each with its lock and its part of the capacity
+    uint32_t shards{16};
+};
+
+// sockets the daemons listen on instead of binding the address of the App. an App created with an address like
+// unix:/run/app.sock listens on that Unix domain socket
+struct ListenOptions {
+    // of the address of the App among its listeners, see HttpController::listeners
+    std::string name{"main"};
+
+    // bound and listening already, eg: by a supervisor. the daemons share them, at least one daemon per socket. they
+    // stay open after the App stops
+    std::vector<int> fds;
+
+    // adds the sockets of systemd socket activation, the ones of LISTEN_FDS when LISTEN_PID is this process
+    bool systemd{false};
+
+    // permissions of the Unix domain socket file, it is removed when the App stops
+    uint32_t unixMode{0660};
+};
+
+// one more address served by an App, see App::addListener
+struct Listener {
+    std::string name;
+    // an IP address, or unix:<path>
+    std::string address;
+    uint16_t port;
+};
+
+// a certificate chain, the one of the server first, and its private key. PEM, in memory or else read from the files
+struct TlsCertificate {
+    std::string cert;
+    std::string key;
+
+    std::string certFile;
+    std::string keyFile;
+
+    // of an encrypted key
+    std::string password;
+};
+
+// HTTPS on every listener, through the GnuTLS support of libmicrohttpd
+struct TlsOptions {
+    // TLS is enabled when there is one. the client asking for a server name (SNI) gets the certificate issued for it,
+    // the first one when none is. more than one needs cppmhd built with GnuTLS
+    std::vector<TlsCertificate> certificates;
+
+    // a GnuTLS priority string, the protocol versions and ciphers allowed
+    std::string priorities{"NORMAL"};
+
+    // resumption with session tickets, the key is shared by the daemons and rotated by GnuTLS. needs GnuTLS
+    bool sessionTickets{true};
+
+    // the ALPN protocols offered, see HttpRequest::tls. needs GnuTLS
+    std::vector<std::string> alpn{"http/1.1"};
+};
+
+// App::drain and App::restart
+struct ShutdownOptions {
+    // seconds the requests in flight get to finish once the listening sockets stop accepting, the rest are cut off.
+    // websockets and event streams are closed after them
+    uint32_t drainTimeout{30};
+
+    // seconds the process started by App::restart gets to serve on the listening sockets
+    uint32_t handoffTimeout{10};
+};
+
 class App
 {
+    friend class HttpImplement;
+
   public:
     using errorHandler =
         std::function<HttpResponsePtr(const HttpRequestPtr &, HttpStatusCode, HttpError, const std::string &)>;
@@ -61,7 +247,34 @@ class App
 
     std::string host_;
 
+    AccessLogOptions accessLog_;
+
+    MetricsOptions metrics_;
+
+    AdmissionOptions admission_;
+
+    RateLimitOptions rateLimit_;
+
+    uint64_t maxBodySize_;
+
+    CompressionOptions compression_;
+
+    ResponseCacheOptions responseCache_;
+
+    ListenOptions listen_;
+
+    std::vector<Listener> listeners_;
+
+    TlsOptions tls_;
+
+    ShutdownOptions shutdown_;
+
+    RequestObserverPtr observer_;
+
   public:
+    // of an App, with the address it was created with
+    static constexpr size_t kMaxListeners = 32;
+
     App(const std::string &addr, uint16_t port);
     ~App();
 
@@ -69,8 +282,18 @@ class App
 
     int start(const std::function<void(void)> &);
 
+    // the requests in flight are cut off
     void stop();
 
+    // stops accepting connections, lets the requests in flight finish, then stops. keep-alive connections are closed
+    // after their response meanwhile
+    void drain();
+
+    // starts argv, the same app, argv[0] being the path of its executable, eg: /proc/self/exe. it takes the listening
+    // sockets over instead of binding its own, then this one drains: no connection is refused meanwhile. false if it
+    // did not serve within ShutdownOptions::handoffTimeout, this one keeps running then
+    bool restart(const std::vector<std::string> &argv);
+
     uint32_t threadCount()
     {
         return threadCount_;
@@ -115,6 +338,134 @@ class App
     {
         return host_;
     }
+
+    const AccessLogOptions &accessLog() const
+    {
+        return accessLog_;
+    }
+
+    AccessLogOptions &accessLog()
+    {
+        return accessLog_;
+    }
+
+    const MetricsOptions &metrics() const
+    {
+        return metrics_;
+    }
+
+    MetricsOptions &metrics()
+    {
+        return metrics_;
+    }
+
+    const AdmissionOptions &admission() const
+    {
+        return admission_;
+    }
+
+    AdmissionOptions &admission()
+    {
+        return admission_;
+    }
+
+    const RateLimitOptions &rateLimit() const
+    {
+        return rateLimit_;
+    }
+
+    RateLimitOptions &rateLimit()
+    {
+        return rateLimit_;
+    }
+
+    const CompressionOptions &compression() const
+    {
+        return compression_;
+    }
+
+    CompressionOptions &compression()
+    {
+        return compression_;
+    }
+
+    const ResponseCacheOptions &responseCache() const
+    {
+        return responseCache_;
+    }
+
+    ResponseCacheOptions &responseCache()
+    {
+        return responseCache_;
+    }
+
+    const ListenOptions &listen() const
+    {
+        return listen_;
+    }
+
+    ListenOptions &listen()
+    {
+        return listen_;
+    }
+
+    // serves address too, with the same routes and server threads: one thread accepts the connections of the added
+    // listeners and hands them to the daemons in turn. HttpController::listeners picks the routes of each. false if
+    // the App runs, the name is taken, or there are kMaxListeners already
+    bool addListener(const std::string &name, const std::string &address, uint16_t port);
+
+    // the ones added, without the address of the App
+    const std::vector<Listener> &listeners() const
+    {
+        return listeners_;
+    }
+
+    const TlsOptions &tls() const
+    {
+        return tls_;
+    }
+
+    TlsOptions &tls()
+    {
+        return tls_;
+    }
+
+    const ShutdownOptions &shutdown() const
+    {
+        return shutdown_;
+    }
+
+    ShutdownOptions &shutdown()
+    {
+        return shutdown_;
+    }
+
+    // bytes of a request body. a larger one gets a preallocated 413, without reading the rest of the body when the
+    // Content-Length tells in advance. 0 for no limit, HttpController::maxBodySize overrides it per route
+    uint64_t maxBodySize() const
+    {
+        return maxBodySize_;
+    }
+
+    void maxBodySize(uint64_t size)
+    {
+        if (!isRunning()) {
+            maxBodySize_ = size;
+        }
+    }
+
+    // called with the phase timestamps of every completed request. needs cppmhd built with ENABLE_REQUEST_TIMING
+    const RequestObserverPtr &observer() const
+    {
+        return observer_;
+    }
+
+    void observer(RequestObserverPtr observer)
+    {
+        if (!isRunning()) {
+            observer_ = std::move(observer);
+        }
+    }
 };
 
 CPPMHD_NAMESPACE_END
@@ -4,7 +4,10 @@
 #include <cppmhd/core.h>
 #include <cppmhd/entity.h>
 
+#include <map>
+#include <string>
 #include <type_traits>
+#include <vector>
 
 CPPMHD_NAMESPACE_BEGIN
 
@@ -16,6 +19,8 @@ class DataProcessor
 
     static const size_t DataProcessorParseFailed = static_cast<size_t>(~0);
 
+    // the bytes consumed, the rest is passed again with the next data. size 0 ends the body, DataProcessorParseFailed
+    // then rejects a truncated one. with HttpRequest::pause the next call waits for HttpRequest::resume
     virtual size_t onData(HttpRequestPtr& req, const void* in, size_t size) = 0;
 };
 
@@ -64,11 +69,51 @@ class HttpDataProcessor : public DataProcessor
     }
 };
 
+// how the requests of a route are treated when the server sheds load, see AdmissionOptions
+enum class RequestPriority {
+    // shed as long as the server is overloaded
+    LOW,
+    NORMAL,
+    // never shed by the queue delay control, only by the hard limits
+    HIGH
+};
+
+// how the responses of a route are kept in the response cache, see ResponseCacheOptions
+struct CachePolicy {
+    // seconds a 200 to a GET is served from the cache without running the handler. 0 opts out
+    uint32_t ttl;
+    // seconds past ttl it is still served, while one request runs the handler to refresh it
+    uint32_t stale;
+    // request headers that select a variant besides the path and the query. with compression enabled, the encoding
+    // the client accepts always does
+    std::vector<std::string> vary;
+};
+
 class HttpController
 {
   public:
     virtual void onConnection(HttpRequestPtr, HttpResponsePtr&);
 
+    // asked once when the router is built
+    virtual RequestPriority priority() const;
+
+    // the limit of App::maxBodySize for this route, asked once when the router is built. 0 keeps the one of the App
+    virtual uint64_t maxBodySize() const;
+
+    // seconds the ETag and Last-Modified of the last 200 to a GET of a URL (path and query) are trusted, asked once
+    // when the router is built. within them a GET or HEAD whose If-None-Match or If-Modified-Since holds gets a 304
+    // before onConnection. a 200 without an ETag gets one hashed from the body. 0, the default, opts out: an ETag or
+    // Last-Modified set by onRequest is still checked after it
+    virtual uint32_t validatorTtl() const;
+
+    // the responses kept in the response cache, asked once when the router is built. a miss runs the handler once:
+    // the GETs of the same URL arriving meanwhile wait for its response. the default opts out
+    virtual CachePolicy cachePolicy() const;
+
+    // the names of the listeners serving the route, see App::addListener, asked once when the router is built. the
+    // others answer a 404. every listener when empty, the default
+    virtual std::vector<std::string> listeners() const;
+
     virtual void onRequest(HttpRequestPtr, HttpResponsePtr&) = 0;
 
     virtual ~HttpController();
@@ -105,7 +150,7 @@ class DataProcessorController : public HttpController
 
 class FormDataProcessorController : public HttpController
 {
-    std::shared_ptr<DataProcessor> pp;
+    size_t partBuffer_;
 
   public:
     virtual void onConnection(HttpRequestPtr, HttpResponsePtr&) override final;
@@ -122,11 +167,80 @@ class FormDataProcessorController : public HttpController
                         size_t size,
                         bool finish) = 0;
 
-    FormDataProcessorController() = default;
+    // data points into the received body, chunks are as large as what the connection read
+    FormDataProcessorController() : partBuffer_(0) {}
+
+    // the data of a field is coalesced into chunks of at least partBuffer bytes, except for the last one of the field
+    explicit FormDataProcessorController(size_t partBuffer) : partBuffer_(partBuffer) {}
 
     virtual ~FormDataProcessorController();
 };
 
+// how UploadController writes request bodies to disk
+struct UploadOptions {
+    // the default uploadPath creates the files in here
+    std::string directory = "/tmp";
+
+    // bytes copied out of the connection before one write is queued. rounded up to 4096
+    size_t chunkSize = 256 * 1024;
+
+    // chunks of one file queued for the I/O thread. the request is paused when the disk falls further behind
+    size_t maxPending = 4;
+
+    // O_DIRECT, bypasses the page cache. file systems refusing it get buffered writes
+    bool direct = false;
+};
+
+struct UploadedFile {
+    // the form field, empty for a body which is not multipart/form-data
+    std::string field;
+    std::string fileName;
+    std::string contentType;
+    std::string path;
+    uint64_t size;
+    // errno of the first failed open or write, 0 if the file is complete
+    int error;
+};
+
+struct UploadResult {
+    std::vector<UploadedFile> files;
+    // the form fields without a file name, kept in memory
+    std::map<std::string, std::string> fields;
+    // false if the body ended in the middle of a multipart part
+    bool complete;
+};
+
+class UploadWriter;
+
+// streams request bodies into files. multipart/form-data bodies get one file per part with a file name, any other
+// body is written to one file. the writes run on an I/O thread of the controller, the daemon thread only copies the
+// data into the write-behind buffers. files of requests which did not reach onRequest are removed.
+class UploadController : public HttpController
+{
+    const UploadOptions options_;
+    std::shared_ptr<UploadWriter> writer_;
+
+  public:
+    explicit UploadController(const UploadOptions& options = UploadOptions());
+
+    virtual void onConnection(HttpRequestPtr, HttpResponsePtr&) override final;
+
+    // the file a part is written to. a path ending in XXXXXX is made unique like mkstemp, an empty one drops the part
+    virtual std::string uploadPath(HttpRequestPtr, const std::string& field, const std::string& fileName);
+
+    // all files are closed. they belong to the handler from now on
+    virtual void onRequest(HttpRequestPtr, const UploadResult& result, HttpResponsePtr&) = 0;
+
+    virtual void onRequest(HttpRequestPtr req, HttpResponsePtr& resp) override final;
+
+    const UploadOptions& options() const
+    {
+        return options_;
+    }
+
+    virtual ~UploadController();
+};
+
 CPPMHD_NAMESPACE_END
 
 #endif
@@ -22,7 +22,51 @@ class DataProcessor;
 class HttpImplement;
 class HttpConnection;
 
-enum class HttpMethod { GET, HEAD, POST, PUT, DELETE, OPTIONS, CONNECT, TRACE, PATCH };
+enum class HttpMethod {
+    GET,
+    HEAD,
+    POST,
+    PUT,
+    DELETE,
+    OPTIONS,
+    CONNECT,
+    TRACE,
+    PATCH,
+
+    // values from here on are handed out by registerHttpMethod
+    EXTENSION_BEGIN = 16
+};
+
+// register an extension method (eg: PROPFIND, REPORT) so that it can be routed like the standard ones.
+// method names are case-sensitive tokens. registering the same name twice returns the same value.
+// this must be done before App::start.
+bool registerHttpMethod(const char* name, HttpMethod& out);
+
+// "GET", "PROPFIND", ... nullptr if the method was never registered
+const char* httpMethodName(HttpMethod);
+
+// request headers which are looked up often enough to get a fixed slot in the per-request header index
+enum class KnownHeader {
+    HOST = 0,
+    CONTENT_TYPE,
+    CONTENT_LENGTH,
+    ACCEPT_ENCODING,
+    AUTHORIZATION,
+    COOKIE,
+    IF_NONE_MATCH,
+    IF_MODIFIED_SINCE,
+    RANGE,
+    IF_RANGE,
+    EXPECT,
+    CONNECTION,
+    TRANSFER_ENCODING,
+    USER_AGENT,
+    X_FORWARDED_FOR,
+
+    UNKNOWN
+};
+
+const char* knownHeaderName(KnownHeader);
 
 enum HttpStatusCode {
     // Information responses
@@ -79,6 +123,7 @@ enum HttpStatusCode {
     k417ExpectationFailed,
     k418ImaTeapot,
     k421MisDirectedRequest = 421,
+    k426UpgradeRequired = 426,
     k429TooManyRequests = 429,
 
     // Server error responses
@@ -131,21 +176,53 @@ const char* cppmhd_version_string();
 #define CPPMHD_HTTP_HEADER_ACCEPT_CHARSET "Accept-Charset"
 #define CPPMHD_HTTP_HEADER_ACCEPT_ENCODING "Accept-Encoding"
 #define CPPMHD_HTTP_HEADER_ACCEPT_LANGUAGE "Accept-Language"
+#define CPPMHD_HTTP_HEADER_ACCEPT_RANGES "Accept-Ranges"
+
+#define CPPMHD_HTTP_HEADER_AUTHORIZATION "Authorization"
+#define CPPMHD_HTTP_HEADER_CACHE_CONTROL "Cache-Control"
+#define CPPMHD_HTTP_HEADER_CONNECTION "Connection"
+#define CPPMHD_HTTP_HEADER_COOKIE "Cookie"
 
+#define CPPMHD_HTTP_HEADER_CONTENT_ENCODING "Content-Encoding"
 #define CPPMHD_HTTP_HEADER_CONTENT_LENGTH "Content-Length"
 #define CPPMHD_HTTP_HEADER_CONTENT_LOCATION "Content-Location"
+#define CPPMHD_HTTP_HEADER_CONTENT_RANGE "Content-Range"
 #define CPPMHD_HTTP_HEADER_CONTENT_TYPE "Content-Type"
 
+#define CPPMHD_HTTP_HEADER_DATE "Date"
+
+#define CPPMHD_HTTP_HEADER_ETAG "ETag"
+#define CPPMHD_HTTP_HEADER_EXPECT "Expect"
+#define CPPMHD_HTTP_HEADER_EXPIRES "Expires"
+
 #define CPPMHD_HTTP_HEADER_HOST "Host"
+#define CPPMHD_HTTP_HEADER_IF_MODIFIED_SINCE "If-Modified-Since"
+#define CPPMHD_HTTP_HEADER_IF_NONE_MATCH "If-None-Match"
+#define CPPMHD_HTTP_HEADER_IF_RANGE "If-Range"
+#define CPPMHD_HTTP_HEADER_LAST_MODIFIED "Last-Modified"
 #define CPPMHD_HTTP_HEADER_LOCATION "Location"
 
+#define CPPMHD_HTTP_HEADER_RANGE "Range"
+#define CPPMHD_HTTP_HEADER_RETRY_AFTER "Retry-After"
+
+#define CPPMHD_HTTP_HEADER_SEC_WEBSOCKET_ACCEPT "Sec-WebSocket-Accept"
+#define CPPMHD_HTTP_HEADER_SEC_WEBSOCKET_EXTENSIONS "Sec-WebSocket-Extensions"
+#define CPPMHD_HTTP_HEADER_SEC_WEBSOCKET_KEY "Sec-WebSocket-Key"
+#define CPPMHD_HTTP_HEADER_SEC_WEBSOCKET_VERSION "Sec-WebSocket-Version"
 #define CPPMHD_HTTP_HEADER_SERVER "Server"
 
+#define CPPMHD_HTTP_HEADER_TRANSFER_ENCODING "Transfer-Encoding"
+#define CPPMHD_HTTP_HEADER_UPGRADE "Upgrade"
+#define CPPMHD_HTTP_HEADER_USER_AGENT "User-Agent"
+#define CPPMHD_HTTP_HEADER_VARY "Vary"
+#define CPPMHD_HTTP_HEADER_X_FORWARDED_FOR "X-Forwarded-For"
+
 #define CPPMHD_HTTP_MIME_APPLICATION_JSON "application/json"
 #define CPPMHD_HTTP_MIME_APPLICATION_OCTET "application/octet-stream"
 #define CPPMHD_HTTP_MIME_APPLICATION_XML "application/xml"
 #define CPPMHD_HTTP_MIME_APPLICATION_FORM_URLENCODED "application/x-www-form-urlencoded"
 #define CPPMHD_HTTP_MIME_MULTIPART_FORM_DATA "multipart/form-data"
+#define CPPMHD_HTTP_MIME_TEXT_EVENT_STREAM "text/event-stream"
 #define CPPMHD_HTTP_MIME_TEXT_HTML "text/html"
 #define CPPMHD_HTTP_MIME_TEXT_PLAIN "text/plain"
 
@@ -8,9 +8,27 @@
 #include <memory>
 #include <string>
 #include <tuple>
+#include <utility>
+#include <vector>
 
 CPPMHD_NAMESPACE_BEGIN
 
+// all request headers in the order they were received.
+// key and value point into the connection buffer and stay valid until the request finishes.
+using HttpHeaderList = std::vector<std::pair<const char*, const char*>>;
+
+// the TLS session of a request, see HttpRequest::tls
+struct TlsInfo {
+    // eg: TLS1.3
+    std::string protocol;
+    // the ALPN protocol agreed on, empty if none was
+    std::string alpn;
+    // the server name the client asked for (SNI), empty if it did not
+    std::string serverName;
+    // with a session ticket, without a full handshake
+    bool resumed{false};
+};
+
 class HttpRequest
 {
     std::shared_ptr<DataProcessor> dp_;
@@ -21,6 +39,11 @@ class HttpRequest
     void* userdp_;
 
   protected:
+    virtual const char* getKnownHeader(KnownHeader header) const
+    {
+        return getHeader(knownHeaderName(header));
+    }
+
     HttpRequest(MHD_Connection* conn) : conn_(conn)
     {
         dp_ = nullptr;
@@ -72,7 +95,26 @@ class HttpRequest
 
     virtual const char* getHeader(const char* header) const = 0;
 
+    const char* getHeader(KnownHeader header) const
+    {
+        return getKnownHeader(header);
+    }
+
+    virtual const HttpHeaderList& headers() const;
+
     virtual const std::string& getParam(const std::string& name) const = 0;
+
+    // stops reading the body once the running DataProcessor::onData returns, what it did not consume is handed to it
+    // again after resume. the socket is not read in between, so a fast client is held back by TCP flow control.
+    // pausing on the end of the body delays onRequest. a paused connection does not time out, resume it before the
+    // app stops. only from DataProcessor::onData, false if the request can not be paused
+    virtual bool pause();
+
+    // reads the body again, from any thread. false if the request is not paused, or was completed
+    virtual bool resume();
+
+    // false for a request in clear text. info is left empty unless cppmhd is built with GnuTLS
+    virtual bool tls(TlsInfo& info) const;
 };
 
 using HttpRequestPtr = std::shared_ptr<HttpRequest>;
@@ -102,10 +144,14 @@ class HttpResponse
 
     BodyType body_;
 
+    // the file of the body, -1 for none
+    int fd_;
+    uint64_t fileSize_;
+
     void clearBody();
 
   public:
-    HttpResponse()
+    HttpResponse() : fd_(-1), fileSize_(0)
     {
         body_ = std::make_tuple(0, nullptr, false);
     }
@@ -126,6 +172,24 @@ class HttpResponse
 
     void body(const std::string& data);
 
+    // the body is the file at path, which the kernel copies to the socket. sets the ETag and Last-Modified of the
+    // file unless they are set. false if it can not be opened
+    bool file(const std::string& path);
+
+    // the body is the open file fd, the response closes it. false if it is not a regular file
+    bool file(int fd);
+
+    // -1 unless the body is a file, which takes the place of the buffer body
+    int fd() const
+    {
+        return fd_;
+    }
+
+    uint64_t fileSize() const
+    {
+        return fileSize_;
+    }
+
     const HeaderType& headers() const
     {
         return headers_;
@@ -0,0 +1,282 @@
+#ifndef CPPMHD_JSON_H_
+#define CPPMHD_JSON_H_
+
+#include <cppmhd/controller.h>
+#include <cppmhd/core.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+CPPMHD_NAMESPACE_BEGIN
+
+struct JsonLimits {
+    // bytes of the whole document
+    size_t maxSize = 1024 * 1024;
+    // nested arrays and objects
+    size_t maxDepth = 64;
+    // bytes of one string, key or number, after unescaping
+    size_t maxToken = 64 * 1024;
+};
+
+// the events of JsonParser, in document order. text is not NUL terminated and only valid during the call, it points
+// into the parsed buffer when the token did not span buffers or contain escapes. false from any of them stops the
+// parser
+class JsonHandler
+{
+  public:
+    virtual bool onNull() = 0;
+    virtual bool onBool(bool value) = 0;
+    // the text of the number as sent, checked against the JSON grammar
+    virtual bool onNumber(const char* text, size_t length) = 0;
+    // unescaped, UTF-8
+    virtual bool onString(const char* text, size_t length) = 0;
+    virtual bool onKey(const char* text, size_t length) = 0;
+    virtual bool onStartObject() = 0;
+    virtual bool onEndObject() = 0;
+    virtual bool onStartArray() = 0;
+    virtual bool onEndArray() = 0;
+
+    virtual ~JsonHandler();
+};
+
+// incremental JSON parser. the document may be split anywhere, every buffer is parsed as it arrives and only a token
+// cut by the end of a buffer is kept until the next one
+class JsonParser
+{
+    enum class Expect : uint8_t { VALUE, VALUE_OR_END, KEY, KEY_OR_END, COLON, COMMA_OR_END, DONE };
+    enum class Token : uint8_t { NONE, STRING, KEY, NUMBER, LITERAL };
+
+    JsonHandler& handler_;
+    const JsonLimits limits_;
+
+    Expect expect_;
+    Token token_;
+    // true for an object
+    std::vector<bool> stack_;
+
+    // a token spanning buffers, or a string with escapes
+    std::string text_;
+    bool copied_;
+    // the bytes of an escape after the backslash, and the high half of a surrogate pair waiting for the low one
+    std::string escape_;
+    uint32_t surrogate_;
+
+    // bytes before the buffer being parsed
+    uint64_t size_;
+    const char* begin_;
+    std::string error_;
+
+    // nullptr, for the parse functions to return
+    const char* fail(const char* message, const char* at);
+    bool append(const char* p, const char* end);
+    bool value();
+    bool endScalar(const char* text, size_t length, const char* at);
+
+    const char* string(const char* p, const char* end);
+    const char* escape(const char* p, const char* end);
+    const char* scalar(const char* p, const char* end);
+    const char* structural(const char* p);
+
+  public:
+    JsonParser(JsonHandler& handler, const JsonLimits& limits);
+
+    // false on a syntax error, a limit, or a handler returning false. the parser stays failed
+    bool parse(const char* data, size_t size);
+
+    // the end of the document. false if it is empty or incomplete
+    bool finish();
+
+    bool failed() const
+    {
+        return error_.length() != 0;
+    }
+
+    const std::string& error() const
+    {
+        return error_;
+    }
+};
+
+struct JsonMember;
+
+// a value of a JsonDocument. a cheap handle into the arena of the document, valid as long as the document
+class JsonValue
+{
+  public:
+    enum class Type : uint8_t { NUL, BOOLEAN, NUMBER, STRING, ARRAY, OBJECT };
+
+  private:
+    friend class JsonDocument;
+
+    Type type_;
+    // bytes of a string or number, elements of an array or object
+    uint32_t size_;
+    union {
+        bool boolean_;
+        const char* text_;
+        const JsonValue* elements_;
+        const JsonMember* members_;
+    };
+
+  public:
+    JsonValue() : type_(Type::NUL), size_(0), text_(nullptr) {}
+
+    Type type() const
+    {
+        return type_;
+    }
+
+    bool isNull() const
+    {
+        return type_ == Type::NUL;
+    }
+
+    bool isBool() const
+    {
+        return type_ == Type::BOOLEAN;
+    }
+
+    bool isNumber() const
+    {
+        return type_ == Type::NUMBER;
+    }
+
+    bool isString() const
+    {
+        return type_ == Type::STRING;
+    }
+
+    bool isArray() const
+    {
+        return type_ == Type::ARRAY;
+    }
+
+    bool isObject() const
+    {
+        return type_ == Type::OBJECT;
+    }
+
+    // false for anything but true
+    bool asBool() const
+    {
+        return type_ == Type::BOOLEAN && boolean_;
+    }
+
+    // 0 for anything but a number
+    double asDouble() const;
+    int64_t asInt64() const;
+
+    // the string, or the text of a number. NUL terminated, "" for the other types
+    const char* c_str() const
+    {
+        return type_ == Type::STRING || type_ == Type::NUMBER ? text_ : "";
+    }
+
+    size_t length() const
+    {
+        return type_ == Type::STRING || type_ == Type::NUMBER ? size_ : 0;
+    }
+
+    std::string str() const
+    {
+        return std::string(c_str(), length());
+    }
+
+    // elements of an array or members of an object
+    size_t size() const
+    {
+        return type_ == Type::ARRAY || type_ == Type::OBJECT ? size_ : 0;
+    }
+
+    // the element i of an array, a null value if there is none
+    const JsonValue& operator[](size_t i) const;
+
+    // the member i of an object
+    const JsonMember& member(size_t i) const;
+
+    // the first member called key, nullptr if there is none
+    const JsonValue* find(const char* key) const;
+};
+
+struct JsonMember {
+    const char* key;
+    size_t keyLength;
+    JsonValue value;
+};
+
+// a document built from the events of a JsonParser. strings and containers live in an arena owned by the document, so
+// building it costs a few large allocations instead of one per value
+class JsonDocument : public JsonHandler
+{
+    struct Frame {
+        size_t start;
+        bool object;
+    };
+
+    std::vector<std::unique_ptr<char[]>> blocks_;
+    char* cursor_;
+    size_t left_;
+    size_t blockSize_;
+
+    // the values of the open containers, moved into the arena when their container ends
+    std::vector<JsonValue> values_;
+    std::vector<JsonMember> keys_;
+    std::vector<Frame> frames_;
+
+    JsonValue root_;
+
+    JsonDocument(const JsonDocument&) = delete;
+    JsonDocument& operator=(const JsonDocument&) = delete;
+
+    void* allocate(size_t size);
+    const char* copy(const char* text, size_t length);
+    bool push(const JsonValue& value);
+    bool close(bool object);
+
+  public:
+    JsonDocument();
+    virtual ~JsonDocument();
+
+    // a null value until the document is complete
+    const JsonValue& root() const
+    {
+        return root_;
+    }
+
+    virtual bool onNull() override;
+    virtual bool onBool(bool value) override;
+    virtual bool onNumber(const char* text, size_t length) override;
+    virtual bool onString(const char* text, size_t length) override;
+    virtual bool onKey(const char* text, size_t length) override;
+    virtual bool onStartObject() override;
+    virtual bool onEndObject() override;
+    virtual bool onStartArray() override;
+    virtual bool onEndArray() override;
+};
+
+// parses the body of a request into a JsonDocument while it is received. a syntax error or a limit answers 400 before
+// the rest of the body is read
+class JsonController : public HttpController
+{
+    const JsonLimits limits_;
+
+  public:
+    explicit JsonController(const JsonLimits& limits = JsonLimits());
+
+    virtual void onConnection(HttpRequestPtr, HttpResponsePtr&) override final;
+
+    virtual void onRequest(HttpRequestPtr, const JsonValue& body, HttpResponsePtr&) = 0;
+
+    // the body was empty or ended inside the document. answers 400 by default
+    virtual void onBadRequest(HttpRequestPtr, const std::string& error, HttpResponsePtr&);
+
+    virtual void onRequest(HttpRequestPtr req, HttpResponsePtr& resp) override final;
+
+    virtual ~JsonController();
+};
+
+CPPMHD_NAMESPACE_END
+
+#endif
@@ -3,6 +3,7 @@
 #define CPPMHD_LOGGER_H_
 
 #include <cppmhd/core.h>
+
 #include <memory>
 
 CPPMHD_NAMESPACE_BEGIN
@@ -31,6 +32,43 @@ class AbstractLogger
     virtual void fflush() = 0;
 };
 
+// what AsyncLogger does when the ring buffer of the logging thread is full
+enum class OverflowPolicy
+{
+    // discard the record and count it. the count is reported in the log once there is room again
+    kDrop,
+    // wait until the writer thread has made room
+    kBlock
+};
+
+class AsyncLoggerImpl;
+
+// formats the record on the calling thread into a per-thread lock-free ring buffer, a background thread collects
+// the records of all threads and writes them out with writev. use it by:
+//      log::setLogger<log::AsyncLogger>();
+class AsyncLogger : public AbstractLogger
+{
+    AsyncLoggerImpl* impl_;
+
+    AsyncLogger(const AsyncLogger&) = delete;
+    AsyncLogger& operator=(const AsyncLogger&) = delete;
+
+  public:
+    // fd: where records go, stdout by default.
+    // ringSize: ring buffer size in bytes of each logging thread.
+    explicit AsyncLogger(int fd = 1, OverflowPolicy policy = OverflowPolicy::kDrop, size_t ringSize = 256 * 1024);
+
+    virtual ~AsyncLogger();
+
+    virtual void output(enum LogLevel lv, const char* file, const char* func, int line, const char* message) override;
+
+    // block until every record logged before this call has been written
+    virtual void fflush() override;
+
+    // records discarded under OverflowPolicy::kDrop
+    uint64_t dropped() const;
+};
+
 void setLogger(std::shared_ptr<AbstractLogger> logger);
 
 template <class L, class... Args>
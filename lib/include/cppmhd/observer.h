@@ -0,0 +1,75 @@
+#ifndef CPPMHD_OBSERVER_H_
+#define CPPMHD_OBSERVER_H_
+
+#include <cppmhd/core.h>
+#include <cppmhd/entity.h>
+
+#include <cstdint>
+
+CPPMHD_NAMESPACE_BEGIN
+
+// the points a request passes on its way through the server, in order
+enum class RequestPhase {
+    // first callback of MHD, the request line and headers are in
+    BEGIN = 0,
+    METHOD_PARSED,
+    // Host and HTTP version checked
+    CHECKED,
+    ROUTED,
+    // HttpController::onConnection returned
+    CONNECTION,
+    // first chunk of the body handed to the DataProcessor
+    BODY_BEGIN,
+    // the DataProcessor got the end of the body
+    BODY_END,
+    // right before HttpController::onRequest
+    HANDLER,
+    // HttpController::onRequest returned
+    HANDLED,
+    // the response was queued to MHD
+    QUEUED,
+    // the response was sent, or the connection was closed
+    COMPLETED,
+
+    COUNT
+};
+
+constexpr size_t kRequestPhaseCount = static_cast<size_t>(RequestPhase::COUNT);
+
+// monotonic timestamps of one request, in nanoseconds.
+// only recorded when cppmhd is built with ENABLE_REQUEST_TIMING.
+struct RequestTiming {
+    // 0 if the request never reached the phase
+    uint64_t at[kRequestPhaseCount];
+
+    // DataProcessor::onData calls and the time spent inside them
+    uint32_t dataRounds;
+    uint64_t dataTime;
+
+    uint64_t of(RequestPhase phase) const
+    {
+        return at[static_cast<size_t>(phase)];
+    }
+
+    // nanoseconds from `from' to `to', 0 if either of them was not reached
+    uint64_t between(RequestPhase from, RequestPhase to) const
+    {
+        auto f = of(from), t = of(to);
+        return f != 0 && t >= f ? t - f : 0;
+    }
+};
+
+class RequestObserver
+{
+  public:
+    // called on the server thread once the request is completed. must be cheap and must not block
+    virtual void onComplete(const HttpRequest& req, const HttpResponse* resp, const RequestTiming& timing) = 0;
+
+    virtual ~RequestObserver();
+};
+
+using RequestObserverPtr = std::shared_ptr<RequestObserver>;
+
+CPPMHD_NAMESPACE_END
+
+#endif
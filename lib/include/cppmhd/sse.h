@@ -0,0 +1,110 @@
+#ifndef CPPMHD_SSE_H_
+#define CPPMHD_SSE_H_
+
+#include <cppmhd/controller.h>
+#include <cppmhd/core.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+CPPMHD_NAMESPACE_BEGIN
+
+struct SseOptions {
+    // bytes of events queued for a subscriber that does not read them, it is evicted beyond them
+    size_t maxQueued = 1024 * 1024;
+    // seconds between the comments that keep idle streams open and find the clients that went away, 0 for none
+    uint32_t heartbeat = 15;
+};
+
+class SseStream;
+
+// the topics of Server-Sent Events. an event is serialized once and the subscribers of its topic share the buffer.
+// thread safe, publish may be called from any thread
+class SseHub
+{
+    struct Topic {
+        std::mutex mutex;
+        std::unordered_set<SseStream*> streams;
+    };
+
+    const SseOptions options_;
+
+    std::mutex mutex_;
+    std::unordered_map<std::string, std::shared_ptr<Topic>> topics_;
+    // every stream, once
+    std::unordered_set<SseStream*> streams_;
+    std::atomic<uint64_t> evicted_;
+
+    std::condition_variable cv_;
+    bool stopping_;
+    std::thread heartbeat_;
+
+    void beat();
+
+  public:
+    explicit SseHub(const SseOptions& options = SseOptions());
+
+    SseHub(const SseHub&) = delete;
+
+    ~SseHub();
+
+    // one event to the subscribers of topic, the lines of data become data fields. event and id are left out when
+    // empty. returns the subscribers it was queued for, the ones with too much queued already are evicted instead
+    size_t publish(const std::string& topic,
+                   const std::string& data,
+                   const std::string& event = std::string(),
+                   const std::string& id = std::string());
+
+    size_t subscribers(const std::string& topic);
+
+    // the subscribers evicted as slow consumers so far
+    uint64_t evicted() const
+    {
+        return evicted_;
+    }
+
+    const SseOptions& options() const
+    {
+        return options_;
+    }
+
+    // the daemon adds a stream when its response is queued, and removes it when the connection ends
+    void subscribe(SseStream* stream, const std::vector<std::string>& topics);
+    void unsubscribe(SseStream* stream, const std::vector<std::string>& topics);
+};
+
+using SseHubPtr = std::shared_ptr<SseHub>;
+
+// answers a GET with a text/event-stream of the topics onSubscribe picks, until the client goes away or the App stops.
+// the connection leaves the admission count once subscribed
+class SseController : public HttpController
+{
+    SseHubPtr hub_;
+
+  public:
+    explicit SseController(SseHubPtr hub);
+
+    // the topics of the request. setting resp instead rejects it, eg: with a 403. no topic answers a 404
+    virtual void onSubscribe(HttpRequestPtr, std::vector<std::string>& topics, HttpResponsePtr& resp) = 0;
+
+    // never called, onSubscribe takes their place
+    virtual void onConnection(HttpRequestPtr, HttpResponsePtr&) override final;
+    virtual void onRequest(HttpRequestPtr, HttpResponsePtr&) override final;
+
+    const SseHubPtr& hub() const
+    {
+        return hub_;
+    }
+};
+
+CPPMHD_NAMESPACE_END
+
+#endif
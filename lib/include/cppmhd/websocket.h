@@ -0,0 +1,108 @@
+#ifndef CPPMHD_WEBSOCKET_H_
+#define CPPMHD_WEBSOCKET_H_
+
+#include <cppmhd/controller.h>
+#include <cppmhd/core.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+CPPMHD_NAMESPACE_BEGIN
+
+// the status codes of a Close frame, RFC 6455 7.4
+enum WebSocketCloseCode : uint16_t {
+    kWsNormalClosure = 1000,
+    kWsGoingAway = 1001,
+    kWsProtocolError = 1002,
+    kWsUnsupportedData = 1003,
+    // sent by nobody, the Close frame had no code
+    kWsNoStatus = 1005,
+    // sent by nobody, the connection was lost without a Close frame
+    kWsAbnormalClosure = 1006,
+    kWsInvalidPayload = 1007,
+    kWsPolicyViolation = 1008,
+    kWsMessageTooBig = 1009,
+    kWsInternalError = 1011
+};
+
+// an upgraded connection. send, ping and close may be called from any thread, also after the connection is closed
+class WebSocket
+{
+    void* userdp_;
+
+  public:
+    WebSocket() : userdp_(nullptr) {}
+
+    virtual ~WebSocket();
+
+    // one message, compressed when permessage-deflate was negotiated. false once the connection is closing, or when
+    // the client does not read what is already queued for it
+    virtual bool send(const void* data, size_t size, bool binary) = 0;
+
+    bool send(const std::string& text)
+    {
+        return send(text.data(), text.length(), false);
+    }
+
+    virtual bool ping(const std::string& payload) = 0;
+
+    // starts the closing handshake, WebSocketController::onClose follows when the client answers it
+    virtual void close(uint16_t code, const std::string& reason) = 0;
+
+    void close()
+    {
+        close(kWsNormalClosure, std::string());
+    }
+
+    virtual bool isOpen() const = 0;
+
+    void userdata(void* data)
+    {
+        userdp_ = data;
+    }
+
+    void* userdata()
+    {
+        return userdp_;
+    }
+};
+
+using WebSocketPtr = std::shared_ptr<WebSocket>;
+
+// answers the WebSocket handshake of its route with a 101 and takes the connection over from HTTP. the frames of
+// all the websockets of an App are read on one thread, where the callbacks run: they must not block
+class WebSocketController : public HttpController
+{
+  public:
+    // checks the handshake: Upgrade: websocket, Sec-WebSocket-Key and Sec-WebSocket-Version: 13. a request that is
+    // not one gets a 426, or a 400 if the key is missing
+    virtual void onConnection(HttpRequestPtr, HttpResponsePtr&) override;
+
+    // never called, onConnection answers every request
+    virtual void onRequest(HttpRequestPtr, HttpResponsePtr&) override;
+
+    // whether a valid handshake is accepted, eg: after checking Origin or a token. false answers a 403
+    virtual bool accept(HttpRequestPtr);
+
+    // the request is only valid during the call
+    virtual void onOpen(WebSocketPtr, HttpRequestPtr);
+
+    // a whole message, decompressed. a text message is valid UTF-8. data is only valid during the call
+    virtual void onMessage(WebSocketPtr, const char* data, size_t size, bool binary) = 0;
+
+    // the connection is closed, with the code of the client, kWsAbnormalClosure if it went away without one, or the
+    // one the server failed the connection with
+    virtual void onClose(WebSocketPtr, uint16_t code);
+
+    // bytes of a message, a larger one closes the connection with kWsMessageTooBig
+    virtual size_t maxMessageSize() const;
+
+    // permessage-deflate is negotiated when the client offers it, without context takeover. needs cppmhd built with
+    // zlib
+    virtual bool compression() const;
+};
+
+CPPMHD_NAMESPACE_END
+
+#endif
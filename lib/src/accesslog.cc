@@ -0,0 +1,345 @@
+#include "accesslog.h"
+
+#include <fmt/chrono.h>
+
+#include <chrono>
+#include <cstring>
+
+#include "logger.h"
+#include "utils.h"
+
+CPPMHD_NAMESPACE_BEGIN
+
+namespace
+{
+constexpr auto kIdleWait = std::chrono::milliseconds(50);
+constexpr size_t kFlushSize = 64 * 1024;
+
+// xorshift64*, one per server thread
+thread_local uint64_t sampleState = 0;
+
+inline uint32_t nextRandom()
+{
+    auto x = sampleState;
+    if (unlikely(x == 0)) {
+        x = static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count())
+            ^ reinterpret_cast<uintptr_t>(&sampleState);
+        x |= 1;
+    }
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    sampleState = x;
+    return static_cast<uint32_t>((x * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+void appendEscaped(fmt::memory_buffer &out, const char *str, size_t length)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    auto begin = str;
+    for (auto p = str; p < str + length; p++) {
+        auto c = static_cast<unsigned char>(*p);
+        if (likely(c >= 0x20 && c != '"' && c != '\\')) {
+            continue;
+        }
+
+        out.append(begin, p);
+        if (c == '"' || c == '\\') {
+            char esc[2] = {'\\', static_cast<char>(c)};
+            out.append(esc, esc + 2);
+        } else {
+            char esc[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf]};
+            out.append(esc, esc + 6);
+        }
+        begin = p + 1;
+    }
+    out.append(begin, str + length);
+}
+
+}  // namespace
+
+void AccessRecord::setClient(const sockaddr *sa)
+{
+    family = 0;
+    port = 0;
+    memset(addr, 0, sizeof(addr));
+
+    if (unlikely(sa == nullptr)) {
+        return;
+    }
+
+    if (sa->sa_family == AF_INET) {
+        auto in = reinterpret_cast<const sockaddr_in *>(sa);
+        family = 4;
+        port = in->sin_port;
+        memcpy(addr, &in->sin_addr, sizeof(in->sin_addr));
+    } else if (sa->sa_family == AF_INET6) {
+        auto in6 = reinterpret_cast<const sockaddr_in6 *>(sa);
+        family = 6;
+        port = in6->sin6_port;
+        memcpy(addr, &in6->sin6_addr, sizeof(in6->sin6_addr));
+    }
+}
+
+AccessLog::AccessLog(const AccessLogOptions &options, const std::vector<RouteInfo> &routes)
+    : options_(options),
+      routes_(routes),
+      rings_(options.bufferSize),
+      file_(nullptr),
+      running_(false),
+      lastSecond_(0),
+      reportedDrop_(0)
+{
+    auto rate = options.sampleRate;
+    if (rate >= 1.0) {
+        threshold_ = 1ULL << 32;
+    } else if (rate <= 0.0) {
+        threshold_ = 0;
+    } else {
+        threshold_ = static_cast<uint64_t>(rate * 4294967296.0);
+    }
+    lastTime_[0] = '\0';
+}
+
+AccessLog::~AccessLog()
+{
+    if (running_) {
+        running_ = false;
+        cv_.notify_one();
+        writer_.join();
+    }
+
+    if (file_ != nullptr) {
+        fclose(file_);
+    }
+}
+
+bool AccessLog::open()
+{
+    file_ = fopen(options_.path.c_str(), "ab");
+    if (file_ == nullptr) {
+        LOG_ERROR("open access log '{}' failed: {}", options_.path, strerror(errno));
+        return false;
+    }
+
+    if (options_.format == AccessLogFormat::BINARY) {
+        writeRouteTable();
+    }
+
+    running_ = true;
+    writer_ = std::thread(&AccessLog::run, this);
+
+    LOG_INFO("access log '{}', sample rate {}", options_.path, options_.sampleRate);
+    return true;
+}
+
+bool AccessLog::sampled()
+{
+    if (likely(threshold_ > 0xffffffffULL)) {
+        return true;
+    }
+    return threshold_ != 0 && nextRandom() < threshold_;
+}
+
+void AccessLog::record(AccessRecord &rec, const char *path, const AccessTiming *timing)
+{
+    auto length = path == nullptr ? 0 : strlen(path);
+    if (unlikely(length > kMaxPath)) {
+        length = kMaxPath;
+    }
+    rec.pathLength = static_cast<uint16_t>(length);
+
+    size_t extra = 0;
+    if (timing != nullptr) {
+        rec.flags |= AccessRecord::kHasTiming;
+        extra = sizeof(*timing);
+    }
+
+    auto size = sizeof(rec) + extra + length;
+    auto local = rings_.local();
+    auto ptr = local->ring.reserve(size);
+
+    if (unlikely(ptr == nullptr)) {
+        local->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    memcpy(ptr, &rec, sizeof(rec));
+    if (extra != 0) {
+        memcpy(ptr + sizeof(rec), timing, extra);
+    }
+    memcpy(ptr + sizeof(rec) + extra, path, length);
+    local->ring.commit(size);
+}
+
+void AccessLog::writeRouteTable()
+{
+    fmt::memory_buffer table;
+    uint32_t count = static_cast<uint32_t>(routes_.size());
+    table.append(reinterpret_cast<const char *>(&count), reinterpret_cast<const char *>(&count + 1));
+
+    for (const auto &r : routes_) {
+        uint16_t method = static_cast<uint16_t>(r.method);
+        uint16_t length = static_cast<uint16_t>(r.pattern.size());
+        table.append(reinterpret_cast<const char *>(&r.id), reinterpret_cast<const char *>(&r.id + 1));
+        table.append(reinterpret_cast<const char *>(&method), reinterpret_cast<const char *>(&method + 1));
+        table.append(reinterpret_cast<const char *>(&length), reinterpret_cast<const char *>(&length + 1));
+        table.append(r.pattern.data(), r.pattern.data() + length);
+    }
+
+    BlockHeader header{kRouteTable, static_cast<uint32_t>(table.size())};
+    fwrite(&header, sizeof(header), 1, file_);
+    fwrite(table.data(), 1, table.size(), file_);
+    fflush(file_);
+}
+
+void AccessLog::format(const AccessRecord &rec, const AccessTiming *timing, const char *path)
+{
+    if (options_.format == AccessLogFormat::BINARY) {
+        auto extra = timing == nullptr ? 0 : sizeof(*timing);
+        BlockHeader header{kRequest, static_cast<uint32_t>(sizeof(rec) + extra + rec.pathLength)};
+        out_.append(reinterpret_cast<const char *>(&header), reinterpret_cast<const char *>(&header + 1));
+        out_.append(reinterpret_cast<const char *>(&rec), reinterpret_cast<const char *>(&rec + 1));
+        if (timing != nullptr) {
+            out_.append(reinterpret_cast<const char *>(timing), reinterpret_cast<const char *>(timing + 1));
+        }
+        out_.append(path, path + rec.pathLength);
+        return;
+    }
+
+    auto second = static_cast<time_t>(rec.timestamp / 1000000);
+    if (second != lastSecond_) {
+        lastSecond_ = second;
+        auto end = fmt::format_to_n(lastTime_, sizeof(lastTime_) - 1, "{:%Y-%m-%dT%H:%M:%S}", fmt::gmtime(second)).out;
+        *end = '\0';
+    }
+
+    auto method = httpMethodName(static_cast<HttpMethod>(rec.method));
+    fmt::format_to(std::back_inserter(out_),
+                   "{{\"time\":\"{}.{:06}Z\",\"method\":\"{}\",\"path\":\"",
+                   lastTime_,
+                   rec.timestamp % 1000000,
+                   method == nullptr ? "UNKNOWN" : method);
+    appendEscaped(out_, path, rec.pathLength);
+
+    out_.push_back('"');
+    if (rec.route < routes_.size()) {
+        static const char route[] = ",\"route\":\"";
+        out_.append(route, route + sizeof(route) - 1);
+        const auto &pattern = routes_[rec.route].pattern;
+        appendEscaped(out_, pattern.data(), pattern.size());
+        out_.push_back('"');
+    }
+
+    fmt::format_to(std::back_inserter(out_),
+                   ",\"status\":{},\"bytes_in\":{},\"bytes_out\":{},\"latency_us\":{}",
+                   rec.status,
+                   rec.bytesIn,
+                   rec.bytesOut,
+                   rec.latency);
+
+    if (rec.family != 0) {
+        char buffer[INET6_ADDRSTRLEN + 1];
+        auto af = rec.family == 4 ? AF_INET : AF_INET6;
+        if (inet_ntop(af, const_cast<uint8_t *>(rec.addr), buffer, sizeof(buffer)) != nullptr) {
+            fmt::format_to(std::back_inserter(out_),
+                           rec.family == 4 ? ",\"client\":\"{}:{}\"" : ",\"client\":\"[{}]:{}\"",
+                           buffer,
+                           ntohs(rec.port));
+        }
+    }
+
+    if (rec.termination != 0) {
+        fmt::format_to(std::back_inserter(out_), ",\"termination\":{}", rec.termination);
+    }
+
+    if (timing != nullptr) {
+        static const char begin[] = ",\"timing\":{";
+        out_.append(begin, begin + sizeof(begin) - 1);
+        for (auto i = 0u; i < kTimingSpanCount; i++) {
+            fmt::format_to(std::back_inserter(out_), "\"{}_us\":{},", timingSpans[i].name, timing->span[i]);
+        }
+        fmt::format_to(std::back_inserter(out_), "\"data_rounds\":{}}}", timing->dataRounds);
+    }
+
+    static const char end[] = "}\n";
+    out_.append(end, end + sizeof(end) - 1);
+}
+
+void AccessLog::flush()
+{
+    if (out_.size() > 0) {
+        fwrite(out_.data(), 1, out_.size(), file_);
+        fflush(file_);
+        out_.clear();
+    }
+}
+
+size_t AccessLog::drain(std::vector<SpscRingSet::RingPtr> &rings)
+{
+    size_t total = 0;
+
+    for (auto &r : rings) {
+        auto &ring = r->ring;
+        auto cursor = ring.begin();
+        const char *data;
+        size_t size;
+
+        while (ring.next(cursor, data, size)) {
+            AccessRecord rec;
+            memcpy(&rec, data, sizeof(rec));
+            data += sizeof(rec);
+
+            if (rec.flags & AccessRecord::kHasTiming) {
+                AccessTiming timing;
+                memcpy(&timing, data, sizeof(timing));
+                format(rec, &timing, data + sizeof(timing));
+            } else {
+                format(rec, nullptr, data);
+            }
+            total++;
+
+            if (out_.size() >= kFlushSize) {
+                flush();
+            }
+        }
+
+        ring.release(cursor);
+    }
+
+    flush();
+    return total;
+}
+
+void AccessLog::run()
+{
+    std::vector<SpscRingSet::RingPtr> rings;
+    uint64_t version = ~static_cast<uint64_t>(0);
+
+    while (true) {
+        rings_.snapshot(rings, version);
+
+        if (drain(rings) > 0) {
+            continue;
+        }
+
+        auto dropped = rings_.dropped();
+        if (unlikely(dropped > reportedDrop_)) {
+            LOG_WARN("access log dropped {} records, the writer can not keep up", dropped - reportedDrop_);
+            reportedDrop_ = dropped;
+        }
+
+        if (!running_) {
+            break;
+        }
+
+        rings_.retire();
+
+        // server threads never wake the writer, a record waits at most kIdleWait
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait_for(lock, kIdleWait);
+    }
+}
+
+CPPMHD_NAMESPACE_END
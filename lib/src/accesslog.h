@@ -0,0 +1,131 @@
+#ifndef CPPMHD_INTERNAL_ACCESSLOG_H_
+#define CPPMHD_INTERNAL_ACCESSLOG_H_
+
+#include "config.h"
+
+#include <cppmhd/app.h>
+
+#include <fmt/format.h>
+
+#include <condition_variable>
+#include <cstdio>
+#include <thread>
+
+#include "core.h"
+#include "ringset.h"
+#include "router.h"
+#include "timing.h"
+
+struct sockaddr;
+
+CPPMHD_NAMESPACE_BEGIN
+
+// one request, as pushed by the server threads. the path follows the record in the ring.
+//
+// the BINARY format writes the same bytes to the file: every block is a BlockHeader followed by its payload.
+// the first block of every run is a route table (kRouteTable): uint32 count, then per route
+// {uint32 id, uint16 method, uint16 length, pattern}. each request is a kRequest block: AccessRecord, AccessTiming if
+// flags has kHasTiming, then the path. all integers are in host byte order, except port and addr which are in
+// network byte order.
+struct AccessRecord {
+    // unix epoch, microseconds
+    uint64_t timestamp;
+    uint64_t bytesIn;
+    uint64_t bytesOut;
+    // microseconds from the first callback to the completion of the request
+    uint32_t latency;
+    // RouteInfo::id
+    uint32_t route;
+    uint16_t status;
+    uint16_t method;
+    uint16_t port;
+    uint16_t pathLength;
+    uint8_t addr[16];
+    // 0: unknown, 4 or 6
+    uint8_t family;
+    // MHD_RequestTerminationCode
+    uint8_t termination;
+    uint8_t flags;
+    uint8_t reserved[5];
+
+    enum Flags : uint8_t { kHasTiming = 1 };
+
+    void setClient(const sockaddr *);
+};
+
+static_assert(sizeof(AccessRecord) == 64, "AccessRecord is a part of the BINARY format");
+
+// the spans of timingSpans in microseconds, recorded with ENABLE_REQUEST_TIMING only
+struct AccessTiming {
+    uint32_t span[kTimingSpanCount];
+    uint32_t dataRounds;
+};
+
+static_assert(sizeof(AccessTiming) == 24, "AccessTiming is a part of the BINARY format");
+
+class AccessLog
+{
+  public:
+    enum BlockType : uint32_t { kRouteTable = 1, kRequest = 2 };
+
+    struct BlockHeader {
+        uint32_t type;
+        uint32_t length;
+    };
+
+    static constexpr size_t kMaxPath = 2048;
+
+  private:
+    const AccessLogOptions options_;
+    const std::vector<RouteInfo> &routes_;
+
+    // sampleRate scaled to 2^32
+    uint64_t threshold_;
+
+    SpscRingSet rings_;
+    FILE *file_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::atomic_bool running_;
+    std::thread writer_;
+
+    // the writer side
+    fmt::memory_buffer out_;
+    time_t lastSecond_;
+    char lastTime_[32];
+    uint64_t reportedDrop_;
+
+    void run();
+
+    size_t drain(std::vector<SpscRingSet::RingPtr> &rings);
+
+    void format(const AccessRecord &, const AccessTiming *, const char *path);
+
+    void writeRouteTable();
+
+    void flush();
+
+  public:
+    AccessLog(const AccessLogOptions &options, const std::vector<RouteInfo> &routes);
+
+    ~AccessLog();
+
+    // open the file and start the writer thread
+    bool open();
+
+    // whether this request is recorded, decided per server thread without any shared state
+    bool sampled();
+
+    // called on the server threads, never blocks. the record is dropped if the buffer of this thread is full
+    void record(AccessRecord &rec, const char *path, const AccessTiming *timing = nullptr);
+
+    uint64_t dropped()
+    {
+        return rings_.dropped();
+    }
+};
+
+CPPMHD_NAMESPACE_END
+
+#endif
@@ -0,0 +1,69 @@
+#include "admission.h"
+
+#include <cmath>
+
+#include "logger.h"
+
+CPPMHD_NAMESPACE_BEGIN
+
+Admission::Admission(const AdmissionOptions& options)
+    : maxConnections_(options.maxConnections),
+      maxInflight_(options.maxInflight),
+      target_(std::chrono::milliseconds(options.targetDelayMs)),
+      interval_(std::chrono::milliseconds(options.intervalMs == 0 ? 100 : options.intervalMs)),
+      connections_(0),
+      inflight_(0),
+      dropping_(false),
+      count_(0),
+      refused_(0),
+      shed_(0)
+{
+}
+
+bool Admission::admitRouted(RequestPriority priority, Clock::time_point now)
+{
+    if (likely(!dropping_) || priority == RequestPriority::HIGH) {
+        return true;
+    }
+
+    if (priority == RequestPriority::NORMAL) {
+        if (now < dropNext_) {
+            return true;
+        }
+
+        // control law of CoDel: the gap between two drops shrinks with the square root of the drop count
+        count_++;
+        auto gap = std::chrono::duration<double>(interval_) / std::sqrt(static_cast<double>(count_));
+        dropNext_ = now + std::chrono::duration_cast<Clock::duration>(gap);
+    }
+
+    count(shed_);
+    return false;
+}
+
+void Admission::observe(Clock::time_point start, Clock::time_point now)
+{
+    if (now - start < target_) {
+        firstAbove_ = Clock::time_point();
+        if (unlikely(dropping_)) {
+            dropping_ = false;
+            LOG_INFO("queue delay back under {} ms, stop shedding",
+                     std::chrono::duration_cast<std::chrono::milliseconds>(target_).count());
+        }
+        return;
+    }
+
+    if (firstAbove_ == Clock::time_point()) {
+        firstAbove_ = now + interval_;
+    } else if (!dropping_ && now >= firstAbove_) {
+        dropping_ = true;
+        // an overload coming back soon resumes close to the last drop rate
+        count_ = count_ > 2 && now - dropNext_ < interval_ * 16 ? count_ - 2 : 0;
+        dropNext_ = now;
+        LOG_WARN("queue delay above {} ms for {} ms, shedding requests",
+                 std::chrono::duration_cast<std::chrono::milliseconds>(target_).count(),
+                 std::chrono::duration_cast<std::chrono::milliseconds>(interval_).count());
+    }
+}
+
+CPPMHD_NAMESPACE_END
@@ -0,0 +1,141 @@
+#ifndef CPPMHD_INTERNAL_ADMISSION_H_
+#define CPPMHD_INTERNAL_ADMISSION_H_
+
+#include "config.h"
+
+#include <cppmhd/app.h>
+#include <cppmhd/controller.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "core.h"
+
+CPPMHD_NAMESPACE_BEGIN
+
+// admission control of one MHD daemon. the request state is only used by the thread of the daemon. the connection
+// count is not: MHD_add_connection runs MHDAcceptCB on the acceptor thread of the added listeners, while the daemon
+// counts opened and closed connections on its own. the counters are read by a scrape, inflight by a drain.
+//
+// the queue delay is the time a request stays in the server, from its first callback to completed. all connections
+// of a daemon share one event loop, so under overload every request waits longer for each of its rounds. as in CoDel
+// only the smallest delay of an interval counts: slow handlers alone make no standing queue as long as other requests
+// still get through quickly.
+class Admission
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+  private:
+    const uint32_t maxConnections_;
+    const uint32_t maxInflight_;
+    const Clock::duration target_;
+    const Clock::duration interval_;
+
+    std::atomic<uint32_t> connections_;
+    // written by the thread of the daemon only
+    std::atomic<uint32_t> inflight_;
+
+    // CoDel state. firstAbove_ is the end of the interval the delay has to stay above the target for
+    bool dropping_;
+    uint32_t count_;
+    Clock::time_point firstAbove_;
+    Clock::time_point dropNext_;
+
+    std::atomic<uint64_t> refused_;
+    std::atomic<uint64_t> shed_;
+
+    static void count(std::atomic<uint64_t>& counter)
+    {
+        counter.fetch_add(1, std::memory_order_relaxed);
+    }
+
+  public:
+    explicit Admission(const AdmissionOptions& options);
+
+    // from MHDAcceptCB, before MHD creates the connection. the limit is loose: the connections the acceptor adds
+    // before the daemon counted them as opened may go over it
+    bool acceptConnection()
+    {
+        if (maxConnections_ != 0 && connections_.load(std::memory_order_relaxed) >= maxConnections_) {
+            count(refused_);
+            return false;
+        }
+        return true;
+    }
+
+    void connectionOpened()
+    {
+        connections_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void connectionClosed()
+    {
+        auto n = connections_.load(std::memory_order_relaxed);
+        while (likely(n > 0) && !connections_.compare_exchange_weak(n, n - 1, std::memory_order_relaxed)) {
+        }
+    }
+
+    // first callback of a request, before anything is allocated for it. every admitted request must be released
+    bool admit()
+    {
+        auto inflight = inflight_.load(std::memory_order_relaxed);
+        if (maxInflight_ != 0 && inflight >= maxInflight_) {
+            count(shed_);
+            return false;
+        }
+        inflight_.store(inflight + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    void release()
+    {
+        auto inflight = inflight_.load(std::memory_order_relaxed);
+        if (likely(inflight > 0)) {
+            inflight_.store(inflight - 1, std::memory_order_relaxed);
+        }
+    }
+
+    bool delayControl() const
+    {
+        return target_ != Clock::duration::zero();
+    }
+
+    // after routing. false if the queue delay control sheds a request of this priority
+    bool admitRouted(RequestPriority priority, Clock::time_point now);
+
+    // queue delay of a request that was served. the ones shed by admitRouted are too quick to tell anything
+    void observe(Clock::time_point start, Clock::time_point now);
+
+    bool dropping() const
+    {
+        return dropping_;
+    }
+
+    uint32_t connections() const
+    {
+        return connections_.load(std::memory_order_relaxed);
+    }
+
+    uint32_t inflight() const
+    {
+        return inflight_.load(std::memory_order_relaxed);
+    }
+
+    // connections closed by acceptConnection
+    uint64_t refused() const
+    {
+        return refused_.load(std::memory_order_relaxed);
+    }
+
+    // requests rejected by admit and admitRouted
+    uint64_t shed() const
+    {
+        return shed_.load(std::memory_order_relaxed);
+    }
+};
+
+CPPMHD_NAMESPACE_END
+
+#endif
@@ -8,7 +8,9 @@
 #include <cassert>
 
 #include "http.h"
+#include "listen.h"
 #include "logger.h"
+#include "metrics.h"
 #include "router.h"
 #include "utils.h"
 
@@ -169,6 +171,7 @@ App::App(const std::string& addr, uint16_t port) : address_(addr), port_(port)
     http_ = nullptr;
 
     threadCount_ = getNProc();
+    maxBodySize_ = 0;
     eh = defaultEH;
     {
         std::lock_guard<std::mutex> _(AppManager::manager.handlersMutex);
@@ -179,11 +182,19 @@ App::App(const std::string& addr, uint16_t port) : address_(addr), port_(port)
 int App::start(const std::function<void(void)>& cb)
 {
     InetAddress addr;
-    if (InetAddress::parse(addr, address_, port_)) {
+    if (unixPath(address_).length() != 0 || InetAddress::parse(addr, address_, port_)) {
+        MetricsController* metrics = nullptr;
+        if (metrics_.enable) {
+            metrics = builder_.add<MetricsController>(HttpMethod::GET, metrics_.path);
+        }
+
         Router r(std::move(builder_));
 
         if (r.build()) {
-            http_ = new HttpImplement(addr, std::move(r), host_, eh);
+            http_ = new HttpImplement(addr, std::move(r), *this);
+            if (metrics != nullptr) {
+                metrics->attach(http_->metrics());
+            }
 
             if (!AppManager::manager.have(SIGINT)) {
                 setSignalHandler(SIGINT, [](App& app, int) {
@@ -217,7 +228,33 @@ int App::start()
 void App::stop()
 {
     if (isRunning())
-        http_->stop();
+        http_->stop(false);
+}
+
+void App::drain()
+{
+    if (isRunning()) {
+        http_->stop(true);
+    }
+}
+
+bool App::addListener(const std::string& name, const std::string& address, uint16_t port)
+{
+    if (isRunning() || name == listen_.name || listeners_.size() + 1 >= kMaxListeners) {
+        return false;
+    }
+    for (auto& l : listeners_) {
+        if (l.name == name) {
+            return false;
+        }
+    }
+    listeners_.push_back(Listener{name, address, port});
+    return true;
+}
+
+bool App::restart(const std::vector<std::string>& argv)
+{
+    return isRunning() && http_->restart(argv);
 }
 
 
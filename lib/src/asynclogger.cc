@@ -0,0 +1,330 @@
+#include "config.h"
+
+#include <cppmhd/logger.h>
+
+#ifdef ON_UNIX
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+
+#include "logger.h"
+#include "ringset.h"
+
+CPPMHD_NAMESPACE_BEGIN
+
+namespace log
+{
+namespace
+{
+constexpr size_t kMaxBatch = 64;
+constexpr auto kIdleWait = std::chrono::milliseconds(20);
+
+#ifndef ON_UNIX
+struct iovec {
+    void* iov_base;
+    size_t iov_len;
+};
+#endif
+
+void writeAll(int fd, struct iovec* iov, int count)
+{
+#ifdef ON_UNIX
+    while (count > 0) {
+        auto w = ::writev(fd, iov, count);
+        if (unlikely(w < 0)) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+
+        size_t written = static_cast<size_t>(w);
+        while (count > 0 && written >= iov->iov_len) {
+            written -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + written;
+            iov->iov_len -= written;
+        }
+    }
+#else
+    auto out = fd == 2 ? stderr : stdout;
+    for (int i = 0; i < count; i++) {
+        fwrite(iov[i].iov_base, 1, iov[i].iov_len, out);
+    }
+    std::fflush(out);
+#endif
+}
+
+}  // namespace
+
+class AsyncLoggerImpl
+{
+    const int fd_;
+    const OverflowPolicy policy_;
+
+    SpscRingSet rings_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::condition_variable flushed_;
+    // kBlock producers wait there for the writer to release room in their ring
+    std::condition_variable space_;
+
+    std::atomic_bool running_;
+    std::atomic_bool sleeping_;
+    // producers waiting on space_
+    std::atomic<uint32_t> blocked_;
+    uint64_t reportedDrop_;
+
+    std::thread writer_;
+
+    void wakeWriter()
+    {
+        // pairs with the fence of run: either the writer sees the record committed, or this sees it asleep
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeping_.load(std::memory_order_relaxed)) {
+            // the writer holds the mutex from setting sleeping_ until it waits, the notify can not fall in between
+            std::lock_guard<std::mutex> _(mutex_);
+            cv_.notify_one();
+        }
+    }
+
+    void wakeProducers()
+    {
+        // pairs with the fence of push: either the producer sees the room released, or this sees it blocked
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (blocked_.load(std::memory_order_relaxed) != 0) {
+            std::lock_guard<std::mutex> _(mutex_);
+            space_.notify_all();
+        }
+    }
+
+    // write one batch of every ring, returns the number of records written
+    size_t drain(std::vector<SpscRingSet::RingPtr>& rings);
+
+    void reportDrop();
+
+    void run();
+
+  public:
+    AsyncLoggerImpl(int fd, OverflowPolicy policy, size_t ringSize)
+        : fd_(fd),
+          policy_(policy),
+          rings_(ringSize),
+          running_(true),
+          sleeping_(false),
+          blocked_(0),
+          reportedDrop_(0)
+    {
+        writer_ = std::thread(&AsyncLoggerImpl::run, this);
+    }
+
+    ~AsyncLoggerImpl()
+    {
+        {
+            std::lock_guard<std::mutex> _(mutex_);
+            running_ = false;
+            cv_.notify_one();
+            space_.notify_all();
+        }
+        if (writer_.joinable()) {
+            writer_.join();
+        }
+    }
+
+    uint64_t dropped()
+    {
+        return rings_.dropped();
+    }
+
+    void push(const char* data, size_t size);
+
+    void flush();
+};
+
+void AsyncLoggerImpl::push(const char* data, size_t size)
+{
+    auto tr = rings_.local();
+    auto& r = tr->ring;
+
+    size = std::min(size, r.maxRecord());
+
+    while (true) {
+        auto ptr = r.reserve(size);
+        if (likely(ptr != nullptr)) {
+            memcpy(ptr, data, size);
+            r.commit(size);
+            wakeWriter();
+            return;
+        }
+
+        if (policy_ == OverflowPolicy::kDrop || unlikely(!running_)) {
+            tr->dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        // kBlock: wait for the writer to release room, the reserve is tried again under the lock it notifies with
+        blocked_.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            ptr = r.reserve(size);
+            if (ptr == nullptr && running_) {
+                cv_.notify_one();
+                space_.wait_for(lock, kIdleWait);
+            }
+        }
+        blocked_.fetch_sub(1, std::memory_order_relaxed);
+
+        if (ptr != nullptr) {
+            memcpy(ptr, data, size);
+            r.commit(size);
+            wakeWriter();
+            return;
+        }
+    }
+}
+
+size_t AsyncLoggerImpl::drain(std::vector<SpscRingSet::RingPtr>& rings)
+{
+    struct iovec iov[kMaxBatch];
+    size_t total = 0;
+
+    // round-robin, run calls it again while records are written: a busy producer does not hold back the others
+    for (auto& tr : rings) {
+        auto& r = tr->ring;
+        if (r.empty()) {
+            continue;
+        }
+
+        auto cursor = r.begin();
+        int count = 0;
+        const char* data;
+        size_t size;
+
+        // the payloads are written straight out of the ring, and handed back to the producer after that
+        while (count < static_cast<int>(kMaxBatch) && r.next(cursor, data, size)) {
+            iov[count].iov_base = const_cast<char*>(data);
+            iov[count].iov_len = size;
+            count++;
+        }
+
+        if (count > 0) {
+            writeAll(fd_, iov, count);
+            total += count;
+        }
+        r.release(cursor);
+    }
+
+    if (total > 0 && policy_ == OverflowPolicy::kBlock) {
+        wakeProducers();
+    }
+    return total;
+}
+
+void AsyncLoggerImpl::reportDrop()
+{
+    auto count = dropped();
+    auto last = reportedDrop_;
+    if (unlikely(count > last)) {
+        reportedDrop_ = count;
+        fmt::memory_buffer line;
+        auto message = fmt::format("{} log records dropped, ring buffer full", count - last);
+        formatLine(line, kWarning, "AsyncLogger", __LINE__, message.c_str());
+
+        struct iovec iov;
+        iov.iov_base = line.data();
+        iov.iov_len = line.size();
+        writeAll(fd_, &iov, 1);
+    }
+}
+
+void AsyncLoggerImpl::run()
+{
+    std::vector<SpscRingSet::RingPtr> rings;
+    uint64_t version = ~static_cast<uint64_t>(0);
+
+    while (true) {
+        rings_.snapshot(rings, version);
+
+        if (drain(rings) > 0) {
+            continue;
+        }
+
+        if (policy_ == OverflowPolicy::kDrop) {
+            reportDrop();
+        }
+
+        flushed_.notify_all();
+
+        if (!running_) {
+            break;
+        }
+
+        rings_.retire();
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        sleeping_.store(true, std::memory_order_relaxed);
+        // pairs with the fence of wakeWriter: a record committed before the producer saw sleeping_ unset is seen here
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (running_ && rings_.empty()) {
+            cv_.wait_for(lock, kIdleWait);
+        }
+        sleeping_.store(false, std::memory_order_relaxed);
+    }
+}
+
+void AsyncLoggerImpl::flush()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (running_ && !rings_.empty()) {
+        cv_.notify_one();
+        flushed_.wait_for(lock, kIdleWait);
+    }
+}
+
+AsyncLogger::AsyncLogger(int fd, OverflowPolicy policy, size_t ringSize)
+{
+    impl_ = new AsyncLoggerImpl(fd, policy, ringSize);
+}
+
+AsyncLogger::~AsyncLogger()
+{
+    delete impl_;
+}
+
+void AsyncLogger::output(enum LogLevel lv, const char*, const char* func, int line, const char* message)
+{
+#ifdef NDEBUG
+    if (lv >= getLevel() && lv <= kFatal) {
+#else
+    if (lv >= getLevel() && lv <= LV_DTRACE) {
+#endif
+        fmt::memory_buffer all;
+        formatLine(all, lv, func, line, message);
+        impl_->push(all.data(), all.size());
+    }
+}
+
+void AsyncLogger::fflush()
+{
+    impl_->flush();
+}
+
+uint64_t AsyncLogger::dropped() const
+{
+    return impl_->dropped();
+}
+
+}  // namespace log
+
+CPPMHD_NAMESPACE_END
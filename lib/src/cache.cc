@@ -0,0 +1,177 @@
+#include "cache.h"
+
+#include <algorithm>
+
+CPPMHD_NAMESPACE_BEGIN
+
+ResponseCache::ResponseCache(size_t capacity, size_t shards)
+{
+    shards = std::max<size_t>(shards, 1);
+    shardCapacity_ = capacity / shards;
+    for (size_t i = 0; i < shards; i++) {
+        shards_.emplace_back(new Shard());
+    }
+}
+
+ResponseCache::ResponsePtr ResponseCache::own(MHD_Response *response)
+{
+    return ResponsePtr(response, [](MHD_Response *r) {
+        if (r != nullptr) {
+            MHD_destroy_response(r);
+        }
+    });
+}
+
+void ResponseCache::erase(Shard &s, std::list<Entry>::iterator it)
+{
+    s.bytes -= it->bytes;
+    s.index.erase(it->key);
+    s.lru.erase(it);
+}
+
+void ResponseCache::wake(Shard &s, uint64_t key)
+{
+    auto it = s.pending.find(key);
+    if (it == s.pending.end()) {
+        return;
+    }
+    for (auto waiter : it->second) {
+        waiter->resume();
+    }
+    s.pending.erase(it);
+}
+
+ResponseCache::Result ResponseCache::lookup(uint64_t key, Clock::time_point now, HttpRequest *waiter, Cached &cached)
+{
+    auto &s = shard(key);
+    std::lock_guard<std::mutex> lock(s.mutex);
+
+    auto it = s.index.find(key);
+    if (it != s.index.end()) {
+        auto &e = *it->second;
+        if (now < e.fresh) {
+            s.lru.splice(s.lru.begin(), s.lru, it->second);
+            cached = e.cached;
+            return Result::HIT;
+        }
+        if (now < e.stale) {
+            s.lru.splice(s.lru.begin(), s.lru, it->second);
+            if (waiter == nullptr || s.closed || s.pending.find(key) != s.pending.end()) {
+                cached = e.cached;
+                return Result::HIT;
+            }
+            // this one refreshes it, the others keep getting it meanwhile
+            s.pending[key];
+            return Result::LEAD;
+        }
+        erase(s, it->second);
+    }
+
+    if (waiter == nullptr || s.closed) {
+        return Result::MISS;
+    }
+    auto p = s.pending.find(key);
+    if (p == s.pending.end()) {
+        s.pending[key];
+        return Result::LEAD;
+    }
+    // paused with the lock held, the leader can not resume it before
+    if (!waiter->pause()) {
+        return Result::MISS;
+    }
+    p->second.push_back(waiter);
+    return Result::WAIT;
+}
+
+void ResponseCache::store(uint64_t key, Cached &&cached, size_t bytes, Clock::time_point fresh, Clock::time_point stale)
+{
+    auto &s = shard(key);
+    std::lock_guard<std::mutex> lock(s.mutex);
+
+    auto it = s.index.find(key);
+    if (it != s.index.end()) {
+        erase(s, it->second);
+    }
+
+    bytes += sizeof(Entry) + cached.etag.length() + cached.lastModified.length();
+    if (bytes <= shardCapacity_) {
+        while (s.bytes + bytes > shardCapacity_) {
+            erase(s, std::prev(s.lru.end()));
+        }
+        s.lru.push_front(Entry{key, std::move(cached), bytes, fresh, stale});
+        s.index[key] = s.lru.begin();
+        s.bytes += bytes;
+    }
+    wake(s, key);
+}
+
+void ResponseCache::redate(uint64_t key, const Cached &cached)
+{
+    auto &s = shard(key);
+    std::lock_guard<std::mutex> lock(s.mutex);
+
+    auto it = s.index.find(key);
+    if (it == s.index.end()) {
+        return;
+    }
+    auto &e = it->second->cached;
+    if (e.body == cached.body && e.second < cached.second) {
+        e.response = cached.response;
+        e.second = cached.second;
+    }
+}
+
+void ResponseCache::release(uint64_t key)
+{
+    auto &s = shard(key);
+    std::lock_guard<std::mutex> lock(s.mutex);
+    wake(s, key);
+}
+
+void ResponseCache::cancel(uint64_t key, HttpRequest *waiter)
+{
+    auto &s = shard(key);
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto it = s.pending.find(key);
+    if (it != s.pending.end()) {
+        auto &waiters = it->second;
+        waiters.erase(std::remove(waiters.begin(), waiters.end(), waiter), waiters.end());
+    }
+}
+
+void ResponseCache::close()
+{
+    for (auto &s : shards_) {
+        std::lock_guard<std::mutex> lock(s->mutex);
+        s->closed = true;
+        for (auto &p : s->pending) {
+            for (auto waiter : p.second) {
+                waiter->resume();
+            }
+        }
+        // the store or release of a leader still running finds no waiters
+        s->pending.clear();
+    }
+}
+
+size_t ResponseCache::size()
+{
+    size_t n = 0;
+    for (auto &s : shards_) {
+        std::lock_guard<std::mutex> lock(s->mutex);
+        n += s->lru.size();
+    }
+    return n;
+}
+
+size_t ResponseCache::bytes()
+{
+    size_t n = 0;
+    for (auto &s : shards_) {
+        std::lock_guard<std::mutex> lock(s->mutex);
+        n += s->bytes;
+    }
+    return n;
+}
+
+CPPMHD_NAMESPACE_END
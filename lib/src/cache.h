@@ -0,0 +1,132 @@
+#ifndef CPPMHD_INTERNAL_CACHE_H_
+#define CPPMHD_INTERNAL_CACHE_H_
+
+#include "config.h"
+
+#include <cppmhd/entity.h>
+
+#include <microhttpd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "compress.h"
+#include "core.h"
+#include "validator.h"
+
+CPPMHD_NAMESPACE_BEGIN
+
+// the 200s of the GETs of the routes opted in with HttpController::cachePolicy, as MHD responses queued as they are
+// for every request of their key in the second of their Date. the keys are spread over shards, each keeps its part of
+// the capacity in LRU order. a miss elects one request of the key to run the handler, the others wait for it or get
+// the stale response
+class ResponseCache
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+    using ResponsePtr = std::shared_ptr<MHD_Response>;
+
+    struct Cached {
+        // with the Date of second, nullptr until the first hit creates it
+        ResponsePtr response;
+        time_t second;
+        // the bytes and headers of response as sent, but the Date and Connection. a later second creates it again
+        CompressedBody body;
+        std::shared_ptr<const HttpResponse::HeaderType> sent;
+        std::string etag;
+        std::string lastModified;
+        // the headers a 304 for it repeats
+        KeptHeaders headers;
+        // of the body of response
+        uint64_t length;
+    };
+
+    enum class Result {
+        // fresh, or stale while another request refreshes it
+        HIT,
+        // the caller runs the handler, then stores or releases the key. the others wait or get the stale response
+        LEAD,
+        // the caller runs the handler, as it would without the cache
+        MISS,
+        // the request is paused until the leader stores or releases the key
+        WAIT
+    };
+
+  private:
+    struct Entry {
+        uint64_t key;
+        Cached cached;
+        size_t bytes;
+        // served as it is until fresh, then until stale while a leader refreshes it
+        Clock::time_point fresh;
+        Clock::time_point stale;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        // most recently used first
+        std::list<Entry> lru;
+        std::unordered_map<uint64_t, std::list<Entry>::iterator> index;
+        size_t bytes;
+        // the keys a leader runs the handler of, with the requests waiting for it
+        std::unordered_map<uint64_t, std::vector<HttpRequest *>> pending;
+        // no request waits or leads any more
+        bool closed;
+
+        Shard() : bytes(0), closed(false) {}
+    };
+
+    size_t shardCapacity_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+
+    Shard &shard(uint64_t key)
+    {
+        return *shards_[(key ^ (key >> 32)) % shards_.size()];
+    }
+
+    static void erase(Shard &s, std::list<Entry>::iterator it);
+
+    // resumes the waiters of the key, with the lock of the shard held
+    static void wake(Shard &s, uint64_t key);
+
+  public:
+    ResponseCache(size_t capacity, size_t shards);
+
+    // HIT fills cached. a waiter is paused with HttpRequest::pause, MISS if it can not be. nullptr neither waits nor
+    // leads
+    Result lookup(uint64_t key, Clock::time_point now, HttpRequest *waiter, Cached &cached);
+
+    // the response is destroyed with the last of its owners
+    static ResponsePtr own(MHD_Response *response);
+
+    // keeps the response and wakes the waiters of the key. bytes are the ones of its body and headers, a response
+    // larger than the capacity of a shard is not kept
+    void store(uint64_t key, Cached &&cached, size_t bytes, Clock::time_point fresh, Clock::time_point stale);
+
+    // the response of a later second, shared by the hits of that second. dropped if the key was stored again
+    void redate(uint64_t key, const Cached &cached);
+
+    // the leader has no response to keep, the waiters run the handler themselves
+    void release(uint64_t key);
+
+    // the connection of a waiter ends before it is woken
+    void cancel(uint64_t key, HttpRequest *waiter);
+
+    // the daemons stop, a suspended connection would outlive them: every waiter is woken to run the handler itself,
+    // as if its leader released the key. a later miss neither waits nor leads
+    void close();
+
+    // the entries and their bytes
+    size_t size();
+    size_t bytes();
+};
+
+CPPMHD_NAMESPACE_END
+
+#endif
@@ -0,0 +1,111 @@
+#include "clock.h"
+
+#include <fmt/chrono.h>
+#include <fmt/format.h>
+
+#include <atomic>
+
+CPPMHD_NAMESPACE_BEGIN
+
+namespace
+{
+// a writer never reuses the slot readers were handed out during the last kSlots - 1 seconds
+constexpr size_t kSlots = 4;
+
+struct ClockSlot {
+    // read by every caller while a writer may be refilling the slot after kSlots seconds
+    std::atomic<time_t> second;
+    char log[kLogTimestampLength + 1];
+    char date[kHttpDateLength + 1];
+};
+
+ClockSlot slots[kSlots];
+std::atomic<size_t> current(0);
+std::atomic_flag updating = ATOMIC_FLAG_INIT;
+
+const char* const weekdays[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+const char* const months[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+
+void fill(ClockSlot& slot, time_t second)
+{
+    slot.second.store(second, std::memory_order_relaxed);
+
+    auto local = fmt::localtime(second);
+    auto end = fmt::format_to_n(slot.log, kLogTimestampLength, "{:%Y-%m-%d %H:%M:%S}", local).out;
+    *end = '\0';
+
+    formatHttpDate(second, slot.date);
+}
+
+struct ClockInit {
+    ClockInit()
+    {
+        fill(slots[0], CoarseClock::now());
+    }
+} clockInit;
+
+const ClockSlot& refresh()
+{
+    auto index = current.load(std::memory_order_acquire);
+    auto& slot = slots[index];
+    auto now = CoarseClock::now();
+
+    if (likely(slot.second.load(std::memory_order_relaxed) == now)) {
+        return slot;
+    }
+
+    // somebody else is formatting this second, the previous one is still good enough
+    if (updating.test_and_set(std::memory_order_acquire)) {
+        return slot;
+    }
+
+    auto next = (index + 1) % kSlots;
+    fill(slots[next], now);
+    current.store(next, std::memory_order_release);
+    updating.clear(std::memory_order_release);
+
+    return slots[next];
+}
+
+}  // namespace
+
+time_t CoarseClock::now()
+{
+#ifdef HAVE_CLOCK_REALTIME_COARSE
+    struct timespec ts;
+    if (likely(clock_gettime(CLOCK_REALTIME_COARSE, &ts) == 0)) {
+        return ts.tv_sec;
+    }
+#endif
+    return time(nullptr);
+}
+
+const char* CoarseClock::logTimestamp()
+{
+    return refresh().log;
+}
+
+const char* CoarseClock::httpDate()
+{
+    return refresh().date;
+}
+
+void formatHttpDate(time_t second, char (&out)[kHttpDateLength + 1])
+{
+    // the names are fixed by RFC 7231, strftime would follow the locale
+    auto gmt = fmt::gmtime(second);
+    auto end = fmt::format_to_n(out,
+                                kHttpDateLength,
+                                "{}, {:02} {} {:04} {:02}:{:02}:{:02} GMT",
+                                weekdays[gmt.tm_wday],
+                                gmt.tm_mday,
+                                months[gmt.tm_mon],
+                                gmt.tm_year + 1900,
+                                gmt.tm_hour,
+                                gmt.tm_min,
+                                gmt.tm_sec)
+                   .out;
+    *end = '\0';
+}
+
+CPPMHD_NAMESPACE_END
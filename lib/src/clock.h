@@ -0,0 +1,37 @@
+#ifndef CPPMHD_INTERNAL_CLOCK_H_
+#define CPPMHD_INTERNAL_CLOCK_H_
+
+#include "config.h"
+
+#include <ctime>
+
+#include "core.h"
+
+CPPMHD_NAMESPACE_BEGIN
+
+constexpr size_t kLogTimestampLength = 19;  // 2006-01-02 15:04:05
+constexpr size_t kHttpDateLength = 29;      // Mon, 02 Jan 2006 15:04:05 GMT
+
+// process wide wall clock with one second resolution.
+//
+// the clock is read with CLOCK_REALTIME_COARSE where available. the formatted strings are rebuilt by the first
+// caller which sees a new second, all other callers get the preformatted text of the current second. the returned
+// pointers stay valid for a few seconds, long enough to copy them into a log line or a response header.
+class CoarseClock
+{
+  public:
+    static time_t now();
+
+    // local time as `%Y-%m-%d %H:%M:%S', NUL terminated
+    static const char* logTimestamp();
+
+    // IMF-fixdate of RFC 7231 for the Date header, NUL terminated
+    static const char* httpDate();
+};
+
+// IMF-fixdate of any second, NUL terminated
+void formatHttpDate(time_t second, char (&out)[kHttpDateLength + 1]);
+
+CPPMHD_NAMESPACE_END
+
+#endif
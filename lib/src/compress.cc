@@ -0,0 +1,644 @@
+#include "compress.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef ENABLE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef ENABLE_ZSTD
+#include <zstd.h>
+#endif
+
+#ifdef ENABLE_BROTLI
+#include <brotli/encode.h>
+#endif
+
+#include "logger.h"
+#include "utils.h"
+#include "validator.h"
+
+CPPMHD_NAMESPACE_BEGIN
+
+namespace
+{
+// bytes the output grows by when it is full
+constexpr size_t kOutputChunk = 16 * 1024;
+// bytes of a streamed body compressed at a time
+constexpr size_t kStreamChunk = 64 * 1024;
+
+const Encoding kPreferred[] = {Encoding::BROTLI, Encoding::ZSTD, Encoding::GZIP, Encoding::DEFLATE};
+
+// room at the end of out for the codec to write to, returns where it starts
+char *grow(std::string &out, size_t &room)
+{
+    auto used = out.length();
+    room = std::max(kOutputChunk, out.capacity() - used);
+    out.resize(used + room);
+    return &out[used];
+}
+
+#ifdef ENABLE_ZLIB
+class ZlibEncoder : public Encoder
+{
+    z_stream zs_;
+    bool ok_;
+
+    bool run(const void *data, size_t size, int flush, std::string &out)
+    {
+        zs_.next_in = reinterpret_cast<Bytef *>(const_cast<void *>(data));
+        zs_.avail_in = static_cast<uInt>(size);
+
+        while (true) {
+            size_t room;
+            auto used = out.length();
+            zs_.next_out = reinterpret_cast<Bytef *>(grow(out, room));
+            zs_.avail_out = static_cast<uInt>(std::min<size_t>(room, UINT32_MAX));
+            auto avail = zs_.avail_out;
+            auto ret = deflate(&zs_, flush);
+            out.resize(used + avail - zs_.avail_out);
+
+            if (ret == Z_STREAM_ERROR) {
+                return false;
+            }
+            if (flush == Z_FINISH ? ret == Z_STREAM_END : zs_.avail_out != 0) {
+                return true;
+            }
+        }
+    }
+
+  public:
+    ZlibEncoder(bool gzip, int level)
+    {
+        memset(&zs_, 0, sizeof(zs_));
+        // 16 more window bits for the gzip wrapper, deflate in HTTP is the zlib format
+        ok_ = deflateInit2(&zs_, level, Z_DEFLATED, gzip ? 15 + 16 : 15, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+    }
+
+    virtual ~ZlibEncoder()
+    {
+        if (ok_) {
+            deflateEnd(&zs_);
+        }
+    }
+
+    virtual bool update(const void *data, size_t size, std::string &out) override
+    {
+        auto p = reinterpret_cast<const char *>(data);
+        // avail_in is 32 bits
+        while (ok_ && size > 0) {
+            auto n = std::min<size_t>(size, 1u << 30);
+            ok_ = run(p, n, Z_NO_FLUSH, out);
+            p += n;
+            size -= n;
+        }
+        return ok_;
+    }
+
+    virtual bool finish(std::string &out) override
+    {
+        return ok_ && run(nullptr, 0, Z_FINISH, out);
+    }
+};
+#endif
+
+#ifdef ENABLE_ZSTD
+class ZstdEncoder : public Encoder
+{
+    ZSTD_CCtx *ctx_;
+
+    bool run(const void *data, size_t size, ZSTD_EndDirective mode, std::string &out)
+    {
+        ZSTD_inBuffer in = {data, size, 0};
+        while (true) {
+            size_t room;
+            auto used = out.length();
+            ZSTD_outBuffer o = {grow(out, room), room, 0};
+            auto left = ZSTD_compressStream2(ctx_, &o, &in, mode);
+            out.resize(used + o.pos);
+
+            if (ZSTD_isError(left)) {
+                LOG_DEBUG("zstd: {}", ZSTD_getErrorName(left));
+                return false;
+            }
+            if (mode == ZSTD_e_end ? left == 0 : in.pos == in.size) {
+                return true;
+            }
+        }
+    }
+
+  public:
+    explicit ZstdEncoder(int level) : ctx_(ZSTD_createCCtx())
+    {
+        if (ctx_ != nullptr) {
+            ZSTD_CCtx_setParameter(ctx_, ZSTD_c_compressionLevel, level);
+        }
+    }
+
+    virtual ~ZstdEncoder()
+    {
+        ZSTD_freeCCtx(ctx_);
+    }
+
+    virtual bool update(const void *data, size_t size, std::string &out) override
+    {
+        return ctx_ != nullptr && run(data, size, ZSTD_e_continue, out);
+    }
+
+    virtual bool finish(std::string &out) override
+    {
+        return ctx_ != nullptr && run(nullptr, 0, ZSTD_e_end, out);
+    }
+};
+#endif
+
+#ifdef ENABLE_BROTLI
+class BrotliEncoder : public Encoder
+{
+    BrotliEncoderState *state_;
+
+    bool run(const void *data, size_t size, BrotliEncoderOperation op, std::string &out)
+    {
+        auto next = reinterpret_cast<const uint8_t *>(data);
+        while (true) {
+            size_t room;
+            auto used = out.length();
+            auto p = reinterpret_cast<uint8_t *>(grow(out, room));
+            auto avail = room;
+            auto ok = BrotliEncoderCompressStream(state_, op, &size, &next, &avail, &p, nullptr);
+            out.resize(used + room - avail);
+
+            if (!ok) {
+                return false;
+            }
+            if (size == 0 && !BrotliEncoderHasMoreOutput(state_)
+                && (op != BROTLI_OPERATION_FINISH || BrotliEncoderIsFinished(state_))) {
+                return true;
+            }
+        }
+    }
+
+  public:
+    explicit BrotliEncoder(int level) : state_(BrotliEncoderCreateInstance(nullptr, nullptr, nullptr))
+    {
+        if (state_ != nullptr) {
+            BrotliEncoderSetParameter(state_, BROTLI_PARAM_QUALITY, static_cast<uint32_t>(level));
+        }
+    }
+
+    virtual ~BrotliEncoder()
+    {
+        if (state_ != nullptr) {
+            BrotliEncoderDestroyInstance(state_);
+        }
+    }
+
+    virtual bool update(const void *data, size_t size, std::string &out) override
+    {
+        return state_ != nullptr && run(data, size, BROTLI_OPERATION_PROCESS, out);
+    }
+
+    virtual bool finish(std::string &out) override
+    {
+        return state_ != nullptr && run(nullptr, 0, BROTLI_OPERATION_FINISH, out);
+    }
+};
+#endif
+
+// thousandths, -1 for a malformed value
+int parseQ(const char *p, const char *end)
+{
+    if (p == end || (*p != '0' && *p != '1')) {
+        return -1;
+    }
+    int q = (*p++ - '0') * 1000;
+    if (p != end && *p == '.') {
+        p++;
+        for (int scale = 100; p != end && *p >= '0' && *p <= '9' && scale > 0; p++, scale /= 10) {
+            q += (*p - '0') * scale;
+        }
+    }
+    return p == end && q <= 1000 ? q : -1;
+}
+
+bool tokenIs(const char *p, size_t length, const char *name)
+{
+    return strlen(name) == length && strncasecmp(p, name, length) == 0;
+}
+
+ssize_t readCompressed(void *cls, uint64_t pos, char *buf, size_t max)
+{
+    auto &body = **reinterpret_cast<CompressedBody *>(cls);
+    if (pos >= body.length()) {
+        return MHD_CONTENT_READER_END_OF_STREAM;
+    }
+    auto n = std::min<size_t>(max, body.length() - pos);
+    memcpy(buf, body.data() + pos, n);
+    return static_cast<ssize_t>(n);
+}
+
+void freeCompressed(void *cls)
+{
+    delete reinterpret_cast<CompressedBody *>(cls);
+}
+
+// a body compressed while it is sent
+struct CompressStream {
+    // owns the body
+    HttpResponsePtr resp;
+    Encoding encoding;
+    const char *data;
+    size_t size;
+    size_t in;
+
+    std::unique_ptr<Encoder> encoder;
+    std::string pending;
+    size_t sent;
+    bool finished;
+    SentCounter total;
+};
+
+ssize_t readStream(void *cls, uint64_t, char *buf, size_t max)
+{
+    auto s = reinterpret_cast<CompressStream *>(cls);
+
+    while (s->sent == s->pending.length()) {
+        if (s->finished) {
+            return MHD_CONTENT_READER_END_OF_STREAM;
+        }
+
+        s->pending.clear();
+        s->sent = 0;
+        auto n = std::min(kStreamChunk, s->size - s->in);
+        auto ok = n != 0 ? s->encoder->update(s->data + s->in, n, s->pending) : s->encoder->finish(s->pending);
+        if (unlikely(!ok)) {
+            LOG_ERROR("compress: {} failed in the middle of a response", encodingName(s->encoding));
+            return MHD_CONTENT_READER_END_WITH_ERROR;
+        }
+        s->in += n;
+        s->finished = n == 0;
+    }
+
+    auto n = std::min(max, s->pending.length() - s->sent);
+    memcpy(buf, s->pending.data() + s->sent, n);
+    s->sent += n;
+    *s->total += n;
+    return static_cast<ssize_t>(n);
+}
+
+void freeStream(void *cls)
+{
+    delete reinterpret_cast<CompressStream *>(cls);
+}
+}  // namespace
+
+const char *encodingName(Encoding encoding)
+{
+    switch (encoding) {
+        case Encoding::BROTLI:
+            return "br";
+        case Encoding::ZSTD:
+            return "zstd";
+        case Encoding::GZIP:
+            return "gzip";
+        case Encoding::DEFLATE:
+            return "deflate";
+        default:
+            return "identity";
+    }
+}
+
+bool encodingSupported(Encoding encoding)
+{
+    switch (encoding) {
+#ifdef ENABLE_BROTLI
+        case Encoding::BROTLI:
+            return true;
+#endif
+#ifdef ENABLE_ZSTD
+        case Encoding::ZSTD:
+            return true;
+#endif
+#ifdef ENABLE_ZLIB
+        case Encoding::GZIP:
+        case Encoding::DEFLATE:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+Encoding negotiate(const char *acceptEncoding)
+{
+    if (acceptEncoding == nullptr) {
+        return Encoding::IDENTITY;
+    }
+
+    // q of each encoding in thousandths, -1 when it is not listed
+    int q[static_cast<size_t>(Encoding::DEFLATE) + 1] = {-1, -1, -1, -1, -1};
+    int any = -1;
+
+    auto p = acceptEncoding;
+    while (*p != '\0') {
+        while (*p == ' ' || *p == '\t' || *p == ',') {
+            p++;
+        }
+        auto name = p;
+        while (*p != '\0' && *p != ',' && *p != ';' && *p != ' ' && *p != '\t') {
+            p++;
+        }
+        auto length = static_cast<size_t>(p - name);
+
+        int value = 1000;
+        while (*p != '\0' && *p != ',') {
+            if (*p == ';') {
+                p++;
+                while (*p == ' ' || *p == '\t') {
+                    p++;
+                }
+                if ((*p == 'q' || *p == 'Q') && p[1] == '=') {
+                    auto begin = p + 2;
+                    auto end = begin;
+                    while (*end != '\0' && *end != ',' && *end != ';' && *end != ' ' && *end != '\t') {
+                        end++;
+                    }
+                    value = parseQ(begin, end);
+                    p = end;
+                    continue;
+                }
+            }
+            if (*p != '\0' && *p != ',') {
+                p++;
+            }
+        }
+
+        if (length == 0 || value < 0) {
+            continue;
+        }
+        if (tokenIs(name, length, "*")) {
+            any = value;
+        } else if (tokenIs(name, length, "br")) {
+            q[static_cast<size_t>(Encoding::BROTLI)] = value;
+        } else if (tokenIs(name, length, "zstd")) {
+            q[static_cast<size_t>(Encoding::ZSTD)] = value;
+        } else if (tokenIs(name, length, "gzip") || tokenIs(name, length, "x-gzip")) {
+            q[static_cast<size_t>(Encoding::GZIP)] = value;
+        } else if (tokenIs(name, length, "deflate")) {
+            q[static_cast<size_t>(Encoding::DEFLATE)] = value;
+        }
+    }
+
+    auto best = Encoding::IDENTITY;
+    int bestQ = 0;
+    for (auto e : kPreferred) {
+        auto v = q[static_cast<size_t>(e)];
+        if (v < 0) {
+            v = any;
+        }
+        if (v > bestQ && encodingSupported(e)) {
+            best = e;
+            bestQ = v;
+        }
+    }
+    return best;
+}
+
+Encoder::~Encoder() {}
+
+std::unique_ptr<Encoder> Encoder::create(Encoding encoding, int level)
+{
+    level = std::max(1, std::min(level, 9));
+    switch (encoding) {
+#ifdef ENABLE_ZLIB
+        case Encoding::GZIP:
+            return std::unique_ptr<Encoder>(new ZlibEncoder(true, level));
+        case Encoding::DEFLATE:
+            return std::unique_ptr<Encoder>(new ZlibEncoder(false, level));
+#endif
+#ifdef ENABLE_ZSTD
+        case Encoding::ZSTD:
+            return std::unique_ptr<Encoder>(new ZstdEncoder(level));
+#endif
+#ifdef ENABLE_BROTLI
+        case Encoding::BROTLI:
+            return std::unique_ptr<Encoder>(new BrotliEncoder(level));
+#endif
+        default:
+            return nullptr;
+    }
+}
+
+bool compress(Encoding encoding, int level, const void *data, size_t size, std::string &out)
+{
+    auto encoder = Encoder::create(encoding, level);
+    if (!encoder) {
+        return false;
+    }
+    // most text shrinks to less than half
+    out.reserve(out.length() + size / 2 + 64);
+    return encoder->update(data, size, out) && encoder->finish(out);
+}
+
+bool CompressionCache::get(uint64_t hash, size_t size, Encoding encoding, CompressedBody &body)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(Key{hash, size, encoding});
+    if (it == index_.end()) {
+        return false;
+    }
+    lru_.splice(lru_.begin(), lru_, it->second);
+    body = it->second->body;
+    return true;
+}
+
+void CompressionCache::put(uint64_t hash, size_t size, Encoding encoding, CompressedBody body)
+{
+    Entry entry{Key{hash, size, encoding}, std::move(body)};
+    auto c = cost(entry);
+    if (c > capacity_) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    // another thread compressed it at the same time
+    if (index_.find(entry.key) != index_.end()) {
+        return;
+    }
+    while (used_ + c > capacity_ && lru_.size() != 0) {
+        used_ -= cost(lru_.back());
+        index_.erase(lru_.back().key);
+        lru_.pop_back();
+    }
+    lru_.push_front(std::move(entry));
+    index_[lru_.front().key] = lru_.begin();
+    used_ += c;
+}
+
+Compressor::Compressor(const CompressionOptions &options) : options_(options), cache_(options.cacheSize) {}
+
+bool Compressor::compressible(const HttpResponse &resp) const
+{
+    auto sc = resp.status();
+    if (sc < k200OK || sc == k204NoContent || sc == k206PartialContent || sc == k304NotModified) {
+        return false;
+    }
+    if (std::get<0>(resp.body()) < std::max<size_t>(options_.minSize, 1)) {
+        return false;
+    }
+
+    auto &headers = resp.headers();
+    if (headers.find(CPPMHD_HTTP_HEADER_CONTENT_ENCODING) != headers.end()) {
+        return false;
+    }
+    auto type = headers.find(CPPMHD_HTTP_HEADER_CONTENT_TYPE);
+    if (type == headers.end()) {
+        return false;
+    }
+
+    auto &value = type->second;
+    for (auto &t : options_.types) {
+        if (value.length() >= t.length() && strncasecmp(value.c_str(), t.c_str(), t.length()) == 0) {
+            // "text/" matches any text, "text/html" not "text/htmlx"
+            auto next = value.c_str()[t.length()];
+            if (t.back() == '/' || next == '\0' || next == ';' || next == ' ') {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+Encoding Compressor::prepare(HttpResponsePtr &resp, const char *acceptEncoding) const
+{
+    if (!compressible(*resp)) {
+        return Encoding::IDENTITY;
+    }
+
+    auto &vary = resp->header(CPPMHD_HTTP_HEADER_VARY);
+    if (vary.length() == 0) {
+        vary = CPPMHD_HTTP_HEADER_ACCEPT_ENCODING;
+    } else if (vary != "*" && !containsNoCase(vary, CPPMHD_HTTP_HEADER_ACCEPT_ENCODING)) {
+        vary += ", " CPPMHD_HTTP_HEADER_ACCEPT_ENCODING;
+    }
+
+    return negotiate(acceptEncoding);
+}
+
+CompressedBody Compressor::compressAll(const HttpResponse &resp, Encoding encoding)
+{
+    auto &body = resp.body();
+    auto size = std::get<0>(body);
+    auto data = std::get<1>(body);
+    auto persistent = !std::get<2>(body);
+    auto cached = persistent && options_.cacheSize != 0;
+
+    CompressedBody out;
+    // hashing is much cheaper than compressing, and sees a body changed in place
+    auto hash = cached ? xxh64(data, size) : 0;
+    if (!cached || !cache_.get(hash, size, encoding, out)) {
+        std::string s;
+        if (!compress(encoding, options_.level, data, size, s)) {
+            LOG_ERROR("compress: {} of {} bytes failed", encodingName(encoding), size);
+        } else if (s.length() < size) {
+            out = std::make_shared<const std::string>(std::move(s));
+        }
+        if (cached) {
+            cache_.put(hash, size, encoding, out);
+        }
+    }
+    return out;
+}
+
+void Compressor::label(HttpResponsePtr &resp, Encoding encoding)
+{
+    resp->header(CPPMHD_HTTP_HEADER_CONTENT_ENCODING) = encodingName(encoding);
+    // the bytes differ from the ones a strong ETag stands for, a weak one still validates them
+    auto &headers = resp->headers();
+    auto etag = headers.find(CPPMHD_HTTP_HEADER_ETAG);
+    if (etag != headers.end() && etag->second.length() != 0 && etag->second[0] == '"') {
+        resp->header(CPPMHD_HTTP_HEADER_ETAG) = "W/" + etag->second;
+    }
+}
+
+MHD_Response *Compressor::create(
+    HttpResponsePtr &resp, const char *acceptEncoding, bool stream, uint64_t &length, SentCounter &sent)
+{
+    auto encoding = prepare(resp, acceptEncoding);
+    if (encoding == Encoding::IDENTITY) {
+        return nullptr;
+    }
+
+    auto &body = resp->body();
+    auto size = std::get<0>(body);
+    auto data = std::get<1>(body);
+    auto persistent = !std::get<2>(body);
+    auto cached = persistent && options_.cacheSize != 0;
+
+    MHD_Response *res;
+    if (stream && !cached && size > options_.streamSize) {
+        auto encoder = Encoder::create(encoding, options_.level);
+        if (!encoder) {
+            return nullptr;
+        }
+        auto counter = std::make_shared<uint64_t>(0);
+        auto s = new CompressStream{resp,
+                                    encoding,
+                                    reinterpret_cast<const char *>(data),
+                                    size,
+                                    0,
+                                    std::move(encoder),
+                                    std::string(),
+                                    0,
+                                    false,
+                                    counter};
+        res = MHD_create_response_from_callback(MHD_SIZE_UNKNOWN, kStreamChunk, readStream, s, freeStream);
+        if (res == nullptr) {
+            delete s;
+            return nullptr;
+        }
+        length = 0;
+        sent = std::move(counter);
+    } else {
+        auto out = compressAll(*resp, encoding);
+        if (!out) {
+            return nullptr;
+        }
+        length = out->length();
+        res = createBodyResponse(std::move(out));
+        if (res == nullptr) {
+            return nullptr;
+        }
+    }
+
+    label(resp, encoding);
+    return res;
+}
+
+CompressedBody Compressor::encode(HttpResponsePtr &resp, const char *acceptEncoding)
+{
+    auto encoding = prepare(resp, acceptEncoding);
+    if (encoding == Encoding::IDENTITY) {
+        return nullptr;
+    }
+    auto out = compressAll(*resp, encoding);
+    if (out) {
+        label(resp, encoding);
+    }
+    return out;
+}
+
+MHD_Response *createBodyResponse(CompressedBody body)
+{
+    auto length = body->length();
+    auto holder = new CompressedBody(std::move(body));
+    auto res = MHD_create_response_from_callback(
+        length, std::max<size_t>(std::min(kStreamChunk, length), 1), readCompressed, holder, freeCompressed);
+    if (res == nullptr) {
+        delete holder;
+    }
+    return res;
+}
+
+CPPMHD_NAMESPACE_END
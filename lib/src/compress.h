@@ -0,0 +1,154 @@
+#ifndef CPPMHD_INTERNAL_COMPRESS_H_
+#define CPPMHD_INTERNAL_COMPRESS_H_
+
+#include "config.h"
+
+#include <cppmhd/app.h>
+#include <cppmhd/entity.h>
+
+#include <microhttpd.h>
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "core.h"
+#include "utils.h"
+
+CPPMHD_NAMESPACE_BEGIN
+
+// in the order the server prefers them when the client likes several as much
+enum class Encoding : uint8_t { IDENTITY, BROTLI, ZSTD, GZIP, DEFLATE };
+
+// the name in Content-Encoding
+const char *encodingName(Encoding encoding);
+
+// true if this build can compress with it
+bool encodingSupported(Encoding encoding);
+
+// the encoding of an Accept-Encoding value with the highest q, IDENTITY if none of the supported ones is acceptable
+Encoding negotiate(const char *acceptEncoding);
+
+// a compression stream. the output is appended to out
+class Encoder
+{
+  public:
+    // nullptr if this build does not support the encoding
+    static std::unique_ptr<Encoder> create(Encoding encoding, int level);
+
+    // false on an error of the codec
+    virtual bool update(const void *data, size_t size, std::string &out) = 0;
+
+    // the end of the stream
+    virtual bool finish(std::string &out) = 0;
+
+    virtual ~Encoder();
+};
+
+// compresses a whole buffer. false on an error
+bool compress(Encoding encoding, int level, const void *data, size_t size, std::string &out);
+
+using CompressedBody = std::shared_ptr<const std::string>;
+
+// a response of the bytes of body, which it shares until it is destroyed. nullptr on an error
+MHD_Response *createBodyResponse(CompressedBody body);
+
+// compressed variants of persistent bodies, keyed by the xxh64 and size of the bytes: a body changed in place is a
+// new key, and the same bytes at another address share the entry. the least recently used are dropped when the
+// compressed bytes exceed the capacity. shared by all server threads
+class CompressionCache
+{
+    struct Key {
+        uint64_t hash;
+        size_t size;
+        Encoding encoding;
+
+        bool operator==(const Key &other) const
+        {
+            return hash == other.hash && size == other.size && encoding == other.encoding;
+        }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key &key) const
+        {
+            return static_cast<size_t>(key.hash) ^ static_cast<size_t>(key.encoding);
+        }
+    };
+
+    struct Entry {
+        Key key;
+        // nullptr if the body does not get smaller
+        CompressedBody body;
+    };
+
+    const size_t capacity_;
+    size_t used_;
+
+    std::mutex mutex_;
+    // most recently used first
+    std::list<Entry> lru_;
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index_;
+
+    static size_t cost(const Entry &entry)
+    {
+        return sizeof(Entry) + (entry.body ? entry.body->length() : 0);
+    }
+
+  public:
+    explicit CompressionCache(size_t capacity) : capacity_(capacity), used_(0) {}
+
+    // hash is the xxh64 of the size bytes of the body. false if the body is not cached. body is nullptr for a body
+    // compression did not make smaller
+    bool get(uint64_t hash, size_t size, Encoding encoding, CompressedBody &body);
+
+    void put(uint64_t hash, size_t size, Encoding encoding, CompressedBody body);
+
+    size_t size()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return lru_.size();
+    }
+
+    size_t used()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return used_;
+    }
+};
+
+// the compression stage of the responses of one app
+class Compressor
+{
+    const CompressionOptions options_;
+    CompressionCache cache_;
+
+    bool compressible(const HttpResponse &resp) const;
+
+    // adds Vary to a compressible resp. IDENTITY if it is not compressed
+    Encoding prepare(HttpResponsePtr &resp, const char *acceptEncoding) const;
+    // the body of resp at once, through the cache of persistent bodies. nullptr if it does not get smaller
+    CompressedBody compressAll(const HttpResponse &resp, Encoding encoding);
+    // the headers of a body compressed with encoding
+    static void label(HttpResponsePtr &resp, Encoding encoding);
+
+  public:
+    explicit Compressor(const CompressionOptions &options);
+
+    // a response with the compressed body of resp, with Content-Encoding set. nullptr to send resp as it is. adds
+    // Vary to resp when the body could be compressed, so caches keep the variants apart. without stream a large body
+    // is compressed at once, and the response can be queued for several connections. length is the compressed length,
+    // or sent counts the bytes of a body compressed while it is sent
+    MHD_Response *create(
+        HttpResponsePtr &resp, const char *acceptEncoding, bool stream, uint64_t &length, SentCounter &sent);
+
+    // the body of resp compressed at once, with the headers set as create sets them. nullptr to send resp as it is
+    CompressedBody encode(HttpResponsePtr &resp, const char *acceptEncoding);
+};
+
+CPPMHD_NAMESPACE_END
+
+#endif
@@ -4,6 +4,7 @@
 
 #include <cassert>
 
+#include "form.h"
 #include "http.h"
 #include "logger.h"
 #include "utils.h"
@@ -15,6 +16,31 @@ void HttpController::onConnection(HttpRequestPtr, HttpResponsePtr &)
     // no-op
 }
 
+RequestPriority HttpController::priority() const
+{
+    return RequestPriority::NORMAL;
+}
+
+uint64_t HttpController::maxBodySize() const
+{
+    return 0;
+}
+
+uint32_t HttpController::validatorTtl() const
+{
+    return 0;
+}
+
+CachePolicy HttpController::cachePolicy() const
+{
+    return CachePolicy{0, 0, {}};
+}
+
+std::vector<std::string> HttpController::listeners() const
+{
+    return {};
+}
+
 HttpController::~HttpController() {}
 
 DataProcessor::~DataProcessor() {}
@@ -27,110 +53,61 @@ DataProcessor::DataProcessor()
 
 namespace
 {
-using ccp = const char *;
-
-MHD_Return formIter(void *, MHD_ValueKind, ccp, ccp, ccp, ccp, ccp, uint64_t, size_t);
-
-class FormProcessor;
-struct FormProcessorData {
-    FormProcessor *proc;
-    std::weak_ptr<HttpRequest> req;
-};
-
-class FormProcessor : public DataProcessor
+class FormProcessor : public DataProcessor, public FormSink
 {
-    friend MHD_Return formIter(void *, MHD_ValueKind, ccp, ccp, ccp, ccp, ccp, uint64_t, size_t);
-
-    MHD_Connection *conn_;
-    MHD_PostProcessor *pp_;
-    FormProcessorData data_;
     FormDataProcessorController *ctrl_;
-
-    std::string kN_, fN_, cT_, tE_;
+    std::unique_ptr<FormParser> parser_;
+    // the request of the onData being parsed
+    HttpRequestPtr *current_;
 
   public:
-    virtual ~FormProcessor()
+    FormProcessor(FormDataProcessorController *ctrl) : ctrl_(ctrl), current_(nullptr) {}
+
+    bool init(const char *contentType, size_t partBuffer)
     {
-        if (likely(pp_)) {
-            MHD_destroy_post_processor(pp_);
-        }
+        parser_ = FormParser::create(contentType, *this, partBuffer);
+        return parser_ != nullptr;
     }
 
     virtual size_t onData(HttpRequestPtr &req, const void *data, size_t size) override
     {
-        assert(pp_);
+        current_ = &req;
         if (unlikely(size == 0)) {
-            ctrl_->onData(req, kN_, fN_, cT_, tE_, nullptr, 0, 0, true);
-            return 0;
-        } else {
-            if (likely(MHD_post_process(pp_, reinterpret_cast<const char *>(data), size)) == MHD_OK) {
-                return size;
-            } else {
+            if (unlikely(!parser_->finish())) {
+                LOG_DEBUG("{}", "form body is incomplete");
                 return DataProcessor::DataProcessorParseFailed;
             }
+            auto &f = parser_->field();
+            ctrl_->onData(req, f.name, f.fileName, f.contentType, f.transferEncoding, nullptr, 0, 0, true);
+            return 0;
         }
-    }
 
-    bool buildPostProcessor(HttpRequestPtr req)
-    {
-        data_.req = req;
-        pp_ = MHD_create_post_processor(conn_, 20 * 1024, formIter, &data_);
-        return pp_ != nullptr;
-    }
-
-    FormProcessor(MHD_Connection *conn, FormDataProcessorController *ctrl) : conn_(conn), pp_(nullptr), ctrl_(ctrl)
-    {
-        data_.proc = this;
+        if (likely(parser_->parse(reinterpret_cast<const char *>(data), size))) {
+            return size;
+        }
+        return DataProcessor::DataProcessorParseFailed;
     }
 
-    bool onData(HttpRequestPtr &req, ccp key, ccp fN, ccp cT, ccp tE, ccp data, uint64_t off, size_t size)
+    virtual bool onField(const FormField &f, const char *data, uint64_t offset, size_t size) override
     {
-        if (key && kN_ != key) {
-            kN_ = key;
-        }
-        if (fN && fN_ != fN) {
-            fN_ = fN;
-        }
-        if (cT && cT_ != cT) {
-            cT_ = cT;
-        }
-        if (tE && tE_ != tE) {
-            tE_ = tE;
-        }
-
-        return ctrl_->onData(req, kN_, fN_, cT_, tE_, data, off, size, false);
+        auto &req = *current_;
+        return ctrl_->onData(req, f.name, f.fileName, f.contentType, f.transferEncoding, data, offset, size, false);
     }
 };
 
-
-MHD_Return formIter(
-    void *cls, MAYBE_UNUSED MHD_ValueKind kind, ccp key, ccp fN, ccp cT, ccp tE, ccp data, uint64_t off, size_t size)
-{
-    MAYBE_UNUSED auto fp = reinterpret_cast<FormProcessorData *>(cls);
-    assert(kind == MHD_POSTDATA_KIND);
-    auto req = fp->req.lock();
-    return fp->proc->onData(req, key, fN, cT, tE, data, off, size) ? MHD_OK : MHD_FAILED;
-}
-
 }  // namespace
 
 void FormDataProcessorController::postConnection(HttpRequestPtr) {}
 
 void FormDataProcessorController::onConnection(HttpRequestPtr req, HttpResponsePtr &)
 {
-    auto conn = req->connection();
-    if (likely(conn)) {
-        auto ct = req->getHeader(CPPMHD_HTTP_HEADER_CONTENT_TYPE);
-        if (isPrefixOfArray(ct, CPPMHD_HTTP_MIME_APPLICATION_FORM_URLENCODED)
-            || isPrefixOfArray(ct, CPPMHD_HTTP_MIME_MULTIPART_FORM_DATA)) {
-            auto fp = new FormProcessor(conn, this);
-            if (fp->buildPostProcessor(req)) {
-                pp = std::shared_ptr<DataProcessor>(fp);
-                req->setProcessor(pp);
-                postConnection(req);
-            } else {
-                delete fp;
-            }
+    auto ct = req->getHeader(KnownHeader::CONTENT_TYPE);
+    if (isPrefixOfArray(ct, CPPMHD_HTTP_MIME_APPLICATION_FORM_URLENCODED)
+        || isPrefixOfArray(ct, CPPMHD_HTTP_MIME_MULTIPART_FORM_DATA)) {
+        auto fp = std::make_shared<FormProcessor>(this);
+        if (fp->init(ct, partBuffer_)) {
+            req->setProcessor(fp);
+            postConnection(req);
         }
     }
 }
@@ -1,16 +1,24 @@
 #include "entity.h"
 
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fmt/format.h>
+
 #include <algorithm>
 #include <cassert>
 #include <cctype>
 #include <cstring>
 
+#include "clock.h"
+#include "tls.h"
 #include "utils.h"
 
 using namespace cppmhd;
 
-MHDHttpRequest::MHDHttpRequest(MHD_Connection* con, char const* url, HttpMethod mth)
-    : HttpRequest(con), uri(url), mhd(mth)
+MHDHttpRequest::MHDHttpRequest(MHD_Connection* con, char const* url, HttpMethod mth, PausedRequests* paused)
+    : HttpRequest(con), uri(url), mhd(mth), pausedRequests_(paused), paused_(false), completed_(false)
 {
     state_ = RequestState::INITIAL;
 }
@@ -27,16 +35,94 @@ const std::string& MHDHttpRequest::getParam(const std::string& name) const
 
 const char* MHDHttpRequest::getHeader(const char* header) const
 {
-    auto conn = reinterpret_cast<MHD_Connection*>(connection());
-    assert(conn);
-    return MHD_lookup_connection_value(conn, MHD_HEADER_KIND, header);
+    return headerIndex().get(header);
+}
+
+bool MHDHttpRequest::pause()
+{
+    std::lock_guard<std::mutex> all(pausedRequests_->mutex_);
+    std::lock_guard<std::mutex> lock(suspendMutex_);
+    if (completed_ || pausedRequests_->ended_) {
+        return false;
+    }
+    if (!paused_) {
+        // called inside the access handler callback, MHD suspends the connection when it returns
+        MHD_suspend_connection(connection());
+        paused_ = true;
+        pausedRequests_->requests_.insert(this);
+    }
+    return true;
+}
+
+bool MHDHttpRequest::tls(TlsInfo& info) const
+{
+    return tlsInfo(connection(), info);
+}
+
+bool MHDHttpRequest::resume()
+{
+    std::lock_guard<std::mutex> all(pausedRequests_->mutex_);
+    std::lock_guard<std::mutex> lock(suspendMutex_);
+    if (!paused_ || completed_) {
+        return false;
+    }
+    paused_ = false;
+    pausedRequests_->requests_.erase(this);
+    MHD_resume_connection(connection());
+    return true;
+}
+
+void MHDHttpRequest::complete()
+{
+    std::lock_guard<std::mutex> all(pausedRequests_->mutex_);
+    std::lock_guard<std::mutex> lock(suspendMutex_);
+    completed_ = true;
+    paused_ = false;
+    pausedRequests_->requests_.erase(this);
+}
+
+void PausedRequests::end()
+{
+    // a request is not freed before complete takes it out
+    std::lock_guard<std::mutex> all(mutex_);
+    ended_ = true;
+    for (auto req : requests_) {
+        std::lock_guard<std::mutex> lock(req->suspendMutex_);
+        req->paused_ = false;
+        MHD_resume_connection(req->connection());
+    }
+    requests_.clear();
 }
 
 HttpRequest::~HttpRequest() {}
 
+bool HttpRequest::pause()
+{
+    return false;
+}
+
+bool HttpRequest::resume()
+{
+    return false;
+}
+
+bool HttpRequest::tls(TlsInfo&) const
+{
+    return false;
+}
+
+const HttpHeaderList& HttpRequest::headers() const
+{
+    static const HttpHeaderList none;
+    return none;
+}
+
 HttpResponse::~HttpResponse()
 {
     clearBody();
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
 }
 
 std::string& HttpResponse::header(const std::string& key)
@@ -77,4 +163,49 @@ void HttpResponse::body(size_t size, const void* data, bool persistent)
     }
     clearBody();
     body_ = std::make_tuple(size, save, !persistent);
-}
\ No newline at end of file
+}
+
+bool HttpResponse::file(int fd)
+{
+    struct stat st;
+    if (fd < 0 || ::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        return false;
+    }
+
+    clearBody();
+    body_ = std::make_tuple(0, nullptr, false);
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+    fd_ = fd;
+    fileSize_ = static_cast<uint64_t>(st.st_size);
+    return true;
+}
+
+bool HttpResponse::file(const std::string& path)
+{
+    auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    if (!file(fd)) {
+        ::close(fd);
+        return false;
+    }
+
+    struct stat st;
+    ::fstat(fd, &st);
+
+    // as nginx does: the file changes when its time or size does
+    auto& etag = header(CPPMHD_HTTP_HEADER_ETAG);
+    if (etag.length() == 0) {
+        etag = FORMAT("\"{:x}-{:x}\"", static_cast<uint64_t>(st.st_mtime), fileSize_);
+    }
+    auto& modified = header(CPPMHD_HTTP_HEADER_LAST_MODIFIED);
+    if (modified.length() == 0) {
+        char date[kHttpDateLength + 1];
+        formatHttpDate(st.st_mtime, date);
+        modified = date;
+    }
+    return true;
+}
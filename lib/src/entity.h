@@ -5,14 +5,46 @@
 
 #include <microhttpd.h>
 
+#include <mutex>
+#include <unordered_set>
+
 #include "core.h"
+#include "header.h"
 
 CPPMHD_NAMESPACE_BEGIN
 
 enum class RequestState { INITIAL, INITIAL_COMPLETE, DATA_RECEIVING, DATA_RECEIVED, RS_ERROR };
 
+class MHDHttpRequest;
+
+// the requests of one App suspended by HttpRequest::pause: a paused upload, a DataProcessor waiting for its
+// consumer. the daemons can not stop while one of them is suspended
+class PausedRequests
+{
+    friend class MHDHttpRequest;
+
+    // taken before the mutex of a request
+    std::mutex mutex_;
+    std::unordered_set<MHDHttpRequest*> requests_;
+    bool ended_;
+
+  public:
+    PausedRequests() : ended_(false) {}
+
+    // resumes every paused request, a later pause fails. the request goes on as if it could not be paused
+    void end();
+
+    size_t size()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return requests_.size();
+    }
+};
+
 class MHDHttpRequest : public HttpRequest
 {
+    friend class PausedRequests;
+
     // MHD_Connection* conn;
 
     const char* uri;
@@ -23,8 +55,33 @@ class MHDHttpRequest : public HttpRequest
 
     std::map<std::string, std::string> param_;
 
+    mutable HeaderIndex headers_;
+
+    PausedRequests* pausedRequests_;
+
+    // pause and resume race with the end of the connection, which frees it
+    std::mutex suspendMutex_;
+    bool paused_;
+    bool completed_;
+
+    const HeaderIndex& headerIndex() const
+    {
+        if (unlikely(!headers_.built())) {
+            headers_.build(connection());
+        }
+        return headers_;
+    }
+
+  protected:
+    virtual const char* getKnownHeader(KnownHeader header) const override
+    {
+        return headerIndex().get(header);
+    }
+
   public:
-    MHDHttpRequest(MHD_Connection* con, const char* uri, HttpMethod method);
+    using HttpRequest::getHeader;
+
+    MHDHttpRequest(MHD_Connection* con, const char* uri, HttpMethod method, PausedRequests* paused);
 
     std::shared_ptr<DataProcessor> processor()
     {
@@ -55,11 +112,25 @@ class MHDHttpRequest : public HttpRequest
 
     virtual const char* getHeader(const char* header) const override;
 
+    virtual const HttpHeaderList& headers() const override
+    {
+        return headerIndex().all();
+    }
+
     virtual const char* getPath() const override
     {
         return uri;
     }
 
+    virtual bool pause() override;
+
+    virtual bool resume() override;
+
+    virtual bool tls(TlsInfo& info) const override;
+
+    // the connection is gone, resume has nothing left to do
+    void complete();
+
     virtual ~MHDHttpRequest() {}
 };
 
@@ -0,0 +1,579 @@
+#include "form.h"
+
+#include <cppmhd/core.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "logger.h"
+#include "utils.h"
+
+CPPMHD_NAMESPACE_BEGIN
+
+constexpr size_t FormParser::kFailed;
+
+namespace
+{
+// a part whose headers do not end within this many bytes fails the parser
+constexpr size_t kMaxPartHeaders = 8 * 1024;
+// the name of an urlencoded field is kept whole, a longer one fails the parser like too large part headers
+constexpr size_t kMaxFieldName = kMaxPartHeaders;
+// RFC 2046
+constexpr size_t kMaxBoundary = 70;
+
+inline char lower(char c)
+{
+    return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+// `lowered' is NUL terminated and in lower case
+bool equalsIgnoreCase(const char *str, size_t length, const char *lowered)
+{
+    for (size_t i = 0; i < length; i++) {
+        if (lowered[i] == '\0' || lower(str[i]) != lowered[i]) {
+            return false;
+        }
+    }
+    return lowered[length] == '\0';
+}
+
+inline const char *skipSpace(const char *p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t')) {
+        p++;
+    }
+    return p;
+}
+
+inline const char *trimEnd(const char *begin, const char *end)
+{
+    while (end > begin && (end[-1] == ' ' || end[-1] == '\t')) {
+        end--;
+    }
+    return end;
+}
+
+inline int hexValue(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    c = lower(c);
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+// calls f(key, keyLength, value) for every parameter of a header value like `form-data; name="a"; filename="b"'
+template <class F>
+void forEachParam(const char *p, const char *end, F f)
+{
+    std::string value;
+
+    // the type in front of the parameters
+    while (p < end && *p != ';') {
+        p++;
+    }
+
+    while (p < end) {
+        p = skipSpace(p + 1, end);
+        auto key = p;
+        while (p < end && *p != '=' && *p != ';') {
+            p++;
+        }
+        auto keyEnd = trimEnd(key, p);
+
+        value.clear();
+        if (p < end && *p == '=') {
+            p = skipSpace(p + 1, end);
+            if (p < end && *p == '"') {
+                auto begin = ++p;
+                while (p < end && *p != '"') {
+                    p++;
+                }
+                value.assign(begin, p);
+            } else {
+                auto begin = p;
+                while (p < end && *p != ';') {
+                    p++;
+                }
+                value.assign(begin, trimEnd(begin, p));
+            }
+            while (p < end && *p != ';') {
+                p++;
+            }
+        }
+
+        if (keyEnd > key) {
+            f(key, static_cast<size_t>(keyEnd - key), value);
+        }
+    }
+}
+
+// the headers of one part, [p, end) without the blank line
+void parsePartHeaders(const char *p, const char *end, FormField &field)
+{
+    field.name.clear();
+    field.fileName.clear();
+    field.contentType.clear();
+    field.transferEncoding.clear();
+
+    while (p < end) {
+        auto eol = p;
+        while (eol < end && !(eol[0] == '\r' && eol + 1 < end && eol[1] == '\n')) {
+            eol++;
+        }
+
+        auto colon = reinterpret_cast<const char *>(memchr(p, ':', static_cast<size_t>(eol - p)));
+        if (colon != nullptr) {
+            auto name = p;
+            auto nameLength = static_cast<size_t>(trimEnd(p, colon) - p);
+            auto value = skipSpace(colon + 1, eol);
+            auto valueEnd = trimEnd(value, eol);
+
+            if (equalsIgnoreCase(name, nameLength, "content-disposition")) {
+                forEachParam(value, valueEnd, [&field](const char *key, size_t length, const std::string &v) {
+                    if (equalsIgnoreCase(key, length, "name")) {
+                        field.name = v;
+                    } else if (equalsIgnoreCase(key, length, "filename")) {
+                        field.fileName = v;
+                    }
+                });
+            } else if (equalsIgnoreCase(name, nameLength, "content-type")) {
+                field.contentType.assign(value, valueEnd);
+            } else if (equalsIgnoreCase(name, nameLength, "content-transfer-encoding")) {
+                field.transferEncoding.assign(value, valueEnd);
+            }
+        }
+
+        p = eol + 2;
+    }
+}
+
+// the blank line after the part headers
+const char *findBlankLine(const char *p, const char *end)
+{
+    while (p < end) {
+        p = reinterpret_cast<const char *>(memchr(p, '\r', static_cast<size_t>(end - p)));
+        if (p == nullptr || end - p < 4) {
+            return nullptr;
+        }
+        if (memcmp(p, "\r\n\r\n", 4) == 0) {
+            return p;
+        }
+        p++;
+    }
+    return nullptr;
+}
+
+class MultipartParser : public FormParser
+{
+    enum class State { PREAMBLE, DELIMITER, HEADERS, BODY, EPILOGUE };
+
+    Searcher delimiter_;
+    State state_;
+
+  public:
+    MultipartParser(const std::string &boundary, FormSink &sink, size_t bufferSize)
+        : FormParser(sink, bufferSize), delimiter_("\r\n--" + boundary), state_(State::PREAMBLE)
+    {
+        // the first boundary may start the body, without the CRLF in front of it
+        prepend("\r\n", 2);
+    }
+
+  protected:
+    virtual size_t lookahead() const override
+    {
+        return state_ == State::HEADERS ? kMaxPartHeaders : delimiter_.length();
+    }
+
+    virtual bool complete() override
+    {
+        return state_ == State::EPILOGUE;
+    }
+
+    virtual size_t run(const char *data, size_t size) override
+    {
+        auto p = data, end = data + size;
+
+        while (p < end) {
+            switch (state_) {
+            case State::PREAMBLE:
+            case State::BODY: {
+                bool found;
+                auto pos = delimiter_.find(p, static_cast<size_t>(end - p), found);
+                if (state_ == State::BODY && !emit(p, pos)) {
+                    return kFailed;
+                }
+                if (!found) {
+                    return static_cast<size_t>(p + pos - data);
+                }
+                if (state_ == State::BODY && !endField()) {
+                    return kFailed;
+                }
+                p += pos + delimiter_.length();
+                state_ = State::DELIMITER;
+                break;
+            }
+
+            case State::DELIMITER:
+                // transport padding, then CRLF in front of the next part or `--' at the end of the body
+                if (*p == ' ' || *p == '\t') {
+                    p++;
+                } else if (end - p < 2) {
+                    return static_cast<size_t>(p - data);
+                } else if (p[0] == '-' && p[1] == '-') {
+                    p += 2;
+                    state_ = State::EPILOGUE;
+                } else if (p[0] == '\r' && p[1] == '\n') {
+                    p += 2;
+                    state_ = State::HEADERS;
+                } else {
+                    LOG_DEBUG("{}", "multipart: bad delimiter line");
+                    return kFailed;
+                }
+                break;
+
+            case State::HEADERS: {
+                auto left = static_cast<size_t>(end - p);
+                if (left < 2) {
+                    return static_cast<size_t>(p - data);
+                }
+
+                if (p[0] == '\r' && p[1] == '\n') {
+                    // a part without headers
+                    parsePartHeaders(p, p, field_);
+                    p += 2;
+                } else {
+                    auto blank = findBlankLine(p, end);
+                    if (blank == nullptr) {
+                        if (left >= kMaxPartHeaders) {
+                            LOG_DEBUG("multipart: part headers larger than {} bytes", kMaxPartHeaders);
+                            return kFailed;
+                        }
+                        return static_cast<size_t>(p - data);
+                    }
+                    parsePartHeaders(p, blank, field_);
+                    p = blank + 4;
+                }
+                state_ = State::BODY;
+                break;
+            }
+
+            case State::EPILOGUE:
+                return size;
+            }
+        }
+
+        return static_cast<size_t>(p - data);
+    }
+};
+
+class UrlEncodedParser : public FormParser
+{
+    // in the value of field_, field_.name is complete
+    bool value_;
+    std::string decoded_;
+
+    // appends [p, end) to out with the percent escapes and `+' decoded. an invalid escape is kept as it is
+    static void decode(const char *p, const char *end, std::string &out)
+    {
+        while (p < end) {
+            if (*p == '+') {
+                out.push_back(' ');
+                p++;
+            } else if (*p == '%' && end - p >= 3 && hexValue(p[1]) >= 0 && hexValue(p[2]) >= 0) {
+                out.push_back(static_cast<char>(hexValue(p[1]) << 4 | hexValue(p[2])));
+                p += 3;
+            } else {
+                out.push_back(*p++);
+            }
+        }
+    }
+
+    // the end of [p, end) without a percent escape cut by the end of the buffer
+    static const char *escapeCut(const char *p, const char *end)
+    {
+        if (end - p >= 1 && end[-1] == '%') {
+            return end - 1;
+        }
+        if (end - p >= 2 && end[-2] == '%') {
+            return end - 2;
+        }
+        return end;
+    }
+
+  public:
+    UrlEncodedParser(FormSink &sink, size_t bufferSize) : FormParser(sink, bufferSize), value_(false) {}
+
+  protected:
+    virtual size_t lookahead() const override
+    {
+        return 3;
+    }
+
+    virtual bool complete() override
+    {
+        if (value_ || field_.name.length() != 0) {
+            value_ = false;
+            return endField();
+        }
+        return true;
+    }
+
+    virtual size_t run(const char *data, size_t size) override
+    {
+        auto p = data, end = data + size;
+
+        while (p < end) {
+            auto amp = reinterpret_cast<const char *>(memchr(p, '&', static_cast<size_t>(end - p)));
+            auto stop = amp == nullptr ? end : amp;
+
+            if (!value_) {
+                auto eq = reinterpret_cast<const char *>(memchr(p, '=', static_cast<size_t>(stop - p)));
+                auto keyEnd = eq == nullptr ? stop : eq;
+                auto cut = amp == nullptr && eq == nullptr ? escapeCut(p, keyEnd) : keyEnd;
+
+                decode(p, cut, field_.name);
+                if (unlikely(field_.name.length() > kMaxFieldName)) {
+                    LOG_DEBUG("urlencoded: field name larger than {} bytes", kMaxFieldName);
+                    return kFailed;
+                }
+                p = cut;
+                if (cut < keyEnd) {
+                    return static_cast<size_t>(p - data);
+                }
+
+                if (eq != nullptr) {
+                    value_ = true;
+                    p = eq + 1;
+                    continue;
+                }
+                if (amp == nullptr) {
+                    break;
+                }
+
+                // a key without `=', eg: a&b
+                p = amp + 1;
+                if (field_.name.length() != 0 && !endField()) {
+                    return kFailed;
+                }
+                field_.name.clear();
+                continue;
+            }
+
+            auto cut = amp == nullptr ? escapeCut(p, stop) : stop;
+            auto length = static_cast<size_t>(cut - p);
+            if (memchr(p, '%', length) == nullptr && memchr(p, '+', length) == nullptr) {
+                if (!emit(p, length)) {
+                    return kFailed;
+                }
+            } else {
+                decoded_.clear();
+                decode(p, cut, decoded_);
+                if (!emit(decoded_.data(), decoded_.length())) {
+                    return kFailed;
+                }
+            }
+            p = cut;
+
+            if (amp == nullptr) {
+                if (cut < stop) {
+                    return static_cast<size_t>(p - data);
+                }
+                break;
+            }
+
+            p = amp + 1;
+            value_ = false;
+            if (!endField()) {
+                return kFailed;
+            }
+            field_.name.clear();
+        }
+
+        return static_cast<size_t>(p - data);
+    }
+};
+
+}  // namespace
+
+Searcher::Searcher(const std::string &needle) : needle_(needle)
+{
+    auto m = needle_.length();
+    for (auto &s : skip_) {
+        s = m;
+    }
+    for (size_t i = 0; i + 1 < m; i++) {
+        skip_[static_cast<uint8_t>(needle_[i])] = m - 1 - i;
+    }
+}
+
+size_t Searcher::find(const char *data, size_t size, bool &found) const
+{
+    auto m = needle_.length();
+    auto needle = needle_.data();
+    found = false;
+
+    if (size >= m) {
+        auto last = needle[m - 1];
+        for (size_t pos = 0; pos <= size - m;) {
+            auto c = data[pos + m - 1];
+            if (c == last && memcmp(data + pos, needle, m - 1) == 0) {
+                found = true;
+                return pos;
+            }
+            pos += skip_[static_cast<uint8_t>(c)];
+        }
+    }
+
+    // a match cut off by the end of data starts within its last m - 1 bytes
+    auto p = data + (size >= m ? size - m + 1 : 0);
+    auto end = data + size;
+    while (p < end) {
+        p = reinterpret_cast<const char *>(memchr(p, needle[0], static_cast<size_t>(end - p)));
+        if (p == nullptr) {
+            break;
+        }
+        if (memcmp(p, needle, static_cast<size_t>(end - p)) == 0) {
+            return static_cast<size_t>(p - data);
+        }
+        p++;
+    }
+    return size;
+}
+
+FormSink::~FormSink() {}
+
+FormParser::FormParser(FormSink &sink, size_t bufferSize)
+    : sink_(sink), bufferSize_(bufferSize), offset_(0), emitted_(false)
+{
+}
+
+FormParser::~FormParser() {}
+
+bool FormParser::flush()
+{
+    if (buffer_.length() == 0) {
+        return true;
+    }
+
+    auto ok = sink_.onField(field_, buffer_.data(), offset_, buffer_.length());
+    offset_ += buffer_.length();
+    buffer_.clear();
+    return ok;
+}
+
+bool FormParser::emit(const char *data, size_t size)
+{
+    if (size == 0) {
+        return true;
+    }
+    emitted_ = true;
+
+    // large enough chunks skip the buffer
+    if (buffer_.length() == 0 && size >= bufferSize_) {
+        auto ok = sink_.onField(field_, data, offset_, size);
+        offset_ += size;
+        return ok;
+    }
+
+    if (buffer_.capacity() < bufferSize_) {
+        buffer_.reserve(bufferSize_);
+    }
+    while (size > 0) {
+        auto n = std::min(size, bufferSize_ - buffer_.length());
+        buffer_.append(data, n);
+        data += n;
+        size -= n;
+        if (buffer_.length() == bufferSize_ && !flush()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool FormParser::endField()
+{
+    auto ok = flush();
+    if (ok && !emitted_) {
+        ok = sink_.onField(field_, "", 0, 0);
+    }
+    offset_ = 0;
+    emitted_ = false;
+    return ok;
+}
+
+bool FormParser::parse(const char *data, size_t size)
+{
+    if (carry_.length() != 0) {
+        // what was left undecided, looked at again with the head of this buffer
+        auto old = carry_.length();
+        auto take = std::min(size, lookahead());
+        carry_.append(data, take);
+
+        auto used = run(carry_.data(), carry_.length());
+        if (used == kFailed) {
+            return false;
+        }
+        if (used < old) {
+            if (take < size) {
+                return false;
+            }
+            carry_.erase(0, used);
+            return true;
+        }
+
+        carry_.clear();
+        data += used - old;
+        size -= used - old;
+    }
+
+    auto used = run(data, size);
+    if (used == kFailed) {
+        return false;
+    }
+    carry_.assign(data + used, size - used);
+    return true;
+}
+
+bool FormParser::finish()
+{
+    if (carry_.length() != 0) {
+        auto used = run(carry_.data(), carry_.length());
+        auto left = carry_.length();
+        carry_.clear();
+        if (used == kFailed || used < left) {
+            return false;
+        }
+    }
+    return complete();
+}
+
+std::unique_ptr<FormParser> FormParser::create(const char *contentType, FormSink &sink, size_t bufferSize)
+{
+    if (isPrefixOfArray(contentType, CPPMHD_HTTP_MIME_APPLICATION_FORM_URLENCODED)) {
+        return std::unique_ptr<FormParser>(new UrlEncodedParser(sink, bufferSize));
+    }
+
+    if (!isPrefixOfArray(contentType, CPPMHD_HTTP_MIME_MULTIPART_FORM_DATA)) {
+        return nullptr;
+    }
+
+    std::string boundary;
+    auto end = contentType + strlen(contentType);
+    forEachParam(contentType, end, [&boundary](const char *key, size_t length, const std::string &v) {
+        if (equalsIgnoreCase(key, length, "boundary")) {
+            boundary = v;
+        }
+    });
+
+    if (boundary.length() == 0 || boundary.length() > kMaxBoundary) {
+        LOG_DEBUG("multipart: bad boundary in '{}'", contentType);
+        return nullptr;
+    }
+    return std::unique_ptr<FormParser>(new MultipartParser(boundary, sink, bufferSize));
+}
+
+CPPMHD_NAMESPACE_END
@@ -0,0 +1,114 @@
+#ifndef CPPMHD_INTERNAL_FORM_H_
+#define CPPMHD_INTERNAL_FORM_H_
+
+#include "config.h"
+
+#include <memory>
+#include <string>
+
+#include "core.h"
+
+CPPMHD_NAMESPACE_BEGIN
+
+// Boyer-Moore-Horspool search of one needle. a mismatch skips up to the length of the needle at once, and the
+// candidates of a match cut off by the end of the buffer are found with memchr
+class Searcher
+{
+    std::string needle_;
+    size_t skip_[256];
+
+  public:
+    explicit Searcher(const std::string &needle);
+
+    // position of the first match in data. without a match, the start of the longest suffix of data which is a prefix
+    // of the needle, or size if there is none. `found' tells a match from a suffix
+    size_t find(const char *data, size_t size, bool &found) const;
+
+    size_t length() const
+    {
+        return needle_.length();
+    }
+};
+
+// the part of a form the data belongs to. stays the same for all chunks of the part
+struct FormField {
+    std::string name;
+    std::string fileName;
+    std::string contentType;
+    std::string transferEncoding;
+};
+
+class FormSink
+{
+  public:
+    // data points into the received body, or into the coalescing buffer of the parser. false stops the parser
+    virtual bool onField(const FormField &field, const char *data, uint64_t offset, size_t size) = 0;
+
+    virtual ~FormSink();
+};
+
+// streaming parser of multipart/form-data and application/x-www-form-urlencoded bodies.
+//
+// the body may be split anywhere. the data of a field is handed to the sink straight out of the received buffer, only
+// what can not be decided without the next buffer (the start of a boundary, part headers, a cut percent escape) is
+// copied aside and looked at again with the head of the next buffer. with bufferSize the data of a field is coalesced
+// into chunks of at least that size first, except for the last one of the field.
+class FormParser
+{
+    std::string carry_;
+
+    FormSink &sink_;
+    const size_t bufferSize_;
+    std::string buffer_;
+    uint64_t offset_;
+    bool emitted_;
+
+    bool flush();
+
+  protected:
+    static constexpr size_t kFailed = ~static_cast<size_t>(0);
+
+    FormField field_;
+
+    FormParser(FormSink &sink, size_t bufferSize);
+
+    // hands data to the sink as the next chunk of field_
+    bool emit(const char *data, size_t size);
+
+    // the end of field_. a field without data is still reported, with size 0
+    bool endField();
+
+    // the bytes consumed, or kFailed. the rest is passed again together with the next buffer
+    virtual size_t run(const char *data, size_t size) = 0;
+
+    // the most bytes run needs to see at once to make progress
+    virtual size_t lookahead() const = 0;
+
+    // the end of the body was reached, nothing is pending. false if the body is incomplete
+    virtual bool complete() = 0;
+
+    void prepend(const char *data, size_t size)
+    {
+        carry_.assign(data, size);
+    }
+
+  public:
+    virtual ~FormParser();
+
+    bool parse(const char *data, size_t size);
+
+    // the end of the body. false if it was truncated
+    bool finish();
+
+    const FormField &field() const
+    {
+        return field_;
+    }
+
+    // nullptr if the content type is neither form type, or has no valid boundary
+    static std::unique_ptr<FormParser> create(const char *contentType, FormSink &sink, size_t bufferSize);
+};
+
+CPPMHD_NAMESPACE_END
+
+#endif
@@ -72,28 +72,8 @@ struct formatter<HttpMethod> {
     template <typename FormatContext>
     auto format(const HttpMethod& mtd, FormatContext& ctx) -> decltype(ctx.out())
     {
-        const char* ptr = "UNKNOWN";
-
-#define BUILD_HTTP_METHOD_STRING(MTD) \
-    case HttpMethod::MTD: {           \
-        ptr = #MTD;                   \
-        break;                        \
-    }
-
-        switch (mtd) {
-            BUILD_HTTP_METHOD_STRING(GET)
-            BUILD_HTTP_METHOD_STRING(HEAD)
-            BUILD_HTTP_METHOD_STRING(POST)
-            BUILD_HTTP_METHOD_STRING(PUT)
-            BUILD_HTTP_METHOD_STRING(DELETE)
-            BUILD_HTTP_METHOD_STRING(OPTIONS)
-            BUILD_HTTP_METHOD_STRING(CONNECT)
-            BUILD_HTTP_METHOD_STRING(TRACE)
-            BUILD_HTTP_METHOD_STRING(PATCH)
-        }
-        return format_to(ctx.out(), "{}", ptr);
-
-#undef BUILD_HTTP_METHOD_STRING
+        const char* ptr = httpMethodName(mtd);
+        return format_to(ctx.out(), "{}", ptr == nullptr ? "UNKNOWN" : ptr);
     }
 };
 
@@ -0,0 +1,196 @@
+#include "handoff.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <fmt/format.h>
+
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+
+#include "logger.h"
+
+extern char **environ;
+
+CPPMHD_NAMESPACE_BEGIN
+
+namespace
+{
+// SCM_MAX_FD of Linux
+constexpr size_t kMaxFds = 253;
+
+using Clock = std::chrono::steady_clock;
+
+// waits for events on fd until the deadline, false on timeout
+bool waitFor(int fd, short events, Clock::time_point deadline)
+{
+    while (true) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+        if (left <= 0) {
+            return false;
+        }
+        pollfd p{fd, events, 0};
+        auto n = poll(&p, 1, static_cast<int>(left));
+        if (n > 0) {
+            return true;
+        }
+        if (n < 0 && errno != EINTR) {
+            return false;
+        }
+    }
+}
+
+// the fds go over conn, the end of the socket pair this process kept. the child confirms them with their count
+bool serve(int conn, const std::vector<int> &fds, Clock::time_point deadline)
+{
+    // the number of fds as the byte of data, the fds as its ancillary data
+    char count = static_cast<char>(fds.size());
+    iovec iov{&count, 1};
+    std::vector<char> control(CMSG_SPACE(sizeof(int) * fds.size()));
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.data();
+    msg.msg_controllen = control.size();
+    auto cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+    memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+
+    // a child which exits closes its end, the recv sees it at once
+    char ack = 0;
+    return sendmsg(conn, &msg, MSG_NOSIGNAL) == 1 && waitFor(conn, POLLIN, deadline) && recv(conn, &ack, 1, 0) == 1
+           && ack == count;
+}
+}  // namespace
+
+bool handOver(const std::vector<std::string> &argv, const std::vector<int> &fds, uint32_t timeout)
+{
+    if (argv.empty() || fds.empty() || fds.size() > kMaxFds) {
+        LOG_ERROR("handoff: {} arguments, {} sockets", argv.size(), fds.size());
+        return false;
+    }
+
+    // no path another user could bind first: only the child inherits the other end
+    int pair[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, pair) != 0) {
+        LOG_ERROR("handoff: socketpair failed: {}", strerror(errno));
+        return false;
+    }
+
+    // built before fork, the child only calls execve
+    auto marker = fmt::format("{}=", kHandoffEnv);
+    std::vector<std::string> env;
+    for (auto e = environ; *e != nullptr; e++) {
+        if (strncmp(*e, marker.c_str(), marker.length()) != 0) {
+            env.emplace_back(*e);
+        }
+    }
+    env.push_back(marker + std::to_string(pair[1]));
+    std::vector<char *> envp, args;
+    for (auto &e : env) {
+        envp.push_back(const_cast<char *>(e.c_str()));
+    }
+    envp.push_back(nullptr);
+    for (auto &a : argv) {
+        args.push_back(const_cast<char *>(a.c_str()));
+    }
+    args.push_back(nullptr);
+
+    auto child = fork();
+    if (child == 0) {
+        // the end of the child is the one fd of this process which stays open across execve
+        fcntl(pair[1], F_SETFD, 0);
+        execve(args[0], args.data(), envp.data());
+        _exit(127);
+    }
+    ::close(pair[1]);
+
+    auto ok = child > 0 && serve(pair[0], fds, Clock::now() + std::chrono::seconds(timeout));
+    if (child < 0) {
+        LOG_ERROR("handoff: fork failed: {}", strerror(errno));
+    }
+    ::close(pair[0]);
+
+    if (child > 0 && !ok) {
+        LOG_ERROR("handoff: {} did not take the sockets over in {}s", argv[0], timeout);
+        kill(child, SIGKILL);
+        waitpid(child, nullptr, 0);
+    }
+    return ok;
+}
+
+bool takeOver(std::vector<int> &fds, int &conn)
+{
+    auto env = getenv(kHandoffEnv);
+    if (env == nullptr) {
+        return false;
+    }
+    std::string value(env);
+    // the processes this one starts are not handed anything
+    unsetenv(kHandoffEnv);
+
+    char *end = nullptr;
+    errno = 0;
+    auto fd = strtol(value.c_str(), &end, 10);
+    sockaddr_storage addr;
+    socklen_t length = sizeof(addr);
+    if (errno != 0 || end == value.c_str() || *end != '\0' || fd < 0 || fd > INT_MAX
+        || getsockname(static_cast<int>(fd), reinterpret_cast<sockaddr *>(&addr), &length) != 0
+        || addr.ss_family != AF_UNIX) {
+        LOG_ERROR("handoff: {} is not the socket of a restart", value);
+        return false;
+    }
+    conn = static_cast<int>(fd);
+    fcntl(conn, F_SETFD, FD_CLOEXEC);
+
+    char count = 0;
+    iovec iov{&count, 1};
+    std::vector<char> control(CMSG_SPACE(sizeof(int) * kMaxFds));
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.data();
+    msg.msg_controllen = control.size();
+    auto n = recvmsg(conn, &msg, MSG_CMSG_CLOEXEC);
+
+    for (auto cmsg = CMSG_FIRSTHDR(&msg); n == 1 && cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            auto k = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            auto data = reinterpret_cast<const int *>(CMSG_DATA(cmsg));
+            fds.insert(fds.end(), data, data + k);
+        }
+    }
+    if (n != 1 || fds.size() != static_cast<size_t>(static_cast<unsigned char>(count))) {
+        LOG_ERROR("handoff: received {} of {} sockets", fds.size(), static_cast<unsigned char>(count));
+        for (auto fd : fds) {
+            ::close(fd);
+        }
+        fds.clear();
+        ::close(conn);
+        return false;
+    }
+    return true;
+}
+
+void confirmTakeOver(int conn, size_t count)
+{
+    // the old process compares it with what it sent, then stops accepting
+    auto ack = static_cast<char>(count);
+    if (send(conn, &ack, 1, MSG_NOSIGNAL) != 1) {
+        LOG_ERROR("handoff: confirm failed: {}", strerror(errno));
+    }
+    ::close(conn);
+}
+
+CPPMHD_NAMESPACE_END
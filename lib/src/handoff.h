@@ -0,0 +1,31 @@
+#ifndef CPPMHD_INTERNAL_HANDOFF_H_
+#define CPPMHD_INTERNAL_HANDOFF_H_
+
+#include "config.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "core.h"
+
+CPPMHD_NAMESPACE_BEGIN
+
+// the fd of the Unix socket a process started by handOver takes the listening sockets from
+constexpr char kHandoffEnv[] = "CPPMHD_HANDOFF";
+
+// starts argv, argv[0] being the path of the executable, and passes it the listening sockets fds over one end of a
+// socket pair it inherits. true once it serves on them. false if it could not be started or did not confirm within
+// timeout seconds, it is killed then
+bool handOver(const std::vector<std::string> &argv, const std::vector<int> &fds, uint32_t timeout);
+
+// the listening sockets of the process that started this one with handOver. false if it was not started so, or if
+// they can not be received. conn is confirmed with confirmTakeOver once the daemons run on all of them, or closed
+bool takeOver(std::vector<int> &fds, int &conn);
+
+void confirmTakeOver(int conn, size_t count);
+
+CPPMHD_NAMESPACE_END
+
+#endif
@@ -0,0 +1,138 @@
+#include "header.h"
+
+#include <cassert>
+
+#include "http.h"
+
+#ifdef ON_WINDOWS
+#define strncasecmp _strnicmp
+#define strcasecmp _stricmp
+#endif
+
+CPPMHD_NAMESPACE_BEGIN
+
+namespace
+{
+const char* const knownNames[kKnownHeaderCount] = {CPPMHD_HTTP_HEADER_HOST,
+                                                   CPPMHD_HTTP_HEADER_CONTENT_TYPE,
+                                                   CPPMHD_HTTP_HEADER_CONTENT_LENGTH,
+                                                   CPPMHD_HTTP_HEADER_ACCEPT_ENCODING,
+                                                   CPPMHD_HTTP_HEADER_AUTHORIZATION,
+                                                   CPPMHD_HTTP_HEADER_COOKIE,
+                                                   CPPMHD_HTTP_HEADER_IF_NONE_MATCH,
+                                                   CPPMHD_HTTP_HEADER_IF_MODIFIED_SINCE,
+                                                   CPPMHD_HTTP_HEADER_RANGE,
+                                                   CPPMHD_HTTP_HEADER_IF_RANGE,
+                                                   CPPMHD_HTTP_HEADER_EXPECT,
+                                                   CPPMHD_HTTP_HEADER_CONNECTION,
+                                                   CPPMHD_HTTP_HEADER_TRANSFER_ENCODING,
+                                                   CPPMHD_HTTP_HEADER_USER_AGENT,
+                                                   CPPMHD_HTTP_HEADER_X_FORWARDED_FOR};
+
+inline KnownHeader matchName(const char* name, size_t length, KnownHeader candidate)
+{
+    auto expect = knownNames[static_cast<size_t>(candidate)];
+    assert(strlen(expect) == length);
+    return strncasecmp(name, expect, length) == 0 ? candidate : KnownHeader::UNKNOWN;
+}
+
+MHD_Return headerIter(void* cls, MAYBE_UNUSED MHD_ValueKind kind, const char* key, const char* value)
+{
+    auto index = reinterpret_cast<HeaderIndex*>(cls);
+    assert(kind == MHD_HEADER_KIND);
+    index->add(key, value);
+    return MHD_OK;
+}
+
+}  // namespace
+
+const char* knownHeaderName(KnownHeader h)
+{
+    return h == KnownHeader::UNKNOWN ? nullptr : knownNames[static_cast<size_t>(h)];
+}
+
+KnownHeader classifyHeader(const char* name, size_t length)
+{
+    if (unlikely(length < 4)) {
+        return KnownHeader::UNKNOWN;
+    }
+
+    // the length together with the first letter leaves at most one candidate
+    auto first = name[0] | 0x20;
+
+    switch (length) {
+        case 4:
+            return matchName(name, length, KnownHeader::HOST);
+        case 5:
+            return matchName(name, length, KnownHeader::RANGE);
+        case 6:
+            return first == 'c' ? matchName(name, length, KnownHeader::COOKIE)
+                                : matchName(name, length, KnownHeader::EXPECT);
+        case 8:
+            return matchName(name, length, KnownHeader::IF_RANGE);
+        case 10:
+            return first == 'c' ? matchName(name, length, KnownHeader::CONNECTION)
+                                : matchName(name, length, KnownHeader::USER_AGENT);
+        case 12:
+            return matchName(name, length, KnownHeader::CONTENT_TYPE);
+        case 13:
+            return first == 'a' ? matchName(name, length, KnownHeader::AUTHORIZATION)
+                                : matchName(name, length, KnownHeader::IF_NONE_MATCH);
+        case 14:
+            return matchName(name, length, KnownHeader::CONTENT_LENGTH);
+        case 15:
+            return first == 'a' ? matchName(name, length, KnownHeader::ACCEPT_ENCODING)
+                                : matchName(name, length, KnownHeader::X_FORWARDED_FOR);
+        case 17:
+            return first == 'i' ? matchName(name, length, KnownHeader::IF_MODIFIED_SINCE)
+                                : matchName(name, length, KnownHeader::TRANSFER_ENCODING);
+        default:
+            return KnownHeader::UNKNOWN;
+    }
+}
+
+void HeaderIndex::add(const char* key, const char* value)
+{
+    if (unlikely(key == nullptr)) {
+        return;
+    }
+
+    auto h = classifyHeader(key);
+    if (h != KnownHeader::UNKNOWN) {
+        auto& slot = known_[static_cast<size_t>(h)];
+        if (slot == nullptr) {
+            slot = value;
+        }
+    }
+    all_.emplace_back(key, value);
+}
+
+void HeaderIndex::build(MHD_Connection* conn)
+{
+    assert(conn);
+    clear();
+    all_.reserve(16);
+    MHD_get_connection_values(conn, MHD_HEADER_KIND, headerIter, this);
+    finish();
+}
+
+const char* HeaderIndex::get(const char* name) const
+{
+    if (unlikely(name == nullptr)) {
+        return nullptr;
+    }
+
+    auto h = classifyHeader(name);
+    if (likely(h != KnownHeader::UNKNOWN)) {
+        return get(h);
+    }
+
+    for (const auto& item : all_) {
+        if (strcasecmp(item.first, name) == 0) {
+            return item.second;
+        }
+    }
+    return nullptr;
+}
+
+CPPMHD_NAMESPACE_END
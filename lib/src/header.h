@@ -0,0 +1,76 @@
+#ifndef CPPMHD_INTERNAL_HEADER_H_
+#define CPPMHD_INTERNAL_HEADER_H_
+
+#include "config.h"
+
+#include <cppmhd/core.h>
+#include <cppmhd/entity.h>
+
+#include <cstring>
+
+#include "core.h"
+
+CPPMHD_NAMESPACE_BEGIN
+
+constexpr size_t kKnownHeaderCount = static_cast<size_t>(KnownHeader::UNKNOWN);
+
+// map a header name to its fixed slot, case-insensitive. KnownHeader::UNKNOWN if it has none.
+KnownHeader classifyHeader(const char* name, size_t length);
+
+inline KnownHeader classifyHeader(const char* name)
+{
+    return name == nullptr ? KnownHeader::UNKNOWN : classifyHeader(name, strlen(name));
+}
+
+// per-request view of the request headers.
+// the header list of MHD is walked once on first access, well-known headers are put into fixed slots,
+// and everything else is kept as pointer pairs for the linear fallback lookup and for iteration.
+class HeaderIndex
+{
+    const char* known_[kKnownHeaderCount];
+    HttpHeaderList all_;
+    bool built_;
+
+  public:
+    HeaderIndex() : built_(false)
+    {
+        clear();
+    }
+
+    bool built() const
+    {
+        return built_;
+    }
+
+    void clear()
+    {
+        memset(known_, 0, sizeof(known_));
+        all_.clear();
+    }
+
+    // add one header. as MHD_lookup_connection_value does, the first one wins on duplicated headers.
+    void add(const char* key, const char* value);
+
+    void build(MHD_Connection* conn);
+
+    void finish()
+    {
+        built_ = true;
+    }
+
+    const char* get(KnownHeader h) const
+    {
+        return h == KnownHeader::UNKNOWN ? nullptr : known_[static_cast<size_t>(h)];
+    }
+
+    const char* get(const char* name) const;
+
+    const HttpHeaderList& all() const
+    {
+        return all_;
+    }
+};
+
+CPPMHD_NAMESPACE_END
+
+#endif
@@ -5,7 +5,14 @@
 #include <cppmhd/app.h>
 #include <cppmhd/entity.h>
 
+#include <fcntl.h>
 #include <signal.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
 
 #define FORMAT_INETADDRESS
 #define FORMAT_REQUEST_STATE
@@ -14,9 +21,15 @@
 #define FORMAT_HTTP_METHOD
 #endif
 
+#include "clock.h"
 #include "entity.h"
 #include "format.h"
+#include "handoff.h"
 #include "logger.h"
+#include "method.h"
+#include "probes.h"
+#include "range.h"
+#include "timing.h"
 
 using namespace cppmhd;
 using fmt::format;
@@ -24,42 +37,48 @@ using std::move;
 
 namespace
 {
-bool parseHttpMethod(HttpMethod &out, const char *mth)
+MHD_Return MHDAcceptCB(void *cls, MAYBE_UNUSED const struct sockaddr *addr, MAYBE_UNUSED socklen_t addrlen)
 {
-#define MATCH_METHOD(a, b, like) (like(strncmp(a, b, (sizeof(b) - 1)) == 0))
-#define IF_BLOCK_RAW(name, like)                           \
-    if (MATCH_METHOD(mth, MHD_HTTP_METHOD_##name, like)) { \
-        out = HttpMethod::name;                            \
+    auto ctx = reinterpret_cast<DaemonContext *>(cls);
+    if (unlikely(!ctx->admission.acceptConnection())) {
+        LOG_DTRACE("{} connections open, refuse a new one", ctx->admission.connections());
+        return MHD_FAILED;
     }
-#define IF_BLOCK(name) IF_BLOCK_RAW(name, unlikely)
-#define IF_LIKELY(name) IF_BLOCK_RAW(name, likely)
-
-    bool ret = true;
 
-    // clang-format off
-    IF_LIKELY(GET)
-    else IF_LIKELY(POST) 
-    else IF_BLOCK(PUT) 
-    else IF_BLOCK(DELETE) 
-    else IF_BLOCK(OPTIONS) 
-
-    else IF_BLOCK(HEAD) 
-    else IF_BLOCK(TRACE) 
-    else IF_BLOCK(PATCH) 
-    else IF_BLOCK(CONNECT) 
-    else ret = false;
-    // clang-format on
+    auto limiter = ctx->http->limiter();
+    if (limiter != nullptr && limiter->options().key == RateLimitKey::CLIENT_ADDRESS
+        && unlikely(!limiter->available(RateLimiter::keyOf(addr), limiter->now()))) {
+        LOG_DTRACE("{}", "client over its rate, refuse the connection");
+        return MHD_FAILED;
+    }
+    return MHD_OK;
+}
 
-#undef IF_BLOCK
-#undef IF_LIKELY
-#undef MATCH_METHOD
+uint64_t clientKey(MHD_Connection *conn)
+{
+    auto info = MHD_get_connection_info(conn, MHD_CONNECTION_INFO_CLIENT_ADDRESS);
+    return RateLimiter::keyOf(info == nullptr ? nullptr : info->client_addr);
+}
 
-    return ret;
+// the rate limit key known before routing, 0 for ROUTE_PARAM
+uint64_t requestKey(MHD_Connection *conn, const RateLimitOptions &options)
+{
+    if (options.key == RateLimitKey::HEADER) {
+        auto value = MHD_lookup_connection_value(conn, MHD_HEADER_KIND, options.name.c_str());
+        if (value != nullptr) {
+            return RateLimiter::keyOf(value, strlen(value));
+        }
+    } else if (options.key == RateLimitKey::ROUTE_PARAM) {
+        return 0;
+    }
+    return clientKey(conn);
 }
 
-MHD_Return MHDAcceptCB(MAYBE_UNUSED void *cls, MAYBE_UNUSED const struct sockaddr *addr, MAYBE_UNUSED socklen_t addrlen)
+// the listener of the connection, the daemon notified about it when it opened
+uint32_t connectionListener(MHD_Connection *conn)
 {
-    return MHD_OK;
+    auto info = MHD_get_connection_info(conn, MHD_CONNECTION_INFO_SOCKET_CONTEXT);
+    return info == nullptr ? 0 : static_cast<uint32_t>(reinterpret_cast<uintptr_t>(info->socket_context));
 }
 
 struct ConnectionObject {
@@ -67,6 +86,32 @@ struct ConnectionObject {
     HttpResponsePtr response;
     MHDHttpRequest *raw;
     HttpController *ctrl;
+    const RouteInfo *route;
+
+    std::chrono::steady_clock::time_point start;
+    uint64_t bytesIn;
+    // the body length of the response queued, plus what its reader counted in sent when the length is unknown
+    uint64_t bytesOut;
+    SentCounter sent;
+    // limit of bytesIn, 0 for none
+    uint64_t maxBodySize;
+    // status of the preallocated response the request was rejected with, 0 if it was not
+    int rejected;
+    // status of the cached response queued for the request, 0 if none was
+    int cached;
+
+    // the key of the response in the response cache, 0 if it is not cached
+    uint64_t cacheKey;
+    // runs the handler for the requests of cacheKey waiting for it
+    bool cacheLeader;
+    // paused until the leader of cacheKey is done
+    bool cacheWaiting;
+    // the connection is a websocket or an event stream, admission released it already
+    bool released;
+
+#ifdef ENABLE_REQUEST_TIMING
+    RequestTiming timing;
+#endif
 
 #ifndef NDEBUG
     size_t time;
@@ -75,6 +120,21 @@ struct ConnectionObject {
     {
         raw = other.raw;
         ctrl = other.ctrl;
+        route = other.route;
+        start = other.start;
+        bytesIn = other.bytesIn;
+        bytesOut = other.bytesOut;
+        sent = other.sent;
+        maxBodySize = other.maxBodySize;
+        rejected = other.rejected;
+        cached = other.cached;
+        cacheKey = other.cacheKey;
+        cacheLeader = other.cacheLeader;
+        cacheWaiting = other.cacheWaiting;
+        released = other.released;
+#ifdef ENABLE_REQUEST_TIMING
+        timing = other.timing;
+#endif
         request = other.request;
         response = other.response;
     }
@@ -85,10 +145,32 @@ struct ConnectionObject {
         raw = new MHDHttpRequest(std::forward<Args>(args)...);
         request = HttpRequestPtr(raw);
         ctrl = nullptr;
+        route = nullptr;
+        start = std::chrono::steady_clock::now();
+        bytesIn = 0;
+        bytesOut = 0;
+        maxBodySize = 0;
+        rejected = 0;
+        cached = 0;
+        cacheKey = 0;
+        cacheLeader = false;
+        cacheWaiting = false;
+        released = false;
+#ifdef ENABLE_REQUEST_TIMING
+        memset(&timing, 0, sizeof(timing));
+#endif
 #ifndef NDEBUG
         time = 1;
 #endif
     }
+
+    int status() const
+    {
+        if (response) {
+            return response->status();
+        }
+        return rejected != 0 ? rejected : cached;
+    }
 };
 }  // namespace
 
@@ -127,6 +209,14 @@ struct formatter<ConnectionObject> {
 
 namespace
 {
+void setServerHeader(HttpResponse &resp)
+{
+    auto &server = resp.header(CPPMHD_HTTP_HEADER_SERVER);
+    if (server.length() == 0) {
+        server = PROJECT_SERVER_HEADER;
+    }
+}
+
 void setResponseHeader(MHD_Response *resp, const HttpResponse::HeaderType &headers)
 {
     assert(resp);
@@ -137,7 +227,15 @@ void setResponseHeader(MHD_Response *resp, const HttpResponse::HeaderType &heade
     }
 }
 
-MHD_Response *createResponse(HttpResponsePtr &resp, HttpImplement *http)
+// length is the body length of the response created, or sent counts the bytes of a body compressed while it is sent
+MHD_Response *createResponse(HttpResponsePtr &resp,
+                             HttpImplement *http,
+                             const char *acceptEncoding,
+                             const char *range,
+                             const char *ifRange,
+                             bool stream,
+                             uint64_t &length,
+                             SentCounter &sent)
 {
     assert(resp);
     static const std::string oct(CPPMHD_HTTP_MIME_APPLICATION_OCTET);
@@ -145,33 +243,380 @@ MHD_Response *createResponse(HttpResponsePtr &resp, HttpImplement *http)
     auto size = std::get<0>(body);
     auto data = std::get<1>(body);
     auto persis = std::get<2>(body);
+    auto fd = resp->fd();
 
-
-    auto res = MHD_create_response_from_buffer(
-        size, const_cast<void *>(data), !persis ? MHD_RESPMEM_PERSISTENT : MHD_RESPMEM_MUST_COPY);
-
-    if (size > 0) {
+    if (size > 0 || fd >= 0) {
         auto &type = resp->header(CPPMHD_HTTP_HEADER_CONTENT_TYPE);
 
         if (type.length() == 0) {
             type = oct;
         }
     }
-    http->addSharedHeaders(resp);
+
+    MHD_Response *res = nullptr;
+    if (range != nullptr) {
+        res = createRangeResponse(resp, range, ifRange, length);
+    }
+
+    auto compressor = http->compressor();
+    if (res == nullptr && compressor != nullptr && size > 0) {
+        res = compressor->create(resp, acceptEncoding, stream, length, sent);
+    }
+
+    if (res == nullptr && fd >= 0) {
+        // MHD closes its own copy, the response may be sent again
+        auto copy = ::dup(fd);
+        res = copy < 0 ? nullptr : MHD_create_response_from_fd_at_offset64(resp->fileSize(), copy, 0);
+        length = resp->fileSize();
+        if (res == nullptr) {
+            LOG_ERROR("create response of fd {} failed: {}", fd, strerror(errno));
+            if (copy >= 0) {
+                ::close(copy);
+            }
+        }
+    }
+
+    if (res == nullptr) {
+        res = MHD_create_response_from_buffer(
+            size, const_cast<void *>(data), !persis ? MHD_RESPMEM_PERSISTENT : MHD_RESPMEM_MUST_COPY);
+        length = size;
+    }
+    if (fd >= 0) {
+        resp->header(CPPMHD_HTTP_HEADER_ACCEPT_RANGES) = "bytes";
+    }
+    http->addSharedHeaders(resp, res);
     setResponseHeader(res, resp->headers());
 
     return res;
 }
 
-MHD_Return sendHttpResponsePtr(MHD_Connection *conn, HttpImplement *http, HttpResponsePtr &resp)
+// length is the body length of the response queued, or sent counts the bytes of a body of unknown length
+MHD_Return queueResponse(MHD_Connection *conn,
+                         HttpImplement *http,
+                         HttpResponsePtr &resp,
+                         const char *acceptEncoding,
+                         const char *range,
+                         const char *ifRange,
+                         uint64_t &length,
+                         SentCounter &sent)
 {
-    auto res = createResponse(resp, http);
+    auto res = createResponse(resp, http, acceptEncoding, range, ifRange, true, length, sent);
     auto ret = MHD_queue_response(conn, resp->status(), res);
     MHD_destroy_response(res);
 
     return ret;
 }
 
+bool isSafeMethod(HttpMethod method)
+{
+    return method == HttpMethod::GET || method == HttpMethod::HEAD;
+}
+
+MHD_Return hashArgument(void *cls, MHD_ValueKind, const char *key, const char *value)
+{
+    auto &hash = *reinterpret_cast<uint64_t *>(cls);
+    hash = xxh64(key, strlen(key), hash);
+    // "?a" and "?a=" differ
+    hash = value == nullptr ? xxh64(nullptr, 0, hash + 1) : xxh64(value, strlen(value), hash);
+    return MHD_OK;
+}
+
+// a URL is its route, its path and its query arguments
+uint64_t validatorKey(MHD_Connection *conn, const ConnectionObject *co)
+{
+    auto path = co->raw->getPath();
+    auto key = xxh64(path, strlen(path), co->route->id);
+    MHD_get_connection_values(conn, MHD_GET_ARGUMENT_KIND, hashArgument, &key);
+    return key;
+}
+
+// the headers of the 200 a 304 for it repeats
+KeptHeaders keptHeaders(const HttpResponse &of)
+{
+    static const char *const kKept[] = {CPPMHD_HTTP_HEADER_CACHE_CONTROL,
+                                        CPPMHD_HTTP_HEADER_CONTENT_LOCATION,
+                                        CPPMHD_HTTP_HEADER_EXPIRES,
+                                        CPPMHD_HTTP_HEADER_VARY};
+
+    KeptHeaders kept;
+    auto &headers = of.headers();
+    for (auto name : kKept) {
+        auto it = headers.find(name);
+        if (it != headers.end()) {
+            kept.emplace_back(name, it->second);
+        }
+    }
+    return kept;
+}
+
+// the 304 of a 200 with these validators and headers
+HttpResponsePtr notModifiedResponse(const std::string &etag, const std::string &lastModified, const KeptHeaders &kept)
+{
+    auto resp = std::make_shared<HttpResponse>();
+    resp->status(k304NotModified);
+    for (auto &h : kept) {
+        resp->header(h.first) = h.second;
+    }
+    if (etag.length() != 0) {
+        resp->header(CPPMHD_HTTP_HEADER_ETAG) = etag;
+    }
+    if (lastModified.length() != 0) {
+        resp->header(CPPMHD_HTTP_HEADER_LAST_MODIFIED) = lastModified;
+    }
+    return resp;
+}
+
+// a 304 from the validators of the last 200 of the URL, without running the handler
+bool cachedNotModified(MHD_Connection *conn, HttpImplement *http, ConnectionObject *co)
+{
+    auto ifNoneMatch = co->raw->getHeader(KnownHeader::IF_NONE_MATCH);
+    auto ifModifiedSince = ifNoneMatch == nullptr ? co->raw->getHeader(KnownHeader::IF_MODIFIED_SINCE) : nullptr;
+    if (ifNoneMatch == nullptr && ifModifiedSince == nullptr) {
+        return false;
+    }
+
+    ValidatorCache::Validators v;
+    if (!http->validators()->lookup(validatorKey(conn, co), ValidatorCache::Clock::now(), v)
+        || !notModified(ifNoneMatch, ifModifiedSince, v.etag, v.lastModified)) {
+        return false;
+    }
+    co->response = notModifiedResponse(v.etag, v.lastModified, v.headers);
+    return true;
+}
+
+// a 200 to a GET or HEAD: stores its validators when the route caches them, and turns it into a 304 when the
+// conditions of the request hold
+void checkValidators(MHD_Connection *conn, HttpImplement *http, ConnectionObject *co)
+{
+    auto &resp = co->response;
+    auto &headers = resp->headers();
+    auto it = headers.find(CPPMHD_HTTP_HEADER_ETAG);
+    auto etag = it != headers.end() ? it->second : std::string();
+    it = headers.find(CPPMHD_HTTP_HEADER_LAST_MODIFIED);
+    auto lastModified = it != headers.end() ? it->second : std::string();
+
+    auto ttl = co->route->validatorTtl;
+    if (ttl != 0) {
+        // a file is not hashed, HttpResponse::file(path) sets an ETag. a persistent body is hashed every time as well,
+        // it may have been changed in place
+        if (etag.length() == 0 && resp->fd() < 0) {
+            auto &body = resp->body();
+            etag = etagOf(std::get<1>(body), std::get<0>(body));
+            resp->header(CPPMHD_HTTP_HEADER_ETAG) = etag;
+        }
+        http->validators()->store(
+            validatorKey(conn, co),
+            {etag, lastModified, keptHeaders(*resp), ValidatorCache::Clock::now() + std::chrono::seconds(ttl)});
+    }
+
+    if (etag.length() == 0 && lastModified.length() == 0) {
+        return;
+    }
+
+    auto ifNoneMatch = co->raw->getHeader(KnownHeader::IF_NONE_MATCH);
+    auto ifModifiedSince = co->raw->getHeader(KnownHeader::IF_MODIFIED_SINCE);
+    if (notModified(ifNoneMatch, ifModifiedSince, etag, lastModified)) {
+        LOG_DTRACE("{}: validators hold, 304", *co);
+        resp = notModifiedResponse(etag, lastModified, keptHeaders(*resp));
+    }
+}
+
+// the key of a GET of a cached route: its URL, the headers the route varies on and the encoding the client accepts
+uint64_t cacheKey(MHD_Connection *conn, HttpImplement *http, const ConnectionObject *co)
+{
+    auto key = validatorKey(conn, co);
+    for (auto &name : co->route->cache.vary) {
+        auto value = co->raw->getHeader(name.c_str());
+        key = value == nullptr ? xxh64(nullptr, 0, key + 1) : xxh64(value, strlen(value), key);
+    }
+    if (http->compressor() != nullptr) {
+        auto encoding = negotiate(co->raw->getHeader(KnownHeader::ACCEPT_ENCODING));
+        key = xxh64(&encoding, sizeof(encoding), key);
+    }
+    // 0 is no key
+    return key != 0 ? key : 1;
+}
+
+// a cached 200, or a 304 when the conditions of the request hold for it
+MHD_Return sendCached(MHD_Connection *conn,
+                      HttpImplement *http,
+                      ConnectionObject *co,
+                      const ResponseCache::Cached &cached)
+{
+    auto ifNoneMatch = co->raw->getHeader(KnownHeader::IF_NONE_MATCH);
+    auto ifModifiedSince = co->raw->getHeader(KnownHeader::IF_MODIFIED_SINCE);
+    if (notModified(ifNoneMatch, ifModifiedSince, cached.etag, cached.lastModified)) {
+        co->response = notModifiedResponse(cached.etag, cached.lastModified, cached.headers);
+        return queueResponse(conn,
+                             http,
+                             co->response,
+                             co->raw->getHeader(KnownHeader::ACCEPT_ENCODING),
+                             nullptr,
+                             nullptr,
+                             co->bytesOut,
+                             co->sent);
+    }
+
+    auto response = http->datedResponse(co->cacheKey, cached);
+    if (unlikely(!response)) {
+        LOG_ERROR("create the cached response of {} failed", co->raw->getPath());
+        return MHD_FAILED;
+    }
+    co->cached = k200OK;
+    co->bytesOut = cached.length;
+    TIMING_MARK(co, QUEUED);
+    CPPMHD_PROBE2(response__queued, conn, static_cast<int>(k200OK));
+    return MHD_queue_response(conn, k200OK, response.get());
+}
+
+// the response asks shared caches not to keep it
+bool noStore(const HttpResponse &resp)
+{
+    auto &headers = resp.headers();
+    auto it = headers.find(CPPMHD_HTTP_HEADER_CACHE_CONTROL);
+    return it != headers.end() && (containsNoCase(it->second, "no-store") || containsNoCase(it->second, "private"));
+}
+
+// keeps the 200 of a cached route, with an ETag hashed once, and sends it
+MHD_Return storeCached(MHD_Connection *conn, HttpImplement *http, ConnectionObject *co)
+{
+    auto &resp = co->response;
+    auto &body = resp->body();
+    auto &etag = resp->header(CPPMHD_HTTP_HEADER_ETAG);
+    if (etag.length() == 0) {
+        etag = etagOf(std::get<1>(body), std::get<0>(body));
+    }
+
+    // not streamed, the bytes are shared by the responses of every second of the key
+    auto compressor = http->compressor();
+    auto encoded =
+        compressor != nullptr ? compressor->encode(resp, co->raw->getHeader(KnownHeader::ACCEPT_ENCODING)) : nullptr;
+    if (!encoded) {
+        encoded = std::make_shared<const std::string>(static_cast<const char *>(std::get<1>(body)), std::get<0>(body));
+    }
+    if (std::get<0>(body) > 0 && resp->header(CPPMHD_HTTP_HEADER_CONTENT_TYPE).length() == 0) {
+        resp->header(CPPMHD_HTTP_HEADER_CONTENT_TYPE) = CPPMHD_HTTP_MIME_APPLICATION_OCTET;
+    }
+    setServerHeader(*resp);
+
+    // as sent: the compression adds to Vary and weakens the ETag
+    auto &headers = resp->headers();
+    auto lastModified = headers.find(CPPMHD_HTTP_HEADER_LAST_MODIFIED);
+    ResponseCache::Cached cached{nullptr,
+                                 0,
+                                 encoded,
+                                 std::make_shared<const HttpResponse::HeaderType>(headers),
+                                 headers.find(CPPMHD_HTTP_HEADER_ETAG)->second,
+                                 lastModified != headers.end() ? lastModified->second : std::string(),
+                                 keptHeaders(*resp),
+                                 encoded->length()};
+    auto bytes = encoded->length();
+    for (auto &h : headers) {
+        bytes += h.first.length() + h.second.length();
+    }
+
+    auto &policy = co->route->cache;
+    auto fresh = ResponseCache::Clock::now() + std::chrono::seconds(policy.ttl);
+    auto sent = cached;
+    co->cacheLeader = false;
+    http->responseCache()->store(
+        co->cacheKey, std::move(cached), bytes, fresh, fresh + std::chrono::seconds(policy.stale));
+    return sendCached(conn, http, co, sent);
+}
+
+MHD_Return sendResponse(MHD_Connection *conn, HttpImplement *http, ConnectionObject *co)
+{
+    if (co->cacheKey != 0) {
+        if (co->response->status() == k200OK && co->response->fd() < 0 && !noStore(*co->response)) {
+            return storeCached(conn, http, co);
+        }
+        if (co->cacheLeader) {
+            co->cacheLeader = false;
+            http->responseCache()->release(co->cacheKey);
+        }
+    }
+
+    if (co->route != nullptr && co->response->status() == k200OK && isSafeMethod(co->raw->getMethod())) {
+        checkValidators(conn, http, co);
+    }
+
+    TIMING_MARK(co, QUEUED);
+    CPPMHD_PROBE2(response__queued, conn, static_cast<int>(co->response->status()));
+
+    // a range of a 200 to a GET, after the validators: a 304 has no body to take it from
+    const char *range = nullptr, *ifRange = nullptr;
+    if (co->response->status() == k200OK && co->raw->getMethod() == HttpMethod::GET) {
+        range = co->raw->getHeader(KnownHeader::RANGE);
+        if (range != nullptr) {
+            ifRange = co->raw->getHeader(KnownHeader::IF_RANGE);
+        }
+    }
+    return queueResponse(conn,
+                         http,
+                         co->response,
+                         co->raw->getHeader(KnownHeader::ACCEPT_ENCODING),
+                         range,
+                         ifRange,
+                         co->bytesOut,
+                         co->sent);
+}
+
+// the method of a request parseHttpMethod does not know, in metrics and the access log
+const auto kUnknownMethod = static_cast<HttpMethod>(0xffff);
+
+// the bodies of the preallocated responses, by Reject
+const char *const kRejectBodies[] = {"Service Unavailable", "Too Many Requests", "Payload Too Large"};
+const int kRejectStatus[] = {k503ServiceUnavailable, k429TooManyRequests, k413PayloadTooLarge};
+
+// the length of the body of the preallocated response
+size_t rejectLength(Reject reject)
+{
+    return strlen(kRejectBodies[static_cast<size_t>(reject)]);
+}
+
+// co is nullptr for a request rejected before it got one. a response MHD refuses to queue, like a 413 in the middle of
+// a body it can not answer, is not recorded: the connection closes without a status
+MHD_Return sendRejected(MHD_Connection *conn, DaemonContext *ctx, ConnectionObject *co, Reject reject)
+{
+    auto status = kRejectStatus[static_cast<size_t>(reject)];
+    auto ret = MHD_queue_response(conn, status, ctx->http->rejectResponse(ctx->rejects, reject));
+    if (co != nullptr && ret == MHD_OK) {
+        co->rejected = status;
+        co->bytesOut = rejectLength(reject);
+    }
+    return ret;
+}
+
+MHD_Return sendShed(MHD_Connection *conn, DaemonContext *ctx, ConnectionObject *co)
+{
+    return sendRejected(conn, ctx, co, Reject::SHED);
+}
+
+MHD_Return sendLimited(MHD_Connection *conn, DaemonContext *ctx, ConnectionObject *co)
+{
+    return sendRejected(conn, ctx, co, Reject::LIMITED);
+}
+
+MHD_Return sendTooLarge(MHD_Connection *conn, DaemonContext *ctx, ConnectionObject *co)
+{
+    return sendRejected(conn, ctx, co, Reject::TOO_LARGE);
+}
+
+// the Content-Length is over the limit. a chunked body is counted as it comes
+bool declaredTooLarge(const MHDHttpRequest *raw, uint64_t limit)
+{
+    auto value = raw->getHeader(KnownHeader::CONTENT_LENGTH);
+    if (value == nullptr) {
+        return false;
+    }
+
+    char *end;
+    errno = 0;
+    auto length = strtoull(value, &end, 10);
+    // MHD answers a malformed Content-Length itself
+    return end != value && errno == 0 && length > limit;
+}
+
 MHD_Return sendTSR(MHD_Connection *conn, HttpImplement *http, ConnectionObject *obj)
 {
     auto next = FORMAT("{}/", obj->request->getPath());
@@ -180,7 +625,127 @@ MHD_Return sendTSR(MHD_Connection *conn, HttpImplement *http, ConnectionObject *
 
     resp->header(CPPMHD_HTTP_HEADER_LOCATION, move(next));
 
-    return sendHttpResponsePtr(conn, http, resp);
+    return sendResponse(conn, http, obj);
+}
+
+// the time and the client of rec are filled in here
+void logAccess(AccessLog *log, MHD_Connection *conn, AccessRecord &rec, const char *path, const AccessTiming *timing)
+{
+    rec.timestamp = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch())
+            .count());
+
+    auto info = MHD_get_connection_info(conn, MHD_CONNECTION_INFO_CLIENT_ADDRESS);
+    rec.setClient(info == nullptr ? nullptr : info->client_addr);
+
+    log->record(rec, path, timing);
+}
+
+// a request answered before it got a ConnectionObject: the 405 of an unknown method, or a 429 or 503 of the
+// preallocated ones. it never reached a route, its latency is too short to tell anything
+void recordRejected(
+    HttpImplement *http, MHD_Connection *conn, const char *url, HttpMethod method, int status, uint64_t bytesOut)
+{
+    auto metrics = http->metrics();
+    if (metrics != nullptr) {
+        metrics->observe(nullptr, method, status, 0);
+    }
+
+    auto log = http->accessLog();
+    if (log != nullptr && log->sampled()) {
+        AccessRecord rec;
+        rec.latency = 0;
+        rec.route = RouteInfo::kNoRoute;
+        rec.method = static_cast<uint16_t>(method);
+        rec.bytesIn = 0;
+        rec.bytesOut = method != HttpMethod::HEAD ? bytesOut : 0;
+        rec.status = static_cast<uint16_t>(status);
+        rec.termination = static_cast<uint8_t>(MHD_REQUEST_TERMINATED_COMPLETED_OK);
+        rec.flags = 0;
+        memset(rec.reserved, 0, sizeof(rec.reserved));
+        logAccess(log, conn, rec, url, nullptr);
+    }
+}
+
+// MHD hands the socket over once the 101 is sent
+void upgradeCB(void *cls,
+               MAYBE_UNUSED MHD_Connection *conn,
+               void *reqCls,
+               const char *extra,
+               size_t extraSize,
+               MHD_socket sock,
+               MHD_UpgradeResponseHandle *urh)
+{
+    auto ctx = reinterpret_cast<DaemonContext *>(cls);
+    auto co = reinterpret_cast<ConnectionObject *>(reqCls);
+
+    // no longer a request in flight
+    co->released = true;
+    ctx->admission.release();
+
+    auto &headers = co->response->headers();
+    auto deflate = headers.find(CPPMHD_HTTP_HEADER_SEC_WEBSOCKET_EXTENSIONS) != headers.end();
+    LOG_DTRACE("{}: upgraded, deflate {}", *co, deflate);
+    ctx->http->webSockets()->open(
+        static_cast<WebSocketController *>(co->ctrl), co->request, sock, urh, extra, extraSize, deflate);
+}
+
+MHD_Return sendUpgrade(MHD_Connection *conn, DaemonContext *ctx, ConnectionObject *co)
+{
+    TIMING_MARK(co, QUEUED);
+    CPPMHD_PROBE2(response__queued, conn, static_cast<int>(co->response->status()));
+
+    auto res = MHD_create_response_for_upgrade(upgradeCB, ctx);
+    if (res == nullptr) {
+        LOG_ERROR("{}", "create response for upgrade failed");
+        return MHD_FAILED;
+    }
+    ctx->http->addSharedHeaders(co->response, res);
+    setResponseHeader(res, co->response->headers());
+    auto ret = MHD_queue_response(conn, k101SwitchingProtocol, res);
+    MHD_destroy_response(res);
+
+    return ret;
+}
+
+MHD_Return sendEvents(MHD_Connection *conn, DaemonContext *ctx, ConnectionObject *co, SseController *sse)
+{
+    auto http = ctx->http;
+    std::vector<std::string> topics;
+    sse->onSubscribe(co->request, topics, co->response);
+    TIMING_MARK(co, CONNECTION);
+    if (co->response) {
+        return sendResponse(conn, http, co);
+    }
+    if (topics.empty()) {
+        co->response = http->getErrorHandler()(
+            co->request, k404NotFound, HttpError::ROUTER_NOT_FOUND, format("no topic at {}", co->raw->getPath()));
+        return sendResponse(conn, http, co);
+    }
+
+    TIMING_MARK(co, QUEUED);
+    CPPMHD_PROBE2(response__queued, conn, static_cast<int>(k200OK));
+
+    auto res = SseStream::open(conn, sse->hub(), std::move(topics), co->sent, http->eventStreams());
+    if (res == nullptr) {
+        LOG_ERROR("{}", "create response of event stream failed");
+        return MHD_FAILED;
+    }
+    co->response = std::make_shared<HttpResponse>();
+    co->response->status(k200OK);
+    co->response->header(CPPMHD_HTTP_HEADER_CONTENT_TYPE) = CPPMHD_HTTP_MIME_TEXT_EVENT_STREAM;
+    co->response->header(CPPMHD_HTTP_HEADER_CACHE_CONTROL) = "no-cache";
+    http->addSharedHeaders(co->response, res);
+    setResponseHeader(res, co->response->headers());
+
+    // subscribed until the client goes away, no longer a request in flight
+    co->released = true;
+    ctx->admission.release();
+
+    auto ret = MHD_queue_response(conn, k200OK, res);
+    MHD_destroy_response(res);
+
+    return ret;
 }
 
 MHD_Return MHDconnectionCB(void *cls,
@@ -192,7 +757,8 @@ MHD_Return MHDconnectionCB(void *cls,
                            size_t *dataSize,
                            void **con_cls)
 {
-    auto http = reinterpret_cast<HttpImplement *>(cls);
+    auto ctx = reinterpret_cast<DaemonContext *>(cls);
+    auto http = ctx->http;
     assert(http != nullptr);
 
     auto co = reinterpret_cast<ConnectionObject *>(*con_cls);
@@ -211,6 +777,9 @@ MHD_Return MHDconnectionCB(void *cls,
         // first round
         bool tsr;
         HttpMethod mtd;
+#ifdef ENABLE_REQUEST_TIMING
+        auto begin = monotonicNanos();
+#endif
 
         if (unlikely(!parseHttpMethod(mtd, method))) {
             auto resp = http->getErrorHandler()(nullptr,
@@ -218,26 +787,124 @@ MHD_Return MHDconnectionCB(void *cls,
                                                 HttpError::BAD_HTTP_METHOD,
                                                 FORMAT("un-acceptable Http Method: {}", method));
             LOG_DTRACE("unknown HttpMethod '{}', return 405", method);
-            return sendHttpResponsePtr(conn, http, resp);
+            uint64_t length = 0;
+            SentCounter sent;
+            auto ret = queueResponse(conn, http, resp, nullptr, nullptr, nullptr, length, sent);
+            recordRejected(http, conn, url, kUnknownMethod, k405MethodNotAllowed, length);
+            return ret;
+        }
+
+        auto limiter = http->limiter();
+        if (limiter != nullptr) {
+            auto key = requestKey(conn, limiter->options());
+            if (key != 0 && unlikely(!limiter->acquire(key))) {
+                LOG_DTRACE("{} over the rate limit, 429", url);
+                recordRejected(http, conn, url, mtd, k429TooManyRequests, rejectLength(Reject::LIMITED));
+                return sendLimited(conn, ctx, nullptr);
+            }
+        }
+
+        if (unlikely(!ctx->admission.admit())) {
+            LOG_DTRACE("{} requests in flight, shed {}", ctx->admission.inflight(), url);
+            recordRejected(http, conn, url, mtd, k503ServiceUnavailable, rejectLength(Reject::SHED));
+            return sendShed(conn, ctx, nullptr);
         }
 
-        *con_cls = co = new ConnectionObject(conn, url, mtd);
+        *con_cls = co = new ConnectionObject(conn, url, mtd, http->pausedRequests());
+#ifdef ENABLE_REQUEST_TIMING
+        co->timing.at[static_cast<size_t>(RequestPhase::BEGIN)] = begin;
+#endif
+        TIMING_MARK(co, METHOD_PARSED);
+        CPPMHD_PROBE3(request__start, conn, static_cast<int>(mtd), url);
 
         co->response = http->checkRequest(co->request, version);
+        TIMING_MARK(co, CHECKED);
 
         if (co->response) {
             LOG_DTRACE("{}: checkRequest return a Response. ", *co);
-            return sendHttpResponsePtr(conn, http, co->response);
+            return sendResponse(conn, http, co);
         }
 
-        co->ctrl = http->forward(co->raw, co->raw->param(), tsr);
+        co->ctrl = http->forward(co->raw, co->raw->param(), tsr, co->route);
+        if (unlikely(http->hasListenerRoutes()) && co->ctrl != nullptr
+            && !http->serves(co->route, connectionListener(conn))) {
+            // as if the route did not exist
+            co->ctrl = nullptr;
+            tsr = false;
+        }
+        TIMING_MARK(co, ROUTED);
+        CPPMHD_PROBE4(route__resolved, conn, static_cast<int>(mtd), url, co->ctrl);
 
         if (likely(co->ctrl)) {
             LOG_DTRACE("{}: route found.", *co);
+            if (limiter != nullptr && limiter->options().key == RateLimitKey::ROUTE_PARAM) {
+                auto &params = co->raw->param();
+                auto it = params.find(limiter->options().name);
+                auto key =
+                    it == params.end() ? clientKey(conn) : RateLimiter::keyOf(it->second.data(), it->second.size());
+                if (unlikely(!limiter->acquire(key))) {
+                    LOG_DTRACE("{}: over the rate limit, 429", *co);
+                    return sendLimited(conn, ctx, co);
+                }
+            }
+
+            if (unlikely(ctx->admission.delayControl())
+                && !ctx->admission.admitRouted(co->route->priority, std::chrono::steady_clock::now())) {
+                LOG_DTRACE("{}: overloaded, shed", *co);
+                return sendShed(conn, ctx, co);
+            }
+
+            co->maxBodySize = http->maxBodySize(co->route);
+            if (co->maxBodySize != 0 && unlikely(declaredTooLarge(co->raw, co->maxBodySize))) {
+                // queued before the body is read: no 100 Continue is sent, and the connection closes after the 413
+                LOG_DTRACE("{}: Content-Length over {}, 413", *co, co->maxBodySize);
+                return sendTooLarge(conn, ctx, co);
+            }
+
+            if (co->route->validatorTtl != 0 && isSafeMethod(mtd) && cachedNotModified(conn, http, co)) {
+                LOG_DTRACE("{}: cached validators hold, 304", *co);
+                return sendResponse(conn, http, co);
+            }
+
+            if (co->route->cache.ttl != 0 && mtd == HttpMethod::GET
+                && co->raw->getHeader(KnownHeader::RANGE) == nullptr) {
+                co->cacheKey = cacheKey(conn, http, co);
+                ResponseCache::Cached cached;
+                switch (http->responseCache()->lookup(co->cacheKey, ResponseCache::Clock::now(), co->raw, cached)) {
+                    case ResponseCache::Result::HIT:
+                        LOG_DTRACE("{}: cached", *co);
+                        return sendCached(conn, http, co, cached);
+                    case ResponseCache::Result::WAIT:
+                        // resumed when the leader is done, onConnection runs then if its response is not cached
+                        LOG_DTRACE("{}: waits for the leader of its key", *co);
+                        co->cacheWaiting = true;
+                        co->raw->state() = RequestState::INITIAL_COMPLETE;
+                        return MHD_OK;
+                    case ResponseCache::Result::LEAD:
+                        co->cacheLeader = true;
+                        break;
+                    default:
+                        break;
+                }
+            }
+
+            if (unlikely(http->hasEventRoutes())) {
+                auto sse = dynamic_cast<SseController *>(co->ctrl);
+                if (sse != nullptr) {
+                    LOG_DTRACE("{}: event stream", *co);
+                    return sendEvents(conn, ctx, co, sse);
+                }
+            }
+
             co->ctrl->onConnection(co->request, co->response);
+            TIMING_MARK(co, CONNECTION);
             if (co->response) {
                 LOG_DTRACE("{}: onConnection handler return a Response", *co);
-                return sendHttpResponsePtr(conn, http, co->response);
+                if (co->response->status() == k101SwitchingProtocol
+                    && dynamic_cast<WebSocketController *>(co->ctrl) != nullptr) {
+                    return sendUpgrade(conn, ctx, co);
+                }
+                return sendResponse(conn, http, co);
             }
 
             LOG_DTRACE("{}: onConnection finished", *co);
@@ -252,7 +919,29 @@ MHD_Return MHDconnectionCB(void *cls,
             co->response = http->getErrorHandler()(
                 co->request, k404NotFound, HttpError::ROUTER_NOT_FOUND, format("{} to {} not found", method, url));
 
-            return sendHttpResponsePtr(conn, http, co->response);
+            return sendResponse(conn, http, co);
+        }
+    }
+
+    if (unlikely(co->rejected != 0 || co->cached != 0)) {
+        // the 413 is queued, MHD may still hand over what it has read of the body
+        *dataSize = 0;
+        return MHD_OK;
+    }
+
+    if (unlikely(co->cacheWaiting)) {
+        // resumed by the leader: its response, or the handler runs as it would without the cache
+        co->cacheWaiting = false;
+        ResponseCache::Cached cached;
+        auto cache = http->responseCache();
+        if (cache->lookup(co->cacheKey, ResponseCache::Clock::now(), nullptr, cached) == ResponseCache::Result::HIT) {
+            LOG_DTRACE("{}: cached by the leader", *co);
+            return sendCached(conn, http, co, cached);
+        }
+        co->ctrl->onConnection(co->request, co->response);
+        TIMING_MARK(co, CONNECTION);
+        if (co->response) {
+            return sendResponse(conn, http, co);
         }
     }
 
@@ -264,7 +953,7 @@ MHD_Return MHDconnectionCB(void *cls,
             *dataSize = 0;
             return MHD_OK;
         } else {
-            return sendHttpResponsePtr(conn, http, co->response);
+            return sendResponse(conn, http, co);
         }
     }
 
@@ -277,19 +966,33 @@ MHD_Return MHDconnectionCB(void *cls,
         if (unlikely(state == RequestState::DATA_RECEIVING)) {
             auto pp = co->raw->processor();
             assert(pp);
-            pp->onData(co->request, nullptr, 0);
+            if (unlikely(pp->onData(co->request, nullptr, 0) == DataProcessor::DataProcessorParseFailed)) {
+                LOG_DTRACE("{}: body incomplete, 400", *co);
+                co->response = http->getErrorHandler()(
+                    co->request,
+                    k400BadRequest,
+                    HttpError::DATA_PROCESSOR_RETURN_ERROR,
+                    format("Data Processor return an error at the end of {} Request to {}", method, url));
+                state = RequestState::RS_ERROR;
+                return sendResponse(conn, http, co);
+            }
+            TIMING_MARK(co, BODY_END);
             state = RequestState::DATA_RECEIVED;
             LOG_DTRACE("{}: send last data signal to handler.", *co);
             return MHD_OK;
         }
 
         if (co->ctrl != nullptr) {
+            TIMING_MARK(co, HANDLER);
+            CPPMHD_PROBE2(handler__start, conn, co->ctrl);
             co->ctrl->onRequest(co->request, co->response);
+            CPPMHD_PROBE2(handler__end, conn, co->ctrl);
+            TIMING_MARK(co, HANDLED);
         }
 
         if (co->response) {
             LOG_DTRACE("{}: request finish", *co);
-            return sendHttpResponsePtr(conn, http, co->response);
+            return sendResponse(conn, http, co);
         } else {
             LOG_DTRACE("{} Handler Should make response but there exist none.", *co);
         }
@@ -304,6 +1007,15 @@ MHD_Return MHDconnectionCB(void *cls,
     } else {
         auto pp = co->raw->processor();
 
+        // what the processor did not consume comes again, only the consumed bytes are counted
+        if (co->maxBodySize != 0 && unlikely(co->bytesIn + *dataSize > co->maxBodySize)) {
+            // the processor never sees a byte over the limit. if MHD can not send the 413 in the middle of the body,
+            // the failed queue closes the connection instead, and the request is recorded without a status
+            co->bytesIn += *dataSize;
+            LOG_DTRACE("{}: body over {}, 413", *co, co->maxBodySize);
+            return sendTooLarge(conn, ctx, co);
+        }
+
         if (unlikely(pp == nullptr)) {
             LOG_DTRACE("{}: PP not found return 405.", *co);
             co->response = http->getErrorHandler()(co->request,
@@ -312,6 +1024,7 @@ MHD_Return MHDconnectionCB(void *cls,
                                                    format("Data Processor not set in {} Request to {}", method, url));
 
             state = RequestState::RS_ERROR;
+            co->bytesIn += *dataSize;
             *dataSize = 0;
 
         } else {
@@ -320,7 +1033,15 @@ MHD_Return MHDconnectionCB(void *cls,
                 state = RequestState::DATA_RECEIVING;
             }
 
+#ifdef ENABLE_REQUEST_TIMING
+            TIMING_MARK_ONCE(co, BODY_BEGIN);
+            auto dataBegin = monotonicNanos();
+#endif
             size_t size = pp->onData(co->request, data, *dataSize);
+#ifdef ENABLE_REQUEST_TIMING
+            co->timing.dataRounds++;
+            co->timing.dataTime += monotonicNanos() - dataBegin;
+#endif
             LOG_DTRACE("{}: PP process {}, in {} bytes, return {} bytes", *co, (void *)data, *dataSize, size);
 
             if (unlikely(size == DataProcessor::DataProcessorParseFailed)) {
@@ -330,8 +1051,10 @@ MHD_Return MHDconnectionCB(void *cls,
                                             HttpError::DATA_PROCESSOR_RETURN_ERROR,
                                             format("Data Processor return an error in {} Request to {}", method, url));
 
+                // answered now like a 413, the rest of the body is never read
                 state = RequestState::RS_ERROR;
-                size = *dataSize;
+                co->bytesIn += *dataSize;
+                return sendResponse(conn, http, co);
             } else if (unlikely(size > *dataSize)) {
                 LOG_WARN(
                     "Data Processor return read size {} larger than original data size {}. "
@@ -341,20 +1064,105 @@ MHD_Return MHDconnectionCB(void *cls,
                 size = *dataSize;
             }
 
+            co->bytesIn += size;
             *dataSize -= size;
         }
     }
     return MHD_OK;
 }
 
+void recordAccess(AccessLog *log,
+                  MHD_Connection *conn,
+                  ConnectionObject *co,
+                  uint64_t latency,
+                  const AccessTiming *timing,
+                  MHD_RequestTerminationCode toe)
+{
+    AccessRecord rec;
+
+    rec.latency = static_cast<uint32_t>(latency);
+    rec.route = co->route == nullptr ? RouteInfo::kNoRoute : co->route->id;
+    rec.method = static_cast<uint16_t>(co->raw->getMethod());
+    rec.bytesIn = co->bytesIn;
+    rec.termination = static_cast<uint8_t>(toe);
+    rec.flags = 0;
+    memset(rec.reserved, 0, sizeof(rec.reserved));
+
+    rec.status = static_cast<uint16_t>(co->status());
+    // MHD sends no body to a HEAD
+    if (co->raw->getMethod() != HttpMethod::HEAD) {
+        rec.bytesOut = co->bytesOut + (co->sent ? *co->sent : 0);
+    } else {
+        rec.bytesOut = 0;
+    }
+
+    logAccess(log, conn, rec, co->raw->getPath(), timing);
+}
+
 void connectionFinishCB(void *cls,
-                        MAYBE_UNUSED MHD_Connection *conn,
+                        MHD_Connection *conn,
                         void **data,
                         MAYBE_UNUSED MHD_RequestTerminationCode toe)
 {
-    auto http = reinterpret_cast<HttpImplement *>(cls);
+    auto ctx = reinterpret_cast<DaemonContext *>(cls);
+    auto http = ctx->http;
     auto req = reinterpret_cast<ConnectionObject *>(*data);
     if (req != nullptr) {
+        auto &admission = ctx->admission;
+        auto log = http->accessLog();
+        auto metrics = http->metrics();
+
+        if (!req->released) {
+            admission.release();
+        }
+        const AccessTiming *timing = nullptr;
+
+#ifdef ENABLE_REQUEST_TIMING
+        TIMING_MARK(req, COMPLETED);
+
+        AccessTiming spans;
+        spanMicros(req->timing, spans.span);
+        spans.dataRounds = req->timing.dataRounds;
+        timing = &spans;
+
+        auto &observer = http->observer();
+        if (observer) {
+            observer->onComplete(*req->request, req->response.get(), req->timing);
+        }
+#endif
+
+        if (log != nullptr || metrics != nullptr || admission.delayControl()) {
+            auto now = std::chrono::steady_clock::now();
+            auto latency = static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::microseconds>(now - req->start).count());
+
+            if (admission.delayControl() && req->rejected == 0 && !req->released) {
+                admission.observe(req->start, now);
+            }
+            if (metrics != nullptr) {
+                metrics->observe(req->route, req->raw->getMethod(), req->status(), latency);
+                if (timing != nullptr) {
+                    metrics->observeSpans(timing->span);
+                }
+            }
+            if (log != nullptr && log->sampled()) {
+                recordAccess(log, conn, req, latency, timing, toe);
+            }
+        }
+
+        CPPMHD_PROBE6(request__done,
+                      conn,
+                      static_cast<int>(req->raw->getMethod()),
+                      req->raw->getPath(),
+                      req->status(),
+                      req->ctrl,
+                      static_cast<int>(toe));
+        if (req->cacheWaiting) {
+            http->responseCache()->cancel(req->cacheKey, req->raw);
+        } else if (req->cacheLeader) {
+            http->responseCache()->release(req->cacheKey);
+        }
+        req->raw->complete();
         delete req;
     }
 
@@ -367,10 +1175,25 @@ void connectionFinishCB(void *cls,
 
 void notifyConnectionCB(void *cls,
                         MHD_Connection *conn,
-                        MAYBE_UNUSED void **socket_context,
+                        void **socket_context,
                         MHD_ConnectionNotificationCode toe)
 {
-    auto http = reinterpret_cast<HttpImplement *>(cls);
+    auto ctx = reinterpret_cast<DaemonContext *>(cls);
+    auto http = ctx->http;
+
+    if (toe == MHD_CONNECTION_NOTIFY_STARTED) {
+        CPPMHD_PROBE1(conn__open, conn);
+        ctx->admission.connectionOpened();
+        if (http->tls() != nullptr) {
+            http->tls()->prepare(conn);
+        }
+        if (http->hasListenerRoutes()) {
+            *socket_context = reinterpret_cast<void *>(static_cast<uintptr_t>(http->listenerOf(conn)));
+        }
+    } else {
+        CPPMHD_PROBE1(conn__close, conn);
+        ctx->admission.connectionClosed();
+    }
 
     if (http->isLogConnectionStatus()) {
         auto coninfo = MHD_get_connection_info(conn, MHD_CONNECTION_INFO_CLIENT_ADDRESS);
@@ -380,12 +1203,30 @@ void notifyConnectionCB(void *cls,
             auto fdinfo = MHD_get_connection_info(conn, MHD_CONNECTION_INFO_CONNECTION_FD);
             auto fd = fdinfo == nullptr ? 0 : fdinfo->connect_fd;
 
-            if (unlikely(http->isV6())) {
-                sockaddr_in6 &addr = *(reinterpret_cast<sockaddr_in6 *>(coninfo->client_addr));
-                LOG_TRACE("{} connection to {} (#{})", code[toe], addr, fd);
-            } else {
-                sockaddr_in &addr = *(reinterpret_cast<sockaddr_in *>(coninfo->client_addr));
-                LOG_TRACE("{} connection to {} (#{})", code[toe], addr, fd);
+            // the connections of the added listeners may not be of the family of the App
+            switch (coninfo->client_addr->sa_family) {
+                case AF_INET: {
+                    sockaddr_in &addr = *(reinterpret_cast<sockaddr_in *>(coninfo->client_addr));
+                    LOG_TRACE("{} connection to {} (#{})", code[toe], addr, fd);
+                    break;
+                }
+                case AF_INET6: {
+                    sockaddr_in6 &addr = *(reinterpret_cast<sockaddr_in6 *>(coninfo->client_addr));
+                    LOG_TRACE("{} connection to {} (#{})", code[toe], addr, fd);
+                    break;
+                }
+                default: {
+                    // the client end of a Unix domain socket is unnamed, the path it connected to is ours
+                    sockaddr_un local;
+                    socklen_t len = sizeof(local);
+                    if (getsockname(fd, reinterpret_cast<sockaddr *>(&local), &len) == 0
+                        && len > offsetof(sockaddr_un, sun_path) && local.sun_path[0] != 0) {
+                        LOG_TRACE("{} connection to unix:{} (#{})", code[toe], local.sun_path, fd);
+                    } else {
+                        LOG_TRACE("{} connection to unix (#{})", code[toe], fd);
+                    }
+                    break;
+                }
             }
         }
     }
@@ -414,9 +1255,33 @@ void startWait(Barrier *b)
 }
 
 
+// MHD_RESPMEM_PERSISTENT: the body is never copied, the response is queued as it is for a second. retryAfter 0 leaves
+// the Retry-After out
+MHD_Response *createRejectResponse(const char *body, uint32_t retryAfter, bool close, time_t second)
+{
+    auto resp = MHD_create_response_from_buffer(strlen(body), const_cast<char *>(body), MHD_RESPMEM_PERSISTENT);
+    if (unlikely(resp == nullptr)) {
+        return nullptr;
+    }
+    char date[kHttpDateLength + 1];
+    formatHttpDate(second, date);
+    MHD_add_response_header(resp, CPPMHD_HTTP_HEADER_DATE, date);
+    MHD_add_response_header(resp, CPPMHD_HTTP_HEADER_SERVER, PROJECT_SERVER_HEADER);
+    MHD_add_response_header(resp, CPPMHD_HTTP_HEADER_CONTENT_TYPE, CPPMHD_HTTP_MIME_TEXT_PLAIN);
+    if (retryAfter != 0) {
+        MHD_add_response_header(resp, CPPMHD_HTTP_HEADER_RETRY_AFTER, format("{}", retryAfter).c_str());
+    }
+    if (close) {
+        MHD_add_response_header(resp, CPPMHD_HTTP_HEADER_CONNECTION, "close");
+    }
+    return resp;
+}
+
 uint32_t calcFlag()
 {
-    auto flag = MHD_USE_SUPPRESS_DATE_NO_CLOCK | MHD_USE_TURBO;
+    // HttpRequest::pause, WebSocketController, and MHD_quiesce_daemon of a drain
+    auto flag = MHD_USE_SUPPRESS_DATE_NO_CLOCK | MHD_USE_TURBO | MHD_ALLOW_SUSPEND_RESUME | MHD_ALLOW_UPGRADE
+                | MHD_USE_ITC;
 #ifndef NDEBUG
     flag |= MHD_USE_DEBUG;
 #endif
@@ -436,63 +1301,403 @@ uint32_t calcFlag()
 }
 }  // namespace
 
-void HttpImplement::stop()
+void HttpImplement::stop(bool drain)
 {
     if (isRunning()) {
+        draining_ = drain;
         runningBarrier_.wait();
     }
 }
 
+bool HttpImplement::restart(const std::vector<std::string> &argv)
+{
+    if (handingOver_.exchange(true)) {
+        LOG_WARN("{}", "a restart is running already");
+        return false;
+    }
+
+    std::vector<int> fds;
+    {
+        std::lock_guard<std::mutex> _(global::mutex);
+        for (auto d : daemons) {
+            auto info = MHD_get_daemon_info(d, MHD_DAEMON_INFO_LISTEN_FD);
+            if (info != nullptr && info->listen_fd != MHD_INVALID_SOCKET) {
+                fds.push_back(info->listen_fd);
+            }
+        }
+    }
+
+    for (auto &l : listeners_) {
+        fds.push_back(l.fd);
+    }
+
+    auto ok = fds.size() == daemons.size() + listeners_.size() && handOver(argv, fds, shutdownOptions_.handoffTimeout);
+    if (!ok) {
+        handingOver_ = false;
+        return false;
+    }
+    LOG_INFO("{} took {} listening sockets over, draining", argv[0], fds.size());
+    stop(true);
+    return true;
+}
+
+bool HttpImplement::bindRoutes()
+{
+    auto &routes = router_.routes();
+    std::vector<uint32_t> listeners(routes.size(), ~0u);
+    auto filtered = false;
+    for (auto &route : routes) {
+        if (route.listeners.empty()) {
+            continue;
+        }
+        listeners[route.id] = 0;
+        for (auto &name : route.listeners) {
+            auto i = 0u;
+            while (i < listeners_.size() && listeners_[i].listener.name != name) {
+                i++;
+            }
+            if (name == listenOptions_.name) {
+                listeners[route.id] |= 1;
+            } else if (i < listeners_.size()) {
+                listeners[route.id] |= 1u << (i + 1);
+            } else {
+                LOG_ERROR("route {}: no listener named {}", route.pattern, name);
+                return false;
+            }
+        }
+        filtered = true;
+    }
+    if (filtered) {
+        routeListeners_ = std::move(listeners);
+    }
+    return true;
+}
+
+CPPMHD_Error HttpImplement::openListeners(std::vector<int> &taken)
+{
+    for (auto &l : listeners_) {
+        if (l.path.length() == 0 && !InetAddress::parse(l.addr, l.listener.address, l.listener.port)) {
+            auto &a = l.listener;
+            LOG_ERROR("Parse listen address {}:{} of {} failed...", a.address, a.port, a.name);
+            closeListeners(false);
+            return CPPMHD_Error::CPPMHD_LISTEN_ADDRESS_ERROR;
+        }
+
+        // handed over with the ones of the daemons
+        for (auto it = taken.begin(); it != taken.end(); ++it) {
+            sockaddr_storage local;
+            if (localAddress(*it, local) && boundTo(local, l.path, l.addr)) {
+                l.fd = *it;
+                taken.erase(it);
+                break;
+            }
+        }
+        if (l.fd < 0) {
+            l.fd = l.path.length() != 0 ? listenUnix(l.path, listenOptions_.unixMode) : listenInet(l.addr);
+            l.created = l.fd >= 0;
+        }
+
+        // the acceptor must not block in accept
+        auto flags = l.fd < 0 ? -1 : fcntl(l.fd, F_GETFL);
+        if (flags < 0 || fcntl(l.fd, F_SETFL, flags | O_NONBLOCK) != 0) {
+            LOG_ERROR("listener {}: {}", l.listener.name, strerror(errno));
+            closeListeners(false);
+            return CPPMHD_Error::CPPMHD_LISTEN_FAILED;
+        }
+    }
+    return CPPMHD_Error::CPPMHD_OK;
+}
+
+void HttpImplement::closeListeners(bool stopping)
+{
+    for (auto &l : listeners_) {
+        if (l.fd < 0) {
+            continue;
+        }
+        ::close(l.fd);
+        if (l.path.length() != 0 && (stopping ? !handingOver_ : l.created)) {
+            unlink(l.path.c_str());
+        }
+        l.fd = -1;
+        l.created = false;
+    }
+}
+
+void HttpImplement::addConnection(int fd, const sockaddr *addr, socklen_t len, uint32_t listener)
+{
+    // MHD closes the socket of a connection it refuses, eg: over AdmissionOptions::maxConnections
+    auto d = daemons[nextDaemon_++ % daemons.size()];
+    if (MHD_add_connection(d, fd, addr, len) != MHD_OK) {
+        LOG_DTRACE("connection to listener {} refused", listeners_[listener].listener.name);
+    }
+}
+
+uint32_t HttpImplement::listenerOf(MHD_Connection *conn) const
+{
+    auto info = MHD_get_connection_info(conn, MHD_CONNECTION_INFO_CONNECTION_FD);
+    sockaddr_storage local;
+    if (listeners_.empty() || info == nullptr || !localAddress(info->connect_fd, local)) {
+        return 0;
+    }
+    for (size_t i = 0; i < listeners_.size(); i++) {
+        if (boundTo(local, listeners_[i].path, listeners_[i].addr)) {
+            return static_cast<uint32_t>(i + 1);
+        }
+    }
+    return 0;
+}
+
+uint32_t HttpImplement::inflight() const
+{
+    uint32_t n = 0;
+    for (auto &ctx : contexts_) {
+        n += ctx->admission.inflight();
+    }
+    return n;
+}
+
+std::vector<MHD_socket> HttpImplement::drainDaemons()
+{
+    std::vector<MHD_socket> listeners;
+    for (auto d : daemons) {
+        auto fd = MHD_quiesce_daemon(d);
+        if (fd != MHD_INVALID_SOCKET) {
+            listeners.push_back(fd);
+        }
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(shutdownOptions_.drainTimeout);
+    while (inflight() != 0 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    auto left = inflight();
+    if (left != 0) {
+        LOG_WARN("{} requests still in flight after draining {}s", left, shutdownOptions_.drainTimeout);
+    }
+    return listeners;
+}
+
 CPPMHD_Error HttpImplement::startMHDDaemon(uint32_t tc,
                                            const std::function<void(void)> &cb,
                                            const std::vector<int> &sigs)
 {
+#ifndef ENABLE_REQUEST_TIMING
+    if (observer_) {
+        LOG_WARN("{}", "RequestObserver is set but cppmhd is built without ENABLE_REQUEST_TIMING, it is never called");
+    }
+#endif
+
+    if (!bindRoutes()) {
+        return CPPMHD_Error::CPPMHD_ROUTER_TREE_BUILD_FAILED;
+    }
+
+    if (tls_ && MHD_is_feature_supported(MHD_FEATURE_TLS) != MHD_OK) {
+        LOG_ERROR("{}", "TLS is set but libmicrohttpd is built without it");
+        return CPPMHD_Error::CPPMHD_TLS_FAILED;
+    }
+    if (tls_ && !tls_->load()) {
+        return CPPMHD_Error::CPPMHD_TLS_FAILED;
+    }
+
+    if (accessLogOptions_.path.length() != 0) {
+        accessLog_.reset(new AccessLog(accessLogOptions_, router_.routes()));
+        if (!accessLog_->open()) {
+            accessLog_.reset();
+            return CPPMHD_Error::CPPMHD_ACCESS_LOG_OPEN_FAILED;
+        }
+    }
+
     auto flag = calcFlag();
     if (addr_.isV6()) {
         flag |= MHD_USE_DUAL_STACK;
     }
 
+    // the same for every daemon, they copy them
+    std::vector<MHD_OptionItem> tlsOps;
+    if (tls_) {
+        flag |= MHD_USE_TLS;
+        tlsOps.push_back({MHD_OPTION_HTTPS_MEM_CERT, 0, const_cast<char *>(tls_->cert().c_str())});
+        tlsOps.push_back({MHD_OPTION_HTTPS_MEM_KEY, 0, const_cast<char *>(tls_->key().c_str())});
+        tlsOps.push_back({MHD_OPTION_HTTPS_PRIORITIES, 0, const_cast<char *>(tls_->priorities().c_str())});
+        if (tls_->password().length() != 0) {
+            tlsOps.push_back({MHD_OPTION_HTTPS_KEY_PASSWORD, 0, const_cast<char *>(tls_->password().c_str())});
+        }
+    }
+    tlsOps.push_back({MHD_OPTION_END, 0, nullptr});
+
     if (tc > getNProc() << 3) {
         auto next = getNProc() << 2;
         LOG_WARN("Too large threadCount {}. Set to {}.", tc, next);
         tc = next;
     }
 
+    // one per daemon, none to bind addr_. started by App::restart, they are the ones of the old process
+    std::vector<int> sockets;
+    int handoff = -1;
+    auto takenOver = takeOver(sockets, handoff);
+    auto received = sockets.size();
+    // the ones of the added listeners are taken out
+    auto opened = openListeners(sockets);
+    if (opened != CPPMHD_Error::CPPMHD_OK) {
+        for (auto fd : sockets) {
+            ::close(fd);
+        }
+        if (handoff >= 0) {
+            ::close(handoff);
+        }
+        accessLog_.reset();
+        return opened;
+    }
+
+    if (takenOver) {
+        if (tc != sockets.size()) {
+            LOG_WARN("threadCount {} set to the {} listening sockets taken over", tc, sockets.size());
+        }
+        tc = static_cast<uint32_t>(sockets.size());
+    } else {
+        auto shared = listenOptions_.fds;
+        if (listenOptions_.systemd) {
+            auto activated = systemdSockets();
+            shared.insert(shared.end(), activated.begin(), activated.end());
+        }
+
+        auto created = -1;
+        if (shared.empty() && unixPath_.length() != 0) {
+            created = listenUnix(unixPath_, listenOptions_.unixMode);
+            if (created < 0) {
+                closeListeners(false);
+                accessLog_.reset();
+                return CPPMHD_Error::CPPMHD_LISTEN_FAILED;
+            }
+            shared.push_back(created);
+        }
+
+        // every daemon closes its own copy
+        tc = std::max(tc, static_cast<uint32_t>(shared.size()));
+        for (auto i = 0u; i < tc && !shared.empty(); i++) {
+            auto fd = dupListener(shared[i % shared.size()]);
+            if (fd < 0) {
+                break;
+            }
+            sockets.push_back(fd);
+        }
+        if (created >= 0) {
+            ::close(created);
+        }
+        if (sockets.size() != (shared.empty() ? 0 : tc)) {
+            for (auto fd : sockets) {
+                ::close(fd);
+            }
+            closeListeners(false);
+            accessLog_.reset();
+            return CPPMHD_Error::CPPMHD_LISTEN_FAILED;
+        }
+    }
+    auto where = unixPath_.length() != 0 ? unixPath_ : FORMAT("{}", addr_);
+
     auto sock = addr_.getSocket();
 
-    MHD_OptionItem ops[] = {
-        {MHD_OPTION_EXTERNAL_LOGGER, (intptr_t)MHD_LOGGER, this},
-        {MHD_OPTION_NOTIFY_COMPLETED, (intptr_t)connectionFinishCB, this},
-        {MHD_OPTION_NOTIFY_CONNECTION, (intptr_t)notifyConnectionCB, this},
-        {MHD_OPTION_STRICT_FOR_CLIENT, 0, nullptr},
-#if MHD_VERSION >= 0x96800L
-        {MHD_OPTION_SERVER_INSANITY, MHD_DSC_SANE, nullptr},
-#endif
-        {MHD_OPTION_SOCK_ADDR, 0, (void *)sock},
-        {MHD_OPTION_URI_LOG_CALLBACK, (intptr_t)MHD_URI_LOGGER, this},
-        {MHD_OPTION_LISTENING_ADDRESS_REUSE, tc == 1 ? 0 : 1, nullptr},
-        {MHD_OPTION_END, 0, nullptr}
+    // without a confirmation the old process keeps serving on them
+    auto abandon = [this, &sockets, handoff](size_t from) {
+        for (auto i = from; i < sockets.size(); i++) {
+            ::close(sockets[i]);
+        }
+        if (handoff >= 0) {
+            ::close(handoff);
+        }
+        closeListeners(false);
+    };
+
+    if (webSockets_ && !webSockets_->start()) {
+        abandon(0);
+        accessLog_.reset();
+        return CPPMHD_Error::CPPMHD_WEBSOCKET_START_FAILED;
+    }
+
+    // the daemons started so far are stopped, the sockets from the one of daemon i are closed
+    auto fail = [this, &abandon](size_t i) {
+        if (eventStreams_) {
+            eventStreams_->end();
+        }
+        if (cache_) {
+            cache_->close();
+        }
+        pausedRequests_.end();
+        for (auto &daemon : daemons) {
+            MHD_stop_daemon(daemon);
+        }
+        daemons.clear();
+        if (webSockets_) {
+            webSockets_->stop();
+        }
+        abandon(i);
+        destroyContexts();
+        accessLog_.reset();
     };
 
     {
         std::lock_guard<std::mutex> _(global::mutex);
         for (auto i = 0u; i < tc; i++) {
-            auto d = MHD_start_daemon(
-                flag, addr_.port(), MHDAcceptCB, this, MHDconnectionCB, this, MHD_OPTION_ARRAY, ops, MHD_OPTION_END);
+            // every daemon runs on its own thread and gets its own admission state
+            contexts_.emplace_back(new DaemonContext(this, admissionOptions_));
+            auto ctx = contexts_.back().get();
+            if (metrics_) {
+                metrics_->addAdmission(&ctx->admission);
+            }
+
+            MHD_OptionItem ops[] = {
+                {MHD_OPTION_EXTERNAL_LOGGER, (intptr_t)MHD_LOGGER, this},
+                {MHD_OPTION_NOTIFY_COMPLETED, (intptr_t)connectionFinishCB, ctx},
+                {MHD_OPTION_NOTIFY_CONNECTION, (intptr_t)notifyConnectionCB, ctx},
+                {MHD_OPTION_STRICT_FOR_CLIENT, 0, nullptr},
+#if MHD_VERSION >= 0x96800L
+                {MHD_OPTION_SERVER_INSANITY, MHD_DSC_SANE, nullptr},
+#endif
+                sockets.empty() ? MHD_OptionItem{MHD_OPTION_SOCK_ADDR, 0, (void *)sock}
+                                : MHD_OptionItem{MHD_OPTION_LISTEN_SOCKET, sockets[i], nullptr},
+                {MHD_OPTION_URI_LOG_CALLBACK, (intptr_t)MHD_URI_LOGGER, this},
+                {MHD_OPTION_LISTENING_ADDRESS_REUSE, tc == 1 ? 0 : 1, nullptr},
+                {MHD_OPTION_END, 0, nullptr}
+            };
+
+            auto d = MHD_start_daemon(flag,
+                                      addr_.port(),
+                                      MHDAcceptCB,
+                                      ctx,
+                                      MHDconnectionCB,
+                                      ctx,
+                                      MHD_OPTION_ARRAY,
+                                      ops,
+                                      MHD_OPTION_ARRAY,
+                                      tlsOps.data(),
+                                      MHD_OPTION_END);
             if (d != nullptr) {
-                LOG_INFO("#{}: begin listening at {}", i, addr_);
+                LOG_INFO("#{}: begin listening at {}", i, where);
                 daemons.emplace_back(d);
-            } else {
-                LOG_ERROR("#{}: listen failed: {}, stop running threads", i, strerror(errno));
-
-                for (auto &daemon : daemons) {
-                    MHD_stop_daemon(daemon);
-                }
-
-                return CPPMHD_Error::CPPMHD_LISTEN_FAILED;
+                continue;
             }
+            LOG_ERROR("#{}: listen failed: {}, stop running threads", i, strerror(errno));
+            fail(i);
+            return CPPMHD_Error::CPPMHD_LISTEN_FAILED;
+        }
+
+        std::vector<int> fds;
+        for (auto &l : listeners_) {
+            auto at = l.path.length() != 0 ? l.path : FORMAT("{}", l.addr);
+            LOG_INFO("{}: begin listening at {}", l.listener.name, at);
+            fds.push_back(l.fd);
+        }
+        auto added = [this](int fd, const sockaddr *addr, socklen_t len, uint32_t listener) {
+            addConnection(fd, addr, len, listener);
+        };
+        if (!fds.empty() && !acceptor_.start(fds, added)) {
+            fail(tc);
+            return CPPMHD_Error::CPPMHD_LISTEN_FAILED;
         }
     }
+    if (handoff >= 0) {
+        confirmTakeOver(handoff, received);
+    }
 #ifdef HAVE_PTHREAD_SIGMASK
     {
         sigset_t sigset;
@@ -512,6 +1717,28 @@ CPPMHD_Error HttpImplement::startMHDDaemon(uint32_t tc,
     cb();
     thr_.join();
     running_ = false;
+    // the added listeners stop accepting first
+    acceptor_.stop();
+    std::vector<MHD_socket> listeners;
+    if (draining_) {
+        LOG_INFO("draining {} requests in flight...", inflight());
+        listeners = drainDaemons();
+    }
+    if (eventStreams_) {
+        // the idle subscribers are suspended, they are resumed to end
+        LOG_DTRACE("ending {} event streams", eventStreams_->size());
+        eventStreams_->end();
+    }
+    if (cache_) {
+        // the requests waiting for the leader of their key are suspended too
+        cache_->close();
+    }
+    // an upload behind the disk, or a DataProcessor waiting for its consumer, fails instead
+    pausedRequests_.end();
+    if (webSockets_) {
+        // hands the sockets back before the daemons go
+        webSockets_->stop();
+    }
     {
         std::lock_guard<std::mutex> _(global::mutex);
         LOG_INFO("{}", "stopping MHD daemon...");
@@ -519,14 +1746,26 @@ CPPMHD_Error HttpImplement::startMHDDaemon(uint32_t tc,
         for (auto &d : daemons) {
             MHD_stop_daemon(d);
         }
+        daemons.clear();
+    }
+    // quiesced, MHD leaves them open
+    for (auto fd : listeners) {
+        ::close(fd);
+    }
+    // the process the sockets were handed over to listens there now
+    if (unixPath_.length() != 0 && listenOptions_.fds.empty() && !listenOptions_.systemd && !handingOver_) {
+        unlink(unixPath_.c_str());
     }
+    closeListeners(true);
+    destroyContexts();
+    accessLog_.reset();
     return CPPMHD_Error::CPPMHD_OK;
 }
 
 HttpResponsePtr HttpImplement::checkRequest(const HttpRequestPtr &req, const char *version)
 {
     if (host_.length() != 0) {
-        auto h = req->getHeader(CPPMHD_HTTP_HEADER_HOST);
+        auto h = req->getHeader(KnownHeader::HOST);
         if (h == nullptr || strcmp(h, host_.c_str()) != 0) {
             return getErrorHandler()(
                 req, k400BadRequest, HttpError::HOST_FIELD_INCORRECT, "Host Field Not Set Correctly");
@@ -543,10 +1782,95 @@ HttpResponsePtr HttpImplement::checkRequest(const HttpRequestPtr &req, const cha
     return nullptr;
 }
 
-void HttpImplement::addSharedHeaders(HttpResponsePtr &resp)
+MHD_Response *HttpImplement::rejectResponse(RejectResponses &rejects, Reject reject)
 {
-    auto &server = resp->header(CPPMHD_HTTP_HEADER_SERVER);
-    if (server.length() == 0) {
-        server = PROJECT_SERVER_HEADER;
+    auto now = CoarseClock::now();
+    if (unlikely(now != rejects.second)) {
+        // the connections they are queued on keep them until they are sent
+        for (auto &res : rejects.responses) {
+            if (res != nullptr) {
+                MHD_destroy_response(res);
+                res = nullptr;
+            }
+        }
+        rejects.second = now;
+    }
+
+    auto &res = rejects.responses[static_cast<size_t>(reject)];
+    if (unlikely(res == nullptr)) {
+        auto body = kRejectBodies[static_cast<size_t>(reject)];
+        switch (reject) {
+            case Reject::SHED:
+                // a shed client takes its connection with it
+                res = createRejectResponse(body, admissionOptions_.retryAfter, true, now);
+                break;
+            case Reject::LIMITED:
+                res = createRejectResponse(body, limiter_->options().retryAfter, false, now);
+                break;
+            case Reject::TOO_LARGE:
+                // the rest of the body is not read, the connection can not be reused
+                res = createRejectResponse(body, 0, true, now);
+                break;
+        }
+    }
+    return res;
+}
+
+void HttpImplement::destroyContexts()
+{
+    for (auto &ctx : contexts_) {
+        for (auto &res : ctx->rejects.responses) {
+            if (res != nullptr) {
+                MHD_destroy_response(res);
+                res = nullptr;
+            }
+        }
+        if (metrics_) {
+            metrics_->removeAdmission(&ctx->admission);
+        }
+    }
+    contexts_.clear();
+}
+
+void HttpImplement::addSharedHeaders(HttpResponsePtr &resp, MHD_Response *res)
+{
+    setServerHeader(*resp);
+    addRequestHeaders(resp->headers(), res);
+}
+
+void HttpImplement::addRequestHeaders(const HttpResponse::HeaderType &headers, MHD_Response *res)
+{
+    // MHD_USE_SUPPRESS_DATE_NO_CLOCK is set, so the Date comes from the preformatted clock
+    if (likely(headers.find(CPPMHD_HTTP_HEADER_DATE) == headers.end())) {
+        MHD_add_response_header(res, CPPMHD_HTTP_HEADER_DATE, CoarseClock::httpDate());
+    }
+
+    // a drain does not wait for idle keep-alive connections
+    if (unlikely(draining_)) {
+        MHD_add_response_header(res, CPPMHD_HTTP_HEADER_CONNECTION, "close");
+    }
+}
+
+ResponseCache::ResponsePtr HttpImplement::datedResponse(uint64_t key, const ResponseCache::Cached &cached)
+{
+    auto now = CoarseClock::now();
+    if (likely(cached.second == now && !draining_)) {
+        return cached.response;
+    }
+
+    auto res = createBodyResponse(cached.body);
+    if (unlikely(res == nullptr)) {
+        return nullptr;
+    }
+    setResponseHeader(res, *cached.sent);
+    addRequestHeaders(*cached.sent, res);
+    auto response = ResponseCache::own(res);
+    // the Connection: close of a drain is for this hit only
+    if (!draining_) {
+        auto dated = cached;
+        dated.response = response;
+        dated.second = now;
+        cache_->redate(key, dated);
     }
+    return response;
 }
\ No newline at end of file
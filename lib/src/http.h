@@ -5,20 +5,34 @@
 
 #include <cppmhd/app.h>
 #include <cppmhd/core.h>
+#include <cppmhd/observer.h>
 
 #include <microhttpd.h>
 
 #include <atomic>
 #include <thread>
 
+#include "accesslog.h"
+#include "admission.h"
+#include "cache.h"
+#include "clock.h"
+#include "compress.h"
 #include "core.h"
+#include "entity.h"
+#include "listen.h"
+#include "metrics.h"
+#include "ratelimit.h"
 #include "router.h"
+#include "sse.h"
+#include "tls.h"
 #include "utils.h"
+#include "validator.h"
+#include "websocket.h"
 
 #if MHD_VERSION >= 0x00097200
 using MHD_Return = MHD_Result;
 #define MHD_OK MHD_Result::MHD_YES
-#define MHD_FAILED MHD_Result::MHD_NO;
+#define MHD_FAILED MHD_Result::MHD_NO
 #else
 using MHD_Return = int;
 #define MHD_OK ((1))
@@ -27,11 +41,49 @@ using MHD_Return = int;
 
 CPPMHD_NAMESPACE_BEGIN
 
+class HttpImplement;
+
+// the preallocated responses of rejected requests
+enum class Reject { SHED, LIMITED, TOO_LARGE };
+
+// the 503 of shed, 429 of rate limited and 413 of too large requests of one daemon, indexed by Reject. only the thread
+// of the daemon queues them. it creates them again, with the new Date, once the second of theirs is over
+struct RejectResponses {
+    MHD_Response *responses[3];
+    // of their Date
+    time_t second;
+
+    RejectResponses() : responses{nullptr, nullptr, nullptr}, second(0) {}
+};
+
+// the cls of the callbacks of one MHD daemon
+struct DaemonContext {
+    HttpImplement *http;
+    Admission admission;
+    RejectResponses rejects;
+
+    DaemonContext(HttpImplement *h, const AdmissionOptions &options) : http(h), admission(options) {}
+};
+
+// a listener added with App::addListener
+struct ListenerSocket {
+    Listener listener;
+    // of a unix: address, empty to listen on addr
+    std::string path;
+    InetAddress addr;
+    int fd;
+    // bound by this process, not taken over
+    bool created;
+};
+
 class HttpImplement
 {
     std::vector<MHD_Daemon *> daemons;
 
     InetAddress addr_;
+    // of a unix: address, empty to listen on addr_
+    const std::string unixPath_;
+    const ListenOptions listenOptions_;
     Barrier runningBarrier_;
     Router router_;
     std::thread thr_;
@@ -42,11 +94,129 @@ class HttpImplement
 
     bool logConnectionStatus_;
 
+    const AccessLogOptions accessLogOptions_;
+    std::unique_ptr<AccessLog> accessLog_;
+
+    std::unique_ptr<Metrics> metrics_;
+
+    RequestObserverPtr observer_;
+
+    const AdmissionOptions admissionOptions_;
+    std::vector<std::unique_ptr<DaemonContext>> contexts_;
+
+    std::unique_ptr<RateLimiter> limiter_;
+
+    const uint64_t maxBodySize_;
+
+    const ShutdownOptions shutdownOptions_;
+    // stop lets the requests in flight finish, their responses close the connections
+    std::atomic_bool draining_;
+    // stays set once the listening sockets are handed over
+    std::atomic_bool handingOver_;
+
+    std::unique_ptr<Compressor> compressor_;
+
+    std::unique_ptr<ValidatorCache> validators_;
+
+    std::unique_ptr<ResponseCache> cache_;
+
+    std::unique_ptr<WebSocketEngine> webSockets_;
+
+    // of the routes that are SseControllers
+    std::unique_ptr<SseStreams> eventStreams_;
+
+    PausedRequests pausedRequests_;
+
+    std::unique_ptr<TlsContext> tls_;
+
+    // served by the daemons too, their connections are accepted by acceptor_ and added to the daemons in turn. the
+    // address of the App is listener 0, they are numbered from 1
+    std::vector<ListenerSocket> listeners_;
+    Acceptor acceptor_;
+    // acceptor thread only
+    uint32_t nextDaemon_;
+    // by route id, the listeners serving it, a bit each. empty when every route is served by every listener
+    std::vector<uint32_t> routeListeners_;
+
+    // a route is an SseController
+    bool eventRoutes_;
+
+    // the daemons are stopped: their reject responses are destroyed, their admission state leaves the metrics
+    void destroyContexts();
+
+    // the daemons stop accepting, returns their listening sockets once the requests in flight are done or the drain
+    // timeout passed
+    std::vector<MHD_socket> drainDaemons();
+    uint32_t inflight() const;
+
+    // the names of the listeners of the routes. false if one is not a listener of the App
+    bool bindRoutes();
+    // binds the added listeners, or takes them out of the sockets taken over from a restarted process
+    CPPMHD_Error openListeners(std::vector<int> &taken);
+    // the socket files are removed when stopping, unless they were handed over, or else when they were created here
+    void closeListeners(bool stopping);
+    // a connection accepted on an added listener, on the acceptor thread
+    void addConnection(int fd, const sockaddr *addr, socklen_t len, uint32_t listener);
+
   public:
-    HttpImplement(const InetAddress &ad, Router &&r, std::string &host, const App::errorHandler &eh)
-        : addr_(ad), runningBarrier_(2), router_(std::move(r)), eh_(eh), host_(host)
+    // URLs whose validators are kept
+    static constexpr size_t kValidatorCapacity = 64 * 1024;
+
+    HttpImplement(const InetAddress &ad, Router &&r, const App &app)
+        : addr_(ad),
+          unixPath_(unixPath(app.address_)),
+          listenOptions_(app.listen_),
+          runningBarrier_(2),
+          router_(std::move(r)),
+          eh_(app.eh),
+          host_(app.host_),
+          accessLogOptions_(app.accessLog_),
+          observer_(app.observer_),
+          admissionOptions_(app.admission_),
+          maxBodySize_(app.maxBodySize_),
+          shutdownOptions_(app.shutdown_),
+          eventRoutes_(false)
     {
         running_ = false;
+        draining_ = false;
+        handingOver_ = false;
+        nextDaemon_ = 0;
+
+        for (auto &l : app.listeners_) {
+            listeners_.push_back(ListenerSocket{l, unixPath(l.address), InetAddress(), -1, false});
+        }
+
+        if (app.rateLimit_.rate > 0) {
+            limiter_.reset(new RateLimiter(app.rateLimit_));
+        }
+
+        if (!app.tls_.certificates.empty()) {
+            tls_.reset(new TlsContext(app.tls_));
+        }
+
+        if (app.compression_.enable) {
+            compressor_.reset(new Compressor(app.compression_));
+        }
+
+        for (auto &route : router_.routes()) {
+            if (route.validatorTtl != 0 && !validators_) {
+                validators_.reset(new ValidatorCache(kValidatorCapacity));
+            }
+            if (route.cache.ttl != 0 && !cache_) {
+                cache_.reset(new ResponseCache(app.responseCache_.capacity, app.responseCache_.shards));
+            }
+            if (dynamic_cast<const WebSocketController *>(route.controller) != nullptr && !webSockets_) {
+                webSockets_.reset(new WebSocketEngine());
+            }
+            if (dynamic_cast<const SseController *>(route.controller) != nullptr && !eventStreams_) {
+                eventRoutes_ = true;
+                eventStreams_.reset(new SseStreams());
+            }
+        }
+
+        if (app.metrics_.enable) {
+            metrics_.reset(new Metrics(router_.routes(), app.threadCount_));
+        }
 
         logConnectionStatus_ =
 #ifdef NDEBUG
@@ -70,12 +240,115 @@ class HttpImplement
                                 const std::function<void(void)> &cb,
                                 const std::vector<int> &sigs);
 
-    HttpController *forward(HttpRequest *req, std::map<std::string, std::string> &param, bool &tsr) const
+    HttpController *forward(HttpRequest *req,
+                            std::map<std::string, std::string> &param,
+                            bool &tsr,
+                            const RouteInfo *&route) const
+    {
+        return router_.forward(req, param, tsr, route);
+    }
+
+    // nullptr if the access log is disabled
+    AccessLog *accessLog() const
+    {
+        return accessLog_.get();
+    }
+
+    // nullptr if metrics are disabled
+    Metrics *metrics() const
+    {
+        return metrics_.get();
+    }
+
+    const RequestObserverPtr &observer() const
+    {
+        return observer_;
+    }
+
+    // nullptr if rate limiting is disabled
+    RateLimiter *limiter() const
+    {
+        return limiter_.get();
+    }
+
+    // nullptr if compression is disabled
+    Compressor *compressor() const
+    {
+        return compressor_.get();
+    }
+
+    // nullptr if no route caches validators
+    ValidatorCache *validators() const
     {
-        return router_.forward(req, param, tsr);
+        return validators_.get();
     }
 
-    void stop();
+    // nullptr if no route is cached
+    ResponseCache *responseCache() const
+    {
+        return cache_.get();
+    }
+
+    // the listener a connection was accepted on, 0 for the address of the App
+    uint32_t listenerOf(MHD_Connection *conn) const;
+
+    // some route is not served by every listener
+    bool hasListenerRoutes() const
+    {
+        return !routeListeners_.empty();
+    }
+
+    // whether the listener serves the route
+    bool serves(const RouteInfo *route, uint32_t listener) const
+    {
+        return routeListeners_.empty() || (routeListeners_[route->id] >> listener & 1) != 0;
+    }
+
+    // nullptr if TLS is disabled
+    const TlsContext *tls() const
+    {
+        return tls_.get();
+    }
+
+    bool hasEventRoutes() const
+    {
+        return eventRoutes_;
+    }
+
+    // nullptr if no route is a WebSocketController
+    WebSocketEngine *webSockets() const
+    {
+        return webSockets_.get();
+    }
+
+    // nullptr if no route is an SseController
+    SseStreams *eventStreams() const
+    {
+        return eventStreams_.get();
+    }
+
+    // the response of a rejected request, with the Date of this second. on the thread of the daemon of rejects
+    MHD_Response *rejectResponse(RejectResponses &rejects, Reject reject);
+
+    // the cached response with the Date of this second, created again by the first hit of a second. nullptr on an
+    // error
+    ResponseCache::ResponsePtr datedResponse(uint64_t key, const ResponseCache::Cached &cached);
+
+    PausedRequests *pausedRequests()
+    {
+        return &pausedRequests_;
+    }
+
+    // the body limit of a route, 0 for none
+    uint64_t maxBodySize(const RouteInfo *route) const
+    {
+        return route != nullptr && route->maxBodySize != 0 ? route->maxBodySize : maxBodySize_;
+    }
+
+    void stop(bool drain);
+
+    // hands the listening sockets of the daemons over to argv, then drains. see App::restart
+    bool restart(const std::vector<std::string> &argv);
 
     bool isV6() const
     {
@@ -94,7 +367,11 @@ class HttpImplement
 
     HttpResponsePtr checkRequest(const HttpRequestPtr &, const char *);
 
-    void addSharedHeaders(HttpResponsePtr &);
+    void addSharedHeaders(HttpResponsePtr &, MHD_Response *);
+
+    // the Date, unless the handler set one, and the Connection: close of a drain, which no response keeps for longer
+    // than a request
+    void addRequestHeaders(const HttpResponse::HeaderType &headers, MHD_Response *res);
 };
 
 CPPMHD_NAMESPACE_END
@@ -0,0 +1,751 @@
+#include "config.h"
+
+#include <cppmhd/json.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include "core.h"
+#include "logger.h"
+#include "utils.h"
+
+CPPMHD_NAMESPACE_BEGIN
+
+namespace
+{
+constexpr size_t kFirstBlock = 4096;
+constexpr size_t kMaxBlock = 1024 * 1024;
+
+inline bool isSpace(char c)
+{
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+inline bool isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+inline bool isNumberChar(char c)
+{
+    return isDigit(c) || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+}
+
+inline int hexValue(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+// the first quote, backslash or control character. eight bytes are tested at once, the exact byte is found by the
+// plain loop
+const char *scanString(const char *p, const char *end)
+{
+    constexpr uint64_t kOnes = 0x0101010101010101ULL;
+    constexpr uint64_t kHigh = 0x8080808080808080ULL;
+
+    while (end - p >= 8) {
+        uint64_t x;
+        memcpy(&x, p, sizeof(x));
+        auto quote = x ^ (kOnes * '"');
+        auto slash = x ^ (kOnes * '\\');
+        auto special = ((quote - kOnes) & ~quote) | ((slash - kOnes) & ~slash) | ((x - kOnes * 0x20) & ~x);
+        if ((special & kHigh) != 0) {
+            break;
+        }
+        p += 8;
+    }
+
+    while (p < end && *p != '"' && *p != '\\' && static_cast<uint8_t>(*p) >= 0x20) {
+        p++;
+    }
+    return p;
+}
+
+bool validNumber(const char *p, size_t length)
+{
+    auto end = p + length;
+
+    if (p < end && *p == '-') {
+        p++;
+    }
+    if (p == end) {
+        return false;
+    }
+
+    if (*p == '0') {
+        p++;
+    } else if (isDigit(*p)) {
+        while (p < end && isDigit(*p)) {
+            p++;
+        }
+    } else {
+        return false;
+    }
+
+    if (p < end && *p == '.') {
+        p++;
+        if (p == end || !isDigit(*p)) {
+            return false;
+        }
+        while (p < end && isDigit(*p)) {
+            p++;
+        }
+    }
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        if (p < end && (*p == '+' || *p == '-')) {
+            p++;
+        }
+        if (p == end || !isDigit(*p)) {
+            return false;
+        }
+        while (p < end && isDigit(*p)) {
+            p++;
+        }
+    }
+
+    return p == end;
+}
+
+void appendUtf8(std::string &out, uint32_t cp)
+{
+    if (cp < 0x80) {
+        out.push_back(static_cast<char>(cp));
+    } else if (cp < 0x800) {
+        out.push_back(static_cast<char>(0xc0 | (cp >> 6)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3f)));
+    } else if (cp < 0x10000) {
+        out.push_back(static_cast<char>(0xe0 | (cp >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3f)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3f)));
+    } else {
+        out.push_back(static_cast<char>(0xf0 | (cp >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3f)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3f)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3f)));
+    }
+}
+
+class JsonProcessor : public DataProcessor
+{
+    JsonDocument document_;
+    JsonParser parser_;
+    bool done_;
+    bool complete_;
+
+  public:
+    explicit JsonProcessor(const JsonLimits &limits) : parser_(document_, limits), done_(false), complete_(false) {}
+
+    virtual size_t onData(HttpRequestPtr &, const void *data, size_t size) override
+    {
+        if (unlikely(size == 0)) {
+            complete();
+            return 0;
+        }
+
+        if (unlikely(!parser_.parse(reinterpret_cast<const char *>(data), size))) {
+            LOG_DEBUG("json: {}", parser_.error());
+            return DataProcessor::DataProcessorParseFailed;
+        }
+        return size;
+    }
+
+    bool complete()
+    {
+        if (!done_) {
+            done_ = true;
+            complete_ = parser_.finish();
+        }
+        return complete_;
+    }
+
+    const JsonDocument &document() const
+    {
+        return document_;
+    }
+
+    const std::string &error() const
+    {
+        return parser_.error();
+    }
+};
+
+}  // namespace
+
+JsonHandler::~JsonHandler() {}
+
+JsonParser::JsonParser(JsonHandler &handler, const JsonLimits &limits)
+    : handler_(handler),
+      limits_(limits),
+      expect_(Expect::VALUE),
+      token_(Token::NONE),
+      copied_(false),
+      surrogate_(0),
+      size_(0),
+      begin_(nullptr)
+{
+}
+
+const char *JsonParser::fail(const char *message, const char *at)
+{
+    if (error_.length() == 0) {
+        error_ = FORMAT("{} at byte {}", message, size_ + static_cast<uint64_t>(at - begin_));
+    }
+    return nullptr;
+}
+
+bool JsonParser::append(const char *p, const char *end)
+{
+    if (p < end && surrogate_ != 0) {
+        fail("unpaired surrogate", p);
+        return false;
+    }
+
+    text_.append(p, end);
+    copied_ = true;
+    if (text_.length() > limits_.maxToken) {
+        fail("token too long", end);
+        return false;
+    }
+    return true;
+}
+
+bool JsonParser::value()
+{
+    expect_ = stack_.size() == 0 ? Expect::DONE : Expect::COMMA_OR_END;
+    return true;
+}
+
+bool JsonParser::endScalar(const char *text, size_t length, const char *at)
+{
+    bool ok;
+
+    if (token_ == Token::NUMBER) {
+        if (!validNumber(text, length)) {
+            fail("bad number", at);
+            return false;
+        }
+        ok = handler_.onNumber(text, length);
+    } else if (length == 4 && memcmp(text, "null", 4) == 0) {
+        ok = handler_.onNull();
+    } else if (length == 4 && memcmp(text, "true", 4) == 0) {
+        ok = handler_.onBool(true);
+    } else if (length == 5 && memcmp(text, "false", 5) == 0) {
+        ok = handler_.onBool(false);
+    } else {
+        fail("bad literal", at);
+        return false;
+    }
+
+    token_ = Token::NONE;
+    if (!ok) {
+        fail("stopped by the handler", at);
+        return false;
+    }
+    return value();
+}
+
+const char *JsonParser::escape(const char *p, const char *end)
+{
+    while (p < end) {
+        escape_.push_back(*p++);
+
+        size_t need = escape_[1] == 'u' ? 6 : 2;
+        if (escape_.length() < need) {
+            continue;
+        }
+
+        if (need == 2) {
+            static const char kFrom[] = "\"\\/bfnrt";
+            static const char kTo[] = "\"\\/\b\f\n\r\t";
+            auto c = strchr(kFrom, escape_[1]);
+            if (c == nullptr || escape_[1] == '\0') {
+                return fail("bad escape", p);
+            }
+            if (surrogate_ != 0) {
+                return fail("unpaired surrogate", p);
+            }
+            text_.push_back(kTo[c - kFrom]);
+        } else {
+            uint32_t cp = 0;
+            for (size_t i = 2; i < 6; i++) {
+                auto v = hexValue(escape_[i]);
+                if (v < 0) {
+                    return fail("bad unicode escape", p);
+                }
+                cp = cp << 4 | static_cast<uint32_t>(v);
+            }
+
+            if (surrogate_ != 0) {
+                if (cp < 0xdc00 || cp > 0xdfff) {
+                    return fail("unpaired surrogate", p);
+                }
+                appendUtf8(text_, 0x10000 + ((surrogate_ - 0xd800) << 10) + (cp - 0xdc00));
+                surrogate_ = 0;
+            } else if (cp >= 0xd800 && cp <= 0xdbff) {
+                surrogate_ = cp;
+            } else if (cp >= 0xdc00 && cp <= 0xdfff) {
+                return fail("unpaired surrogate", p);
+            } else {
+                appendUtf8(text_, cp);
+            }
+        }
+
+        escape_.clear();
+        if (text_.length() > limits_.maxToken) {
+            return fail("token too long", p);
+        }
+        break;
+    }
+    return p;
+}
+
+const char *JsonParser::string(const char *p, const char *end)
+{
+    while (p < end) {
+        if (escape_.length() != 0) {
+            p = escape(p, end);
+            if (p == nullptr) {
+                return nullptr;
+            }
+            continue;
+        }
+
+        auto q = scanString(p, end);
+        if (q == end) {
+            return append(p, end) ? end : nullptr;
+        }
+
+        if (*q == '\\') {
+            if (!append(p, q)) {
+                return nullptr;
+            }
+            escape_.push_back('\\');
+            p = q + 1;
+            continue;
+        }
+
+        if (*q != '"') {
+            return fail("control character in string", q);
+        }
+
+        const char *text = p;
+        size_t length = static_cast<size_t>(q - p);
+        if (copied_) {
+            if (!append(p, q)) {
+                return nullptr;
+            }
+            text = text_.data();
+            length = text_.length();
+        }
+        if (surrogate_ != 0) {
+            return fail("unpaired surrogate", q);
+        }
+        if (length > limits_.maxToken) {
+            return fail("token too long", q);
+        }
+        // the escapes append UTF-8, the raw bytes may be anything. checked once the string is complete, a sequence
+        // may be split over the chunks
+        if (!validUtf8(text, length)) {
+            return fail("invalid UTF-8 in string", q);
+        }
+
+        auto key = token_ == Token::KEY;
+        token_ = Token::NONE;
+        if (key) {
+            expect_ = Expect::COLON;
+            if (!handler_.onKey(text, length)) {
+                return fail("stopped by the handler", q);
+            }
+        } else if (!handler_.onString(text, length) || !value()) {
+            return fail("stopped by the handler", q);
+        }
+        return q + 1;
+    }
+    return p;
+}
+
+const char *JsonParser::scalar(const char *p, const char *end)
+{
+    auto q = p;
+    if (token_ == Token::NUMBER) {
+        while (q < end && isNumberChar(*q)) {
+            q++;
+        }
+    } else {
+        while (q < end && *q >= 'a' && *q <= 'z') {
+            q++;
+        }
+    }
+
+    if (q == end) {
+        return append(p, end) ? end : nullptr;
+    }
+
+    const char *text = p;
+    size_t length = static_cast<size_t>(q - p);
+    if (copied_) {
+        if (!append(p, q)) {
+            return nullptr;
+        }
+        text = text_.data();
+        length = text_.length();
+    }
+    if (length > limits_.maxToken) {
+        return fail("token too long", q);
+    }
+
+    return endScalar(text, length, q) ? q : nullptr;
+}
+
+const char *JsonParser::structural(const char *p)
+{
+    auto c = *p;
+    auto expectValue = expect_ == Expect::VALUE || expect_ == Expect::VALUE_OR_END;
+
+    switch (c) {
+    case '{':
+    case '[':
+        if (!expectValue) {
+            break;
+        }
+        if (stack_.size() >= limits_.maxDepth) {
+            return fail("nested too deep", p);
+        }
+        stack_.push_back(c == '{');
+        expect_ = c == '{' ? Expect::KEY_OR_END : Expect::VALUE_OR_END;
+        if (!(c == '{' ? handler_.onStartObject() : handler_.onStartArray())) {
+            return fail("stopped by the handler", p);
+        }
+        return p + 1;
+
+    case '}':
+    case ']': {
+        auto object = c == '}';
+        if (stack_.size() == 0 || stack_.back() != object
+            || !(expect_ == Expect::COMMA_OR_END || expect_ == (object ? Expect::KEY_OR_END : Expect::VALUE_OR_END))) {
+            break;
+        }
+        stack_.pop_back();
+        if (!(object ? handler_.onEndObject() : handler_.onEndArray()) || !value()) {
+            return fail("stopped by the handler", p);
+        }
+        return p + 1;
+    }
+
+    case ',':
+        if (expect_ != Expect::COMMA_OR_END) {
+            break;
+        }
+        expect_ = stack_.back() ? Expect::KEY : Expect::VALUE;
+        return p + 1;
+
+    case ':':
+        if (expect_ != Expect::COLON) {
+            break;
+        }
+        expect_ = Expect::VALUE;
+        return p + 1;
+
+    case '"':
+        if (expect_ == Expect::KEY || expect_ == Expect::KEY_OR_END) {
+            token_ = Token::KEY;
+        } else if (expectValue) {
+            token_ = Token::STRING;
+        } else {
+            break;
+        }
+        text_.clear();
+        copied_ = false;
+        return p + 1;
+
+    default:
+        if (!expectValue) {
+            break;
+        }
+        if (c == '-' || isDigit(c)) {
+            token_ = Token::NUMBER;
+        } else if (c == 't' || c == 'f' || c == 'n') {
+            token_ = Token::LITERAL;
+        } else {
+            break;
+        }
+        text_.clear();
+        copied_ = false;
+        return p;
+    }
+
+    return fail("unexpected character", p);
+}
+
+bool JsonParser::parse(const char *data, size_t size)
+{
+    if (failed()) {
+        return false;
+    }
+
+    begin_ = data;
+    if (size_ + size > limits_.maxSize) {
+        fail("document too large", data + (limits_.maxSize - size_));
+        return false;
+    }
+
+    auto p = data, end = data + size;
+    while (p != nullptr && p < end) {
+        switch (token_) {
+        case Token::STRING:
+        case Token::KEY:
+            p = string(p, end);
+            break;
+
+        case Token::NUMBER:
+        case Token::LITERAL:
+            p = scalar(p, end);
+            break;
+
+        case Token::NONE:
+            while (p < end && isSpace(*p)) {
+                p++;
+            }
+            if (p < end) {
+                p = expect_ == Expect::DONE ? fail("data after the document", p) : structural(p);
+            }
+            break;
+        }
+    }
+
+    size_ += size;
+    return p != nullptr;
+}
+
+bool JsonParser::finish()
+{
+    if (failed()) {
+        return false;
+    }
+
+    begin_ = nullptr;
+    if ((token_ == Token::NUMBER || token_ == Token::LITERAL) && !endScalar(text_.data(), text_.length(), nullptr)) {
+        return false;
+    }
+
+    if (token_ != Token::NONE) {
+        fail("unterminated string", nullptr);
+        return false;
+    }
+    if (expect_ != Expect::DONE) {
+        fail(size_ == 0 ? "empty document" : "incomplete document", nullptr);
+        return false;
+    }
+    return true;
+}
+
+double JsonValue::asDouble() const
+{
+    return type_ == Type::NUMBER ? strtod(text_, nullptr) : 0;
+}
+
+int64_t JsonValue::asInt64() const
+{
+    return type_ == Type::NUMBER ? strtoll(text_, nullptr, 10) : 0;
+}
+
+const JsonValue &JsonValue::operator[](size_t i) const
+{
+    static const JsonValue kNull;
+    return type_ == Type::ARRAY && i < size_ ? elements_[i] : kNull;
+}
+
+const JsonMember &JsonValue::member(size_t i) const
+{
+    return members_[i];
+}
+
+const JsonValue *JsonValue::find(const char *key) const
+{
+    if (type_ != Type::OBJECT) {
+        return nullptr;
+    }
+
+    auto length = strlen(key);
+    for (size_t i = 0; i < size_; i++) {
+        if (members_[i].keyLength == length && memcmp(members_[i].key, key, length) == 0) {
+            return &members_[i].value;
+        }
+    }
+    return nullptr;
+}
+
+JsonDocument::JsonDocument() : cursor_(nullptr), left_(0), blockSize_(kFirstBlock) {}
+
+JsonDocument::~JsonDocument() {}
+
+void *JsonDocument::allocate(size_t size)
+{
+    size = (size + 7) & ~static_cast<size_t>(7);
+    if (size > left_) {
+        // blocks grow with the document, a value larger than the next block gets one of its own
+        auto block = std::max(blockSize_, size);
+        blocks_.emplace_back(new char[block]);
+        cursor_ = blocks_.back().get();
+        left_ = block;
+        blockSize_ = std::min(blockSize_ * 2, kMaxBlock);
+    }
+
+    auto p = cursor_;
+    cursor_ += size;
+    left_ -= size;
+    return p;
+}
+
+const char *JsonDocument::copy(const char *text, size_t length)
+{
+    auto p = static_cast<char *>(allocate(length + 1));
+    memcpy(p, text, length);
+    p[length] = '\0';
+    return p;
+}
+
+bool JsonDocument::push(const JsonValue &value)
+{
+    if (frames_.size() == 0) {
+        root_ = value;
+    } else {
+        values_.push_back(value);
+    }
+    return true;
+}
+
+bool JsonDocument::close(bool object)
+{
+    auto frame = frames_.back();
+    frames_.pop_back();
+
+    auto count = values_.size() - frame.start;
+    JsonValue v;
+    v.type_ = object ? JsonValue::Type::OBJECT : JsonValue::Type::ARRAY;
+    v.size_ = static_cast<uint32_t>(count);
+
+    if (object) {
+        auto members = static_cast<JsonMember *>(allocate(count * sizeof(JsonMember)));
+        auto first = keys_.size() - count;
+        for (size_t i = 0; i < count; i++) {
+            auto m = new (members + i) JsonMember(keys_[first + i]);
+            m->value = values_[frame.start + i];
+        }
+        keys_.resize(first);
+        v.members_ = members;
+    } else {
+        auto elements = static_cast<JsonValue *>(allocate(count * sizeof(JsonValue)));
+        for (size_t i = 0; i < count; i++) {
+            new (elements + i) JsonValue(values_[frame.start + i]);
+        }
+        v.elements_ = elements;
+    }
+
+    values_.resize(frame.start);
+    return push(v);
+}
+
+bool JsonDocument::onNull()
+{
+    return push(JsonValue());
+}
+
+bool JsonDocument::onBool(bool value)
+{
+    JsonValue v;
+    v.type_ = JsonValue::Type::BOOLEAN;
+    v.boolean_ = value;
+    return push(v);
+}
+
+bool JsonDocument::onNumber(const char *text, size_t length)
+{
+    JsonValue v;
+    v.type_ = JsonValue::Type::NUMBER;
+    v.size_ = static_cast<uint32_t>(length);
+    v.text_ = copy(text, length);
+    return push(v);
+}
+
+bool JsonDocument::onString(const char *text, size_t length)
+{
+    JsonValue v;
+    v.type_ = JsonValue::Type::STRING;
+    v.size_ = static_cast<uint32_t>(length);
+    v.text_ = copy(text, length);
+    return push(v);
+}
+
+bool JsonDocument::onKey(const char *text, size_t length)
+{
+    JsonMember m;
+    m.key = copy(text, length);
+    m.keyLength = length;
+    keys_.push_back(m);
+    return true;
+}
+
+bool JsonDocument::onStartObject()
+{
+    frames_.push_back(Frame{values_.size(), true});
+    return true;
+}
+
+bool JsonDocument::onEndObject()
+{
+    return close(true);
+}
+
+bool JsonDocument::onStartArray()
+{
+    frames_.push_back(Frame{values_.size(), false});
+    return true;
+}
+
+bool JsonDocument::onEndArray()
+{
+    return close(false);
+}
+
+JsonController::JsonController(const JsonLimits &limits) : limits_(limits) {}
+
+void JsonController::onConnection(HttpRequestPtr req, HttpResponsePtr &)
+{
+    req->setProcessor(std::make_shared<JsonProcessor>(limits_));
+}
+
+void JsonController::onBadRequest(HttpRequestPtr, const std::string &error, HttpResponsePtr &resp)
+{
+    resp = std::make_shared<HttpResponse>();
+    resp->status(k400BadRequest);
+    resp->header(CPPMHD_HTTP_HEADER_CONTENT_TYPE) = CPPMHD_HTTP_MIME_TEXT_PLAIN;
+    resp->body(error);
+}
+
+void JsonController::onRequest(HttpRequestPtr req, HttpResponsePtr &resp)
+{
+    auto p = static_cast<JsonProcessor *>(req->processor().get());
+    if (p->complete()) {
+        onRequest(req, p->document().root(), resp);
+    } else {
+        onBadRequest(req, p->error(), resp);
+    }
+}
+
+JsonController::~JsonController() {}
+
+CPPMHD_NAMESPACE_END
@@ -0,0 +1,277 @@
+#include "listen.h"
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+#define FORMAT_INETADDRESS
+#include "format.h"
+#include "logger.h"
+
+CPPMHD_NAMESPACE_BEGIN
+
+namespace
+{
+// SD_LISTEN_FDS_START of sd-daemon
+constexpr int kSystemdFirstFd = 3;
+
+bool unixAddress(const std::string &path, sockaddr_un &addr)
+{
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.length() == 0 || path.length() >= sizeof(addr.sun_path)) {
+        LOG_ERROR("bad Unix socket path '{}'", path);
+        return false;
+    }
+    memcpy(addr.sun_path, path.c_str(), path.length() + 1);
+    return true;
+}
+}  // namespace
+
+std::string unixPath(const std::string &address)
+{
+    auto length = sizeof(kUnixPrefix) - 1;
+    if (address.compare(0, length, kUnixPrefix) != 0) {
+        return std::string();
+    }
+    return address.substr(length);
+}
+
+std::vector<int> systemdSockets()
+{
+    std::vector<int> fds;
+    auto pid = getenv("LISTEN_PID");
+    auto count = getenv("LISTEN_FDS");
+    if (pid != nullptr && count != nullptr && strtol(pid, nullptr, 10) == getpid()) {
+        auto n = strtol(count, nullptr, 10);
+        for (long i = 0; i < n && i < 1024; i++) {
+            auto fd = kSystemdFirstFd + static_cast<int>(i);
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+            fds.push_back(fd);
+        }
+    }
+    unsetenv("LISTEN_PID");
+    unsetenv("LISTEN_FDS");
+    unsetenv("LISTEN_FDNAMES");
+    return fds;
+}
+
+int listenUnix(const std::string &path, uint32_t mode)
+{
+    sockaddr_un addr;
+    if (!unixAddress(path, addr)) {
+        return -1;
+    }
+
+    auto fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        LOG_ERROR("socket(AF_UNIX) failed: {}", strerror(errno));
+        return -1;
+    }
+
+    auto sa = reinterpret_cast<sockaddr *>(&addr);
+    auto bound = bind(fd, sa, sizeof(addr)) == 0;
+    if (!bound && errno == EADDRINUSE) {
+        // left by a process that is gone, unless connecting to it works
+        auto probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        auto live = probe >= 0 && connect(probe, sa, sizeof(addr)) == 0;
+        if (probe >= 0) {
+            ::close(probe);
+        }
+        if (live) {
+            LOG_ERROR("another process listens at {}", path);
+            ::close(fd);
+            return -1;
+        }
+        unlink(path.c_str());
+        bound = bind(fd, sa, sizeof(addr)) == 0;
+    }
+    if (!bound) {
+        LOG_ERROR("bind {} failed: {}", path, strerror(errno));
+        ::close(fd);
+        return -1;
+    }
+
+    if (chmod(path.c_str(), static_cast<mode_t>(mode)) != 0 || listen(fd, SOMAXCONN) != 0) {
+        LOG_ERROR("listen at {} failed: {}", path, strerror(errno));
+        ::close(fd);
+        unlink(path.c_str());
+        return -1;
+    }
+    return fd;
+}
+
+int dupListener(int fd)
+{
+    auto copy = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    if (copy < 0) {
+        LOG_ERROR("dup listening socket {} failed: {}", fd, strerror(errno));
+        return -1;
+    }
+    // the daemons sharing it must not block in accept
+    auto flags = fcntl(copy, F_GETFL);
+    if (flags < 0 || fcntl(copy, F_SETFL, flags | O_NONBLOCK) != 0) {
+        LOG_ERROR("set listening socket {} non-blocking failed: {}", fd, strerror(errno));
+        ::close(copy);
+        return -1;
+    }
+    return copy;
+}
+
+int listenInet(const InetAddress &addr)
+{
+    auto family = addr.isV6() ? AF_INET6 : AF_INET;
+    auto fd = socket(family, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        LOG_ERROR("socket failed: {}", strerror(errno));
+        return -1;
+    }
+
+    int on = 1;
+    int off = 0;
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) != 0
+        || (addr.isV6() && setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off)) != 0)
+        || bind(fd, addr.getSocket(), static_cast<socklen_t>(addr.socketLen())) != 0 || listen(fd, SOMAXCONN) != 0) {
+        LOG_ERROR("listen at {} failed: {}", addr, strerror(errno));
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool localAddress(int fd, sockaddr_storage &local)
+{
+    socklen_t len = sizeof(local);
+    memset(&local, 0, sizeof(local));
+    return getsockname(fd, reinterpret_cast<sockaddr *>(&local), &len) == 0;
+}
+
+bool boundTo(const sockaddr_storage &local, const std::string &path, const InetAddress &addr)
+{
+    if (path.length() != 0) {
+        auto &un = reinterpret_cast<const sockaddr_un &>(local);
+        return local.ss_family == AF_UNIX && strncmp(un.sun_path, path.c_str(), sizeof(un.sun_path)) == 0;
+    }
+    if (addr.isV6()) {
+        auto &want = *reinterpret_cast<const sockaddr_in6 *>(addr.getSocket());
+        auto &in6 = reinterpret_cast<const sockaddr_in6 &>(local);
+        return local.ss_family == AF_INET6 && in6.sin6_port == want.sin6_port
+               && (IN6_IS_ADDR_UNSPECIFIED(&want.sin6_addr)
+                   || memcmp(&in6.sin6_addr, &want.sin6_addr, sizeof(in6.sin6_addr)) == 0);
+    }
+    auto &want = *reinterpret_cast<const sockaddr_in *>(addr.getSocket());
+    auto &in = reinterpret_cast<const sockaddr_in &>(local);
+    return local.ss_family == AF_INET && in.sin_port == want.sin_port
+           && (want.sin_addr.s_addr == htonl(INADDR_ANY) || in.sin_addr.s_addr == want.sin_addr.s_addr);
+}
+
+Acceptor::Acceptor() : epoll_(-1), wake_(-1)
+{
+    running_ = false;
+}
+
+Acceptor::~Acceptor()
+{
+    stop();
+}
+
+bool Acceptor::start(const std::vector<int> &fds, Handler &&handler)
+{
+    epoll_ = epoll_create1(EPOLL_CLOEXEC);
+    wake_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+    auto ok = epoll_ >= 0 && wake_ >= 0;
+    epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    // the listeners are numbered from 0, the wake up comes after them
+    for (size_t i = 0; ok && i <= fds.size(); i++) {
+        ev.data.u32 = static_cast<uint32_t>(i);
+        ok = epoll_ctl(epoll_, EPOLL_CTL_ADD, i < fds.size() ? fds[i] : wake_, &ev) == 0;
+    }
+    if (!ok) {
+        LOG_ERROR("acceptor: {}", strerror(errno));
+        for (auto fd : {&epoll_, &wake_}) {
+            if (*fd >= 0) {
+                ::close(*fd);
+                *fd = -1;
+            }
+        }
+        return false;
+    }
+
+    fds_ = fds;
+    handler_ = std::move(handler);
+    running_ = true;
+    thread_ = std::thread(&Acceptor::run, this);
+    return true;
+}
+
+void Acceptor::stop()
+{
+    if (!thread_.joinable()) {
+        return;
+    }
+
+    running_ = false;
+    uint64_t one = 1;
+    if (::write(wake_, &one, sizeof(one)) < 0) {
+        LOG_ERROR("acceptor: wake up failed: {}", strerror(errno));
+    }
+    thread_.join();
+
+    ::close(epoll_);
+    ::close(wake_);
+    epoll_ = wake_ = -1;
+}
+
+void Acceptor::run()
+{
+    constexpr int kEvents = 32;
+    epoll_event events[kEvents];
+
+    while (running_) {
+        auto n = epoll_wait(epoll_, events, kEvents, -1);
+        if (n < 0 && errno != EINTR) {
+            LOG_ERROR("acceptor: epoll_wait failed: {}", strerror(errno));
+            break;
+        }
+        for (auto i = 0; i < n && running_; i++) {
+            if (events[i].data.u32 < fds_.size()) {
+                accept(events[i].data.u32);
+            }
+        }
+    }
+}
+
+void Acceptor::accept(uint32_t listener)
+{
+    // the ones pending at most, the other listeners get their turn
+    for (auto i = 0; i < 64; i++) {
+        sockaddr_storage addr;
+        socklen_t len = sizeof(addr);
+        auto fd = accept4(fds_[listener], reinterpret_cast<sockaddr *>(&addr), &len, SOCK_CLOEXEC | SOCK_NONBLOCK);
+        if (fd >= 0) {
+            handler_(fd, reinterpret_cast<sockaddr *>(&addr), len, listener);
+            continue;
+        }
+        if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+            // out of descriptors: the connections wait in the backlog until some are closed
+            LOG_WARN("acceptor: accept failed: {}", strerror(errno));
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return;
+    }
+}
+
+CPPMHD_NAMESPACE_END
@@ -0,0 +1,80 @@
+#ifndef CPPMHD_INTERNAL_LISTEN_H_
+#define CPPMHD_INTERNAL_LISTEN_H_
+
+#include "config.h"
+
+#include <sys/socket.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "core.h"
+#include "utils.h"
+
+CPPMHD_NAMESPACE_BEGIN
+
+// the address of an App listening on a Unix domain socket starts with it, eg: unix:/run/app.sock
+constexpr char kUnixPrefix[] = "unix:";
+
+// the path of a unix: address, empty for an IP address
+std::string unixPath(const std::string &address);
+
+// the sockets systemd passed with LISTEN_FDS, empty unless LISTEN_PID is this process. the variables are unset, so
+// the processes this one starts do not take them too
+std::vector<int> systemdSockets();
+
+// a listening Unix domain socket at path with the permissions of mode. the file of a socket nobody listens on is
+// replaced, -1 if another process listens on it
+int listenUnix(const std::string &path, uint32_t mode);
+
+// a copy of a listening socket for one more daemon, non-blocking. -1 on error
+int dupListener(int fd);
+
+// a listening TCP socket bound to addr, both IPv4 and IPv6 for an IPv6 address. -1 on error
+int listenInet(const InetAddress &addr);
+
+// the address a socket is bound to, or the one a connection was accepted on
+bool localAddress(int fd, sockaddr_storage &local);
+
+// whether local is the Unix domain socket path, or addr when path is empty. a wildcard addr matches any address on
+// its port
+bool boundTo(const sockaddr_storage &local, const std::string &path, const InetAddress &addr);
+
+// accepts the connections of the listeners added to an App on one thread, the daemons serve them
+class Acceptor
+{
+  public:
+    // a connection accepted on the socket at index listener, non-blocking. the handler owns it
+    using Handler = std::function<void(int fd, const sockaddr *addr, socklen_t len, uint32_t listener)>;
+
+  private:
+    int epoll_;
+    // wakes the loop up to stop
+    int wake_;
+    std::thread thread_;
+    std::atomic_bool running_;
+    std::vector<int> fds_;
+    Handler handler_;
+
+    void run();
+    void accept(uint32_t listener);
+
+  public:
+    Acceptor();
+    ~Acceptor();
+
+    Acceptor(const Acceptor &) = delete;
+
+    // the sockets stay the caller's
+    bool start(const std::vector<int> &fds, Handler &&handler);
+    // returns once no connection is accepted anymore
+    void stop();
+};
+
+CPPMHD_NAMESPACE_END
+
+#endif
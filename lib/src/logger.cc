@@ -2,13 +2,12 @@
 
 #include "config.h"
 
-#include <fmt/chrono.h>
-#include <time.h>
-
 #include <atomic>
 #include <cstdio>
 #include <mutex>
 
+#include "clock.h"
+
 using namespace cppmhd::log;
 
 #ifndef ON_WINDOWS
@@ -39,8 +38,7 @@ CPPMHD_NAMESPACE_BEGIN
 
 namespace log
 {
-void SimpleSTDOUTLogger::output(enum LogLevel lv, const char*, const char* func, int line, const char* message)
-
+void formatLine(fmt::memory_buffer& out, enum LogLevel lv, const char* func, int line, const char* message)
 {
     static const char* lvStr[16] = {MAGENTA " [TRACE] " RESET,
                                     BLUE " [DEBUG] " RESET,
@@ -53,6 +51,19 @@ void SimpleSTDOUTLogger::output(enum LogLevel lv, const char*, const char* func,
                                     DG "[DTRACE]" RESET
 #endif
     };
+    uint8_t ln = lv;
+    fmt::format_to(std::back_inserter(out),
+                   "{} {} [{}:{}] {}\n",
+                   CoarseClock::logTimestamp(),
+                   lvStr[ln],
+                   func,
+                   line,
+                   message);
+}
+
+void SimpleSTDOUTLogger::output(enum LogLevel lv, const char*, const char* func, int line, const char* message)
+
+{
 #ifdef NDEBUG
     if (lv >= getLevel()) {
         uint8_t ln = lv;
@@ -63,13 +74,12 @@ void SimpleSTDOUTLogger::output(enum LogLevel lv, const char*, const char* func,
         }
 #else
     if (lv >= getLevel() && lv <= LV_DTRACE) {
-        uint8_t ln = lv;
 #endif
-        auto all = fmt::format(
-            "{:%Y-%m-%d %H:%M:%S} {} [{}:{}] {}\n", fmt::localtime(time(nullptr)), lvStr[ln], func, line, message);
+        fmt::memory_buffer all;
+        formatLine(all, lv, func, line, message);
 
         mutex.lock();
-        fprintf(stdout, "%s", all.c_str());
+        fwrite(all.data(), 1, all.size(), stdout);
         mutex.unlock();
     }
 }
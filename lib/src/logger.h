@@ -38,6 +38,9 @@ class SimpleSTDOUTLogger : public AbstractLogger
     virtual ~SimpleSTDOUTLogger();
 };
 
+// "<time> [LEVEL] [func:line] message\n", the format of every logger shipped with cppmhd
+void formatLine(fmt::memory_buffer& out, enum LogLevel lv, const char* func, int line, const char* message);
+
 inline void fflush()
 {
     logInstance->fflush();
@@ -0,0 +1,181 @@
+#include "method.h"
+
+#include <atomic>
+#include <cstring>
+#include <mutex>
+
+#include "logger.h"
+
+CPPMHD_NAMESPACE_BEGIN
+
+namespace
+{
+#define METHOD_WORD(a, b, c, d)                                                                     \
+    ((static_cast<uint32_t>(a)) | (static_cast<uint32_t>(b) << 8) | (static_cast<uint32_t>(c) << 16) \
+     | (static_cast<uint32_t>(d) << 24))
+
+// first four bytes of the method as a little-endian word. for three-letter methods the NUL terminator is the 4th byte.
+inline uint32_t firstWord(const char* mth)
+{
+    auto p = reinterpret_cast<const uint8_t*>(mth);
+    return METHOD_WORD(p[0], p[1], p[2], p[3]);
+}
+
+struct ExtensionMethod {
+    char name[kMaxMethodLength + 1];
+    size_t length;
+};
+
+ExtensionMethod extensions[kMaxExtensionMethods];
+std::atomic<size_t> extensionCount(0);
+std::mutex extensionMutex;
+
+const char* const standardNames[] = {"GET", "HEAD", "POST", "PUT", "DELETE", "OPTIONS", "CONNECT", "TRACE", "PATCH"};
+
+bool parseStandardMethod(HttpMethod& out, const char* mth, size_t length)
+{
+    // length + first word is a perfect hash over the standard methods
+    auto w = firstWord(mth);
+
+    switch (length) {
+        case 3:
+            if (likely(w == METHOD_WORD('G', 'E', 'T', 0))) {
+                out = HttpMethod::GET;
+                return true;
+            } else if (w == METHOD_WORD('P', 'U', 'T', 0)) {
+                out = HttpMethod::PUT;
+                return true;
+            }
+            return false;
+        case 4:
+            if (likely(w == METHOD_WORD('P', 'O', 'S', 'T'))) {
+                out = HttpMethod::POST;
+                return true;
+            } else if (w == METHOD_WORD('H', 'E', 'A', 'D')) {
+                out = HttpMethod::HEAD;
+                return true;
+            }
+            return false;
+        case 5:
+            if (w == METHOD_WORD('P', 'A', 'T', 'C') && mth[4] == 'H') {
+                out = HttpMethod::PATCH;
+                return true;
+            } else if (w == METHOD_WORD('T', 'R', 'A', 'C') && mth[4] == 'E') {
+                out = HttpMethod::TRACE;
+                return true;
+            }
+            return false;
+        case 6:
+            if (w == METHOD_WORD('D', 'E', 'L', 'E') && memcmp(mth + 4, "TE", 2) == 0) {
+                out = HttpMethod::DELETE;
+                return true;
+            }
+            return false;
+        case 7:
+            if (w == METHOD_WORD('O', 'P', 'T', 'I') && memcmp(mth + 4, "ONS", 3) == 0) {
+                out = HttpMethod::OPTIONS;
+                return true;
+            } else if (w == METHOD_WORD('C', 'O', 'N', 'N') && memcmp(mth + 4, "ECT", 3) == 0) {
+                out = HttpMethod::CONNECT;
+                return true;
+            }
+            return false;
+        default:
+            return false;
+    }
+}
+
+bool parseExtensionMethod(HttpMethod& out, const char* mth, size_t length)
+{
+    auto count = extensionCount.load(std::memory_order_acquire);
+    for (auto i = 0u; i < count; i++) {
+        const auto& ext = extensions[i];
+        if (ext.length == length && memcmp(ext.name, mth, length) == 0) {
+            out = static_cast<HttpMethod>(static_cast<size_t>(HttpMethod::EXTENSION_BEGIN) + i);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool isMethodToken(const char* name, size_t length)
+{
+    if (length == 0 || length > kMaxMethodLength) {
+        return false;
+    }
+    for (auto i = 0u; i < length; i++) {
+        auto c = name[i];
+        if (!((c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-' || c == '_')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+#undef METHOD_WORD
+}  // namespace
+
+bool parseHttpMethod(HttpMethod& out, const char* mth, size_t length)
+{
+    if (unlikely(mth == nullptr || length < 3)) {
+        return false;
+    }
+
+    if (likely(parseStandardMethod(out, mth, length))) {
+        return true;
+    }
+
+    return unlikely(extensionCount.load(std::memory_order_relaxed) > 0) && parseExtensionMethod(out, mth, length);
+}
+
+bool parseHttpMethod(HttpMethod& out, const char* mth)
+{
+    return mth != nullptr && parseHttpMethod(out, mth, strlen(mth));
+}
+
+bool registerHttpMethod(const char* name, HttpMethod& out)
+{
+    auto length = name == nullptr ? 0 : strlen(name);
+
+    if (unlikely(!isMethodToken(name, length))) {
+        LOG_ERROR("Bad Http Method name '{}'. Method must be an upper case token of at most {} characters",
+                  name == nullptr ? "" : name,
+                  kMaxMethodLength);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> _(extensionMutex);
+
+    if (parseHttpMethod(out, name, length)) {
+        return true;
+    }
+
+    auto count = extensionCount.load(std::memory_order_relaxed);
+    if (unlikely(count >= kMaxExtensionMethods)) {
+        LOG_ERROR("Too many extension Http Methods, '{}' is not registered", name);
+        return false;
+    }
+
+    auto& ext = extensions[count];
+    memcpy(ext.name, name, length + 1);
+    ext.length = length;
+    extensionCount.store(count + 1, std::memory_order_release);
+
+    out = static_cast<HttpMethod>(static_cast<size_t>(HttpMethod::EXTENSION_BEGIN) + count);
+    LOG_DEBUG("register extension Http Method '{}'", name);
+    return true;
+}
+
+const char* httpMethodName(HttpMethod mtd)
+{
+    auto value = static_cast<size_t>(mtd);
+
+    if (likely(!isExtensionMethod(mtd))) {
+        return value < sizeof(standardNames) / sizeof(standardNames[0]) ? standardNames[value] : nullptr;
+    }
+
+    auto index = value - static_cast<size_t>(HttpMethod::EXTENSION_BEGIN);
+    return index < extensionCount.load(std::memory_order_acquire) ? extensions[index].name : nullptr;
+}
+
+CPPMHD_NAMESPACE_END
@@ -0,0 +1,30 @@
+#ifndef CPPMHD_INTERNAL_METHOD_H_
+#define CPPMHD_INTERNAL_METHOD_H_
+
+#include "config.h"
+
+#include <cppmhd/core.h>
+
+#include <cstddef>
+
+#include "core.h"
+
+CPPMHD_NAMESPACE_BEGIN
+
+constexpr size_t kMaxExtensionMethods = 32;
+constexpr size_t kMaxMethodLength = 23;
+
+// exact match of the NUL terminated request method: "GETX" or "GE" are rejected.
+// standard methods are decoded by length plus one 32 bits compare, registered extensions come after.
+bool parseHttpMethod(HttpMethod& out, const char* method, size_t length);
+
+bool parseHttpMethod(HttpMethod& out, const char* method);
+
+inline bool isExtensionMethod(HttpMethod mtd)
+{
+    return mtd >= HttpMethod::EXTENSION_BEGIN;
+}
+
+CPPMHD_NAMESPACE_END
+
+#endif
@@ -0,0 +1,214 @@
+#include "metrics.h"
+
+#include <cppmhd/entity.h>
+
+#include <algorithm>
+
+#include "logger.h"
+
+CPPMHD_NAMESPACE_BEGIN
+
+constexpr size_t Metrics::kBuckets;
+constexpr size_t Metrics::kStatusClasses;
+constexpr size_t Metrics::kMethodSlots;
+constexpr size_t Metrics::kUnknownMethodSlot;
+constexpr size_t Metrics::kSlotSize;
+
+namespace
+{
+std::atomic<size_t> threadSerial(0);
+
+// assigned once per thread, server threads are spread over the shards round-robin
+thread_local size_t shardHint = ~static_cast<size_t>(0);
+
+const char* const statusClassNames[] = {"none", "1xx", "2xx", "3xx", "4xx", "5xx"};
+
+void appendLabel(fmt::memory_buffer& out, const std::string& value)
+{
+    for (auto c : value) {
+        if (unlikely(c == '"' || c == '\\')) {
+            out.push_back('\\');
+        }
+        out.push_back(c);
+    }
+}
+
+}  // namespace
+
+Metrics::Metrics(const std::vector<RouteInfo>& routes, size_t shards)
+    : routes_(routes),
+      series_(routes.size() + kMethodSlots),
+      shardCount_(shards == 0 ? 1 : shards),
+      removedRefused_(0),
+      removedShed_(0)
+{
+    auto size = (series_ * kStatusClasses + kTimingSpanCount) * kSlotSize;
+    for (auto i = 0u; i < shardCount_; i++) {
+        // the padding keeps the shards of two threads off the same cache line
+        shards_.emplace_back(new std::atomic<uint64_t>[size + 8]());
+    }
+    LOG_DEBUG("metrics: {} series, {} shards of {} KB", series_, shardCount_, (size * 8) >> 10);
+}
+
+std::atomic<uint64_t>* Metrics::shard()
+{
+    auto hint = shardHint;
+    if (unlikely(hint == ~static_cast<size_t>(0))) {
+        shardHint = hint = threadSerial++;
+    }
+    return shards_[hint % shardCount_].get();
+}
+
+uint64_t Metrics::collect(size_t offset, uint64_t sum[]) const
+{
+    uint64_t count = 0;
+    for (auto i = 0u; i < kSlotSize; i++) {
+        sum[i] = 0;
+        for (const auto& s : shards_) {
+            sum[i] += s[offset + i].load(std::memory_order_relaxed);
+        }
+        count += i < kBuckets ? sum[i] : 0;
+    }
+    return count;
+}
+
+void Metrics::formatHistogram(
+    fmt::memory_buffer& out, const char* name, fmt::string_view label, const uint64_t sum[], uint64_t count) const
+{
+    // every bucket is written out, so the set of le labels never changes between scrapes
+    uint64_t cumulative = 0;
+    for (auto b = 0u; b < kBuckets - 1; b++) {
+        cumulative += sum[b];
+        fmt::format_to(std::back_inserter(out),
+                       "{}_bucket{{{},le=\"{}\"}} {}\n",
+                       name,
+                       label,
+                       static_cast<double>(upperBound(b)) / 1e6,
+                       cumulative);
+    }
+    fmt::format_to(std::back_inserter(out),
+                   "{}_bucket{{{},le=\"+Inf\"}} {}\n"
+                   "{}_sum{{{}}} {}\n"
+                   "{}_count{{{}}} {}\n",
+                   name,
+                   label,
+                   count,
+                   name,
+                   label,
+                   static_cast<double>(sum[kBuckets]) / 1e6,
+                   name,
+                   label,
+                   count);
+}
+
+void Metrics::format(fmt::memory_buffer& out) const
+{
+    static const char help[] =
+        "# HELP cppmhd_request_duration_seconds Time from the first byte of the request to the response completed.\n"
+        "# TYPE cppmhd_request_duration_seconds histogram\n";
+    out.append(help, help + sizeof(help) - 1);
+
+    uint64_t sum[kSlotSize];
+    fmt::memory_buffer labels;
+
+    for (auto series = 0u; series < series_; series++) {
+        for (auto sc = 0u; sc < kStatusClasses; sc++) {
+            auto count = collect((series * kStatusClasses + sc) * kSlotSize, sum);
+            if (count == 0) {
+                continue;
+            }
+
+            labels.clear();
+            if (series < routes_.size()) {
+                const auto& route = routes_[series];
+                static const char prefix[] = "route=\"";
+                labels.append(prefix, prefix + sizeof(prefix) - 1);
+                appendLabel(labels, route.pattern);
+                auto method = httpMethodName(route.method);
+                fmt::format_to(std::back_inserter(labels), "\",method=\"{}\"", method == nullptr ? "UNKNOWN" : method);
+            } else {
+                auto slot = series - routes_.size();
+                auto method = slot != kUnknownMethodSlot ? httpMethodName(static_cast<HttpMethod>(slot)) : nullptr;
+                fmt::format_to(
+                    std::back_inserter(labels), "route=\"\",method=\"{}\"", method == nullptr ? "UNKNOWN" : method);
+            }
+            fmt::format_to(std::back_inserter(labels), ",status=\"{}\"", statusClassNames[sc]);
+
+            formatHistogram(
+                out, "cppmhd_request_duration_seconds", fmt::string_view(labels.data(), labels.size()), sum, count);
+        }
+    }
+
+    auto spans = series_ * kStatusClasses * kSlotSize;
+    auto headerWritten = false;
+    for (auto i = 0u; i < kTimingSpanCount; i++) {
+        auto count = collect(spans + i * kSlotSize, sum);
+        if (count == 0) {
+            continue;
+        }
+
+        if (!headerWritten) {
+            static const char spanHelp[] =
+                "# HELP cppmhd_request_phase_seconds Time spent in each phase of the request.\n"
+                "# TYPE cppmhd_request_phase_seconds histogram\n";
+            out.append(spanHelp, spanHelp + sizeof(spanHelp) - 1);
+            headerWritten = true;
+        }
+
+        labels.clear();
+        fmt::format_to(std::back_inserter(labels), "phase=\"{}\"", timingSpans[i].name);
+        formatHistogram(
+            out, "cppmhd_request_phase_seconds", fmt::string_view(labels.data(), labels.size()), sum, count);
+    }
+
+    uint64_t refused, shed;
+    {
+        std::lock_guard<std::mutex> _(mutex_);
+        refused = removedRefused_;
+        shed = removedShed_;
+        for (auto a : admissions_) {
+            refused += a->refused();
+            shed += a->shed();
+        }
+    }
+    fmt::format_to(std::back_inserter(out),
+                   "# HELP cppmhd_connections_refused_total Connections refused over AdmissionOptions::maxConnections.\n"
+                   "# TYPE cppmhd_connections_refused_total counter\n"
+                   "cppmhd_connections_refused_total {}\n"
+                   "# HELP cppmhd_requests_shed_total Requests answered 503 by the admission control.\n"
+                   "# TYPE cppmhd_requests_shed_total counter\n"
+                   "cppmhd_requests_shed_total {}\n",
+                   refused,
+                   shed);
+}
+
+void Metrics::removeAdmission(const Admission* admission)
+{
+    std::lock_guard<std::mutex> _(mutex_);
+    auto it = std::find(admissions_.begin(), admissions_.end(), admission);
+    if (it != admissions_.end()) {
+        removedRefused_ += admission->refused();
+        removedShed_ += admission->shed();
+        admissions_.erase(it);
+    }
+}
+
+void MetricsController::onRequest(HttpRequestPtr, HttpResponsePtr& resp)
+{
+    resp = std::make_shared<HttpResponse>();
+
+    auto metrics = metrics_.load();
+    if (unlikely(metrics == nullptr)) {
+        resp->status(k503ServiceUnavailable);
+        return;
+    }
+
+    fmt::memory_buffer out;
+    metrics->format(out);
+
+    resp->body(out.size(), out.data(), false);
+    resp->header(CPPMHD_HTTP_HEADER_CONTENT_TYPE) = "text/plain; version=0.0.4; charset=utf-8";
+    resp->status(k200OK);
+}
+
+CPPMHD_NAMESPACE_END
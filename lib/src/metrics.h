@@ -0,0 +1,163 @@
+#ifndef CPPMHD_INTERNAL_METRICS_H_
+#define CPPMHD_INTERNAL_METRICS_H_
+
+#include "config.h"
+
+#include <cppmhd/controller.h>
+
+#include <fmt/format.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "admission.h"
+#include "core.h"
+#include "method.h"
+#include "router.h"
+#include "timing.h"
+
+CPPMHD_NAMESPACE_BEGIN
+
+// request counters and latency histograms, exported in the Prometheus text format.
+//
+// every server thread writes to its own shard with relaxed atomic adds, so recording never contends. a series is a
+// route (or the request method for unmatched requests) and a status class, each with a log-linear histogram of the
+// latency in microseconds: two buckets per power of two. with ENABLE_REQUEST_TIMING each of timingSpans gets one more
+// histogram. the shards are only summed up when scraped, together with the counters of the admission control of every
+// daemon.
+class Metrics
+{
+  public:
+    // 0, 1, then [2^e, 1.5 * 2^e), [1.5 * 2^e, 2^(e+1)) for e in [1, 30]. the last bucket also takes everything above
+    static constexpr size_t kBuckets = 62;
+    // no response, 1xx, 2xx, 3xx, 4xx, 5xx
+    static constexpr size_t kStatusClasses = 6;
+    // the unmatched requests of every method, the last slot takes the ones of a method parseHttpMethod does not know
+    static constexpr size_t kMethodSlots = static_cast<size_t>(HttpMethod::EXTENSION_BEGIN) + kMaxExtensionMethods + 1;
+    static constexpr size_t kUnknownMethodSlot = kMethodSlots - 1;
+
+    static size_t bucket(uint64_t micros)
+    {
+        if (micros < 2) {
+            return static_cast<size_t>(micros);
+        }
+#ifdef GCC_COMPLIABLE
+        auto e = static_cast<size_t>(63 - __builtin_clzll(micros));
+#else
+        size_t e = 0;
+        for (auto v = micros; v > 1; v >>= 1) {
+            e++;
+        }
+#endif
+        if (unlikely(e > 30)) {
+            return kBuckets - 1;
+        }
+        return (e << 1) + ((micros >> (e - 1)) & 1);
+    }
+
+    // largest value in the bucket
+    static uint64_t upperBound(size_t bucket)
+    {
+        if (bucket < 2) {
+            return bucket;
+        }
+        auto e = bucket >> 1;
+        auto sub = bucket & 1;
+        return (1ULL << e) + ((sub + 1) << (e - 1)) - 1;
+    }
+
+    static size_t statusClass(int status)
+    {
+        return status >= 100 && status < 600 ? static_cast<size_t>(status / 100) : 0;
+    }
+
+  private:
+    // per slot: kBuckets counters, then the sum of latencies
+    static constexpr size_t kSlotSize = kBuckets + 1;
+
+    const std::vector<RouteInfo>& routes_;
+    const size_t series_;
+    const size_t shardCount_;
+    std::vector<std::unique_ptr<std::atomic<uint64_t>[]>> shards_;
+
+    // daemons are added while the ones started before may be scraped already
+    mutable std::mutex mutex_;
+    std::vector<const Admission*> admissions_;
+    // the counts of the ones removed, the totals never go back
+    uint64_t removedRefused_;
+    uint64_t removedShed_;
+
+    std::atomic<uint64_t>* shard();
+
+    // sums up slot `offset' of all shards. returns the count of observations
+    uint64_t collect(size_t offset, uint64_t sum[]) const;
+
+    void formatHistogram(
+        fmt::memory_buffer& out, const char* name, fmt::string_view label, const uint64_t sum[], uint64_t count) const;
+
+    size_t seriesOf(const RouteInfo* route, HttpMethod method) const
+    {
+        if (likely(route != nullptr)) {
+            return route->id;
+        }
+        auto m = static_cast<size_t>(method);
+        return routes_.size() + (m < kUnknownMethodSlot ? m : kUnknownMethodSlot);
+    }
+
+  public:
+    Metrics(const std::vector<RouteInfo>& routes, size_t shards);
+
+    void observe(const RouteInfo* route, HttpMethod method, int status, uint64_t micros)
+    {
+        auto slot = shard() + (seriesOf(route, method) * kStatusClasses + statusClass(status)) * kSlotSize;
+        slot[bucket(micros)].fetch_add(1, std::memory_order_relaxed);
+        slot[kBuckets].fetch_add(micros, std::memory_order_relaxed);
+    }
+
+    // the spans a request passed, in microseconds. 0 for spans which were not passed
+    void observeSpans(const uint32_t micros[kTimingSpanCount])
+    {
+        auto slot = shard() + series_ * kStatusClasses * kSlotSize;
+        for (auto i = 0u; i < kTimingSpanCount; i++, slot += kSlotSize) {
+            if (micros[i] != 0) {
+                slot[bucket(micros[i])].fetch_add(1, std::memory_order_relaxed);
+                slot[kBuckets].fetch_add(micros[i], std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // the admission control of a daemon, until removeAdmission
+    void addAdmission(const Admission* admission)
+    {
+        std::lock_guard<std::mutex> _(mutex_);
+        admissions_.push_back(admission);
+    }
+
+    // the daemon of admission stopped. its counts are kept in the totals
+    void removeAdmission(const Admission* admission);
+
+    // Prometheus text exposition format 0.0.4
+    void format(fmt::memory_buffer& out) const;
+};
+
+// serves the scrape. registered by App::start when metrics are enabled, attached once the server is built
+class MetricsController : public HttpController
+{
+    std::atomic<const Metrics*> metrics_;
+
+  public:
+    MetricsController() : metrics_(nullptr) {}
+
+    void attach(const Metrics* metrics)
+    {
+        metrics_ = metrics;
+    }
+
+    virtual void onRequest(HttpRequestPtr, HttpResponsePtr&) override;
+};
+
+CPPMHD_NAMESPACE_END
+
+#endif
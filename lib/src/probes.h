@@ -0,0 +1,38 @@
+#ifndef CPPMHD_INTERNAL_PROBES_H_
+#define CPPMHD_INTERNAL_PROBES_H_
+
+#include "config.h"
+
+// USDT probes on the request path, provider `cppmhd'. built with -DENABLE_USDT=ON and only when sys/sdt.h is found.
+// a probe is a single nop in the code plus a note in .note.stapsdt, there is no runtime dependency and nothing is
+// evaluated until a tracer attaches. the connection pointer ties the probes of one request together.
+//
+//   conn__open(conn)                               MHD accepted a connection
+//   conn__close(conn)                              MHD closed it
+//   request__start(conn, method, path)             request line and headers are in, method is the HttpMethod
+//   route__resolved(conn, method, path, ctrl)      ctrl is the HttpController, null if no route matched
+//   handler__start(conn, ctrl)                     right before HttpController::onRequest
+//   handler__end(conn, ctrl)                       HttpController::onRequest returned
+//   response__queued(conn, status)                 the response was handed to MHD
+//   request__done(conn, method, path, status, ctrl, toe)
+//                                                  status is 0 if no response was made, toe the termination code
+//
+// e.g. with bpftrace:
+//   bpftrace -e 'usdt:./libcppmhd.so:cppmhd:request__done { @[arg3] = count(); }'
+#if defined ENABLE_USDT && defined HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+
+#define CPPMHD_PROBE1(name, a) DTRACE_PROBE1(cppmhd, name, a)
+#define CPPMHD_PROBE2(name, a, b) DTRACE_PROBE2(cppmhd, name, a, b)
+#define CPPMHD_PROBE3(name, a, b, c) DTRACE_PROBE3(cppmhd, name, a, b, c)
+#define CPPMHD_PROBE4(name, a, b, c, d) DTRACE_PROBE4(cppmhd, name, a, b, c, d)
+#define CPPMHD_PROBE6(name, a, b, c, d, e, f) DTRACE_PROBE6(cppmhd, name, a, b, c, d, e, f)
+#else
+#define CPPMHD_PROBE1(name, a) ((void)0)
+#define CPPMHD_PROBE2(name, a, b) ((void)0)
+#define CPPMHD_PROBE3(name, a, b, c) ((void)0)
+#define CPPMHD_PROBE4(name, a, b, c, d) ((void)0)
+#define CPPMHD_PROBE6(name, a, b, c, d, e, f) ((void)0)
+#endif
+
+#endif
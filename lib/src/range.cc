@@ -0,0 +1,281 @@
+#include "range.h"
+
+#include <unistd.h>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <string>
+
+#include "logger.h"
+#include "validator.h"
+
+CPPMHD_NAMESPACE_BEGIN
+
+namespace
+{
+const char *skipSpaces(const char *p)
+{
+    while (*p == ' ' || *p == '\t') {
+        p++;
+    }
+    return p;
+}
+
+// false without a digit. saturates instead of overflowing, such a position is past any body
+bool parseNumber(const char *&p, uint64_t &value)
+{
+    auto begin = p;
+    value = 0;
+    for (; *p >= '0' && *p <= '9'; p++) {
+        auto digit = static_cast<uint64_t>(*p - '0');
+        value = value > (UINT64_MAX - digit) / 10 ? UINT64_MAX : value * 10 + digit;
+    }
+    return p != begin;
+}
+
+// a part of a multipart/byteranges body: the text of the part headers, or a range of the body
+struct Segment {
+    // where it starts in the response
+    uint64_t start;
+    uint64_t length;
+
+    std::string text;
+    // in the body, when text is empty
+    uint64_t offset;
+};
+
+struct MultiRange {
+    // owns the body or the file
+    HttpResponsePtr resp;
+    const char *data;
+    int fd;
+
+    std::vector<Segment> segments;
+    size_t current;
+};
+
+ssize_t readRanges(void *cls, uint64_t pos, char *buf, size_t max)
+{
+    auto m = reinterpret_cast<MultiRange *>(cls);
+
+    // MHD reads in order, the segment of pos is the current one or a later one
+    if (m->current != 0 && pos < m->segments[m->current].start) {
+        m->current = 0;
+    }
+    while (m->current < m->segments.size() && pos >= m->segments[m->current].start + m->segments[m->current].length) {
+        m->current++;
+    }
+    if (m->current == m->segments.size()) {
+        return MHD_CONTENT_READER_END_OF_STREAM;
+    }
+
+    auto &s = m->segments[m->current];
+    auto skip = pos - s.start;
+    auto n = static_cast<size_t>(std::min<uint64_t>(max, s.length - skip));
+    if (s.text.length() != 0) {
+        memcpy(buf, s.text.data() + skip, n);
+    } else if (m->data != nullptr) {
+        memcpy(buf, m->data + s.offset + skip, n);
+    } else {
+        auto r = ::pread(m->fd, buf, n, static_cast<off_t>(s.offset + skip));
+        if (r <= 0) {
+            LOG_ERROR("range: read of {} bytes at {} failed: {}", n, s.offset + skip, r < 0 ? strerror(errno) : "EOF");
+            return MHD_CONTENT_READER_END_WITH_ERROR;
+        }
+        n = static_cast<size_t>(r);
+    }
+    return static_cast<ssize_t>(n);
+}
+
+void freeRanges(void *cls)
+{
+    delete reinterpret_cast<MultiRange *>(cls);
+}
+
+std::string boundary()
+{
+    static std::atomic<uint64_t> sequence(0);
+    auto n = sequence++;
+    auto seed = static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+    return FORMAT("{:016x}", xxh64(&n, sizeof(n), seed));
+}
+}  // namespace
+
+RangeResult parseRange(const char *value, uint64_t size, std::vector<ByteRange> &ranges)
+{
+    ranges.clear();
+    if (value == nullptr) {
+        return RangeResult::IGNORED;
+    }
+
+    auto p = skipSpaces(value);
+    if (strncasecmp(p, "bytes", 5) != 0) {
+        return RangeResult::IGNORED;
+    }
+    p = skipSpaces(p + 5);
+    if (*p++ != '=') {
+        return RangeResult::IGNORED;
+    }
+
+    size_t specs = 0;
+    while (true) {
+        p = skipSpaces(p);
+        if (*p == ',') {
+            p++;
+            continue;
+        }
+        if (*p == '\0') {
+            break;
+        }
+        if (++specs > kMaxRanges) {
+            return RangeResult::IGNORED;
+        }
+
+        uint64_t first, last;
+        auto hasFirst = parseNumber(p, first);
+        p = skipSpaces(p);
+        if (*p++ != '-') {
+            return RangeResult::IGNORED;
+        }
+        p = skipSpaces(p);
+        auto hasLast = parseNumber(p, last);
+        p = skipSpaces(p);
+        if ((!hasFirst && !hasLast) || (*p != ',' && *p != '\0') || (hasFirst && hasLast && last < first)) {
+            return RangeResult::IGNORED;
+        }
+
+        if (hasFirst) {
+            // past the end, unsatisfiable on its own
+            if (first < size) {
+                ranges.push_back({first, hasLast ? std::min(last, size - 1) : size - 1});
+            }
+        } else if (last != 0 && size != 0) {
+            // the last bytes
+            ranges.push_back({last >= size ? 0 : size - last, size - 1});
+        }
+    }
+
+    if (specs == 0) {
+        return RangeResult::IGNORED;
+    }
+    if (ranges.size() == 0) {
+        return RangeResult::UNSATISFIABLE;
+    }
+
+    std::sort(ranges.begin(), ranges.end(), [](const ByteRange &a, const ByteRange &b) { return a.first < b.first; });
+    size_t n = 0;
+    for (size_t i = 1; i < ranges.size(); i++) {
+        if (ranges[i].first <= ranges[n].last + 1) {
+            ranges[n].last = std::max(ranges[n].last, ranges[i].last);
+        } else {
+            ranges[++n] = ranges[i];
+        }
+    }
+    ranges.resize(n + 1);
+    return RangeResult::SATISFIABLE;
+}
+
+bool ifRangeHolds(const char *ifRange, const HttpResponse &resp)
+{
+    if (ifRange == nullptr) {
+        return true;
+    }
+
+    auto &headers = resp.headers();
+    ifRange = skipSpaces(ifRange);
+    if (*ifRange == '"') {
+        // the strong comparison, a weak ETag never matches
+        auto etag = headers.find(CPPMHD_HTTP_HEADER_ETAG);
+        return etag != headers.end() && etag->second == ifRange;
+    }
+
+    int64_t since, modified;
+    auto lastModified = headers.find(CPPMHD_HTTP_HEADER_LAST_MODIFIED);
+    return lastModified != headers.end() && parseHttpDate(ifRange, since)
+           && parseHttpDate(lastModified->second.c_str(), modified) && since == modified;
+}
+
+MHD_Response *createRangeResponse(HttpResponsePtr &resp, const char *range, const char *ifRange, uint64_t &length)
+{
+    auto &body = resp->body();
+    auto fd = resp->fd();
+    auto data = fd >= 0 ? nullptr : reinterpret_cast<const char *>(std::get<1>(body));
+    auto size = fd >= 0 ? resp->fileSize() : std::get<0>(body);
+
+    std::vector<ByteRange> ranges;
+    auto result = parseRange(range, size, ranges);
+    if (result == RangeResult::IGNORED || !ifRangeHolds(ifRange, *resp)) {
+        return nullptr;
+    }
+
+    if (result == RangeResult::UNSATISFIABLE) {
+        resp->status(k416RangeNotSatisfiable);
+        resp->header(CPPMHD_HTTP_HEADER_CONTENT_RANGE) = FORMAT("bytes */{}", size);
+        length = 0;
+        return MHD_create_response_from_buffer(0, nullptr, MHD_RESPMEM_PERSISTENT);
+    }
+
+    MHD_Response *res;
+    if (ranges.size() == 1) {
+        auto &r = ranges[0];
+        if (fd >= 0) {
+            // MHD closes its own copy
+            auto copy = ::dup(fd);
+            res = copy < 0 ? nullptr : MHD_create_response_from_fd_at_offset64(r.length(), copy, r.first);
+            if (res == nullptr && copy >= 0) {
+                ::close(copy);
+            }
+        } else {
+            res = MHD_create_response_from_buffer(static_cast<size_t>(r.length()),
+                                                  const_cast<char *>(data + r.first),
+                                                  std::get<2>(body) ? MHD_RESPMEM_MUST_COPY : MHD_RESPMEM_PERSISTENT);
+        }
+        if (res == nullptr) {
+            return nullptr;
+        }
+        resp->header(CPPMHD_HTTP_HEADER_CONTENT_RANGE) = FORMAT("bytes {}-{}/{}", r.first, r.last, size);
+        length = r.length();
+    } else {
+        auto &type = resp->header(CPPMHD_HTTP_HEADER_CONTENT_TYPE);
+        auto b = boundary();
+
+        auto m = new MultiRange{resp, data, fd, {}, 0};
+        uint64_t total = 0;
+        for (auto &r : ranges) {
+            auto text = FORMAT("\r\n--{}\r\n" CPPMHD_HTTP_HEADER_CONTENT_TYPE
+                               ": {}\r\n" CPPMHD_HTTP_HEADER_CONTENT_RANGE ": bytes {}-{}/{}\r\n\r\n",
+                               b,
+                               type,
+                               r.first,
+                               r.last,
+                               size);
+            auto length = text.length();
+            m->segments.push_back({total, length, std::move(text), 0});
+            total += length;
+            m->segments.push_back({total, r.length(), std::string(), r.first});
+            total += r.length();
+        }
+        auto end = FORMAT("\r\n--{}--\r\n", b);
+        auto length = end.length();
+        m->segments.push_back({total, length, std::move(end), 0});
+        total += length;
+
+        res = MHD_create_response_from_callback(total, 64 * 1024, readRanges, m, freeRanges);
+        if (res == nullptr) {
+            delete m;
+            return nullptr;
+        }
+        type = "multipart/byteranges; boundary=" + b;
+        length = total;
+    }
+
+    resp->status(k206PartialContent);
+    return res;
+}
+
+CPPMHD_NAMESPACE_END
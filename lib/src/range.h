@@ -0,0 +1,52 @@
+#ifndef CPPMHD_INTERNAL_RANGE_H_
+#define CPPMHD_INTERNAL_RANGE_H_
+
+#include "config.h"
+
+#include <cppmhd/entity.h>
+
+#include <microhttpd.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "core.h"
+
+CPPMHD_NAMESPACE_BEGIN
+
+// inclusive, as in Content-Range
+struct ByteRange {
+    uint64_t first;
+    uint64_t last;
+
+    uint64_t length() const
+    {
+        return last - first + 1;
+    }
+};
+
+enum class RangeResult {
+    // no Range, a malformed one or another unit: the whole body is sent
+    IGNORED,
+    SATISFIABLE,
+    // 416
+    UNSATISFIABLE
+};
+
+// ranges a request may ask for, a Range with more is ignored
+constexpr size_t kMaxRanges = 16;
+
+// the ranges of a Range value over a body of size bytes, sorted with the overlapping and adjacent ones merged
+RangeResult parseRange(const char *value, uint64_t size, std::vector<ByteRange> &ranges);
+
+// If-Range allows a range of this response: it is its strong ETag or exactly its Last-Modified. true for nullptr
+bool ifRangeHolds(const char *ifRange, const HttpResponse &resp);
+
+// the 206 or 416 of a 200 to a GET with a Range. nullptr if the whole body goes out. sets the status, Content-Range
+// and, for several ranges, the multipart/byteranges Content-Type of resp. a single range of a file is sent from the
+// file by MHD (sendfile), several ranges are read with pread. length is the length of the body of the response
+MHD_Response *createRangeResponse(HttpResponsePtr &resp, const char *range, const char *ifRange, uint64_t &length);
+
+CPPMHD_NAMESPACE_END
+
+#endif
@@ -0,0 +1,219 @@
+#include "ratelimit.h"
+
+#include <cmath>
+
+#include "logger.h"
+#include "timing.h"
+
+CPPMHD_NAMESPACE_BEGIN
+
+constexpr size_t RateLimiter::kWays;
+constexpr uint32_t RateLimiter::kTokenOne;
+constexpr uint64_t RateLimiter::kGenMask;
+constexpr uint64_t RateLimiter::kSeenMask;
+constexpr uint64_t RateLimiter::kTagMask;
+constexpr uint32_t RateLimiter::kSeenShift;
+constexpr uint64_t RateLimiter::kTokenMask;
+constexpr uint64_t RateLimiter::kRateScale;
+
+namespace
+{
+constexpr uint32_t kMaxBurst = 0xffff;
+
+uint64_t burstOf(const RateLimitOptions &options)
+{
+    double burst = options.burst != 0 ? options.burst : std::ceil(options.rate);
+    if (burst < 1) {
+        burst = 1;
+    } else if (burst > kMaxBurst) {
+        burst = kMaxBurst;
+    }
+    return static_cast<uint64_t>(burst) * RateLimiter::kTokenOne;
+}
+
+uint64_t rateOf(const RateLimitOptions &options)
+{
+    auto rate = static_cast<uint64_t>(options.rate * RateLimiter::kTokenOne * 1000);
+    return rate == 0 ? 1 : rate;
+}
+
+size_t setsOf(size_t capacity)
+{
+    size_t sets = 1;
+    while (sets * RateLimiter::kWays < capacity) {
+        sets <<= 1;
+    }
+    return sets;
+}
+
+// FNV-1a, then the finalizer of MurmurHash3 to spread it over the set index. the upper 32 bits, the tag of the key,
+// are never all 0, which marks an empty slot
+uint64_t hashBytes(const void *data, size_t length)
+{
+    auto p = reinterpret_cast<const uint8_t *>(data);
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < length; i++) {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return (h >> 32) == 0 ? h | 1ULL << 32 : h;
+}
+
+}  // namespace
+
+RateLimiter::RateLimiter(const RateLimitOptions &options)
+    : options_(options),
+      rate_(rateOf(options)),
+      burst_(burstOf(options)),
+      fillTime_(static_cast<uint32_t>(std::min<uint64_t>(burst_ * kRateScale / rate_ + 1, 0x7fffffff))),
+      mask_(setsOf(options.capacity) - 1),
+      storage_(new Set[mask_ + 2]()),
+      epoch_(monotonicNanos())
+{
+    auto p = reinterpret_cast<uintptr_t>(storage_.get());
+    sets_ = reinterpret_cast<Set *>((p + 63) & ~static_cast<uintptr_t>(63));
+
+    LOG_DEBUG("rate limiter: {} per second, burst {}, {} slots", options.rate, burst_ / kTokenOne, capacity());
+}
+
+uint64_t RateLimiter::keyOf(const sockaddr *addr)
+{
+    if (addr != nullptr && addr->sa_family == AF_INET) {
+        auto in = reinterpret_cast<const sockaddr_in *>(addr);
+        return hashBytes(&in->sin_addr, sizeof(in->sin_addr));
+    }
+
+    if (addr != nullptr && addr->sa_family == AF_INET6) {
+        auto in6 = reinterpret_cast<const sockaddr_in6 *>(addr);
+        // a v4 client of a dual stack socket shares the bucket with its plain v4 connections
+        if (IN6_IS_ADDR_V4MAPPED(&in6->sin6_addr)) {
+            return hashBytes(in6->sin6_addr.s6_addr + 12, 4);
+        }
+        return hashBytes(&in6->sin6_addr, sizeof(in6->sin6_addr));
+    }
+
+    return hashBytes(nullptr, 0);
+}
+
+uint64_t RateLimiter::keyOf(const char *data, size_t length)
+{
+    return hashBytes(data, length);
+}
+
+uint32_t RateLimiter::now() const
+{
+    return static_cast<uint32_t>((monotonicNanos() - epoch_) / 1000000);
+}
+
+RateLimiter::Slot *RateLimiter::find(uint64_t key, bool insert, uint32_t now, uint64_t &gen)
+{
+    auto &set = sets_[key & mask_];
+    auto tag = key & kTagMask;
+    auto seen = seenOf(now);
+
+    for (auto &slot : set.slots) {
+        auto k = slot.key.load(std::memory_order_acquire);
+        if ((k & kTagMask) == tag && genOf(slot.bucket.load(std::memory_order_relaxed)) == (k & kGenMask)) {
+            gen = k & kGenMask;
+            if (unlikely((k & kSeenMask) != seen)) {
+                // once a unit of time at most. fails harmlessly if the slot changes hands meanwhile
+                slot.key.compare_exchange_strong(
+                    k, tag | seen | gen, std::memory_order_relaxed, std::memory_order_relaxed);
+            }
+            return &slot;
+        }
+    }
+
+    if (!insert) {
+        return nullptr;
+    }
+
+    // a free slot, otherwise the one used longest ago
+    Slot *victim = nullptr;
+    uint64_t victimBucket = 0;
+    uint64_t oldest = 0;
+    for (auto &slot : set.slots) {
+        auto k = slot.key.load(std::memory_order_acquire);
+        auto b = slot.bucket.load(std::memory_order_relaxed);
+        if (k == 0 || genOf(b) != (k & kGenMask)) {
+            // never used, or left behind by two threads installing keys at once
+            victim = &slot;
+            victimBucket = b;
+            break;
+        }
+
+        auto age = (seen - (k & kSeenMask)) & kSeenMask;
+        if (victim == nullptr || age > oldest) {
+            victim = &slot;
+            victimBucket = b;
+            oldest = age;
+        }
+    }
+
+    gen = (genOf(victimBucket) + 1) & kGenMask;
+    if (!victim->bucket.compare_exchange_strong(
+            victimBucket, pack(now, gen, burst_), std::memory_order_acq_rel, std::memory_order_relaxed)) {
+        // another thread took the slot first
+        return nullptr;
+    }
+    victim->key.store(tag | seen | gen, std::memory_order_release);
+    return victim;
+}
+
+bool RateLimiter::acquire(uint64_t key, uint32_t now)
+{
+    uint64_t gen;
+    auto slot = find(key, true, now, gen);
+    if (unlikely(slot == nullptr)) {
+        return true;
+    }
+
+    auto bucket = slot->bucket.load(std::memory_order_relaxed);
+    while (true) {
+        if (unlikely(genOf(bucket) != gen)) {
+            // the slot went to another key meanwhile
+            return true;
+        }
+
+        uint64_t tokens;
+        uint32_t time;
+        auto last = timeOf(bucket);
+
+        if (likely(static_cast<int32_t>(now - last) > 0)) {
+            tokens = refill(bucket, now, time);
+        } else {
+            // another thread got a later clock
+            tokens = tokensOf(bucket);
+            time = last;
+        }
+
+        if (tokens < kTokenOne) {
+            // nothing is stored, the next refill starts from the same point and loses no part of a token
+            return false;
+        }
+
+        if (slot->bucket.compare_exchange_weak(bucket, pack(time, gen, tokens - kTokenOne), std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+}
+
+bool RateLimiter::available(uint64_t key, uint32_t now)
+{
+    uint64_t gen;
+    auto slot = find(key, false, now, gen);
+    if (slot == nullptr) {
+        return true;
+    }
+
+    auto bucket = slot->bucket.load(std::memory_order_relaxed);
+    return genOf(bucket) != gen || tokensAt(bucket, now) >= kTokenOne;
+}
+
+CPPMHD_NAMESPACE_END
@@ -0,0 +1,161 @@
+#ifndef CPPMHD_INTERNAL_RATELIMIT_H_
+#define CPPMHD_INTERNAL_RATELIMIT_H_
+
+#include "config.h"
+
+#include <cppmhd/app.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "core.h"
+#include "utils.h"
+
+CPPMHD_NAMESPACE_BEGIN
+
+// token buckets of the rate limiter, shared by all server threads.
+//
+// the table is set associative: a key hashes to a set of kWays slots which fill one cache line. a slot holds the
+// hash of its key and the bucket, packed into one word so that a bucket is updated with a single CAS: the upper 32
+// bits are the time in milliseconds the tokens are counted up to, then 8 bits of generation and 24 bits of tokens in
+// 1/256. the key word is the upper 32 bits of the hash, then 24 bits of the time of the last request of the key in
+// units of 1024 ms, a denied one too, and the 8 bits of the generation of the bucket it was installed with: a slot
+// changes hands with one CAS of the bucket to the next generation, a thread still holding the old key fails its CAS
+// on it and the two keys never share the tokens. a key missing from its full set takes the slot used longest ago, an
+// approximate LRU which bounds the memory to the capacity given and never drops a flooding key. keys are hashes, a
+// collision of two clients merges their buckets.
+class RateLimiter
+{
+  public:
+    static constexpr size_t kWays = 4;
+    static constexpr uint32_t kTokenOne = 1 << 8;
+
+  private:
+    static constexpr uint64_t kGenMask = 0xff;
+    // of the key word, the time of the last request above the generation
+    static constexpr uint64_t kSeenMask = 0xffffff00;
+    static constexpr uint64_t kTagMask = ~(kSeenMask | kGenMask);
+    // milliseconds to the unit of that time
+    static constexpr uint32_t kSeenShift = 10;
+    static constexpr uint64_t kTokenMask = 0xffffff;
+    // rate_ is in 1/kTokenOne tokens per kRateScale milliseconds
+    static constexpr uint64_t kRateScale = 1000000;
+
+    struct Slot {
+        std::atomic<uint64_t> key;
+        std::atomic<uint64_t> bucket;
+    };
+
+    // one cache line
+    struct Set {
+        Slot slots[kWays];
+    };
+
+    const RateLimitOptions options_;
+    // tokens per 1000 seconds and the bucket size, both in 1/kTokenOne
+    const uint64_t rate_;
+    const uint64_t burst_;
+    // milliseconds after which an untouched bucket is full again
+    const uint32_t fillTime_;
+
+    const size_t mask_;
+    // one more set than needed, sets_ starts at the first cache line boundary in it
+    std::unique_ptr<Set[]> storage_;
+    Set *sets_;
+
+    const uint64_t epoch_;
+
+    static uint64_t pack(uint32_t time, uint64_t gen, uint64_t tokens)
+    {
+        return static_cast<uint64_t>(time) << 32 | gen << 24 | tokens;
+    }
+
+    static uint32_t timeOf(uint64_t bucket)
+    {
+        return static_cast<uint32_t>(bucket >> 32);
+    }
+
+    static uint64_t genOf(uint64_t bucket)
+    {
+        return (bucket >> 24) & kGenMask;
+    }
+
+    static uint64_t tokensOf(uint64_t bucket)
+    {
+        return bucket & kTokenMask;
+    }
+
+    static uint64_t seenOf(uint32_t now)
+    {
+        return (static_cast<uint64_t>(now >> kSeenShift) << 8) & kSeenMask;
+    }
+
+    // tokens of the bucket at `now', which is after the time it is counted up to. `time' moves on only by the whole
+    // 1/kTokenOne tokens credited, the rest of the elapsed time counts at the next refill
+    uint64_t refill(uint64_t bucket, uint32_t now, uint32_t &time) const
+    {
+        auto last = timeOf(bucket);
+        auto elapsed = now - last;
+        if (elapsed >= fillTime_) {
+            time = now;
+            return burst_;
+        }
+
+        auto credited = elapsed * rate_ / kRateScale;
+        auto tokens = tokensOf(bucket) + credited;
+        if (tokens >= burst_) {
+            time = now;
+            return burst_;
+        }
+        time = last + static_cast<uint32_t>((credited * kRateScale + rate_ - 1) / rate_);
+        return tokens;
+    }
+
+    // tokens of the bucket at `now', whatever the order of the clocks
+    uint64_t tokensAt(uint64_t bucket, uint32_t now) const
+    {
+        uint32_t time;
+        return static_cast<int32_t>(now - timeOf(bucket)) > 0 ? refill(bucket, now, time) : tokensOf(bucket);
+    }
+
+    // the slot of the key and the generation of its bucket
+    Slot *find(uint64_t key, bool insert, uint32_t now, uint64_t &gen);
+
+  public:
+    explicit RateLimiter(const RateLimitOptions &options);
+
+    // client address without the port
+    static uint64_t keyOf(const sockaddr *addr);
+
+    static uint64_t keyOf(const char *data, size_t length);
+
+    // milliseconds since the limiter was created
+    uint32_t now() const;
+
+    // takes a token from the bucket of the key. false if the bucket is empty
+    bool acquire(uint64_t key, uint32_t now);
+
+    bool acquire(uint64_t key)
+    {
+        return acquire(key, now());
+    }
+
+    // true if the bucket of the key has a token left. nothing is taken and unknown keys are not added
+    bool available(uint64_t key, uint32_t now);
+
+    const RateLimitOptions &options() const
+    {
+        return options_;
+    }
+
+    // the number of slots
+    size_t capacity() const
+    {
+        return (mask_ + 1) * kWays;
+    }
+};
+
+CPPMHD_NAMESPACE_END
+
+#endif
@@ -0,0 +1,177 @@
+#ifndef CPPMHD_INTERNAL_RING_H_
+#define CPPMHD_INTERNAL_RING_H_
+
+#include "config.h"
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+
+#include "core.h"
+
+CPPMHD_NAMESPACE_BEGIN
+
+// single-producer single-consumer ring of variable sized records.
+//
+// every record is a 8 bytes header (payload length) followed by the payload, padded to 8 bytes. a record never
+// wraps: when it does not fit into the tail of the buffer, a padding record is written and the record starts over
+// at offset 0. so the consumer always sees every payload as one contiguous block, which can be handed to writev
+// directly without copying.
+class SpscRing
+{
+    static constexpr uint32_t kPadding = 0xffffffffu;
+    static constexpr size_t kHeader = 8;
+
+    static size_t align(size_t size)
+    {
+        return (size + 7) & ~static_cast<size_t>(7);
+    }
+
+    char* buffer_;
+    size_t capacity_;
+    size_t mask_;
+
+    alignas(64) std::atomic<size_t> head_;
+    alignas(64) std::atomic<size_t> tail_;
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    void header(size_t pos, uint32_t length)
+    {
+        memcpy(buffer_ + (pos & mask_), &length, sizeof(length));
+    }
+
+  public:
+    // capacity is rounded up to a power of two
+    explicit SpscRing(size_t capacity) : head_(0), tail_(0)
+    {
+        capacity_ = 1024;
+        while (capacity_ < capacity) {
+            capacity_ <<= 1;
+        }
+        mask_ = capacity_ - 1;
+        buffer_ = new char[capacity_];
+    }
+
+    ~SpscRing()
+    {
+        delete[] buffer_;
+    }
+
+    size_t capacity() const
+    {
+        return capacity_;
+    }
+
+    // largest payload which can ever be pushed
+    size_t maxRecord() const
+    {
+        return (capacity_ >> 1) - kHeader;
+    }
+
+    bool empty() const
+    {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+
+    /// producer side
+
+    // reserve room for a record of `size' bytes. returns nullptr if the ring is full.
+    // the record becomes visible to the consumer on commit(size).
+    char* reserve(size_t size)
+    {
+        if (unlikely(size > maxRecord())) {
+            return nullptr;
+        }
+
+        auto head = head_.load(std::memory_order_relaxed);
+        auto tail = tail_.load(std::memory_order_acquire);
+        auto pos = head & mask_;
+        auto need = align(kHeader + size);
+        auto contiguous = capacity_ - pos;
+        auto total = need > contiguous ? need + contiguous : need;
+
+        if (head + total - tail > capacity_) {
+            return nullptr;
+        }
+
+        if (need > contiguous) {
+            header(head, kPadding);
+            head_.store(head + contiguous, std::memory_order_release);
+            head += contiguous;
+        }
+
+        return buffer_ + (head & mask_) + kHeader;
+    }
+
+    void commit(size_t size)
+    {
+        auto head = head_.load(std::memory_order_relaxed);
+        header(head, static_cast<uint32_t>(size));
+        head_.store(head + align(kHeader + size), std::memory_order_release);
+    }
+
+    bool push(const void* data, size_t size)
+    {
+        auto ptr = reserve(size);
+        if (likely(ptr != nullptr)) {
+            memcpy(ptr, data, size);
+            commit(size);
+            return true;
+        }
+        return false;
+    }
+
+    /// consumer side
+
+    // a position in the ring, walked with next(). the records stay valid until release(position).
+    class Cursor
+    {
+        friend class SpscRing;
+        size_t pos_;
+        size_t end_;
+
+      public:
+        Cursor() : pos_(0), end_(0) {}
+    };
+
+    Cursor begin() const
+    {
+        Cursor c;
+        c.pos_ = tail_.load(std::memory_order_relaxed);
+        c.end_ = head_.load(std::memory_order_acquire);
+        return c;
+    }
+
+    // next record after the cursor, false when all records published at begin() are visited.
+    bool next(Cursor& c, const char*& data, size_t& size) const
+    {
+        while (c.pos_ != c.end_) {
+            uint32_t length;
+            memcpy(&length, buffer_ + (c.pos_ & mask_), sizeof(length));
+
+            if (length == kPadding) {
+                c.pos_ += capacity_ - (c.pos_ & mask_);
+                continue;
+            }
+
+            data = buffer_ + (c.pos_ & mask_) + kHeader;
+            size = length;
+            c.pos_ += align(kHeader + length);
+            return true;
+        }
+        return false;
+    }
+
+    // hand every record visited by the cursor back to the producer
+    void release(const Cursor& c)
+    {
+        tail_.store(c.pos_, std::memory_order_release);
+    }
+};
+
+CPPMHD_NAMESPACE_END
+
+#endif
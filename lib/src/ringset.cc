@@ -0,0 +1,122 @@
+#include "ringset.h"
+
+#include <algorithm>
+
+CPPMHD_NAMESPACE_BEGIN
+
+namespace
+{
+std::atomic<uint64_t> setSerial(0);
+
+// the rings of this thread, one for each live set it produced into
+struct LocalRings {
+    struct Entry {
+        uint64_t serial;
+        SpscRingSet::RingPtr ring;
+    };
+
+    std::vector<Entry> entries;
+
+    ~LocalRings()
+    {
+        for (auto& e : entries) {
+            e.ring->orphan = true;
+        }
+    }
+};
+
+thread_local LocalRings localRings;
+
+}  // namespace
+
+SpscRingSet::SpscRingSet(size_t ringSize) : ringSize_(ringSize), serial_(++setSerial), version_(0), retiredDrop_(0)
+{
+}
+
+SpscRingSet::~SpscRingSet()
+{
+    std::lock_guard<std::mutex> _(mutex_);
+    for (auto& r : rings_) {
+        r->closed = true;
+    }
+}
+
+SpscRingSet::Ring* SpscRingSet::local()
+{
+    for (auto& e : localRings.entries) {
+        if (likely(e.serial == serial_)) {
+            return e.ring.get();
+        }
+    }
+    return attach();
+}
+
+SpscRingSet::Ring* SpscRingSet::attach()
+{
+    auto& entries = localRings.entries;
+    entries.erase(std::remove_if(entries.begin(),
+                                 entries.end(),
+                                 [](const LocalRings::Entry& e) { return e.ring->closed.load(); }),
+                  entries.end());
+
+    auto ring = std::make_shared<Ring>(ringSize_);
+    entries.push_back({serial_, ring});
+
+    std::lock_guard<std::mutex> _(mutex_);
+    rings_.emplace_back(ring);
+    version_++;
+    return ring.get();
+}
+
+bool SpscRingSet::snapshot(std::vector<RingPtr>& out, uint64_t& version)
+{
+    if (likely(version_.load() == version)) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> _(mutex_);
+    out = rings_;
+    version = version_.load();
+    return true;
+}
+
+void SpscRingSet::retire()
+{
+    std::lock_guard<std::mutex> _(mutex_);
+
+    auto end = std::remove_if(rings_.begin(), rings_.end(), [this](const RingPtr& r) {
+        auto done = r->orphan.load() && r->ring.empty();
+        if (done) {
+            retiredDrop_ += r->dropped.load(std::memory_order_relaxed);
+        }
+        return done;
+    });
+
+    if (end != rings_.end()) {
+        rings_.erase(end, rings_.end());
+        version_++;
+    }
+}
+
+bool SpscRingSet::empty()
+{
+    std::lock_guard<std::mutex> _(mutex_);
+    for (const auto& r : rings_) {
+        if (!r->ring.empty()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint64_t SpscRingSet::dropped()
+{
+    std::lock_guard<std::mutex> _(mutex_);
+    auto count = retiredDrop_;
+    for (const auto& r : rings_) {
+        count += r->dropped.load(std::memory_order_relaxed);
+    }
+    return count;
+}
+
+CPPMHD_NAMESPACE_END
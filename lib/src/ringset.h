@@ -0,0 +1,76 @@
+#ifndef CPPMHD_INTERNAL_RINGSET_H_
+#define CPPMHD_INTERNAL_RINGSET_H_
+
+#include "config.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "core.h"
+#include "ring.h"
+
+CPPMHD_NAMESPACE_BEGIN
+
+// the per-thread rings of one consumer.
+//
+// every producing thread gets its own SpscRing on first use, so producers never contend with each other. the
+// consumer takes a snapshot of the ring list, which is only copied again when a thread joined or left.
+class SpscRingSet
+{
+  public:
+    struct Ring {
+        SpscRing ring;
+        // set when the producing thread exits, the consumer drops the ring once drained
+        std::atomic_bool orphan;
+        // set when the set is gone, the thread forgets the ring on its next lookup
+        std::atomic_bool closed;
+        // records the producer could not push
+        std::atomic<uint64_t> dropped;
+
+        explicit Ring(size_t size) : ring(size), orphan(false), closed(false), dropped(0) {}
+    };
+
+    using RingPtr = std::shared_ptr<Ring>;
+
+  private:
+    const size_t ringSize_;
+    const uint64_t serial_;
+
+    std::mutex mutex_;
+    std::vector<RingPtr> rings_;
+    std::atomic<uint64_t> version_;
+    // dropped count of the rings which are already removed
+    uint64_t retiredDrop_;
+
+    Ring* attach();
+
+    SpscRingSet(const SpscRingSet&) = delete;
+    SpscRingSet& operator=(const SpscRingSet&) = delete;
+
+  public:
+    explicit SpscRingSet(size_t ringSize);
+    ~SpscRingSet();
+
+    /// producer side
+
+    // the ring of the calling thread
+    Ring* local();
+
+    /// consumer side
+
+    // copy the ring list into `out' if it changed since `version'. returns true if copied.
+    bool snapshot(std::vector<RingPtr>& out, uint64_t& version);
+
+    // forget the rings of exited threads once they are drained
+    void retire();
+
+    bool empty();
+
+    uint64_t dropped();
+};
+
+CPPMHD_NAMESPACE_END
+
+#endif
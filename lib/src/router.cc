@@ -859,6 +859,8 @@ HttpController *Router::forward(HttpRequest *req, map<string, string> &params, b
 #undef TSR_CHECK
 }
 
+constexpr uint32_t RouteInfo::kNoRoute;
+
 bool Router::buildTree(const string &prefix, RouterBuilder &&builder)
 {
     RawBuilder raw;
@@ -876,6 +878,18 @@ bool Router::buildTree(const string &prefix, RouterBuilder &&builder)
 
         if (likely(raw.insert(prefix + path, method, sc))) {
             controllers.emplace_back(sc);
+
+            auto id = static_cast<uint32_t>(routes_.size());
+            routes_.push_back({id,
+                               method,
+                               prefix + path,
+                               sc.get(),
+                               sc->priority(),
+                               sc->maxBodySize(),
+                               sc->validatorTtl(),
+                               sc->cachePolicy(),
+                               sc->listeners()});
+            routeIndex_.emplace(sc.get(), id);
         } else {
             //            simples.erase(simple);
             success = false;
@@ -5,6 +5,8 @@
 
 #include <cppmhd/router.h>
 
+#include <unordered_map>
+
 #include "utils.h"
 
 #define NORMAL_URL_CHAR "[\\w\\.\\-_]"
@@ -22,6 +24,26 @@
 
 CPPMHD_NAMESPACE_BEGIN
 
+// a route as it was registered. ids are dense, from 0 in registration order
+struct RouteInfo {
+    static constexpr uint32_t kNoRoute = ~static_cast<uint32_t>(0);
+
+    uint32_t id;
+    HttpMethod method;
+    // full path including the sub-route prefix, eg: /user/{\d+:id}
+    std::string pattern;
+    const HttpController* controller;
+    RequestPriority priority;
+    // 0 for the limit of the App
+    uint64_t maxBodySize;
+    // seconds, 0 when the route does not cache validators
+    uint32_t validatorTtl;
+    // ttl 0 when the route is not cached
+    CachePolicy cache;
+    // names of the listeners serving it, empty for all
+    std::vector<std::string> listeners;
+};
+
 struct Handler {
     HttpController* controller;
     HttpControllerPtr ptr;
@@ -225,6 +247,9 @@ class Router
 
     std::vector<RouterTrees> trees_;
 
+    std::vector<RouteInfo> routes_;
+    std::unordered_map<const HttpController*, uint32_t> routeIndex_;
+
     bool buildTree(const std::string& prefix, RouterBuilder&&);
 
     RouterTrees& getMethodTree(HttpMethod mth);
@@ -239,6 +264,8 @@ class Router
         std::swap(trees_, other.trees_);
         std::swap(valid, other.valid);
         std::swap(controllers, other.controllers);
+        std::swap(routes_, other.routes_);
+        std::swap(routeIndex_, other.routeIndex_);
     }
 
     Router(RouterBuilder&& rb, const std::string prefix)
@@ -256,6 +283,28 @@ class Router
     }
 
     HttpController* forward(HttpRequest*, std::map<std::string, std::string>&, bool&) const;
+
+    // same as above, `route' is set to the matched route or nullptr
+    HttpController* forward(HttpRequest* req,
+                            std::map<std::string, std::string>& params,
+                            bool& tsr,
+                            const RouteInfo*& route) const
+    {
+        auto ctrl = forward(req, params, tsr);
+        route = ctrl == nullptr ? nullptr : routeOf(ctrl);
+        return ctrl;
+    }
+
+    const RouteInfo* routeOf(const HttpController* ctrl) const
+    {
+        auto f = routeIndex_.find(ctrl);
+        return f == routeIndex_.end() ? nullptr : &routes_[f->second];
+    }
+
+    const std::vector<RouteInfo>& routes() const
+    {
+        return routes_;
+    }
 };
 
 CPPMHD_NAMESPACE_END
@@ -0,0 +1,335 @@
+#include "sse.h"
+
+#include <cstring>
+
+#include "logger.h"
+
+CPPMHD_NAMESPACE_BEGIN
+
+namespace
+{
+// what one read of MHD asks for at most
+constexpr size_t kStreamBlock = 16 * 1024;
+
+// a comment, ignored by the clients
+const char kHeartbeat[] = ":\n\n";
+
+// a line break in event or id would start another field
+void appendField(std::string &out, const char *name, const std::string &value)
+{
+    out += name;
+    for (auto c : value) {
+        if (c != '\r' && c != '\n') {
+            out += c;
+        }
+    }
+    out += '\n';
+}
+}  // namespace
+
+std::string serializeEvent(const std::string &data, const std::string &event, const std::string &id)
+{
+    std::string out;
+    out.reserve(data.length() + event.length() + id.length() + 32);
+    if (id.length() != 0) {
+        appendField(out, "id: ", id);
+    }
+    if (event.length() != 0) {
+        appendField(out, "event: ", event);
+    }
+
+    // every line of data, \r\n and \r end one too
+    size_t begin = 0;
+    do {
+        auto end = data.find_first_of("\r\n", begin);
+        out += "data: ";
+        out.append(data, begin, end == std::string::npos ? std::string::npos : end - begin);
+        out += '\n';
+        if (end == std::string::npos) {
+            break;
+        }
+        begin = end + (data[end] == '\r' && end + 1 < data.length() && data[end + 1] == '\n' ? 2 : 1);
+    } while (true);
+
+    out += '\n';
+    return out;
+}
+
+SseStream::SseStream(MHD_Connection *conn, const SseHubPtr &hub, std::vector<std::string> &&topics)
+    : conn_(conn),
+      hub_(hub),
+      topics_(std::move(topics)),
+      streams_(nullptr),
+      offset_(0),
+      queued_(0),
+      suspended_(false),
+      evicted_(false),
+      ended_(false),
+      sent_(std::make_shared<uint64_t>(0))
+{
+}
+
+MHD_Response *SseStream::open(MHD_Connection *conn,
+                              const SseHubPtr &hub,
+                              std::vector<std::string> &&topics,
+                              SentCounter &sent,
+                              SseStreams *streams)
+{
+    auto stream = new SseStream(conn, hub, std::move(topics));
+    hub->subscribe(stream, stream->topics_);
+    if (streams != nullptr) {
+        stream->streams_ = streams;
+        streams->add(stream);
+    }
+
+    auto res = MHD_create_response_from_callback(MHD_SIZE_UNKNOWN, kStreamBlock, readCB, stream, freeCB);
+    if (res == nullptr) {
+        freeCB(stream);
+    } else {
+        sent = stream->sent_;
+    }
+    return res;
+}
+
+ssize_t SseStream::readCB(void *cls, MAYBE_UNUSED uint64_t pos, char *buf, size_t max)
+{
+    return reinterpret_cast<SseStream *>(cls)->read(buf, max);
+}
+
+void SseStream::freeCB(void *cls)
+{
+    // no event reaches it once it is unsubscribed
+    auto stream = reinterpret_cast<SseStream *>(cls);
+    stream->hub_->unsubscribe(stream, stream->topics_);
+    if (stream->streams_ != nullptr) {
+        stream->streams_->remove(stream);
+    }
+    delete stream;
+}
+
+SseStream::Push SseStream::push(const SseEvent &event)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (evicted_) {
+        return Push::DROPPED;
+    }
+
+    auto evict = queued_ + event->length() > hub_->options().maxQueued;
+    if (evict) {
+        evicted_ = true;
+        queue_.clear();
+        queued_ = 0;
+    } else {
+        queue_.push_back(event);
+        queued_ += event->length();
+    }
+
+    // an evicted stream is resumed to end
+    if (suspended_) {
+        suspended_ = false;
+        MHD_resume_connection(conn_);
+    }
+    return evict ? Push::EVICTED : Push::QUEUED;
+}
+
+void SseStream::end()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    ended_ = true;
+    if (suspended_) {
+        suspended_ = false;
+        MHD_resume_connection(conn_);
+    }
+}
+
+ssize_t SseStream::read(char *buf, size_t max)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (unlikely(evicted_)) {
+        return MHD_CONTENT_READER_END_WITH_ERROR;
+    }
+
+    if (queue_.empty()) {
+        if (unlikely(ended_)) {
+            return MHD_CONTENT_READER_END_OF_STREAM;
+        }
+        // the reader of MHD runs on the connection, which is suspended when it returns
+        if (conn_ != nullptr && !suspended_) {
+            MHD_suspend_connection(conn_);
+            suspended_ = true;
+        }
+        return 0;
+    }
+
+    size_t n = 0;
+    while (n < max && !queue_.empty()) {
+        auto &front = *queue_.front();
+        auto size = std::min(max - n, front.length() - offset_);
+        memcpy(buf + n, front.data() + offset_, size);
+        n += size;
+        offset_ += size;
+        if (offset_ == front.length()) {
+            queued_ -= front.length();
+            queue_.pop_front();
+            offset_ = 0;
+        }
+    }
+    *sent_ += n;
+    return static_cast<ssize_t>(n);
+}
+
+void SseStreams::add(SseStream *stream)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    streams_.insert(stream);
+    if (ended_) {
+        stream->end();
+    }
+}
+
+void SseStreams::remove(SseStream *stream)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    streams_.erase(stream);
+}
+
+void SseStreams::end()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    ended_ = true;
+    for (auto stream : streams_) {
+        stream->end();
+    }
+}
+
+SseHub::SseHub(const SseOptions &options) : options_(options), stopping_(false)
+{
+    evicted_ = 0;
+    if (options_.heartbeat != 0) {
+        heartbeat_ = std::thread(&SseHub::beat, this);
+    }
+}
+
+SseHub::~SseHub()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    if (heartbeat_.joinable()) {
+        heartbeat_.join();
+    }
+}
+
+void SseHub::beat()
+{
+    auto comment = std::make_shared<const std::string>(kHeartbeat);
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!cv_.wait_for(lock, std::chrono::seconds(options_.heartbeat), [this] { return stopping_; })) {
+        // writing to a client that went away ends its connection
+        for (auto stream : streams_) {
+            if (stream->push(comment) == SseStream::Push::EVICTED) {
+                evicted_++;
+            }
+        }
+    }
+}
+
+size_t SseHub::publish(const std::string &topic,
+                       const std::string &data,
+                       const std::string &event,
+                       const std::string &id)
+{
+    std::shared_ptr<Topic> t;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = topics_.find(topic);
+        if (it == topics_.end()) {
+            return 0;
+        }
+        t = it->second;
+    }
+
+    // serialized once, outside the locks
+    auto e = std::make_shared<const std::string>(serializeEvent(data, event, id));
+
+    size_t n = 0, evicted = 0;
+    {
+        std::lock_guard<std::mutex> lock(t->mutex);
+        for (auto stream : t->streams) {
+            switch (stream->push(e)) {
+                case SseStream::Push::QUEUED:
+                    n++;
+                    break;
+                case SseStream::Push::EVICTED:
+                    evicted++;
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+    if (evicted != 0) {
+        LOG_DEBUG("{}: {} slow subscribers evicted", topic, evicted);
+        evicted_ += evicted;
+    }
+    return n;
+}
+
+size_t SseHub::subscribers(const std::string &topic)
+{
+    std::shared_ptr<Topic> t;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = topics_.find(topic);
+        if (it == topics_.end()) {
+            return 0;
+        }
+        t = it->second;
+    }
+    std::lock_guard<std::mutex> lock(t->mutex);
+    return t->streams.size();
+}
+
+void SseHub::subscribe(SseStream *stream, const std::vector<std::string> &topics)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    streams_.insert(stream);
+    for (auto &topic : topics) {
+        auto &t = topics_[topic];
+        if (!t) {
+            t = std::make_shared<Topic>();
+        }
+        std::lock_guard<std::mutex> tl(t->mutex);
+        t->streams.insert(stream);
+    }
+}
+
+void SseHub::unsubscribe(SseStream *stream, const std::vector<std::string> &topics)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    streams_.erase(stream);
+    for (auto &topic : topics) {
+        auto it = topics_.find(topic);
+        if (it == topics_.end()) {
+            continue;
+        }
+        auto &t = *it->second;
+        std::unique_lock<std::mutex> tl(t.mutex);
+        t.streams.erase(stream);
+        // a publisher holding it finds it empty
+        if (t.streams.empty()) {
+            tl.unlock();
+            topics_.erase(it);
+        }
+    }
+}
+
+SseController::SseController(SseHubPtr hub) : hub_(std::move(hub)) {}
+
+void SseController::onConnection(HttpRequestPtr, HttpResponsePtr &) {}
+
+void SseController::onRequest(HttpRequestPtr, HttpResponsePtr &) {}
+
+CPPMHD_NAMESPACE_END
@@ -0,0 +1,120 @@
+#ifndef CPPMHD_INTERNAL_SSE_H_
+#define CPPMHD_INTERNAL_SSE_H_
+
+#include "config.h"
+
+#include <cppmhd/sse.h>
+
+#include <microhttpd.h>
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "core.h"
+#include "utils.h"
+
+CPPMHD_NAMESPACE_BEGIN
+
+// an event as it is written to every subscriber
+using SseEvent = std::shared_ptr<const std::string>;
+
+// the fields of one event and the empty line ending it
+std::string serializeEvent(const std::string &data, const std::string &event, const std::string &id);
+
+class SseStreams;
+
+// the body of the response of one subscriber. the connection is suspended while nothing is queued and resumed by
+// the next event
+class SseStream
+{
+    MHD_Connection *conn_;
+    // keeps the hub as long as the stream is subscribed
+    const SseHubPtr hub_;
+    const std::vector<std::string> topics_;
+    // of the daemon, nullptr for none
+    SseStreams *streams_;
+
+    std::mutex mutex_;
+    std::deque<SseEvent> queue_;
+    // written of the first event
+    size_t offset_;
+    // of the events queued
+    size_t queued_;
+    bool suspended_;
+    bool evicted_;
+    // the response ends once what is queued is written
+    bool ended_;
+    // written to the connection
+    SentCounter sent_;
+
+    static ssize_t readCB(void *cls, uint64_t pos, char *buf, size_t max);
+    static void freeCB(void *cls);
+
+  public:
+    enum class Push {
+        QUEUED,
+        // too much was queued, the connection ends
+        EVICTED,
+        // evicted before
+        DROPPED
+    };
+
+    // a stream without a connection is never suspended
+    SseStream(MHD_Connection *conn, const SseHubPtr &hub, std::vector<std::string> &&topics);
+
+    // the response of a new subscriber, nullptr if it can not be created. sent counts the bytes written to it. the
+    // stream is one of streams until its connection ends
+    static MHD_Response *open(MHD_Connection *conn,
+                              const SseHubPtr &hub,
+                              std::vector<std::string> &&topics,
+                              SentCounter &sent,
+                              SseStreams *streams);
+
+    Push push(const SseEvent &event);
+
+    // resumes the connection, the response ends after what is queued instead of waiting for the next event
+    void end();
+
+    // up to max bytes of what is queued, 0 for nothing yet, MHD_CONTENT_READER_END_WITH_ERROR once evicted and
+    // MHD_CONTENT_READER_END_OF_STREAM once ended
+    ssize_t read(char *buf, size_t max);
+
+    size_t queued()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return queued_;
+    }
+};
+
+// the streams of the connections of an App. MHD_stop_daemon must not find a connection suspended, an idle subscriber
+// is, so they are ended before
+class SseStreams
+{
+    std::mutex mutex_;
+    std::unordered_set<SseStream *> streams_;
+    bool ended_;
+
+  public:
+    SseStreams() : ended_(false) {}
+
+    // a stream added once they are ended ends at once
+    void add(SseStream *stream);
+    void remove(SseStream *stream);
+
+    // ends every stream, see SseStream::end
+    void end();
+
+    size_t size()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return streams_.size();
+    }
+};
+
+CPPMHD_NAMESPACE_END
+
+#endif
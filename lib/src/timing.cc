@@ -0,0 +1,13 @@
+#include "timing.h"
+
+CPPMHD_NAMESPACE_BEGIN
+
+const TimingSpan timingSpans[kTimingSpanCount] = {{"dispatch", RequestPhase::BEGIN, RequestPhase::ROUTED},
+                                                  {"connection", RequestPhase::ROUTED, RequestPhase::CONNECTION},
+                                                  {"body", RequestPhase::BODY_BEGIN, RequestPhase::BODY_END},
+                                                  {"handler", RequestPhase::HANDLER, RequestPhase::HANDLED},
+                                                  {"send", RequestPhase::QUEUED, RequestPhase::COMPLETED}};
+
+RequestObserver::~RequestObserver() {}
+
+CPPMHD_NAMESPACE_END
@@ -0,0 +1,63 @@
+#ifndef CPPMHD_INTERNAL_TIMING_H_
+#define CPPMHD_INTERNAL_TIMING_H_
+
+#include "config.h"
+
+#include <cppmhd/observer.h>
+
+#include <chrono>
+#include <ctime>
+
+#include "core.h"
+
+CPPMHD_NAMESPACE_BEGIN
+
+inline uint64_t monotonicNanos()
+{
+#ifdef ON_UNIX
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+#else
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+#endif
+}
+
+// the durations reported to the metrics and the access log
+struct TimingSpan {
+    const char* name;
+    RequestPhase from;
+    RequestPhase to;
+};
+
+constexpr size_t kTimingSpanCount = 5;
+
+extern const TimingSpan timingSpans[kTimingSpanCount];
+
+// every span in microseconds, 0 for the spans the request did not pass
+inline void spanMicros(const RequestTiming& timing, uint32_t out[kTimingSpanCount])
+{
+    for (auto i = 0u; i < kTimingSpanCount; i++) {
+        out[i] = static_cast<uint32_t>(timing.between(timingSpans[i].from, timingSpans[i].to) / 1000);
+    }
+}
+
+#ifdef ENABLE_REQUEST_TIMING
+#define TIMING_MARK(co, phase) ((co)->timing.at[static_cast<size_t>(RequestPhase::phase)] = monotonicNanos())
+#define TIMING_MARK_ONCE(co, phase)                                          \
+    do {                                                                     \
+        auto& at = (co)->timing.at[static_cast<size_t>(RequestPhase::phase)]; \
+        if (at == 0) {                                                       \
+            at = monotonicNanos();                                           \
+        }                                                                    \
+    } while (false)
+#else
+#define TIMING_MARK(co, phase) ((void)0)
+#define TIMING_MARK_ONCE(co, phase) ((void)0)
+#endif
+
+CPPMHD_NAMESPACE_END
+
+#endif
@@ -0,0 +1,190 @@
+#include "tls.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include "logger.h"
+
+CPPMHD_NAMESPACE_BEGIN
+
+namespace
+{
+bool readFile(const std::string &path, std::string &out)
+{
+    auto file = fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        LOG_ERROR("open {} failed: {}", path, strerror(errno));
+        return false;
+    }
+    char buf[4096];
+    size_t n;
+    out.clear();
+    while ((n = fread(buf, 1, sizeof(buf), file)) > 0) {
+        out.append(buf, n);
+    }
+    auto ok = ferror(file) == 0;
+    fclose(file);
+    if (!ok) {
+        LOG_ERROR("read {} failed", path);
+    }
+    return ok;
+}
+
+#ifdef ENABLE_GNUTLS
+gnutls_datum_t datum(const std::string &s)
+{
+    return gnutls_datum_t{reinterpret_cast<unsigned char *>(const_cast<char *>(s.data())),
+                          static_cast<unsigned int>(s.length())};
+}
+#endif
+}  // namespace
+
+TlsContext::TlsContext(const TlsOptions &options) : options_(options)
+{
+#ifdef ENABLE_GNUTLS
+    credentials_ = nullptr;
+    ticketKey_ = gnutls_datum_t{nullptr, 0};
+#endif
+}
+
+TlsContext::~TlsContext()
+{
+    clear();
+}
+
+void TlsContext::clear()
+{
+    cert_.clear();
+    key_.clear();
+#ifdef ENABLE_GNUTLS
+    if (credentials_ != nullptr) {
+        gnutls_certificate_free_credentials(credentials_);
+        credentials_ = nullptr;
+    }
+    if (ticketKey_.data != nullptr) {
+        gnutls_memset(ticketKey_.data, 0, ticketKey_.size);
+        gnutls_free(ticketKey_.data);
+        ticketKey_ = gnutls_datum_t{nullptr, 0};
+    }
+    alpn_.clear();
+#endif
+}
+
+bool TlsContext::load()
+{
+    clear();
+    if (options_.certificates.empty()) {
+        return false;
+    }
+
+#ifdef ENABLE_GNUTLS
+    if (gnutls_certificate_allocate_credentials(&credentials_) != GNUTLS_E_SUCCESS) {
+        LOG_ERROR("{}", "allocate TLS credentials failed");
+        credentials_ = nullptr;
+        return false;
+    }
+    if (options_.sessionTickets && gnutls_session_ticket_key_generate(&ticketKey_) != GNUTLS_E_SUCCESS) {
+        LOG_ERROR("{}", "generate the session ticket key failed");
+        return false;
+    }
+    for (auto &protocol : options_.alpn) {
+        alpn_.push_back(datum(protocol));
+    }
+#else
+    if (options_.certificates.size() > 1) {
+        LOG_WARN("{} certificates but cppmhd is built without GnuTLS, only the first one is used",
+                 options_.certificates.size());
+    }
+#endif
+
+    for (size_t i = 0; i < options_.certificates.size(); i++) {
+        auto &c = options_.certificates[i];
+        std::string cert = c.cert;
+        std::string key = c.key;
+        if ((cert.length() == 0 && !readFile(c.certFile, cert)) || (key.length() == 0 && !readFile(c.keyFile, key))) {
+            return false;
+        }
+        if (i == 0) {
+            cert_ = cert;
+            key_ = key;
+        }
+
+#ifdef ENABLE_GNUTLS
+        auto certData = datum(cert);
+        auto keyData = datum(key);
+        auto rc = gnutls_certificate_set_x509_key_mem2(credentials_,
+                                                       &certData,
+                                                       &keyData,
+                                                       GNUTLS_X509_FMT_PEM,
+                                                       c.password.length() != 0 ? c.password.c_str() : nullptr,
+                                                       0);
+        if (rc < 0) {
+            LOG_ERROR("certificate #{} {}: {}", i, c.certFile, gnutls_strerror(rc));
+            return false;
+        }
+#endif
+    }
+    return true;
+}
+
+void TlsContext::prepare(MAYBE_UNUSED MHD_Connection *conn) const
+{
+#ifdef ENABLE_GNUTLS
+    auto info = MHD_get_connection_info(conn, MHD_CONNECTION_INFO_GNUTLS_SESSION);
+    if (info != nullptr && info->tls_session != nullptr) {
+        prepare(static_cast<gnutls_session_t>(info->tls_session));
+    }
+#endif
+}
+
+#ifdef ENABLE_GNUTLS
+bool TlsContext::prepare(gnutls_session_t session) const
+{
+    // the one of libmicrohttpd has the first certificate only
+    auto rc = gnutls_credentials_set(session, GNUTLS_CRD_CERTIFICATE, credentials_);
+    if (rc >= 0 && options_.sessionTickets) {
+        rc = gnutls_session_ticket_enable_server(session, &ticketKey_);
+    }
+    if (rc >= 0 && !alpn_.empty()) {
+        rc = gnutls_alpn_set_protocols(
+            session, alpn_.data(), static_cast<unsigned>(alpn_.size()), GNUTLS_ALPN_SERVER_PRECEDENCE);
+    }
+    if (rc < 0) {
+        LOG_WARN("TLS session setup failed: {}", gnutls_strerror(rc));
+        return false;
+    }
+    return true;
+}
+#endif
+
+bool tlsInfo(MHD_Connection *conn, MAYBE_UNUSED TlsInfo &info)
+{
+    auto session = conn == nullptr ? nullptr : MHD_get_connection_info(conn, MHD_CONNECTION_INFO_GNUTLS_SESSION);
+    if (session == nullptr || session->tls_session == nullptr) {
+        return false;
+    }
+
+#ifdef ENABLE_GNUTLS
+    auto s = static_cast<gnutls_session_t>(session->tls_session);
+    auto protocol = gnutls_protocol_get_name(gnutls_protocol_get_version(s));
+    info.protocol = protocol != nullptr ? protocol : "";
+
+    gnutls_datum_t alpn;
+    if (gnutls_alpn_get_selected_protocol(s, &alpn) == GNUTLS_E_SUCCESS) {
+        info.alpn.assign(reinterpret_cast<const char *>(alpn.data), alpn.size);
+    }
+
+    char name[256];
+    size_t size = sizeof(name);
+    unsigned int type;
+    if (gnutls_server_name_get(s, name, &size, &type, 0) == GNUTLS_E_SUCCESS && type == GNUTLS_NAME_DNS) {
+        info.serverName.assign(name, strnlen(name, size));
+    }
+
+    info.resumed = gnutls_session_is_resumed(s) != 0;
+#endif
+    return true;
+}
+
+CPPMHD_NAMESPACE_END
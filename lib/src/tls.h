@@ -0,0 +1,86 @@
+#ifndef CPPMHD_INTERNAL_TLS_H_
+#define CPPMHD_INTERNAL_TLS_H_
+
+#include "config.h"
+
+#include <cppmhd/app.h>
+#include <cppmhd/entity.h>
+
+#include <microhttpd.h>
+
+#ifdef ENABLE_GNUTLS
+#include <gnutls/gnutls.h>
+#endif
+
+#include <string>
+#include <vector>
+
+#include "core.h"
+
+CPPMHD_NAMESPACE_BEGIN
+
+// the certificates of TlsOptions, loaded when the App starts and shared by its daemons. libmicrohttpd is configured
+// with the first one, the sessions get all of them before their handshake
+class TlsContext
+{
+    const TlsOptions options_;
+
+    // PEM of the first certificate
+    std::string cert_;
+    std::string key_;
+
+#ifdef ENABLE_GNUTLS
+    // every certificate, GnuTLS picks the one issued for the server name
+    gnutls_certificate_credentials_t credentials_;
+    gnutls_datum_t ticketKey_;
+    std::vector<gnutls_datum_t> alpn_;
+#endif
+
+    // what a load left, the ticket key wiped
+    void clear();
+
+  public:
+    explicit TlsContext(const TlsOptions &options);
+    ~TlsContext();
+
+    TlsContext(const TlsContext &) = delete;
+
+    // reads the certificates and their keys, in place of the ones of an earlier load. false if one can not be used
+    bool load();
+
+    const std::string &cert() const
+    {
+        return cert_;
+    }
+
+    const std::string &key() const
+    {
+        return key_;
+    }
+
+    // of the key of the first certificate
+    const std::string &password() const
+    {
+        return options_.certificates.front().password;
+    }
+
+    const std::string &priorities() const
+    {
+        return options_.priorities;
+    }
+
+    // a connection accepted by a daemon, on its thread before the handshake: the certificates, session tickets and ALPN
+    // of its session. nothing without GnuTLS
+    void prepare(MHD_Connection *conn) const;
+
+#ifdef ENABLE_GNUTLS
+    bool prepare(gnutls_session_t session) const;
+#endif
+};
+
+// the TLS session of conn, false if it is in clear text
+bool tlsInfo(MHD_Connection *conn, TlsInfo &info);
+
+CPPMHD_NAMESPACE_END
+
+#endif
@@ -0,0 +1,486 @@
+#include "upload.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include "form.h"
+#include "logger.h"
+#include "utils.h"
+
+CPPMHD_NAMESPACE_BEGIN
+
+constexpr size_t UploadBuffer::kAlign;
+
+namespace
+{
+bool isTemplate(const std::string &path)
+{
+    static const char kSuffix[] = "XXXXXX";
+    return path.length() >= sizeof(kSuffix) - 1
+           && path.compare(path.length() - (sizeof(kSuffix) - 1), std::string::npos, kSuffix) == 0;
+}
+
+void setDirect(int fd, bool on)
+{
+#ifdef O_DIRECT
+    auto flags = ::fcntl(fd, F_GETFL);
+    if (flags >= 0) {
+        ::fcntl(fd, F_SETFL, on ? flags | O_DIRECT : flags & ~O_DIRECT);
+    }
+#else
+    (void)fd;
+    (void)on;
+#endif
+}
+
+class UploadProcessor : public DataProcessor, public FormSink
+{
+    UploadController *ctrl_;
+    std::shared_ptr<UploadWriter> writer_;
+    std::unique_ptr<FormParser> parser_;
+    // the request of the onData being parsed
+    HttpRequestPtr *current_;
+
+    UploadResult result_;
+    // the files of result_.files, nullptr for those which could not be created. the part being received goes to the
+    // last of them while file_ is set, or to value_, or is dropped
+    std::vector<std::unique_ptr<UploadFile>> files_;
+    UploadFile *file_;
+    // the file written to last, the I/O thread is done with the others of the request once it is done with this one
+    UploadFile *last_;
+    std::string *value_;
+
+    // the files this request created, removed if it never completes
+    std::vector<std::string> created_;
+    bool started_;
+    bool finished_;
+
+    // the tail of the part is queued, the file is closed by finish()
+    void endPart()
+    {
+        if (file_ != nullptr) {
+            writer_->flush(*file_);
+            file_ = nullptr;
+        }
+    }
+
+    void openPart(HttpRequestPtr &req, const std::string &field, const std::string &fileName, const char *type)
+    {
+        endPart();
+        value_ = nullptr;
+
+        if (parser_ && fileName.length() == 0) {
+            value_ = &result_.fields[field];
+            return;
+        }
+
+        auto path = ctrl_->uploadPath(req, field, fileName);
+        if (path.length() == 0) {
+            return;
+        }
+
+        UploadedFile f = {field, fileName, type != nullptr ? type : "", path, 0, 0};
+        files_.push_back(writer_->open(path, f.error));
+        file_ = files_.back().get();
+        if (file_ != nullptr) {
+            f.path = file_->path();
+            created_.push_back(f.path);
+            last_ = file_;
+        }
+        result_.files.push_back(std::move(f));
+    }
+
+    void append(const char *data, size_t size)
+    {
+        if (value_ != nullptr) {
+            value_->append(data, size);
+        } else if (file_ != nullptr) {
+            // a failed write is reported when the file is closed, the rest of the part is dropped
+            writer_->write(*file_, data, size);
+        }
+    }
+
+  public:
+    UploadProcessor(UploadController *ctrl, std::shared_ptr<UploadWriter> writer, const char *contentType)
+        : ctrl_(ctrl),
+          writer_(std::move(writer)),
+          current_(nullptr),
+          file_(nullptr),
+          last_(nullptr),
+          value_(nullptr),
+          started_(false),
+          finished_(false)
+    {
+        if (isPrefixOfArray(contentType, CPPMHD_HTTP_MIME_MULTIPART_FORM_DATA)) {
+            parser_ = FormParser::create(contentType, *this, 0);
+        }
+        result_.complete = !parser_;
+    }
+
+    virtual ~UploadProcessor()
+    {
+        // an aborted request leaves its writes to the I/O thread
+        for (auto &file : files_) {
+            if (file) {
+                writer_->discard(std::move(file));
+            }
+        }
+        if (!finished_) {
+            for (auto &path : created_) {
+                LOG_DEBUG("upload: removing {} of an incomplete request", path);
+                ::unlink(path.c_str());
+            }
+        }
+    }
+
+    const UploadResult &result() const
+    {
+        return result_;
+    }
+
+    // the writes are done, onData paused the request until they were
+    void finish()
+    {
+        endPart();
+        for (size_t i = 0; i < files_.size(); i++) {
+            if (files_[i]) {
+                auto &f = result_.files[i];
+                auto error = writer_->close(*files_[i]);
+                if (f.error == 0) {
+                    f.error = error;
+                }
+                f.size = files_[i]->size();
+                files_[i].reset();
+            }
+        }
+        finished_ = true;
+    }
+
+    virtual size_t onData(HttpRequestPtr &req, const void *data, size_t size) override
+    {
+        current_ = &req;
+
+        if (unlikely(size == 0)) {
+            if (parser_) {
+                result_.complete = parser_->finish();
+            }
+            endPart();
+            // onRequest runs once the files are written, the queue is drained in order. it would wait for the disk on
+            // the daemon thread when the request can not be paused any more, as the daemons stop
+            if (last_ != nullptr && !writer_->pause(*last_, *req, 0)) {
+                return DataProcessor::DataProcessorParseFailed;
+            }
+            return 0;
+        }
+
+        if (parser_) {
+            if (unlikely(!parser_->parse(reinterpret_cast<const char *>(data), size))) {
+                return DataProcessor::DataProcessorParseFailed;
+            }
+        } else {
+            if (!started_) {
+                started_ = true;
+                openPart(req, "", "", req->getHeader(KnownHeader::CONTENT_TYPE));
+            }
+            append(reinterpret_cast<const char *>(data), size);
+        }
+
+        // the backpressure of a disk slower than the network
+        if (last_ != nullptr && !writer_->pauseIfFull(*last_, *req)) {
+            return DataProcessor::DataProcessorParseFailed;
+        }
+        return size;
+    }
+
+    virtual bool onField(const FormField &f, const char *data, uint64_t offset, size_t size) override
+    {
+        if (offset == 0) {
+            openPart(*current_, f.name, f.fileName, f.contentType.c_str());
+        }
+        append(data, size);
+        return true;
+    }
+};
+
+}  // namespace
+
+UploadBuffer::UploadBuffer(size_t size) : storage(new char[size + kAlign])
+{
+    auto p = reinterpret_cast<uintptr_t>(storage.get());
+    data = reinterpret_cast<char *>((p + kAlign - 1) & ~static_cast<uintptr_t>(kAlign - 1));
+}
+
+UploadFile::UploadFile(int fd, bool direct, const std::string &path)
+    : fd_(fd),
+      direct_(direct),
+      path_(path),
+      size_(0),
+      used_(0),
+      error_(0),
+      queued_(0),
+      waiter_(nullptr),
+      resumeAt_(0),
+      discarded_(false)
+{
+}
+
+UploadFile::~UploadFile()
+{
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+UploadWriter::UploadWriter(const UploadOptions &options)
+    : options_(options),
+      chunkSize_((std::max<size_t>(options.chunkSize, 1) + UploadBuffer::kAlign - 1) & ~(UploadBuffer::kAlign - 1)),
+      maxPending_(std::max<size_t>(options.maxPending, 1)),
+      running_(true)
+{
+    thread_ = std::thread(&UploadWriter::run, this);
+}
+
+UploadWriter::~UploadWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+    }
+    work_.notify_one();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+std::unique_ptr<UploadFile> UploadWriter::open(const std::string &path, int &error)
+{
+    auto name = path;
+    int fd;
+    if (isTemplate(name)) {
+        fd = ::mkstemp(&name[0]);
+        if (fd >= 0) {
+            ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+        }
+    } else {
+        fd = ::open(name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    }
+
+    if (fd < 0) {
+        error = errno;
+        LOG_ERROR("upload: can not create {}: {}", path, strerror(error));
+        return nullptr;
+    }
+
+    bool direct = false;
+#ifdef O_DIRECT
+    if (options_.direct) {
+        setDirect(fd, true);
+        direct = (::fcntl(fd, F_GETFL) & O_DIRECT) != 0;
+        if (!direct) {
+            LOG_DEBUG("upload: {} does not take O_DIRECT", name);
+        }
+    }
+#endif
+
+    error = 0;
+    return std::unique_ptr<UploadFile>(new UploadFile(fd, direct, name));
+}
+
+bool UploadWriter::write(UploadFile &file, const char *data, size_t size)
+{
+    file.size_ += size;
+
+    while (size > 0) {
+        if (file.current_.data == nullptr) {
+            // never waits, the processor pauses the request once maxPending_ buffers are queued
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (file.error_ != 0) {
+                return false;
+            }
+            if (file.free_.size() != 0) {
+                file.current_ = std::move(file.free_.back());
+                file.free_.pop_back();
+            } else {
+                lock.unlock();
+                file.current_ = UploadBuffer(chunkSize_);
+            }
+        }
+
+        auto n = std::min(size, chunkSize_ - file.used_);
+        memcpy(file.current_.data + file.used_, data, n);
+        file.used_ += n;
+        data += n;
+        size -= n;
+
+        if (file.used_ == chunkSize_ && !submit(file, false)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool UploadWriter::submit(UploadFile &file, bool last)
+{
+    bool ok;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ok = file.error_ == 0;
+        if (ok) {
+            queue_.push_back(Job{&file, std::move(file.current_), file.used_, last});
+            file.queued_++;
+        } else {
+            file.free_.push_back(std::move(file.current_));
+        }
+    }
+    file.current_ = UploadBuffer();
+    file.used_ = 0;
+    work_.notify_one();
+    return ok;
+}
+
+void UploadWriter::flush(UploadFile &file)
+{
+    if (file.used_ != 0) {
+        submit(file, true);
+    }
+}
+
+bool UploadWriter::pause(UploadFile &file, HttpRequest &req, size_t pending)
+{
+    // under the mutex, the I/O thread can not resume req before it is paused
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (file.queued_ <= pending) {
+        return true;
+    }
+    if (!req.pause()) {
+        return false;
+    }
+    file.waiter_ = &req;
+    file.resumeAt_ = pending;
+    return true;
+}
+
+void UploadWriter::discard(std::unique_ptr<UploadFile> file)
+{
+    flush(*file);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    file->waiter_ = nullptr;
+    if (file->queued_ != 0) {
+        file->discarded_ = true;
+        file.release();
+    }
+}
+
+int UploadWriter::close(UploadFile &file)
+{
+    flush(file);
+
+    int error;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [&]() { return file.queued_ == 0; });
+        error = file.error_;
+    }
+
+    if (file.fd_ >= 0 && ::close(file.fd_) != 0 && error == 0) {
+        error = errno;
+    }
+    file.fd_ = -1;
+    return error;
+}
+
+int UploadWriter::writeJob(UploadFile &file, const Job &job)
+{
+    // O_DIRECT takes whole blocks only, the tail of the file is written through the page cache
+    if (job.last && file.direct_ && job.length % UploadBuffer::kAlign != 0) {
+        setDirect(file.fd_, false);
+        file.direct_ = false;
+    }
+
+    auto p = job.buffer.data;
+    auto left = job.length;
+    while (left > 0) {
+        auto w = ::write(file.fd_, p, left);
+        if (w < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno;
+        }
+        p += w;
+        left -= static_cast<size_t>(w);
+    }
+    return 0;
+}
+
+void UploadWriter::run()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        work_.wait(lock, [this]() { return queue_.size() != 0 || !running_; });
+        if (queue_.size() == 0) {
+            break;
+        }
+
+        auto job = std::move(queue_.front());
+        queue_.pop_front();
+        auto &file = *job.file;
+        auto skip = file.error_ != 0;
+
+        lock.unlock();
+        auto error = skip ? 0 : writeJob(file, job);
+        if (error != 0) {
+            LOG_ERROR("upload: write to {} failed: {}", file.path_, strerror(error));
+        }
+        lock.lock();
+
+        if (file.error_ == 0) {
+            file.error_ = error;
+        }
+        file.free_.push_back(std::move(job.buffer));
+        file.queued_--;
+        if (file.waiter_ != nullptr && file.queued_ <= file.resumeAt_) {
+            file.waiter_->resume();
+            file.waiter_ = nullptr;
+        }
+        if (file.discarded_ && file.queued_ == 0) {
+            delete &file;
+        }
+        done_.notify_all();
+    }
+}
+
+UploadController::UploadController(const UploadOptions &options)
+    : options_(options), writer_(std::make_shared<UploadWriter>(options))
+{
+}
+
+void UploadController::onConnection(HttpRequestPtr req, HttpResponsePtr &)
+{
+    auto ct = req->getHeader(KnownHeader::CONTENT_TYPE);
+    req->setProcessor(std::make_shared<UploadProcessor>(this, writer_, ct));
+}
+
+std::string UploadController::uploadPath(HttpRequestPtr, const std::string &, const std::string &)
+{
+    // never a name the client chose
+    return options_.directory + "/upload-XXXXXX";
+}
+
+void UploadController::onRequest(HttpRequestPtr req, HttpResponsePtr &resp)
+{
+    auto p = static_cast<UploadProcessor *>(req->processor().get());
+    p->finish();
+    onRequest(req, p->result(), resp);
+}
+
+UploadController::~UploadController() {}
+
+CPPMHD_NAMESPACE_END
@@ -0,0 +1,135 @@
+#ifndef CPPMHD_INTERNAL_UPLOAD_H_
+#define CPPMHD_INTERNAL_UPLOAD_H_
+
+#include "config.h"
+
+#include <cppmhd/controller.h>
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "core.h"
+
+CPPMHD_NAMESPACE_BEGIN
+
+// a buffer aligned for O_DIRECT
+struct UploadBuffer {
+    static constexpr size_t kAlign = 4096;
+
+    std::unique_ptr<char[]> storage;
+    char *data;
+
+    UploadBuffer() : data(nullptr) {}
+    explicit UploadBuffer(size_t size);
+};
+
+class UploadFile
+{
+    friend class UploadWriter;
+
+    int fd_;
+    bool direct_;
+    std::string path_;
+    uint64_t size_;
+
+    // the buffer being filled by the daemon thread
+    UploadBuffer current_;
+    size_t used_;
+
+    // shared with the I/O thread, under the mutex of the writer
+    int error_;
+    size_t queued_;
+    std::vector<UploadBuffer> free_;
+    // paused until no more than resumeAt_ buffers are queued
+    HttpRequest *waiter_;
+    size_t resumeAt_;
+    // deleted by the I/O thread after its last write
+    bool discarded_;
+
+  public:
+    UploadFile(int fd, bool direct, const std::string &path);
+    ~UploadFile();
+
+    const std::string &path() const
+    {
+        return path_;
+    }
+
+    uint64_t size() const
+    {
+        return size_;
+    }
+};
+
+// the write-behind queue of one UploadController, drained in order by one I/O thread. the daemon thread never waits
+// for the disk: a request whose file falls behind is paused and resumed by the I/O thread
+class UploadWriter
+{
+    struct Job {
+        UploadFile *file;
+        UploadBuffer buffer;
+        size_t length;
+        bool last;
+    };
+
+    const UploadOptions options_;
+    const size_t chunkSize_;
+    const size_t maxPending_;
+
+    std::mutex mutex_;
+    std::condition_variable work_;
+    std::condition_variable done_;
+    std::deque<Job> queue_;
+    bool running_;
+
+    std::thread thread_;
+
+    void run();
+
+    // errno, or 0
+    int writeJob(UploadFile &file, const Job &job);
+
+    // queues the current buffer of file. false if a write of the file failed already
+    bool submit(UploadFile &file, bool last);
+
+  public:
+    explicit UploadWriter(const UploadOptions &options);
+
+    // writes what is queued, then stops the I/O thread
+    ~UploadWriter();
+
+    // nullptr with error set if the file can not be created. a path ending in XXXXXX is made unique
+    std::unique_ptr<UploadFile> open(const std::string &path, int &error);
+
+    // copies data into the buffers of file, full ones are queued. false once a write failed
+    bool write(UploadFile &file, const char *data, size_t size);
+
+    // queues what is left in the buffer of file as its last write
+    void flush(UploadFile &file);
+
+    // pauses req until no more than `pending' buffers of file are queued, the I/O thread resumes it. false if there are
+    // more and req can not be paused, as once the daemons stop. only from DataProcessor::onData
+    bool pause(UploadFile &file, HttpRequest &req, size_t pending);
+
+    // pauses req while options.maxPending buffers of file are queued
+    bool pauseIfFull(UploadFile &file, HttpRequest &req)
+    {
+        return pause(file, req, maxPending_ - 1);
+    }
+
+    // closes the file after its queued writes, which are waited for unless a pause did already. errno of the first
+    // failed write, or 0
+    int close(UploadFile &file);
+
+    // closes and deletes the file after its queued writes, on the I/O thread if there are any left
+    void discard(std::unique_ptr<UploadFile> file);
+};
+
+CPPMHD_NAMESPACE_END
+
+#endif
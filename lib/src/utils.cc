@@ -173,6 +173,8 @@ const char* dispatchErrorCode(HttpStatusCode sc)
             return "I'm a teapot";
         case k421MisDirectedRequest:
             return "Misdirected Request";
+        case k426UpgradeRequired:
+            return "Upgrade Required";
         case k429TooManyRequests:
             return "Too Many Requests";
 
@@ -235,6 +237,70 @@ void split(const std::string& in, std::vector<std::string>& out, const std::stri
     } while (true);
 }
 
+bool containsNoCase(const std::string& value, const char* name)
+{
+    auto length = strlen(name);
+    for (size_t i = 0; i + length <= value.length(); i++) {
+        if (strncasecmp(value.c_str() + i, name, length) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool validUtf8(const char* data, size_t size)
+{
+    auto p = reinterpret_cast<const uint8_t*>(data);
+    size_t i = 0;
+    while (i < size) {
+        if (i + 8 <= size) {
+            uint64_t v;
+            memcpy(&v, p + i, sizeof(v));
+            if ((v & 0x8080808080808080ULL) == 0) {
+                i += 8;
+                continue;
+            }
+        }
+
+        auto c = p[i];
+        if (c < 0x80) {
+            i++;
+            continue;
+        }
+
+        size_t length;
+        uint32_t cp;
+        if ((c & 0xE0) == 0xC0) {
+            length = 2;
+            cp = c & 0x1F;
+        } else if ((c & 0xF0) == 0xE0) {
+            length = 3;
+            cp = c & 0x0F;
+        } else if ((c & 0xF8) == 0xF0) {
+            length = 4;
+            cp = c & 0x07;
+        } else {
+            return false;
+        }
+        if (i + length > size) {
+            return false;
+        }
+        for (size_t k = 1; k < length; k++) {
+            if ((p[i + k] & 0xC0) != 0x80) {
+                return false;
+            }
+            cp = cp << 6 | (p[i + k] & 0x3F);
+        }
+        // overlong, surrogates and past U+10FFFF
+        if ((length == 2 && cp < 0x80) || (length == 3 && cp < 0x800) || (length == 4 && cp < 0x10000)
+            || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) {
+            return false;
+        }
+        i += length;
+    }
+    return true;
+}
+
 /// regex
 
 #ifdef ENABLE_PCRE2_8
@@ -254,7 +320,10 @@ bool Regex::compileRegex(Regex& re, const char* pattern)
     if (unlikely(ptr == nullptr)) {
         PCRE2_UCHAR buffer[256];
         pcre2_get_error_message(error, buffer, sizeof(buffer));
-        LOG_ERROR("compile regex pattern '{}' failed at offset {}: '{}'", pattern, offset, buffer);
+        LOG_ERROR("compile regex pattern '{}' failed at offset {}: '{}'",
+                  pattern,
+                  offset,
+                  reinterpret_cast<const char*>(buffer));
     } else {
         auto pl = std::char_traits<char>::length(pattern);
         auto pt = new char[pl + 1];
@@ -18,6 +18,7 @@
 #include <condition_variable>
 #include <cstring>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <vector>
@@ -44,8 +45,18 @@ inline void *dumpMemory(const void *data, size_t size)
 
 void split(const std::string &in, std::vector<std::string> &out, const std::string &sep);
 
+// name occurs in value, ignoring the case
+bool containsNoCase(const std::string &value, const char *name);
+
+// well-formed UTF-8: no overlong, surrogate or truncated sequence, nothing past U+10FFFF
+bool validUtf8(const char *data, size_t size);
+
 const char *dispatchErrorCode(HttpStatusCode sc);
 
+// the body bytes a response of unknown length handed to MHD so far, shared by its reader and the request it answers.
+// both run on the thread of the connection
+using SentCounter = std::shared_ptr<uint64_t>;
+
 uint32_t getNProc();
 
 typedef void (*signalHandler)(int);
@@ -0,0 +1,263 @@
+#include "validator.h"
+
+#include <fmt/format.h>
+
+#include <cstring>
+
+CPPMHD_NAMESPACE_BEGIN
+
+namespace
+{
+constexpr uint64_t kPrime1 = 11400714785074694791ULL;
+constexpr uint64_t kPrime2 = 14029467366897019727ULL;
+constexpr uint64_t kPrime3 = 1609587929392839161ULL;
+constexpr uint64_t kPrime4 = 9650029242287828579ULL;
+constexpr uint64_t kPrime5 = 2870177450012600261ULL;
+
+inline uint64_t rotl(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+// little endian, as the reference
+inline uint64_t read64(const uint8_t *p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+inline uint32_t read32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap32(v);
+#endif
+    return v;
+}
+
+inline uint64_t xxRound(uint64_t acc, uint64_t input)
+{
+    acc += input * kPrime2;
+    return rotl(acc, 31) * kPrime1;
+}
+
+inline uint64_t merge(uint64_t acc, uint64_t v)
+{
+    acc ^= xxRound(0, v);
+    return acc * kPrime1 + kPrime4;
+}
+
+const char *skipSpaces(const char *p)
+{
+    while (*p == ' ' || *p == '\t' || *p == ',') {
+        p++;
+    }
+    return p;
+}
+
+// days since 1970-01-01 of a date of the proleptic Gregorian calendar
+int64_t daysFromCivil(int64_t y, unsigned m, unsigned d)
+{
+    y -= m <= 2;
+    auto era = (y >= 0 ? y : y - 399) / 400;
+    auto yoe = static_cast<unsigned>(y - era * 400);
+    auto doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    auto doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<int64_t>(doe) - 719468;
+}
+
+bool number(const char *p, int digits, int &value)
+{
+    value = 0;
+    for (int i = 0; i < digits; i++) {
+        if (p[i] < '0' || p[i] > '9') {
+            return false;
+        }
+        value = value * 10 + (p[i] - '0');
+    }
+    return true;
+}
+}  // namespace
+
+uint64_t xxh64(const void *data, size_t length, uint64_t seed)
+{
+    auto p = reinterpret_cast<const uint8_t *>(data);
+    auto end = p + length;
+    uint64_t h;
+
+    if (length >= 32) {
+        uint64_t v1 = seed + kPrime1 + kPrime2;
+        uint64_t v2 = seed + kPrime2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - kPrime1;
+        do {
+            v1 = xxRound(v1, read64(p));
+            v2 = xxRound(v2, read64(p + 8));
+            v3 = xxRound(v3, read64(p + 16));
+            v4 = xxRound(v4, read64(p + 24));
+            p += 32;
+        } while (p + 32 <= end);
+
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h = merge(h, v1);
+        h = merge(h, v2);
+        h = merge(h, v3);
+        h = merge(h, v4);
+    } else {
+        h = seed + kPrime5;
+    }
+
+    h += length;
+
+    for (; p + 8 <= end; p += 8) {
+        h ^= xxRound(0, read64(p));
+        h = rotl(h, 27) * kPrime1 + kPrime4;
+    }
+    if (p + 4 <= end) {
+        h ^= static_cast<uint64_t>(read32(p)) * kPrime1;
+        h = rotl(h, 23) * kPrime2 + kPrime3;
+        p += 4;
+    }
+    for (; p < end; p++) {
+        h ^= *p * kPrime5;
+        h = rotl(h, 11) * kPrime1;
+    }
+
+    h ^= h >> 33;
+    h *= kPrime2;
+    h ^= h >> 29;
+    h *= kPrime3;
+    h ^= h >> 32;
+    return h;
+}
+
+std::string etagOf(const void *data, size_t length)
+{
+    return FORMAT("\"{:016x}\"", xxh64(data, length));
+}
+
+bool etagMatches(const char *ifNoneMatch, const std::string &etag)
+{
+    if (ifNoneMatch == nullptr || etag.length() < 2) {
+        return false;
+    }
+
+    // the weak comparison ignores W/ on both sides
+    const char *tag = etag.c_str();
+    if (strncmp(tag, "W/", 2) == 0) {
+        tag += 2;
+    }
+    auto tagLength = strlen(tag);
+
+    auto p = skipSpaces(ifNoneMatch);
+    while (*p != '\0') {
+        if (*p == '*') {
+            return true;
+        }
+        if (strncmp(p, "W/", 2) == 0) {
+            p += 2;
+        }
+        if (*p != '"') {
+            // malformed, skip to the next one
+            while (*p != '\0' && *p != ',') {
+                p++;
+            }
+            p = skipSpaces(p);
+            continue;
+        }
+
+        auto end = strchr(p + 1, '"');
+        if (end == nullptr) {
+            return false;
+        }
+        auto length = static_cast<size_t>(end + 1 - p);
+        if (length == tagLength && memcmp(p, tag, length) == 0) {
+            return true;
+        }
+        p = skipSpaces(end + 1);
+    }
+    return false;
+}
+
+bool parseHttpDate(const char *value, int64_t &seconds)
+{
+    static const char kMonths[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+
+    // Sun, 06 Nov 1994 08:49:37 GMT
+    if (value == nullptr || strlen(value) != 29 || value[3] != ',' || value[4] != ' ' || value[7] != ' '
+        || value[11] != ' ' || value[16] != ' ' || value[19] != ':' || value[22] != ':'
+        || strcmp(value + 25, " GMT") != 0) {
+        return false;
+    }
+
+    int day, year, hour, minute, second;
+    if (!number(value + 5, 2, day) || !number(value + 12, 4, year) || !number(value + 17, 2, hour)
+        || !number(value + 20, 2, minute) || !number(value + 23, 2, second)) {
+        return false;
+    }
+
+    unsigned month = 0;
+    while (month < 12 && strncmp(kMonths + month * 3, value + 8, 3) != 0) {
+        month++;
+    }
+    if (month == 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60) {
+        return false;
+    }
+
+    seconds = daysFromCivil(year, month + 1, static_cast<unsigned>(day)) * 86400 + hour * 3600 + minute * 60 + second;
+    return true;
+}
+
+bool notModified(const char *ifNoneMatch,
+                 const char *ifModifiedSince,
+                 const std::string &etag,
+                 const std::string &lastModified)
+{
+    if (ifNoneMatch != nullptr) {
+        return etagMatches(ifNoneMatch, etag);
+    }
+
+    int64_t since, modified;
+    return ifModifiedSince != nullptr && lastModified.length() != 0 && parseHttpDate(ifModifiedSince, since)
+           && parseHttpDate(lastModified.c_str(), modified) && modified <= since;
+}
+
+bool ValidatorCache::lookup(uint64_t key, Clock::time_point now, Validators &validators)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it == index_.end() || it->second->validators.expires <= now) {
+        return false;
+    }
+    lru_.splice(lru_.begin(), lru_, it->second);
+    validators = it->second->validators;
+    return true;
+}
+
+void ValidatorCache::store(uint64_t key, Validators &&validators)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+        it->second->validators = std::move(validators);
+        lru_.splice(lru_.begin(), lru_, it->second);
+        return;
+    }
+
+    if (capacity_ == 0) {
+        return;
+    }
+    if (lru_.size() >= capacity_) {
+        index_.erase(lru_.back().key);
+        lru_.pop_back();
+    }
+    lru_.push_front(Entry{key, std::move(validators)});
+    index_[key] = lru_.begin();
+}
+
+CPPMHD_NAMESPACE_END
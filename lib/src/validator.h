@@ -0,0 +1,89 @@
+#ifndef CPPMHD_INTERNAL_VALIDATOR_H_
+#define CPPMHD_INTERNAL_VALIDATOR_H_
+
+#include "config.h"
+
+#include <cppmhd/entity.h>
+
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "core.h"
+
+CPPMHD_NAMESPACE_BEGIN
+
+// XXH64 of xxHash
+uint64_t xxh64(const void *data, size_t length, uint64_t seed = 0);
+
+// a strong ETag of the body, quoted
+std::string etagOf(const void *data, size_t length);
+
+// the If-None-Match value lists etag, by the weak comparison. "*" matches any
+bool etagMatches(const char *ifNoneMatch, const std::string &etag);
+
+// seconds since the epoch of an IMF-fixdate, eg: "Sun, 06 Nov 1994 08:49:37 GMT". false for the obsolete formats
+bool parseHttpDate(const char *value, int64_t &seconds);
+
+// the conditions of a GET or HEAD hold for a response with these validators, and it is answered with a 304.
+// If-Modified-Since only counts without If-None-Match. both may be nullptr, etag and lastModified empty
+bool notModified(const char *ifNoneMatch,
+                 const char *ifModifiedSince,
+                 const std::string &etag,
+                 const std::string &lastModified);
+
+// the headers of a 200 its 304 repeats, RFC 7232 4.1. the ETag and Last-Modified are kept aside
+using KeptHeaders = std::vector<std::pair<std::string, std::string>>;
+
+// the validators of the last 200 of each URL of the routes opted in with HttpController::validatorTtl. the least
+// recently used URLs are dropped beyond the capacity. shared by all server threads
+class ValidatorCache
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Validators {
+        std::string etag;
+        // the header as sent, empty when the response had none
+        std::string lastModified;
+        KeptHeaders headers;
+
+        Clock::time_point expires;
+    };
+
+  private:
+    struct Entry {
+        uint64_t key;
+        Validators validators;
+    };
+
+    const size_t capacity_;
+
+    std::mutex mutex_;
+    // most recently used first
+    std::list<Entry> lru_;
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> index_;
+
+  public:
+    explicit ValidatorCache(size_t capacity) : capacity_(capacity) {}
+
+    // false if the URL has no validators, or they expired
+    bool lookup(uint64_t key, Clock::time_point now, Validators &validators);
+
+    void store(uint64_t key, Validators &&validators);
+
+    size_t size()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return lru_.size();
+    }
+};
+
+CPPMHD_NAMESPACE_END
+
+#endif
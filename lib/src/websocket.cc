@@ -0,0 +1,902 @@
+#include "websocket.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifdef ENABLE_ZLIB
+#include <zlib.h>
+#endif
+
+#include <cerrno>
+#include <cstring>
+
+#include "logger.h"
+#include "utils.h"
+
+CPPMHD_NAMESPACE_BEGIN
+
+namespace
+{
+constexpr char kGuid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+constexpr uint8_t kContinuation = 0x0;
+constexpr uint8_t kText = 0x1;
+constexpr uint8_t kBinary = 0x2;
+constexpr uint8_t kClose = 0x8;
+constexpr uint8_t kPing = 0x9;
+constexpr uint8_t kPong = 0xA;
+
+constexpr uint8_t kFin = 0x80;
+constexpr uint8_t kRsv1 = 0x40;
+
+// the client answers a Close frame within it, or the connection is dropped
+constexpr auto kCloseTimeout = std::chrono::seconds(5);
+
+inline uint32_t rol(uint32_t x, int n)
+{
+    return (x << n) | (x >> (32 - n));
+}
+
+void sha1(const std::string &data, uint8_t digest[20])
+{
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+
+    std::string msg(data);
+    msg += '\x80';
+    while (msg.length() % 64 != 56) {
+        msg += '\0';
+    }
+    uint64_t bits = static_cast<uint64_t>(data.length()) * 8;
+    for (int i = 7; i >= 0; i--) {
+        msg += static_cast<char>(bits >> (i * 8));
+    }
+
+    for (size_t offset = 0; offset < msg.length(); offset += 64) {
+        auto p = reinterpret_cast<const uint8_t *>(msg.data() + offset);
+        uint32_t w[80];
+        for (int i = 0; i < 16; i++) {
+            w[i] = static_cast<uint32_t>(p[i * 4]) << 24 | static_cast<uint32_t>(p[i * 4 + 1]) << 16
+                   | static_cast<uint32_t>(p[i * 4 + 2]) << 8 | p[i * 4 + 3];
+        }
+        for (int i = 16; i < 80; i++) {
+            w[i] = rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        }
+
+        auto a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; i++) {
+            uint32_t f, k;
+            if (i < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999;
+            } else if (i < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            } else if (i < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDC;
+            } else {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+            auto t = rol(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rol(b, 30);
+            b = a;
+            a = t;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+
+    for (int i = 0; i < 5; i++) {
+        digest[i * 4] = static_cast<uint8_t>(h[i] >> 24);
+        digest[i * 4 + 1] = static_cast<uint8_t>(h[i] >> 16);
+        digest[i * 4 + 2] = static_cast<uint8_t>(h[i] >> 8);
+        digest[i * 4 + 3] = static_cast<uint8_t>(h[i]);
+    }
+}
+
+std::string base64(const uint8_t *data, size_t size)
+{
+    static const char kAlphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    std::string out;
+    for (size_t i = 0; i < size; i += 3) {
+        uint32_t v = static_cast<uint32_t>(data[i]) << 16;
+        if (i + 1 < size) {
+            v |= static_cast<uint32_t>(data[i + 1]) << 8;
+        }
+        if (i + 2 < size) {
+            v |= data[i + 2];
+        }
+        out += kAlphabet[(v >> 18) & 0x3F];
+        out += kAlphabet[(v >> 12) & 0x3F];
+        out += i + 1 < size ? kAlphabet[(v >> 6) & 0x3F] : '=';
+        out += i + 2 < size ? kAlphabet[v & 0x3F] : '=';
+    }
+    return out;
+}
+
+#ifdef ENABLE_ZLIB
+// permessage-deflate without context takeover: every message is a raw deflate stream of its own, flushed with an
+// empty stored block whose last 4 bytes are left out
+const char kDeflateTail[] = {'\x00', '\x00', '\xff', '\xff'};
+
+struct Deflater {
+    z_stream zs;
+    bool ready;
+
+    Deflater()
+    {
+        memset(&zs, 0, sizeof(zs));
+        ready = deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+    }
+
+    ~Deflater()
+    {
+        if (ready) {
+            deflateEnd(&zs);
+        }
+    }
+};
+
+struct Inflater {
+    z_stream zs;
+    bool ready;
+
+    Inflater()
+    {
+        memset(&zs, 0, sizeof(zs));
+        ready = inflateInit2(&zs, -15) == Z_OK;
+    }
+
+    ~Inflater()
+    {
+        if (ready) {
+            inflateEnd(&zs);
+        }
+    }
+};
+
+// the senders compress on their threads, each with its stream
+bool deflateMessage(const char *data, size_t size, std::string &out)
+{
+    thread_local Deflater d;
+    if (!d.ready || size > UINT32_MAX / 2 || deflateReset(&d.zs) != Z_OK) {
+        return false;
+    }
+
+    out.resize(deflateBound(&d.zs, static_cast<uLong>(size)) + 16);
+    d.zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+    d.zs.avail_in = static_cast<uInt>(size);
+    d.zs.next_out = reinterpret_cast<Bytef *>(&out[0]);
+    d.zs.avail_out = static_cast<uInt>(out.length());
+    if (deflate(&d.zs, Z_SYNC_FLUSH) != Z_OK || d.zs.avail_in != 0) {
+        return false;
+    }
+    out.resize(out.length() - d.zs.avail_out);
+    if (out.length() < 4 || memcmp(out.data() + out.length() - 4, kDeflateTail, 4) != 0) {
+        return false;
+    }
+    out.resize(out.length() - 4);
+    return true;
+}
+
+// stops past limit bytes. false for data that is not deflate
+bool inflateMessage(const char *data, size_t size, size_t limit, std::string &out)
+{
+    thread_local Inflater in;
+    if (!in.ready || size > UINT32_MAX / 2 || inflateReset(&in.zs) != Z_OK) {
+        return false;
+    }
+
+    const char *inputs[] = {data, kDeflateTail};
+    size_t sizes[] = {size, sizeof(kDeflateTail)};
+    char buf[16 * 1024];
+    for (int i = 0; i < 2; i++) {
+        in.zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(inputs[i]));
+        in.zs.avail_in = static_cast<uInt>(sizes[i]);
+        do {
+            in.zs.next_out = reinterpret_cast<Bytef *>(buf);
+            in.zs.avail_out = sizeof(buf);
+            auto ret = inflate(&in.zs, Z_SYNC_FLUSH);
+            if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+                return false;
+            }
+            out.append(buf, sizeof(buf) - in.zs.avail_out);
+            if (out.length() > limit || ret == Z_STREAM_END) {
+                return true;
+            }
+            if (ret == Z_BUF_ERROR) {
+                break;
+            }
+        } while (in.zs.avail_in != 0 || in.zs.avail_out == 0);
+    }
+    return true;
+}
+#endif
+
+// the codes a Close frame may carry, RFC 6455 7.4.1
+bool validCloseCode(uint16_t code)
+{
+    if (code >= 3000 && code < 5000) {
+        return true;
+    }
+    return code >= 1000 && code <= 1011 && code != 1004 && code != kWsNoStatus && code != kWsAbnormalClosure;
+}
+}  // namespace
+
+std::string webSocketAccept(const char *key)
+{
+    uint8_t digest[20];
+    sha1(std::string(key) + kGuid, digest);
+    return base64(digest, sizeof(digest));
+}
+
+void unmask(char *data, size_t size, const uint8_t *key)
+{
+    uint32_t k32;
+    memcpy(&k32, key, sizeof(k32));
+    // the key bytes twice in memory order, whatever the byte order
+    uint64_t k64 = static_cast<uint64_t>(k32) << 32 | k32;
+
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t v;
+        memcpy(&v, data + i, sizeof(v));
+        v ^= k64;
+        memcpy(data + i, &v, sizeof(v));
+    }
+    for (; i < size; i++) {
+        data[i] = static_cast<char>(data[i] ^ key[i & 3]);
+    }
+}
+
+void appendFrameHeader(std::string &out, uint8_t first, uint64_t size)
+{
+    out += static_cast<char>(first);
+    if (size < 126) {
+        out += static_cast<char>(size);
+    } else if (size <= 0xFFFF) {
+        out += static_cast<char>(126);
+        out += static_cast<char>(size >> 8);
+        out += static_cast<char>(size);
+    } else {
+        out += static_cast<char>(127);
+        for (int i = 7; i >= 0; i--) {
+            out += static_cast<char>(size >> (i * 8));
+        }
+    }
+}
+
+WebSocket::~WebSocket() {}
+
+void WebSocketController::onConnection(HttpRequestPtr req, HttpResponsePtr &resp)
+{
+    resp = std::make_shared<HttpResponse>();
+
+    auto upgrade = req->getHeader(CPPMHD_HTTP_HEADER_UPGRADE);
+    auto connection = req->getHeader(CPPMHD_HTTP_HEADER_CONNECTION);
+    auto version = req->getHeader(CPPMHD_HTTP_HEADER_SEC_WEBSOCKET_VERSION);
+    if (upgrade == nullptr || strcasecmp(upgrade, "websocket") != 0 || connection == nullptr
+        || !containsNoCase(connection, "upgrade") || version == nullptr || strcmp(version, "13") != 0) {
+        resp->status(k426UpgradeRequired);
+        resp->header(CPPMHD_HTTP_HEADER_SEC_WEBSOCKET_VERSION) = "13";
+        resp->body("WebSocket handshake expected");
+        return;
+    }
+
+    // 16 bytes in base64
+    auto key = req->getHeader(CPPMHD_HTTP_HEADER_SEC_WEBSOCKET_KEY);
+    if (key == nullptr || strlen(key) != 24) {
+        resp->status(k400BadRequest);
+        resp->body("bad Sec-WebSocket-Key");
+        return;
+    }
+
+    if (!accept(req)) {
+        resp->status(k403Forbidden);
+        return;
+    }
+
+    // MHD adds Connection: Upgrade
+    resp->status(k101SwitchingProtocol);
+    resp->header(CPPMHD_HTTP_HEADER_UPGRADE) = "websocket";
+    resp->header(CPPMHD_HTTP_HEADER_SEC_WEBSOCKET_ACCEPT) = webSocketAccept(key);
+
+#ifdef ENABLE_ZLIB
+    // the window of the server can not be made smaller, such an offer is declined
+    auto extensions = req->getHeader(CPPMHD_HTTP_HEADER_SEC_WEBSOCKET_EXTENSIONS);
+    if (compression() && extensions != nullptr && containsNoCase(extensions, "permessage-deflate")
+        && !containsNoCase(extensions, "server_max_window_bits")) {
+        resp->header(CPPMHD_HTTP_HEADER_SEC_WEBSOCKET_EXTENSIONS) =
+            "permessage-deflate; server_no_context_takeover; client_no_context_takeover";
+    }
+#endif
+}
+
+void WebSocketController::onRequest(HttpRequestPtr, HttpResponsePtr &) {}
+
+bool WebSocketController::accept(HttpRequestPtr)
+{
+    return true;
+}
+
+void WebSocketController::onOpen(WebSocketPtr, HttpRequestPtr) {}
+
+void WebSocketController::onClose(WebSocketPtr, uint16_t) {}
+
+size_t WebSocketController::maxMessageSize() const
+{
+    return 1024 * 1024;
+}
+
+bool WebSocketController::compression() const
+{
+    return true;
+}
+
+MHDWebSocket::MHDWebSocket(WebSocketEngine *engine,
+                           WebSocketController *ctrl,
+                           int fd,
+                           MHD_UpgradeResponseHandle *urh,
+                           bool deflate)
+    : engine_(engine),
+      ctrl_(ctrl),
+      fd_(fd),
+      urh_(urh),
+      deflate_(deflate),
+      maxMessage_(ctrl->maxMessageSize()),
+      opcode_(0),
+      compressed_(false),
+      outOffset_(0),
+      writing_(false),
+      watched_(false),
+      closeSent_(false),
+      released_(false)
+{
+    closed_ = false;
+}
+
+bool MHDWebSocket::queue(uint8_t opcode, const char *data, size_t size, bool compressed)
+{
+    if (closed_ || closeSent_ || out_.length() - outOffset_ > kMaxPending) {
+        return false;
+    }
+
+    appendFrameHeader(out_, static_cast<uint8_t>(kFin | (compressed ? kRsv1 : 0) | opcode), size);
+    out_.append(data, size);
+    if (opcode == kClose) {
+        closeSent_ = true;
+        closeDeadline_ = Clock::now() + kCloseTimeout;
+    }
+
+    // what is queued while the socket is full goes out with one write
+    if (!writing_) {
+        flush();
+    }
+    return true;
+}
+
+void MHDWebSocket::flush()
+{
+    while (outOffset_ < out_.length()) {
+        auto n = ::send(fd_, out_.data() + outOffset_, out_.length() - outOffset_, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n > 0) {
+            outOffset_ += static_cast<size_t>(n);
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+
+        // full, or broken: the engine writes the rest or sees the error
+        if (!writing_) {
+            writing_ = true;
+            if (watched_) {
+                engine_->watch(fd_, true);
+            }
+        }
+        return;
+    }
+
+    out_.clear();
+    outOffset_ = 0;
+    if (writing_) {
+        writing_ = false;
+        if (watched_) {
+            engine_->watch(fd_, false);
+        }
+    }
+}
+
+bool MHDWebSocket::attach(int epoll)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLRDHUP | (writing_ ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+    ev.data.fd = fd_;
+    if (epoll_ctl(epoll, EPOLL_CTL_ADD, fd_, &ev) != 0) {
+        return false;
+    }
+    watched_ = true;
+    return true;
+}
+
+bool MHDWebSocket::send(const void *data, size_t size, bool binary)
+{
+    auto p = reinterpret_cast<const char *>(data);
+    auto opcode = binary ? kBinary : kText;
+#ifdef ENABLE_ZLIB
+    std::string deflated;
+    if (deflate_ && size >= kDeflateMinSize && deflateMessage(p, size, deflated) && deflated.length() < size) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return queue(opcode, deflated.data(), deflated.length(), true);
+    }
+#endif
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue(opcode, p, size, false);
+}
+
+bool MHDWebSocket::ping(const std::string &payload)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue(kPing, payload.data(), std::min<size_t>(payload.length(), 125), false);
+}
+
+void MHDWebSocket::close(uint16_t code, const std::string &reason)
+{
+    std::string payload;
+    payload += static_cast<char>(code >> 8);
+    payload += static_cast<char>(code);
+    payload.append(reason, 0, 123);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue(kClose, payload.data(), payload.length(), false);
+}
+
+bool MHDWebSocket::fail(uint16_t code)
+{
+    LOG_DEBUG("websocket {}: failed with {}", fd_, code);
+    {
+        char payload[2] = {static_cast<char>(code >> 8), static_cast<char>(code)};
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue(kClose, payload, sizeof(payload), false);
+    }
+    finish(code);
+    return false;
+}
+
+bool MHDWebSocket::parse()
+{
+    size_t pos = 0;
+    while (true) {
+        auto avail = in_.length() - pos;
+        if (avail < 2) {
+            break;
+        }
+
+        auto p = reinterpret_cast<const uint8_t *>(in_.data() + pos);
+        uint64_t size = p[1] & 0x7F;
+        size_t header = 2;
+        if (size == 126) {
+            if (avail < 4) {
+                break;
+            }
+            size = static_cast<uint64_t>(p[2]) << 8 | p[3];
+            header = 4;
+        } else if (size == 127) {
+            if (avail < 10) {
+                break;
+            }
+            size = 0;
+            for (int i = 2; i < 10; i++) {
+                size = size << 8 | p[i];
+            }
+            header = 10;
+        }
+
+        // a client masks every frame
+        if ((p[1] & 0x80) == 0) {
+            return fail(kWsProtocolError);
+        }
+        if (size > maxMessage_ || message_.length() + size > maxMessage_) {
+            return fail(kWsMessageTooBig);
+        }
+        if (avail < header + 4 + size) {
+            break;
+        }
+
+        auto payload = &in_[pos + header + 4];
+        unmask(payload, static_cast<size_t>(size), p + header);
+        auto ok = frame((p[0] & kFin) != 0, p[0] & 0x70, p[0] & 0x0F, payload, static_cast<size_t>(size));
+        if (!ok) {
+            return false;
+        }
+        pos += header + 4 + static_cast<size_t>(size);
+    }
+
+    in_.erase(0, pos);
+    return true;
+}
+
+bool MHDWebSocket::frame(bool fin, uint8_t rsv, uint8_t opcode, const char *payload, size_t size)
+{
+    if ((rsv & ~(deflate_ ? kRsv1 : 0)) != 0) {
+        return fail(kWsProtocolError);
+    }
+
+    // control frames, between the fragments of a message too
+    if ((opcode & 0x8) != 0) {
+        if (!fin || size > 125 || rsv != 0) {
+            return fail(kWsProtocolError);
+        }
+        if (opcode == kPing) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queue(kPong, payload, size, false);
+            return true;
+        }
+        if (opcode == kPong) {
+            return true;
+        }
+        if (opcode != kClose || size == 1) {
+            return fail(kWsProtocolError);
+        }
+
+        uint16_t code = kWsNoStatus;
+        if (size >= 2) {
+            code = static_cast<uint16_t>(static_cast<uint8_t>(payload[0]) << 8 | static_cast<uint8_t>(payload[1]));
+            if (!validCloseCode(code)) {
+                return fail(kWsProtocolError);
+            }
+            if (!validUtf8(payload + 2, size - 2)) {
+                return fail(kWsInvalidPayload);
+            }
+        }
+        {
+            // the answer echoes the code, unless it answers the Close frame of the server
+            std::lock_guard<std::mutex> lock(mutex_);
+            queue(kClose, payload, size >= 2 ? 2 : 0, false);
+        }
+        finish(code);
+        return false;
+    }
+
+    if (opcode == kContinuation) {
+        if (opcode_ == 0 || rsv != 0) {
+            return fail(kWsProtocolError);
+        }
+    } else {
+        if (opcode_ != 0 || (opcode != kText && opcode != kBinary)) {
+            return fail(kWsProtocolError);
+        }
+        opcode_ = opcode;
+        compressed_ = (rsv & kRsv1) != 0;
+    }
+
+    if (!fin) {
+        message_.append(payload, size);
+        return true;
+    }
+
+    auto binary = opcode_ == kBinary;
+    opcode_ = 0;
+    if (message_.length() == 0) {
+        return deliver(payload, size, binary);
+    }
+    message_.append(payload, size);
+    std::string message;
+    message.swap(message_);
+    return deliver(message.data(), message.length(), binary);
+}
+
+bool MHDWebSocket::deliver(const char *data, size_t size, bool binary)
+{
+#ifdef ENABLE_ZLIB
+    std::string inflated;
+    if (compressed_) {
+        if (!inflateMessage(data, size, maxMessage_, inflated)) {
+            return fail(kWsInvalidPayload);
+        }
+        if (inflated.length() > maxMessage_) {
+            return fail(kWsMessageTooBig);
+        }
+        data = inflated.data();
+        size = inflated.length();
+    }
+#endif
+    if (!binary && !validUtf8(data, size)) {
+        return fail(kWsInvalidPayload);
+    }
+
+    ctrl_->onMessage(shared_from_this(), data, size, binary);
+    return !closed_;
+}
+
+bool MHDWebSocket::onReadable()
+{
+    char buf[64 * 1024];
+    auto n = ::recv(fd_, buf, sizeof(buf), MSG_DONTWAIT);
+    if (n > 0) {
+        // what the client sends after the close is dropped, until it closes its side
+        if (closed_) {
+            return true;
+        }
+        in_.append(buf, static_cast<size_t>(n));
+        return parse();
+    }
+    if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+        return true;
+    }
+    finish(kWsAbnormalClosure);
+    release();
+    return false;
+}
+
+void MHDWebSocket::onWritable()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    flush();
+    // the client reads the Close frame, then sees the end
+    if (closed_ && !writing_) {
+        ::shutdown(fd_, SHUT_WR);
+    }
+}
+
+bool MHDWebSocket::closeExpired(Clock::time_point now)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return (closeSent_ || closed_) && !released_ && now >= closeDeadline_;
+}
+
+void MHDWebSocket::finish(uint16_t code)
+{
+    bool linger;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (closed_) {
+            return;
+        }
+        closed_ = true;
+        if (!closeSent_) {
+            closeDeadline_ = Clock::now() + kCloseTimeout;
+        }
+
+        // closing the socket with the frames left unwritten, or with bytes of the client unread, resets the
+        // connection, and the client never gets the Close frame. the engine writes the rest, the client closes its
+        // side once it has read our end
+        flush();
+        if (!writing_) {
+            ::shutdown(fd_, SHUT_WR);
+        }
+        linger = watched_;
+    }
+
+    ctrl_->onClose(shared_from_this(), code);
+    if (!linger) {
+        release();
+    }
+}
+
+void MHDWebSocket::release()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (released_) {
+            return;
+        }
+        released_ = true;
+        watched_ = false;
+    }
+
+    engine_->remove(fd_);
+    // MHD closes the socket
+    MHD_upgrade_action(urh_, MHD_UPGRADE_ACTION_CLOSE);
+}
+
+WebSocketEngine::WebSocketEngine() : epoll_(-1), wake_(-1)
+{
+    running_ = false;
+}
+
+WebSocketEngine::~WebSocketEngine()
+{
+    stop();
+}
+
+bool WebSocketEngine::start()
+{
+    epoll_ = epoll_create1(EPOLL_CLOEXEC);
+    wake_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+    epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = wake_;
+    if (epoll_ < 0 || wake_ < 0 || epoll_ctl(epoll_, EPOLL_CTL_ADD, wake_, &ev) != 0) {
+        LOG_ERROR("websocket engine: {}", strerror(errno));
+        for (auto fd : {&epoll_, &wake_}) {
+            if (*fd >= 0) {
+                ::close(*fd);
+                *fd = -1;
+            }
+        }
+        return false;
+    }
+
+    running_ = true;
+    thread_ = std::thread(&WebSocketEngine::run, this);
+    return true;
+}
+
+void WebSocketEngine::stop()
+{
+    if (!thread_.joinable()) {
+        return;
+    }
+
+    running_ = false;
+    uint64_t one = 1;
+    if (::write(wake_, &one, sizeof(one)) < 0) {
+        LOG_ERROR("websocket engine: wake up failed: {}", strerror(errno));
+    }
+    thread_.join();
+
+    std::vector<std::shared_ptr<MHDWebSocket>> left;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto &s : sockets_) {
+            left.push_back(s.second);
+        }
+        fresh_.clear();
+    }
+    // the frames the socket buffer takes go out, nothing waits for the slow clients
+    for (auto &ws : left) {
+        ws->close(kWsGoingAway, std::string());
+        ws->finish(kWsGoingAway);
+        ws->release();
+    }
+
+    ::close(epoll_);
+    ::close(wake_);
+    epoll_ = wake_ = -1;
+}
+
+std::shared_ptr<MHDWebSocket> WebSocketEngine::find(int fd)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = sockets_.find(fd);
+    return it != sockets_.end() ? it->second : nullptr;
+}
+
+void WebSocketEngine::open(WebSocketController *ctrl,
+                           HttpRequestPtr &req,
+                           int fd,
+                           MHD_UpgradeResponseHandle *urh,
+                           const char *extra,
+                           size_t extraSize,
+                           bool deflate)
+{
+    auto ws = std::make_shared<MHDWebSocket>(this, ctrl, fd, urh, deflate);
+    ws->received(extra, extraSize);
+    ctrl->onOpen(ws, req);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (running_ && ws->isOpen()) {
+            if (ws->attach(epoll_)) {
+                sockets_[fd] = ws;
+                if (extraSize != 0) {
+                    fresh_.push_back(ws);
+                    uint64_t one = 1;
+                    if (::write(wake_, &one, sizeof(one)) < 0) {
+                        LOG_ERROR("websocket engine: wake up failed: {}", strerror(errno));
+                    }
+                }
+                return;
+            }
+            LOG_ERROR("websocket {}: epoll_ctl failed: {}", fd, strerror(errno));
+        }
+    }
+    ws->finish(kWsGoingAway);
+}
+
+void WebSocketEngine::watch(int fd, bool writable)
+{
+    epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLRDHUP | (writable ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+    ev.data.fd = fd;
+    if (epoll_ctl(epoll_, EPOLL_CTL_MOD, fd, &ev) != 0) {
+        LOG_ERROR("websocket {}: epoll_ctl failed: {}", fd, strerror(errno));
+    }
+}
+
+void WebSocketEngine::remove(int fd)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = sockets_.find(fd);
+    if (it != sockets_.end()) {
+        epoll_ctl(epoll_, EPOLL_CTL_DEL, fd, nullptr);
+        sockets_.erase(it);
+    }
+}
+
+void WebSocketEngine::run()
+{
+    constexpr int kEvents = 64;
+    epoll_event events[kEvents];
+    auto sweep = MHDWebSocket::Clock::now();
+
+    while (running_) {
+        auto n = epoll_wait(epoll_, events, kEvents, 1000);
+        if (n < 0 && errno != EINTR) {
+            LOG_ERROR("websocket engine: epoll_wait failed: {}", strerror(errno));
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            auto fd = events[i].data.fd;
+            if (fd == wake_) {
+                uint64_t count;
+                if (::read(wake_, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+                    LOG_ERROR("websocket engine: read failed: {}", strerror(errno));
+                }
+                std::vector<std::shared_ptr<MHDWebSocket>> fresh;
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    fresh.swap(fresh_);
+                }
+                for (auto &ws : fresh) {
+                    if (ws->isOpen()) {
+                        ws->parse();
+                    }
+                }
+                continue;
+            }
+
+            auto ws = find(fd);
+            if (!ws) {
+                continue;
+            }
+            auto e = events[i].events;
+            if ((e & EPOLLOUT) != 0) {
+                ws->onWritable();
+            }
+            if ((e & (EPOLLIN | EPOLLRDHUP)) != 0) {
+                // reads until recv tells the end
+                ws->onReadable();
+            } else if ((e & (EPOLLERR | EPOLLHUP)) != 0) {
+                ws->finish(kWsAbnormalClosure);
+                ws->release();
+            }
+        }
+
+        auto now = MHDWebSocket::Clock::now();
+        if (now - sweep >= std::chrono::seconds(1)) {
+            sweep = now;
+            std::vector<std::shared_ptr<MHDWebSocket>> expired;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                for (auto &s : sockets_) {
+                    if (s.second->closeExpired(now)) {
+                        expired.push_back(s.second);
+                    }
+                }
+            }
+            for (auto &ws : expired) {
+                ws->finish(kWsAbnormalClosure);
+                ws->release();
+            }
+        }
+    }
+}
+
+CPPMHD_NAMESPACE_END
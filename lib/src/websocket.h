@@ -0,0 +1,177 @@
+#ifndef CPPMHD_INTERNAL_WEBSOCKET_H_
+#define CPPMHD_INTERNAL_WEBSOCKET_H_
+
+#include "config.h"
+
+#include <cppmhd/websocket.h>
+
+#include <microhttpd.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "core.h"
+
+CPPMHD_NAMESPACE_BEGIN
+
+// Sec-WebSocket-Accept of a Sec-WebSocket-Key
+std::string webSocketAccept(const char *key);
+
+// XORs the payload of a client frame with its masking key, a word at a time
+void unmask(char *data, size_t size, const uint8_t *key);
+
+// the header of an unmasked server frame
+void appendFrameHeader(std::string &out, uint8_t first, uint64_t size);
+
+class WebSocketEngine;
+
+// a connection taken over from MHD. reading and the callbacks run on the engine thread, sending on any thread
+class MHDWebSocket : public WebSocket, public std::enable_shared_from_this<MHDWebSocket>
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    // bytes queued for a client that does not read, send fails beyond them
+    static constexpr size_t kMaxPending = 16 * 1024 * 1024;
+    // a compressed message is not worth it below
+    static constexpr size_t kDeflateMinSize = 128;
+
+  private:
+    WebSocketEngine *engine_;
+    WebSocketController *ctrl_;
+    const int fd_;
+    MHD_UpgradeResponseHandle *urh_;
+    const bool deflate_;
+    const size_t maxMessage_;
+
+    // engine thread only: the bytes read and not parsed, and the fragments of the message being received
+    std::string in_;
+    std::string message_;
+    // of message_, 0 between messages
+    uint8_t opcode_;
+    bool compressed_;
+
+    std::mutex mutex_;
+    // frames not written yet, from outOffset_
+    std::string out_;
+    size_t outOffset_;
+    // EPOLLOUT is watched, the engine writes out_
+    bool writing_;
+    // added to the epoll set of the engine, which is told about writing_ from then on
+    bool watched_;
+    bool closeSent_;
+    // the client answers the Close frame by then, and the socket closed is handed back to MHD by then
+    Clock::time_point closeDeadline_;
+    std::atomic_bool closed_;
+    bool released_;
+
+    // with mutex_ held
+    bool queue(uint8_t opcode, const char *data, size_t size, bool compressed);
+    void flush();
+
+    // a frame of the client, unmasked. false when the connection is done
+    bool frame(bool fin, uint8_t rsv, uint8_t opcode, const char *payload, size_t size);
+    bool deliver(const char *data, size_t size, bool binary);
+    // closes the connection with code, after telling the client
+    bool fail(uint16_t code);
+
+  public:
+    MHDWebSocket(WebSocketEngine *engine,
+                 WebSocketController *ctrl,
+                 int fd,
+                 MHD_UpgradeResponseHandle *urh,
+                 bool deflate);
+
+    virtual bool send(const void *data, size_t size, bool binary) override;
+    virtual bool ping(const std::string &payload) override;
+    virtual void close(uint16_t code, const std::string &reason) override;
+
+    virtual bool isOpen() const override
+    {
+        return !closed_;
+    }
+
+    int fd() const
+    {
+        return fd_;
+    }
+
+    // adds the socket to the epoll set, watching writability if frames are left to write
+    bool attach(int epoll);
+
+    // the engine thread. the bytes the client sent with the handshake, before the socket is watched
+    void received(const char *data, size_t size)
+    {
+        in_.append(data, size);
+    }
+
+    // parses what is buffered. false when the connection is done
+    bool parse();
+    bool onReadable();
+    void onWritable();
+
+    // the client did not answer the Close frame, or did not read the frames left, in time
+    bool closeExpired(Clock::time_point now);
+
+    // calls onClose, once. a watched socket lingers until the frames left are written and the client closes its side
+    // or the deadline, the others are released at once
+    void finish(uint16_t code);
+    // hands the socket back to MHD, once
+    void release();
+};
+
+// the epoll loop of the upgraded connections of an App
+class WebSocketEngine
+{
+    int epoll_;
+    // wakes the loop up for the connections in fresh_
+    int wake_;
+    std::thread thread_;
+    std::atomic_bool running_;
+
+    std::mutex mutex_;
+    std::unordered_map<int, std::shared_ptr<MHDWebSocket>> sockets_;
+    // opened with bytes to parse
+    std::vector<std::shared_ptr<MHDWebSocket>> fresh_;
+
+    void run();
+    std::shared_ptr<MHDWebSocket> find(int fd);
+
+  public:
+    WebSocketEngine();
+    ~WebSocketEngine();
+
+    bool start();
+    // closes the websockets left with kWsGoingAway
+    void stop();
+
+    // the upgrade handler of MHD, on its thread. calls onOpen before the first message
+    void open(WebSocketController *ctrl,
+              HttpRequestPtr &req,
+              int fd,
+              MHD_UpgradeResponseHandle *urh,
+              const char *extra,
+              size_t extraSize,
+              bool deflate);
+
+    // watches writability too, while the connection has frames left to write
+    void watch(int fd, bool writable);
+
+    void remove(int fd);
+
+    size_t size()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return sockets_.size();
+    }
+};
+
+CPPMHD_NAMESPACE_END
+
+#endif
@@ -0,0 +1,173 @@
+#include "accesslog.h"
+
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include <unistd.h>
+
+using namespace cppmhd;
+
+namespace
+{
+class Ctrl : public HttpController
+{
+  public:
+    void onRequest(HttpRequestPtr, HttpResponsePtr &) override {}
+};
+
+AccessRecord makeRecord(uint32_t route, uint16_t status)
+{
+    AccessRecord rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.timestamp = 1700000000123456ULL;
+    rec.bytesIn = 10;
+    rec.bytesOut = 20;
+    rec.latency = 30;
+    rec.route = route;
+    rec.status = status;
+    rec.method = static_cast<uint16_t>(HttpMethod::GET);
+
+    sockaddr_in in;
+    memset(&in, 0, sizeof(in));
+    in.sin_family = AF_INET;
+    in.sin_port = htons(5555);
+    inet_pton(AF_INET, "127.0.0.1", &in.sin_addr);
+    rec.setClient(reinterpret_cast<sockaddr *>(&in));
+    return rec;
+}
+
+std::string tempName()
+{
+    char name[] = "/tmp/cppmhd-access-log-XXXXXX";
+    auto fd = mkstemp(name);
+    close(fd);
+    return name;
+}
+
+std::string readAll(const std::string &name)
+{
+    std::ifstream in(name, std::ios::binary);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+}  // namespace
+
+TEST(AccessLog, json)
+{
+    RouterBuilder rb;
+    rb.add<Ctrl>(HttpMethod::GET, "/user/{\\d+:id}");
+    Router router(std::move(rb));
+    ASSERT_TRUE(router.build());
+    ASSERT_EQ(router.routes().size(), 1u);
+
+    AccessLogOptions options;
+    options.path = tempName();
+
+    {
+        AccessLog log(options, router.routes());
+        ASSERT_TRUE(log.open());
+
+        std::vector<std::thread> thr;
+        for (int t = 0; t < 4; t++) {
+            thr.emplace_back([&log]() {
+                for (int i = 0; i < 100; i++) {
+                    ASSERT_TRUE(log.sampled());
+                    auto rec = makeRecord(0, 200);
+                    log.record(rec, "/user/1\"2");
+                }
+            });
+        }
+        for (auto &t : thr) {
+            t.join();
+        }
+
+        auto rec = makeRecord(RouteInfo::kNoRoute, 404);
+        log.record(rec, "/nothing");
+    }
+
+    std::istringstream lines(readAll(options.path));
+    std::string line;
+    int routed = 0, unrouted = 0;
+    while (std::getline(lines, line)) {
+        if (line.find("\"status\":200") != std::string::npos) {
+            EXPECT_EQ(line,
+                      "{\"time\":\"2023-11-14T22:13:20.123456Z\",\"method\":\"GET\",\"path\":\"/user/1\\\"2\","
+                      "\"route\":\"/user/{\\\\d+:id}\",\"status\":200,\"bytes_in\":10,\"bytes_out\":20,"
+                      "\"latency_us\":30,\"client\":\"127.0.0.1:5555\"}");
+            routed++;
+        } else {
+            EXPECT_NE(line.find("\"path\":\"/nothing\",\"status\":404"), std::string::npos) << line;
+            unrouted++;
+        }
+    }
+    EXPECT_EQ(routed, 400);
+    EXPECT_EQ(unrouted, 1);
+
+    unlink(options.path.c_str());
+}
+
+TEST(AccessLog, binary)
+{
+    RouterBuilder rb;
+    rb.add<Ctrl>(HttpMethod::GET, "/a");
+    rb.add<Ctrl>(HttpMethod::POST, "/b");
+    Router router(std::move(rb));
+    ASSERT_TRUE(router.build());
+
+    AccessLogOptions options;
+    options.path = tempName();
+    options.format = AccessLogFormat::BINARY;
+
+    {
+        AccessLog log(options, router.routes());
+        ASSERT_TRUE(log.open());
+        auto rec = makeRecord(1, 201);
+        log.record(rec, "/b");
+    }
+
+    auto data = readAll(options.path);
+    auto p = data.data();
+
+    AccessLog::BlockHeader header;
+    memcpy(&header, p, sizeof(header));
+    EXPECT_EQ(header.type, AccessLog::kRouteTable);
+    uint32_t count;
+    memcpy(&count, p + sizeof(header), sizeof(count));
+    EXPECT_EQ(count, 2u);
+    p += sizeof(header) + header.length;
+
+    memcpy(&header, p, sizeof(header));
+    EXPECT_EQ(header.type, AccessLog::kRequest);
+    ASSERT_EQ(header.length, sizeof(AccessRecord) + 2);
+    AccessRecord rec;
+    memcpy(&rec, p + sizeof(header), sizeof(rec));
+    EXPECT_EQ(rec.status, 201);
+    EXPECT_EQ(rec.route, 1u);
+    EXPECT_EQ(rec.family, 4);
+    EXPECT_EQ(std::string(p + sizeof(header) + sizeof(rec), rec.pathLength), "/b");
+    EXPECT_EQ(p + sizeof(header) + header.length, data.data() + data.size());
+
+    unlink(options.path.c_str());
+}
+
+TEST(AccessLog, sampling)
+{
+    std::vector<RouteInfo> routes;
+    AccessLogOptions options;
+
+    options.sampleRate = 0;
+    AccessLog none(options, routes);
+    options.sampleRate = 0.25;
+    AccessLog quarter(options, routes);
+
+    int sampled = 0;
+    for (int i = 0; i < 100000; i++) {
+        EXPECT_FALSE(none.sampled());
+        sampled += quarter.sampled() ? 1 : 0;
+    }
+    EXPECT_NEAR(sampled, 25000, 2000);
+}
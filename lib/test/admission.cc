@@ -0,0 +1,105 @@
+#include "admission.h"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+
+using namespace cppmhd;
+using std::chrono::milliseconds;
+
+TEST(Admission, limits)
+{
+    AdmissionOptions options;
+    options.maxConnections = 2;
+    options.maxInflight = 1;
+    Admission a(options);
+
+    EXPECT_TRUE(a.acceptConnection());
+    a.connectionOpened();
+    EXPECT_TRUE(a.acceptConnection());
+    a.connectionOpened();
+    EXPECT_FALSE(a.acceptConnection());
+    a.connectionClosed();
+    EXPECT_TRUE(a.acceptConnection());
+    EXPECT_EQ(a.refused(), 1u);
+
+    EXPECT_TRUE(a.admit());
+    EXPECT_FALSE(a.admit());
+    a.release();
+    EXPECT_TRUE(a.admit());
+    EXPECT_EQ(a.shed(), 1u);
+    EXPECT_FALSE(a.delayControl());
+}
+
+TEST(Admission, acceptor)
+{
+    AdmissionOptions options;
+    options.maxConnections = 4;
+    Admission a(options);
+
+    // the acceptor thread of the added listeners asks while the daemon counts
+    std::thread acceptor([&a]() {
+        for (int i = 0; i < 100000; i++) {
+            a.acceptConnection();
+        }
+    });
+    for (int i = 0; i < 100000; i++) {
+        a.connectionOpened();
+        a.connectionClosed();
+    }
+    acceptor.join();
+
+    EXPECT_EQ(a.connections(), 0u);
+    EXPECT_TRUE(a.acceptConnection());
+}
+
+TEST(Admission, unlimited)
+{
+    Admission a(AdmissionOptions{});
+    for (int i = 0; i < 1000; i++) {
+        a.connectionOpened();
+        EXPECT_TRUE(a.acceptConnection());
+        EXPECT_TRUE(a.admit());
+    }
+    EXPECT_EQ(a.shed(), 0u);
+}
+
+TEST(Admission, codel)
+{
+    AdmissionOptions options;
+    options.targetDelayMs = 5;
+    options.intervalMs = 100;
+    Admission a(options);
+    ASSERT_TRUE(a.delayControl());
+
+    auto now = Admission::Clock::now();
+    auto slow = [&a, &now](milliseconds step) {
+        now += step;
+        a.observe(now - milliseconds(20), now);
+    };
+
+    // above the target, but not for a whole interval yet
+    slow(milliseconds(0));
+    slow(milliseconds(50));
+    EXPECT_FALSE(a.dropping());
+    EXPECT_TRUE(a.admitRouted(RequestPriority::LOW, now));
+
+    slow(milliseconds(60));
+    ASSERT_TRUE(a.dropping());
+
+    // the first NORMAL request is dropped right away, then one per interval / sqrt(count)
+    EXPECT_TRUE(a.admitRouted(RequestPriority::HIGH, now));
+    EXPECT_FALSE(a.admitRouted(RequestPriority::NORMAL, now));
+    EXPECT_TRUE(a.admitRouted(RequestPriority::NORMAL, now + milliseconds(50)));
+    EXPECT_FALSE(a.admitRouted(RequestPriority::NORMAL, now + milliseconds(100)));
+    EXPECT_TRUE(a.admitRouted(RequestPriority::NORMAL, now + milliseconds(160)));
+    EXPECT_FALSE(a.admitRouted(RequestPriority::NORMAL, now + milliseconds(171)));
+    EXPECT_FALSE(a.admitRouted(RequestPriority::LOW, now + milliseconds(172)));
+    EXPECT_EQ(a.shed(), 4u);
+
+    // one quick request ends the overload
+    now += milliseconds(200);
+    a.observe(now - milliseconds(1), now);
+    EXPECT_FALSE(a.dropping());
+    EXPECT_TRUE(a.admitRouted(RequestPriority::LOW, now));
+}
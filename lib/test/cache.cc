@@ -0,0 +1,196 @@
+#include "cache.h"
+
+#include <gtest/gtest.h>
+
+using namespace cppmhd;
+
+namespace
+{
+class Waiter : public HttpRequest
+{
+  public:
+    bool pausable{true};
+    int resumed{0};
+
+    virtual const char* getPath() const override
+    {
+        return "/";
+    }
+
+    virtual HttpMethod getMethod() const override
+    {
+        return HttpMethod::GET;
+    }
+
+    virtual const char* getHeader(const char*) const override
+    {
+        return nullptr;
+    }
+
+    virtual const std::string& getParam(const std::string&) const override
+    {
+        static const std::string empty;
+        return empty;
+    }
+
+    virtual bool pause() override
+    {
+        return pausable;
+    }
+
+    virtual bool resume() override
+    {
+        resumed++;
+        return true;
+    }
+};
+
+using Result = ResponseCache::Result;
+
+ResponseCache::Cached cached(const char* etag)
+{
+    return ResponseCache::Cached{
+        nullptr, 0, std::make_shared<const std::string>(etag), nullptr, etag, std::string(), {}, 0};
+}
+}  // namespace
+
+TEST(ResponseCache, coalesce)
+{
+    ResponseCache cache(1024 * 1024, 4);
+    auto now = ResponseCache::Clock::now();
+    ResponseCache::Cached out;
+    Waiter leader, a, b, c;
+
+    EXPECT_EQ(cache.lookup(1, now, &leader, out), Result::LEAD);
+    EXPECT_EQ(cache.lookup(1, now, &a, out), Result::WAIT);
+    EXPECT_EQ(cache.lookup(1, now, &b, out), Result::WAIT);
+    c.pausable = false;
+    EXPECT_EQ(cache.lookup(1, now, &c, out), Result::MISS);
+    // neither waits nor leads
+    EXPECT_EQ(cache.lookup(1, now, nullptr, out), Result::MISS);
+
+    cache.cancel(1, &b);
+    cache.store(1, cached("\"1\""), 100, now + std::chrono::seconds(10), now + std::chrono::seconds(10));
+    EXPECT_EQ(a.resumed, 1);
+    EXPECT_EQ(b.resumed, 0);
+    EXPECT_EQ(cache.size(), 1u);
+
+    EXPECT_EQ(cache.lookup(1, now, &a, out), Result::HIT);
+    EXPECT_EQ(out.etag, "\"1\"");
+    EXPECT_EQ(cache.lookup(1, now + std::chrono::seconds(10), nullptr, out), Result::MISS);
+    EXPECT_EQ(cache.size(), 0u);
+
+    // a leader without a response wakes the waiters all the same
+    EXPECT_EQ(cache.lookup(2, now, &leader, out), Result::LEAD);
+    EXPECT_EQ(cache.lookup(2, now, &a, out), Result::WAIT);
+    cache.release(2);
+    EXPECT_EQ(a.resumed, 2);
+    EXPECT_EQ(cache.lookup(2, now, &a, out), Result::LEAD);
+}
+
+TEST(ResponseCache, close)
+{
+    ResponseCache cache(1024 * 1024, 4);
+    auto now = ResponseCache::Clock::now();
+    ResponseCache::Cached out;
+    Waiter leader, a, b;
+
+    EXPECT_EQ(cache.lookup(1, now, &leader, out), Result::LEAD);
+    EXPECT_EQ(cache.lookup(1, now, &a, out), Result::WAIT);
+    EXPECT_EQ(cache.lookup(2, now, &leader, out), Result::LEAD);
+    EXPECT_EQ(cache.lookup(2, now, &b, out), Result::WAIT);
+
+    // the waiters run the handler themselves, the ones coming later do not wait
+    cache.close();
+    EXPECT_EQ(a.resumed, 1);
+    EXPECT_EQ(b.resumed, 1);
+    EXPECT_EQ(cache.lookup(1, now, &a, out), Result::MISS);
+    EXPECT_EQ(cache.lookup(3, now, &a, out), Result::MISS);
+
+    // the leader still stores its response
+    cache.store(1, cached("\"1\""), 100, now + std::chrono::seconds(10), now + std::chrono::seconds(10));
+    EXPECT_EQ(a.resumed, 1);
+    EXPECT_EQ(cache.lookup(1, now, &b, out), Result::HIT);
+    cache.release(2);
+    EXPECT_EQ(b.resumed, 1);
+}
+
+TEST(ResponseCache, stale)
+{
+    ResponseCache cache(1024 * 1024, 1);
+    auto now = ResponseCache::Clock::now();
+    ResponseCache::Cached out;
+    Waiter a, b;
+
+    cache.store(1, cached("\"1\""), 100, now + std::chrono::seconds(10), now + std::chrono::seconds(20));
+    auto later = now + std::chrono::seconds(15);
+
+    // one refreshes it, the others get the stale one meanwhile
+    EXPECT_EQ(cache.lookup(1, later, &a, out), Result::LEAD);
+    out.etag.clear();
+    EXPECT_EQ(cache.lookup(1, later, &b, out), Result::HIT);
+    EXPECT_EQ(out.etag, "\"1\"");
+    EXPECT_EQ(b.resumed, 0);
+
+    cache.store(1, cached("\"2\""), 100, later + std::chrono::seconds(10), later + std::chrono::seconds(20));
+    EXPECT_EQ(cache.lookup(1, later, &b, out), Result::HIT);
+    EXPECT_EQ(out.etag, "\"2\"");
+
+    EXPECT_EQ(cache.lookup(1, later + std::chrono::seconds(20), &a, out), Result::LEAD);
+}
+
+TEST(ResponseCache, redate)
+{
+    ResponseCache cache(1024 * 1024, 1);
+    auto now = ResponseCache::Clock::now();
+    auto fresh = now + std::chrono::seconds(10);
+    ResponseCache::Cached out;
+
+    cache.store(1, cached("\"1\""), 100, fresh, fresh);
+    EXPECT_EQ(cache.lookup(1, now, nullptr, out), Result::HIT);
+    EXPECT_EQ(out.second, 0);
+
+    // the hits of a second share its response, an earlier one does not replace it
+    auto dated = out;
+    dated.second = 2;
+    cache.redate(1, dated);
+    dated.second = 1;
+    cache.redate(1, dated);
+    EXPECT_EQ(cache.lookup(1, now, nullptr, out), Result::HIT);
+    EXPECT_EQ(out.second, 2);
+
+    // the one of a body stored before is dropped
+    cache.store(1, cached("\"2\""), 100, fresh, fresh);
+    dated.second = 3;
+    cache.redate(1, dated);
+    EXPECT_EQ(cache.lookup(1, now, nullptr, out), Result::HIT);
+    EXPECT_EQ(out.second, 0);
+    EXPECT_EQ(out.etag, "\"2\"");
+}
+
+TEST(ResponseCache, capacity)
+{
+    // one shard of 4000 bytes
+    ResponseCache cache(4000, 1);
+    auto now = ResponseCache::Clock::now();
+    auto fresh = now + std::chrono::seconds(10);
+    ResponseCache::Cached out;
+
+    for (uint64_t key = 1; key <= 3; key++) {
+        cache.store(key, cached(""), 1000, fresh, fresh);
+    }
+    EXPECT_EQ(cache.size(), 3u);
+    EXPECT_LE(cache.bytes(), 4000u);
+
+    // 1 is used, 2 is the least recently used one
+    EXPECT_EQ(cache.lookup(1, now, nullptr, out), Result::HIT);
+    cache.store(4, cached(""), 1000, fresh, fresh);
+    EXPECT_EQ(cache.lookup(2, now, nullptr, out), Result::MISS);
+    EXPECT_EQ(cache.lookup(1, now, nullptr, out), Result::HIT);
+    EXPECT_EQ(cache.lookup(4, now, nullptr, out), Result::HIT);
+
+    // larger than the shard
+    cache.store(5, cached(""), 5000, fresh, fresh);
+    EXPECT_EQ(cache.lookup(5, now, nullptr, out), Result::MISS);
+    EXPECT_LE(cache.bytes(), 4000u);
+}
@@ -0,0 +1,43 @@
+#include "clock.h"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <regex>
+#include <thread>
+#include <vector>
+
+using namespace cppmhd;
+
+TEST(Clock, format)
+{
+    auto now = CoarseClock::now();
+    EXPECT_LE(std::abs(now - time(nullptr)), 1);
+
+    auto log = CoarseClock::logTimestamp();
+    ASSERT_EQ(strlen(log), kLogTimestampLength);
+    EXPECT_TRUE(std::regex_match(log, std::regex("[0-9]{4}-[0-9]{2}-[0-9]{2} [0-9]{2}:[0-9]{2}:[0-9]{2}"))) << log;
+
+    auto date = CoarseClock::httpDate();
+    ASSERT_EQ(strlen(date), kHttpDateLength);
+    EXPECT_TRUE(std::regex_match(
+        date,
+        std::regex("(Mon|Tue|Wed|Thu|Fri|Sat|Sun), [0-9]{2} [A-Z][a-z]{2} [0-9]{4} [0-9]{2}:[0-9]{2}:[0-9]{2} GMT")))
+        << date;
+}
+
+TEST(Clock, concurrent)
+{
+    std::vector<std::thread> thr;
+    for (int t = 0; t < 4; t++) {
+        thr.emplace_back([]() {
+            for (int i = 0; i < 100000; i++) {
+                ASSERT_EQ(strlen(CoarseClock::httpDate()), kHttpDateLength);
+                ASSERT_EQ(strlen(CoarseClock::logTimestamp()), kLogTimestampLength);
+            }
+        });
+    }
+    for (auto& t : thr) {
+        t.join();
+    }
+}
@@ -0,0 +1,169 @@
+#include "compress.h"
+#include "validator.h"
+
+#include <gtest/gtest.h>
+
+#ifdef ENABLE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef ENABLE_ZSTD
+#include <zstd.h>
+#endif
+
+#ifdef ENABLE_BROTLI
+#include <brotli/decode.h>
+#endif
+
+using namespace cppmhd;
+
+namespace
+{
+std::string sample()
+{
+    std::string s;
+    for (int i = 0; i < 5000; i++) {
+        s += "{\"id\":" + std::to_string(i) + ",\"name\":\"item\"},";
+    }
+    return s;
+}
+
+// empty if the data does not decompress
+std::string decompress(Encoding encoding, const std::string &data, size_t size)
+{
+    std::string out(size, '\0');
+    switch (encoding) {
+#ifdef ENABLE_ZLIB
+        case Encoding::GZIP:
+        case Encoding::DEFLATE: {
+            z_stream zs;
+            memset(&zs, 0, sizeof(zs));
+            inflateInit2(&zs, encoding == Encoding::GZIP ? 15 + 16 : 15);
+            zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+            zs.avail_in = static_cast<uInt>(data.length());
+            zs.next_out = reinterpret_cast<Bytef *>(&out[0]);
+            zs.avail_out = static_cast<uInt>(size);
+            auto ret = inflate(&zs, Z_FINISH);
+            inflateEnd(&zs);
+            return ret == Z_STREAM_END && zs.avail_out == 0 ? out : "";
+        }
+#endif
+#ifdef ENABLE_ZSTD
+        case Encoding::ZSTD: {
+            auto n = ZSTD_decompress(&out[0], size, data.data(), data.length());
+            return n == size ? out : "";
+        }
+#endif
+#ifdef ENABLE_BROTLI
+        case Encoding::BROTLI: {
+            auto n = size;
+            auto ret = BrotliDecoderDecompress(data.length(),
+                                               reinterpret_cast<const uint8_t *>(data.data()),
+                                               &n,
+                                               reinterpret_cast<uint8_t *>(&out[0]));
+            return ret == BROTLI_DECODER_RESULT_SUCCESS && n == size ? out : "";
+        }
+#endif
+        default:
+            return "";
+    }
+}
+}  // namespace
+
+TEST(Compress, negotiate)
+{
+    EXPECT_EQ(negotiate(nullptr), Encoding::IDENTITY);
+    EXPECT_EQ(negotiate(""), Encoding::IDENTITY);
+    EXPECT_EQ(negotiate("identity"), Encoding::IDENTITY);
+    EXPECT_EQ(negotiate("compress, unknown"), Encoding::IDENTITY);
+
+    if (!encodingSupported(Encoding::GZIP)) {
+        EXPECT_EQ(negotiate("gzip, deflate"), Encoding::IDENTITY);
+        return;
+    }
+
+    EXPECT_EQ(negotiate("gzip"), Encoding::GZIP);
+    EXPECT_EQ(negotiate("x-gzip"), Encoding::GZIP);
+    EXPECT_EQ(negotiate("GZip;q=0.5"), Encoding::GZIP);
+    EXPECT_EQ(negotiate("deflate, gzip"), Encoding::GZIP);
+    EXPECT_EQ(negotiate("deflate;q=1, gzip;q=0.9"), Encoding::DEFLATE);
+    EXPECT_EQ(negotiate("gzip;q=0, deflate;q=0.001"), Encoding::DEFLATE);
+    EXPECT_EQ(negotiate("gzip;q=0"), Encoding::IDENTITY);
+    EXPECT_EQ(negotiate("gzip;q=2"), Encoding::IDENTITY);
+    EXPECT_EQ(negotiate("gzip ; q=0.8 , deflate ; q=0.7"), Encoding::GZIP);
+    EXPECT_EQ(negotiate("*;q=0.1, gzip;q=0"), encodingSupported(Encoding::BROTLI) ? Encoding::BROTLI
+                                                 : encodingSupported(Encoding::ZSTD) ? Encoding::ZSTD
+                                                                                     : Encoding::DEFLATE);
+
+    if (encodingSupported(Encoding::BROTLI)) {
+        EXPECT_EQ(negotiate("gzip, deflate, br"), Encoding::BROTLI);
+        EXPECT_EQ(negotiate("gzip, br;q=0.9"), Encoding::GZIP);
+    }
+    if (encodingSupported(Encoding::ZSTD)) {
+        EXPECT_EQ(negotiate("gzip, zstd"), Encoding::ZSTD);
+    }
+}
+
+TEST(Compress, roundTrip)
+{
+    auto body = sample();
+
+    for (auto e : {Encoding::GZIP, Encoding::DEFLATE, Encoding::ZSTD, Encoding::BROTLI}) {
+        if (!encodingSupported(e)) {
+            EXPECT_FALSE(Encoder::create(e, 6));
+            continue;
+        }
+
+        std::string out;
+        ASSERT_TRUE(compress(e, 6, body.data(), body.length(), out)) << encodingName(e);
+        EXPECT_LT(out.length(), body.length() / 4) << encodingName(e);
+        EXPECT_EQ(decompress(e, out, body.length()), body) << encodingName(e);
+
+        // streamed in small pieces, the same data comes out
+        auto encoder = Encoder::create(e, 1);
+        std::string streamed;
+        for (size_t i = 0; i < body.length(); i += 1000) {
+            ASSERT_TRUE(encoder->update(body.data() + i, std::min<size_t>(1000, body.length() - i), streamed));
+        }
+        ASSERT_TRUE(encoder->finish(streamed));
+        EXPECT_EQ(decompress(e, streamed, body.length()), body) << encodingName(e);
+    }
+
+    EXPECT_FALSE(Encoder::create(Encoding::IDENTITY, 6));
+}
+
+TEST(Compress, cache)
+{
+    auto a = xxh64("aaaa", 4);
+    auto b = xxh64("bbbb", 4);
+
+    auto big = std::make_shared<const std::string>(1000, 'x');
+    // room for two of the large entries
+    CompressionCache cache(2100);
+    CompressedBody body;
+
+    EXPECT_FALSE(cache.get(a, 4, Encoding::GZIP, body));
+    cache.put(a, 4, Encoding::GZIP, big);
+    ASSERT_TRUE(cache.get(a, 4, Encoding::GZIP, body));
+    EXPECT_EQ(body, big);
+    EXPECT_FALSE(cache.get(a, 4, Encoding::DEFLATE, body));
+    EXPECT_FALSE(cache.get(a, 3, Encoding::GZIP, body));
+
+    // a body that does not get smaller is remembered as well
+    cache.put(b, 4, Encoding::GZIP, nullptr);
+    ASSERT_TRUE(cache.get(b, 4, Encoding::GZIP, body));
+    EXPECT_FALSE(body);
+
+    // a was used after b, b goes first
+    cache.get(a, 4, Encoding::GZIP, body);
+    cache.put(a, 4, Encoding::DEFLATE, big);
+    EXPECT_EQ(cache.size(), 2u);
+    EXPECT_FALSE(cache.get(b, 4, Encoding::GZIP, body));
+    EXPECT_TRUE(cache.get(a, 4, Encoding::GZIP, body));
+    EXPECT_LE(cache.used(), 2100u);
+
+    // larger than the whole cache
+    cache.put(b, 4, Encoding::BROTLI, std::make_shared<const std::string>(3000, 'y'));
+    EXPECT_FALSE(cache.get(b, 4, Encoding::BROTLI, body));
+    EXPECT_EQ(cache.size(), 2u);
+}
@@ -0,0 +1,200 @@
+#include "form.h"
+
+#include <gtest/gtest.h>
+
+#include <map>
+
+using namespace cppmhd;
+
+namespace
+{
+class Collect : public FormSink
+{
+  public:
+    std::map<std::string, std::string> value;
+    std::map<std::string, std::string> file;
+    std::map<std::string, std::string> type;
+    std::vector<size_t> chunks;
+    bool ok = true;
+
+    virtual bool onField(const FormField &field, const char *data, uint64_t offset, size_t size) override
+    {
+        auto &v = value[field.name];
+        EXPECT_EQ(offset, v.length());
+        v.append(data, size);
+        file[field.name] = field.fileName;
+        type[field.name] = field.contentType;
+        chunks.push_back(size);
+        return ok;
+    }
+};
+
+const char *kMultipartType = "multipart/form-data; boundary=\"xYz-12\"";
+
+const std::string kMultipart =
+    "preamble\r\n"
+    "--xYz-12\r\n"
+    "Content-Disposition: form-data; name=\"text\"\r\n"
+    "\r\n"
+    "hello\r\n--xYz-1 world\r\n"
+    "--xYz-12  \r\n"
+    "content-disposition: form-data; name=\"up\"; filename=\"a;b.txt\"\r\n"
+    "Content-Type: text/plain\r\n"
+    "\r\n"
+    "line1\r\nline2\r\n\r\n"
+    "--xYz-12\r\n"
+    "Content-Disposition: form-data; name=\"empty\"\r\n"
+    "\r\n"
+    "\r\n"
+    "--xYz-12--\r\n"
+    "epilogue";
+
+void expectMultipart(const Collect &c)
+{
+    EXPECT_EQ(c.value.at("text"), "hello\r\n--xYz-1 world");
+    EXPECT_EQ(c.value.at("up"), "line1\r\nline2\r\n");
+    EXPECT_EQ(c.file.at("up"), "a;b.txt");
+    EXPECT_EQ(c.type.at("up"), "text/plain");
+    EXPECT_EQ(c.value.at("empty"), "");
+    EXPECT_EQ(c.value.size(), 3u);
+}
+}  // namespace
+
+TEST(Form, searcher)
+{
+    Searcher s("\r\n--ab");
+    bool found;
+
+    std::string data = "xx\r\n-\r\n--ab yy";
+    EXPECT_EQ(s.find(data.data(), data.length(), found), 5u);
+    EXPECT_TRUE(found);
+
+    data = "xxxxxxx\r\n--a";
+    EXPECT_EQ(s.find(data.data(), data.length(), found), 7u);
+    EXPECT_FALSE(found);
+
+    data = "xxxxxxx\r\n-a";
+    EXPECT_EQ(s.find(data.data(), data.length(), found), data.length());
+    EXPECT_FALSE(found);
+
+    data = "\r";
+    EXPECT_EQ(s.find(data.data(), data.length(), found), 0u);
+    EXPECT_FALSE(found);
+}
+
+TEST(Form, multipart)
+{
+    Collect c;
+    auto parser = FormParser::create(kMultipartType, c, 0);
+    ASSERT_TRUE(parser);
+    ASSERT_TRUE(parser->parse(kMultipart.data(), kMultipart.length()));
+    EXPECT_TRUE(parser->finish());
+    expectMultipart(c);
+}
+
+TEST(Form, multipartSplit)
+{
+    // every split point, and byte by byte
+    for (size_t i = 0; i <= kMultipart.length(); i++) {
+        Collect c;
+        auto parser = FormParser::create(kMultipartType, c, 0);
+        ASSERT_TRUE(parser->parse(kMultipart.data(), i));
+        ASSERT_TRUE(parser->parse(kMultipart.data() + i, kMultipart.length() - i));
+        EXPECT_TRUE(parser->finish());
+        expectMultipart(c);
+    }
+
+    Collect c;
+    auto parser = FormParser::create(kMultipartType, c, 0);
+    for (auto ch : kMultipart) {
+        ASSERT_TRUE(parser->parse(&ch, 1));
+    }
+    EXPECT_TRUE(parser->finish());
+    expectMultipart(c);
+}
+
+TEST(Form, multipartBad)
+{
+    Collect c;
+    EXPECT_FALSE(FormParser::create("multipart/form-data", c, 0));
+    EXPECT_FALSE(FormParser::create("multipart/form-data; boundary=", c, 0));
+    EXPECT_FALSE(FormParser::create("text/plain", c, 0));
+
+    // truncated
+    auto parser = FormParser::create(kMultipartType, c, 0);
+    ASSERT_TRUE(parser->parse(kMultipart.data(), 100));
+    EXPECT_FALSE(parser->finish());
+
+    // garbage after the boundary
+    Collect garbage;
+    std::string body = "--xYz-12xx\r\n\r\n";
+    parser = FormParser::create(kMultipartType, garbage, 0);
+    EXPECT_FALSE(parser->parse(body.data(), body.length()));
+
+    // the sink stops the parser
+    Collect stop;
+    stop.ok = false;
+    parser = FormParser::create(kMultipartType, stop, 0);
+    EXPECT_FALSE(parser->parse(kMultipart.data(), kMultipart.length()));
+}
+
+TEST(Form, coalesce)
+{
+    std::string body = "--b\r\nContent-Disposition: form-data; name=\"f\"\r\n\r\n";
+    body += std::string(1000, 'x') + "\r\n--b--";
+
+    Collect c;
+    auto parser = FormParser::create("multipart/form-data; boundary=b", c, 256);
+    for (size_t i = 0; i < body.length(); i += 7) {
+        ASSERT_TRUE(parser->parse(body.data() + i, std::min<size_t>(7, body.length() - i)));
+    }
+    EXPECT_TRUE(parser->finish());
+
+    EXPECT_EQ(c.value["f"], std::string(1000, 'x'));
+    ASSERT_EQ(c.chunks.size(), 4u);
+    EXPECT_EQ(c.chunks[0], 256u);
+    EXPECT_EQ(c.chunks[3], 1000u - 3 * 256);
+}
+
+TEST(Form, urlencoded)
+{
+    std::string body = "a=1+2%3D3&b=%zz%4&&flag&c=%e4%bD%a0&d=";
+
+    for (size_t i = 0; i <= body.length(); i++) {
+        Collect c;
+        auto parser = FormParser::create("application/x-www-form-urlencoded", c, 0);
+        ASSERT_TRUE(parser);
+        ASSERT_TRUE(parser->parse(body.data(), i));
+        ASSERT_TRUE(parser->parse(body.data() + i, body.length() - i));
+        EXPECT_TRUE(parser->finish());
+
+        EXPECT_EQ(c.value["a"], "1 2=3");
+        EXPECT_EQ(c.value["b"], "%zz%4");
+        EXPECT_EQ(c.value["flag"], "");
+        EXPECT_EQ(c.value["c"], "\xe4\xbd\xa0");
+        EXPECT_EQ(c.value["d"], "");
+        EXPECT_EQ(c.value.size(), 5u);
+    }
+
+    Collect c;
+    auto parser = FormParser::create("application/x-www-form-urlencoded", c, 0);
+    body = "k%2";
+    ASSERT_TRUE(parser->parse(body.data(), body.length()));
+    EXPECT_FALSE(parser->finish());
+}
+
+TEST(Form, urlencodedLongName)
+{
+    Collect c;
+    auto parser = FormParser::create("application/x-www-form-urlencoded", c, 0);
+    ASSERT_TRUE(parser);
+
+    // the name is kept whole, it can not grow without a bound
+    std::string name(4096, 'k');
+    bool ok = true;
+    for (int i = 0; i < 4 && ok; i++) {
+        ok = parser->parse(name.data(), name.length());
+    }
+    EXPECT_FALSE(ok);
+    EXPECT_EQ(c.value.size(), 0u);
+}
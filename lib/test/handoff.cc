@@ -0,0 +1,54 @@
+#include "handoff.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdlib>
+
+using namespace cppmhd;
+
+TEST(Handoff, notStartedByRestart)
+{
+    unsetenv(kHandoffEnv);
+    std::vector<int> fds;
+    int conn = -1;
+    EXPECT_FALSE(takeOver(fds, conn));
+
+    // not an fd, or not the one of a socket pair
+    setenv(kHandoffEnv, "/nonexistent/cppmhd-handoff.sock", 1);
+    EXPECT_FALSE(takeOver(fds, conn));
+    EXPECT_TRUE(fds.empty());
+    EXPECT_EQ(getenv(kHandoffEnv), nullptr);
+    auto fd = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_GE(fd, 0);
+    setenv(kHandoffEnv, std::to_string(fd).c_str(), 1);
+    EXPECT_FALSE(takeOver(fds, conn));
+    close(fd);
+
+    // the old process is gone
+    int pair[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, pair), 0);
+    close(pair[0]);
+    setenv(kHandoffEnv, std::to_string(pair[1]).c_str(), 1);
+    EXPECT_FALSE(takeOver(fds, conn));
+    EXPECT_TRUE(fds.empty());
+}
+
+TEST(Handoff, newProcessFails)
+{
+    auto fd = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_GE(fd, 0);
+
+    EXPECT_FALSE(handOver({}, {fd}, 1));
+    EXPECT_FALSE(handOver({"/bin/true"}, {}, 1));
+
+    // exits without taking the sockets
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_FALSE(handOver({"/nonexistent/cppmhd"}, {fd}, 1));
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(3));
+
+    close(fd);
+}
@@ -0,0 +1,54 @@
+#include "header.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+
+using namespace cppmhd;
+
+TEST(Header, classify)
+{
+    for (auto i = 0u; i < kKnownHeaderCount; i++) {
+        auto h = static_cast<KnownHeader>(i);
+        auto name = knownHeaderName(h);
+        ASSERT_NE(name, nullptr);
+        EXPECT_EQ(classifyHeader(name), h) << name;
+
+        std::string lower(name), upper(name);
+        std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+        std::transform(upper.begin(), upper.end(), upper.begin(), ::toupper);
+        EXPECT_EQ(classifyHeader(lower.c_str()), h) << lower;
+        EXPECT_EQ(classifyHeader(upper.c_str()), h) << upper;
+    }
+
+    const char* unknowns[] = {"", "Hos", "Hostt", "X-Request-Id", "Accept", "Content-Lengths", "If-Match", "Cookie2"};
+    for (auto u : unknowns) {
+        EXPECT_EQ(classifyHeader(u), KnownHeader::UNKNOWN) << u;
+    }
+    EXPECT_EQ(classifyHeader(nullptr), KnownHeader::UNKNOWN);
+    EXPECT_EQ(knownHeaderName(KnownHeader::UNKNOWN), nullptr);
+}
+
+TEST(Header, index)
+{
+    HeaderIndex index;
+    index.add("host", "example.com");
+    index.add("X-Request-Id", "abc");
+    index.add("Content-Type", "text/plain");
+    index.add("HOST", "second.example.com");
+    index.finish();
+
+    EXPECT_TRUE(index.built());
+    EXPECT_STREQ(index.get(KnownHeader::HOST), "example.com");
+    EXPECT_STREQ(index.get("Host"), "example.com");
+    EXPECT_STREQ(index.get(KnownHeader::CONTENT_TYPE), "text/plain");
+    EXPECT_STREQ(index.get("x-request-id"), "abc");
+    EXPECT_EQ(index.get(KnownHeader::COOKIE), nullptr);
+    EXPECT_EQ(index.get("X-Not-Exist"), nullptr);
+    EXPECT_EQ(index.get(static_cast<const char*>(nullptr)), nullptr);
+
+    const auto& all = index.all();
+    ASSERT_EQ(all.size(), 4u);
+    EXPECT_STREQ(all[1].first, "X-Request-Id");
+    EXPECT_STREQ(all[3].second, "second.example.com");
+}
@@ -97,6 +97,12 @@ void Curl::addRequestHeader(const std::string &key, const std::string &value)
     reqHeader = curl_slist_append(reqHeader, header.c_str());
 }
 
+void Curl::insecure()
+{
+    CURL_PROCESS(curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L));
+    CURL_PROCESS(curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L));
+}
+
 void Curl::followLocation()
 {
     CURL_PROCESS(curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L));
@@ -141,6 +141,9 @@ class Curl
     void mime_uploadfile(const std::string& name, const std::string& filename);
 
     void followLocation();
+
+    // the certificate of the server is not checked
+    void insecure();
     void perform();
     int status() const
     {
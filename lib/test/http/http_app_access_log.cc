@@ -0,0 +1,95 @@
+#include <unistd.h>
+
+#include <fstream>
+#include <sstream>
+
+#include "http_app.h"
+
+TEST_F(HttpApp, accessLog)
+{
+    char name[] = "/tmp/cppmhd-access-log-XXXXXX";
+    close(mkstemp(name));
+
+    auto mock = add<TestCtrl>(HttpMethod::GET, "/user/{\\d+:id}");
+    app->accessLog().path = name;
+    start();
+
+    DEFAULT_MOCK_REQUEST(mock);
+    DEFAULT_MOCK_CONNECTION(mock);
+    DEFAULT_MOCK_REQUEST_TIMES(mock, 1);
+    DEFAULT_MOCK_CONNECTION_TIMES(mock, 1);
+
+    Curl c1 = curl("/user/123");
+    c1.perform();
+    EXPECT_EQ(c1.status(), k200OK);
+
+    Curl c2 = curl("/nothing");
+    c2.perform();
+    EXPECT_EQ(c2.status(), k404NotFound);
+
+    // the access log is flushed when the server stops
+    app->stop();
+    thr.join();
+
+    std::ifstream in(name);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    auto log = ss.str();
+
+    EXPECT_NE(log.find("\"method\":\"GET\",\"path\":\"/user/123\",\"route\":\"/user/{\\\\d+:id}\",\"status\":200"),
+              std::string::npos)
+        << log;
+    EXPECT_NE(log.find("\"path\":\"/nothing\",\"status\":404"), std::string::npos) << log;
+    EXPECT_NE(log.find("\"client\":\"127.0.0.1:"), std::string::npos) << log;
+
+    unlink(name);
+}
+
+namespace
+{
+const std::string kLogBody(1000, 'x');
+
+class LogBodyCtrl : public HttpController
+{
+  public:
+    virtual void onRequest(HttpRequestPtr, HttpResponsePtr& resp) override
+    {
+        resp = std::make_shared<HttpResponse>();
+        resp->status(k200OK);
+        resp->body(kLogBody.length(), kLogBody.data(), true);
+    }
+};
+}  // namespace
+
+TEST_F(HttpApp, accessLogBytesOut)
+{
+    char name[] = "/tmp/cppmhd-access-log-XXXXXX";
+    close(mkstemp(name));
+
+    add<LogBodyCtrl>(HttpMethod::GET, "/body");
+    app->accessLog().path = name;
+    start();
+
+    Curl whole = curl("/body");
+    whole.perform();
+    EXPECT_EQ(whole.body().length(), kLogBody.length());
+
+    // the bytes of the 206 are logged, not the ones of the body the handler returned
+    Curl part = curl("/body");
+    part.addRequestHeader(CPPMHD_HTTP_HEADER_RANGE, "bytes=0-99");
+    part.perform();
+    EXPECT_EQ(part.status(), k206PartialContent);
+
+    app->stop();
+    thr.join();
+
+    std::ifstream in(name);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    auto log = ss.str();
+
+    EXPECT_NE(log.find("\"status\":200,\"bytes_in\":0,\"bytes_out\":1000,"), std::string::npos) << log;
+    EXPECT_NE(log.find("\"status\":206,\"bytes_in\":0,\"bytes_out\":100,"), std::string::npos) << log;
+
+    unlink(name);
+}
@@ -0,0 +1,54 @@
+#include "http_app.h"
+
+#define FORMAT_INETADDRESS
+#include "format.h"
+
+TEST_F(HttpApp, admissionInflight)
+{
+    auto post = add<TestCtrl>(HttpMethod::POST, myName);
+    auto get = add<TestCtrl>(HttpMethod::GET, myName);
+    app->threadCount(1);
+    app->admission().maxInflight = 1;
+    app->admission().retryAfter = 3;
+    start();
+
+    DEFAULT_MOCK_CONNECTION(post);
+    DEFAULT_MOCK_CONNECTION_TIMES(post, 1);
+    DEFAULT_MOCK_CONNECTION(get);
+    DEFAULT_MOCK_CONNECTION_TIMES(get, 1);
+    DEFAULT_MOCK_REQUEST(get);
+    DEFAULT_MOCK_REQUEST_TIMES(get, 1);
+
+    InetAddress addr;
+    ASSERT_TRUE(InetAddress::parse(addr, host, port));
+
+    // half of the body, the request stays in flight until the client goes away
+    auto req = FORMAT(
+        "POST {} HTTP/1.1\r\n"
+        "Host: {}\r\n"
+        "Content-Type: text/plain\r\n"
+        "Content-Length: 10\r\n"
+        "\r\n"
+        "Hello",
+        myName,
+        host);
+
+    auto sock = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_GT(sock, 0) << fmt::format("socket(AF_INET, SOCK_STREAM, 0) failed: {}", strerror(errno));
+    ASSERT_EQ(connect(sock, addr.getSocket(), addr.socketLen()), 0)
+        << fmt::format("connect to {:a} failed: {}", addr, strerror(errno));
+    ASSERT_EQ(req.length(), send(sock, req.data(), req.length(), 0)) << fmt::format("send failed: {}", strerror(errno));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    Curl shed = curl();
+    shed.perform();
+    EXPECT_EQ(shed.status(), k503ServiceUnavailable);
+    EXPECT_EQ(shed.body(), "Service Unavailable");
+
+    close(sock);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    Curl ok = curl();
+    ok.perform();
+    EXPECT_EQ(ok.status(), k200OK);
+}
@@ -0,0 +1,79 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "http_app.h"
+
+namespace
+{
+// consumes at most half of every buffer and pauses, a thread resumes it a little later
+class SlowProcessor : public DataProcessor
+{
+    std::string& body_;
+    std::atomic<int>& pauses_;
+
+  public:
+    SlowProcessor(std::string& body, std::atomic<int>& pauses) : body_(body), pauses_(pauses) {}
+
+    virtual size_t onData(HttpRequestPtr& req, const void* in, size_t size) override
+    {
+        if (size == 0) {
+            return 0;
+        }
+
+        auto n = (size + 1) / 2;
+        body_.append(reinterpret_cast<const char*>(in), n);
+        if (pauses_ < 16 && req->pause()) {
+            pauses_++;
+            EXPECT_TRUE(req->pause());
+            std::thread([req]() {
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+                EXPECT_TRUE(req->resume());
+                EXPECT_FALSE(req->resume());
+            }).detach();
+        }
+        return n;
+    }
+};
+
+class SlowController : public HttpController
+{
+  public:
+    std::string body;
+    std::atomic<int> pauses{0};
+
+    virtual void onConnection(HttpRequestPtr req, HttpResponsePtr&) override
+    {
+        EXPECT_FALSE(req->resume());
+        body.clear();
+        req->setProcessor(std::make_shared<SlowProcessor>(body, pauses));
+    }
+
+    virtual void onRequest(HttpRequestPtr, HttpResponsePtr& resp) override
+    {
+        resp = std::make_shared<HttpResponse>();
+        resp->status(k200OK);
+        resp->body(std::to_string(body.length()));
+    }
+};
+}  // namespace
+
+TEST_F(HttpApp, backpressure)
+{
+    auto mock = add<SlowController>(HttpMethod::PUT, myName);
+    start();
+
+    std::string sent;
+    for (int i = 0; i < 50 * 1000; i++) {
+        sent += static_cast<char>('a' + i % 26);
+    }
+
+    auto c = curl();
+    c.method(HttpMethod::PUT);
+    c.upload(sent, CPPMHD_HTTP_MIME_APPLICATION_OCTET);
+    c.perform();
+    ASSERT_EQ(c.status(), k200OK);
+    EXPECT_EQ(c.body(), std::to_string(sent.length()));
+    EXPECT_EQ(mock->body, sent);
+    EXPECT_GT(mock->pauses, 0);
+}
@@ -108,6 +108,7 @@ TEST_F(HttpApp, simpleTsr)
     h1.perform();
     EXPECT_EQ(h1.status(), k301MovePermanently);
     EXPECT_EQ(h1.headers()["Location"], myName + "/");
+    EXPECT_EQ(h1.headers()["Date"].size(), 29u);
 
     Curl h2(host, port, myName);
     h2.followLocation();
@@ -127,6 +128,30 @@ TEST_F(HttpApp, badMethod)
     EXPECT_EQ(h1.status(), k405MethodNotAllowed);
 }
 
+TEST_F(HttpApp, extensionMethod)
+{
+    HttpMethod propfind;
+    ASSERT_TRUE(registerHttpMethod("PROPFIND", propfind));
+
+    auto mock = add<TestCtrl>(propfind, myName);
+    start();
+
+    DEFAULT_MOCK_REQUEST(mock);
+    DEFAULT_MOCK_CONNECTION(mock);
+    DEFAULT_MOCK_REQUEST_TIMES(mock, 1);
+    DEFAULT_MOCK_CONNECTION_TIMES(mock, 1);
+
+    Curl h1(host, port, myName);
+    h1.method(propfind);
+    h1.perform();
+    EXPECT_EQ(h1.status(), k200OK);
+
+    Curl h2(host, port, myName);
+    h2.setup(CURLOPT_CUSTOMREQUEST, "PROPFINDX");
+    h2.perform();
+    EXPECT_EQ(h2.status(), k405MethodNotAllowed);
+}
+
 TEST_F(HttpApp, bodyInGet)
 {
     auto mock = add<TestCtrl>(HttpMethod::GET, myName);
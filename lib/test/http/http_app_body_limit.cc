@@ -0,0 +1,111 @@
+#include "http_app.h"
+
+#define FORMAT_INETADDRESS
+#include "format.h"
+
+namespace
+{
+class DiscardProcessor : public DataProcessor
+{
+  public:
+    virtual size_t onData(HttpRequestPtr&, const void*, size_t size) override
+    {
+        return size;
+    }
+};
+
+class BodyCtrl : public HttpController
+{
+    uint64_t limit_;
+
+  public:
+    explicit BodyCtrl(uint64_t limit) : limit_(limit) {}
+
+    virtual uint64_t maxBodySize() const override
+    {
+        return limit_;
+    }
+
+    virtual void onConnection(HttpRequestPtr req, HttpResponsePtr&) override
+    {
+        req->setProcessor(std::make_shared<DiscardProcessor>());
+    }
+
+    virtual void onRequest(HttpRequestPtr, HttpResponsePtr& resp) override
+    {
+        resp = std::make_shared<HttpResponse>();
+        resp->status(k200OK);
+    }
+};
+}  // namespace
+
+TEST_F(HttpApp, bodyLimit)
+{
+    add<BodyCtrl>(HttpMethod::PUT, myName, 0);
+    add<BodyCtrl>(HttpMethod::PUT, "/bodyLimitRoute", 1000);
+    app->maxBodySize(10);
+    start();
+
+    auto small = curl();
+    small.method(HttpMethod::PUT);
+    small.upload("0123456789");
+    small.perform();
+    EXPECT_EQ(small.status(), k200OK);
+
+    auto large = curl();
+    large.method(HttpMethod::PUT);
+    large.upload(std::string(100, 'x'));
+    large.perform();
+    EXPECT_EQ(large.status(), k413PayloadTooLarge);
+    EXPECT_EQ(large.body(), "Payload Too Large");
+
+    // the route has its own limit
+    auto route = curl("/bodyLimitRoute");
+    route.method(HttpMethod::PUT);
+    route.upload(std::string(1000, 'x'));
+    route.perform();
+    EXPECT_EQ(route.status(), k200OK);
+
+    auto over = curl("/bodyLimitRoute");
+    over.method(HttpMethod::PUT);
+    over.upload(std::string(5000, 'x'));
+    over.perform();
+    EXPECT_EQ(over.status(), k413PayloadTooLarge);
+}
+
+TEST_F(HttpApp, bodyLimitExpect)
+{
+    add<BodyCtrl>(HttpMethod::PUT, myName, 10);
+    start();
+
+    InetAddress addr;
+    ASSERT_TRUE(InetAddress::parse(addr, host, port));
+
+    // the client waits for 100 Continue before sending the body, it gets the 413 instead
+    auto req = FORMAT(
+        "PUT {} HTTP/1.1\r\n"
+        "Host: {}\r\n"
+        "Content-Length: 1000000\r\n"
+        "Expect: 100-continue\r\n"
+        "\r\n",
+        myName,
+        host);
+
+    auto sock = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_GT(sock, 0) << fmt::format("socket(AF_INET, SOCK_STREAM, 0) failed: {}", strerror(errno));
+    ASSERT_EQ(connect(sock, addr.getSocket(), addr.socketLen()), 0)
+        << fmt::format("connect to {:a} failed: {}", addr, strerror(errno));
+    ASSERT_EQ(req.length(), send(sock, req.data(), req.length(), 0)) << fmt::format("send failed: {}", strerror(errno));
+
+    std::string resp;
+    char buffer[1024];
+    ssize_t n;
+    while ((n = recv(sock, buffer, sizeof(buffer), 0)) > 0) {
+        resp.append(buffer, n);
+    }
+    close(sock);
+
+    EXPECT_EQ(resp.find("HTTP/1.1 413"), 0u) << resp;
+    EXPECT_EQ(resp.find("100 Continue"), std::string::npos);
+    EXPECT_NE(resp.find("Connection: close"), std::string::npos);
+}
@@ -0,0 +1,134 @@
+#include <atomic>
+#include <thread>
+
+#include "http_app.h"
+
+namespace
+{
+class CatalogueCtrl : public HttpController
+{
+    CachePolicy policy_;
+
+  public:
+    std::atomic<int> calls{0};
+
+    explicit CatalogueCtrl(uint32_t ttl) : policy_{ttl, 0, {"X-Tenant"}} {}
+
+    virtual CachePolicy cachePolicy() const override
+    {
+        return policy_;
+    }
+
+    virtual void onRequest(HttpRequestPtr req, HttpResponsePtr& resp) override
+    {
+        calls++;
+        // long enough for the other requests to arrive
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        auto tenant = req->getHeader("X-Tenant");
+        resp = std::make_shared<HttpResponse>();
+        resp->status(k200OK);
+        resp->body(std::string("catalogue of ") + (tenant != nullptr ? tenant : "all"));
+        resp->header(CPPMHD_HTTP_HEADER_CONTENT_TYPE) = CPPMHD_HTTP_MIME_TEXT_PLAIN;
+        resp->header(CPPMHD_HTTP_HEADER_CACHE_CONTROL) = "max-age=60";
+    }
+};
+
+class PrivateCtrl : public HttpController
+{
+  public:
+    std::atomic<int> calls{0};
+
+    virtual CachePolicy cachePolicy() const override
+    {
+        return CachePolicy{60, 0, {}};
+    }
+
+    virtual void onRequest(HttpRequestPtr, HttpResponsePtr& resp) override
+    {
+        calls++;
+        resp = std::make_shared<HttpResponse>();
+        resp->status(k200OK);
+        resp->body("mine");
+        resp->header(CPPMHD_HTTP_HEADER_CACHE_CONTROL) = "private";
+    }
+};
+}  // namespace
+
+TEST_F(HttpApp, responseCacheCoalesce)
+{
+    app->threadCount(4);
+    auto ctrl = add<CatalogueCtrl>(HttpMethod::GET, "/catalogue", 60);
+    start();
+
+    std::vector<std::thread> clients;
+    std::atomic<int> ok{0};
+    for (int i = 0; i < 8; i++) {
+        clients.emplace_back([&] {
+            auto c = curl("/catalogue");
+            c.perform();
+            if (c.status() == k200OK && c.body() == "catalogue of all") {
+                ok++;
+            }
+        });
+    }
+    for (auto& t : clients) {
+        t.join();
+    }
+    EXPECT_EQ(ok, 8);
+    EXPECT_EQ(ctrl->calls, 1);
+
+    auto hit = curl("/catalogue");
+    hit.perform();
+    EXPECT_EQ(hit.body(), "catalogue of all");
+    auto etag = hit.headers()[CPPMHD_HTTP_HEADER_ETAG];
+    EXPECT_EQ(ctrl->calls, 1);
+
+    auto conditional = curl("/catalogue");
+    conditional.addRequestHeader(CPPMHD_HTTP_HEADER_IF_NONE_MATCH, etag);
+    conditional.perform();
+    EXPECT_EQ(conditional.status(), k304NotModified);
+    EXPECT_EQ(conditional.headers()[CPPMHD_HTTP_HEADER_ETAG], etag);
+    EXPECT_EQ(conditional.headers()[CPPMHD_HTTP_HEADER_CACHE_CONTROL], "max-age=60");
+    EXPECT_EQ(ctrl->calls, 1);
+
+    // another variant
+    auto tenant = curl("/catalogue");
+    tenant.addRequestHeader("X-Tenant", "acme");
+    tenant.perform();
+    EXPECT_EQ(tenant.body(), "catalogue of acme");
+    EXPECT_EQ(ctrl->calls, 2);
+}
+
+TEST_F(HttpApp, responseCacheNoStore)
+{
+    auto ctrl = add<PrivateCtrl>(HttpMethod::GET, myName);
+    start();
+
+    for (int i = 0; i < 2; i++) {
+        auto c = curl();
+        c.perform();
+        EXPECT_EQ(c.body(), "mine");
+    }
+    EXPECT_EQ(ctrl->calls, 2);
+}
+
+TEST_F(HttpApp, responseCacheDate)
+{
+    auto ctrl = add<CatalogueCtrl>(HttpMethod::GET, "/catalogue", 60);
+    start();
+
+    auto first = curl("/catalogue");
+    first.perform();
+    auto date = first.headers()[CPPMHD_HTTP_HEADER_DATE];
+    EXPECT_NE(date, "");
+
+    // a hit of a later second has the Date of its own
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    auto hit = curl("/catalogue");
+    hit.perform();
+    EXPECT_EQ(hit.body(), "catalogue of all");
+    EXPECT_NE(hit.headers()[CPPMHD_HTTP_HEADER_DATE], "");
+    EXPECT_NE(hit.headers()[CPPMHD_HTTP_HEADER_DATE], date);
+    EXPECT_EQ(ctrl->calls, 1);
+}
@@ -0,0 +1,135 @@
+#include "config.h"
+
+#ifdef ENABLE_ZLIB
+
+#include <zlib.h>
+
+#include "http_app.h"
+
+namespace
+{
+std::string text()
+{
+    std::string s;
+    for (int i = 0; i < 20000; i++) {
+        s += "line " + std::to_string(i % 100) + " of a compressible body\n";
+    }
+    return s;
+}
+
+std::string gunzip(const std::string& data)
+{
+    std::string out;
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    inflateInit2(&zs, 15 + 16);
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    zs.avail_in = static_cast<uInt>(data.length());
+
+    char buf[16384];
+    int ret;
+    do {
+        zs.next_out = reinterpret_cast<Bytef*>(buf);
+        zs.avail_out = sizeof(buf);
+        ret = inflate(&zs, Z_NO_FLUSH);
+        out.append(buf, sizeof(buf) - zs.avail_out);
+    } while (ret == Z_OK);
+    inflateEnd(&zs);
+    return ret == Z_STREAM_END ? out : "";
+}
+
+class TextCtrl : public HttpController
+{
+    const std::string& body_;
+    bool persistent_;
+    const char* type_;
+
+  public:
+    TextCtrl(const std::string& body, bool persistent, const char* type)
+        : body_(body), persistent_(persistent), type_(type)
+    {
+    }
+
+    virtual void onRequest(HttpRequestPtr, HttpResponsePtr& resp) override
+    {
+        resp = std::make_shared<HttpResponse>();
+        resp->status(k200OK);
+        resp->body(body_.length(), body_.data(), persistent_);
+        resp->header(CPPMHD_HTTP_HEADER_CONTENT_TYPE) = type_;
+    }
+};
+}  // namespace
+
+TEST_F(HttpApp, compression)
+{
+    static const std::string body = text();
+    static const std::string small = "too small to compress";
+
+    add<TextCtrl>(HttpMethod::GET, "/copied", body, false, "text/plain; charset=utf-8");
+    add<TextCtrl>(HttpMethod::GET, "/persistent", body, true, CPPMHD_HTTP_MIME_APPLICATION_JSON);
+    add<TextCtrl>(HttpMethod::GET, "/small", small, false, CPPMHD_HTTP_MIME_TEXT_PLAIN);
+    add<TextCtrl>(HttpMethod::GET, "/binary", body, false, CPPMHD_HTTP_MIME_APPLICATION_OCTET);
+    app->compression().enable = true;
+    app->compression().streamSize = 64 * 1024;
+    start();
+
+    // larger than streamSize, compressed while it is sent
+    auto copied = curl("/copied");
+    copied.addRequestHeader(CPPMHD_HTTP_HEADER_ACCEPT_ENCODING, "gzip, deflate");
+    copied.perform();
+    ASSERT_EQ(copied.status(), k200OK);
+    EXPECT_EQ(copied.headers()[CPPMHD_HTTP_HEADER_CONTENT_ENCODING], "gzip");
+    EXPECT_EQ(copied.headers()[CPPMHD_HTTP_HEADER_VARY], CPPMHD_HTTP_HEADER_ACCEPT_ENCODING);
+    EXPECT_LT(copied.body().length(), body.length() / 4);
+    EXPECT_EQ(gunzip(copied.body()), body);
+
+    // compressed once, then served from the cache
+    for (int i = 0; i < 3; i++) {
+        auto persistent = curl("/persistent");
+        persistent.addRequestHeader(CPPMHD_HTTP_HEADER_ACCEPT_ENCODING, "gzip");
+        persistent.perform();
+        ASSERT_EQ(persistent.status(), k200OK);
+        EXPECT_EQ(persistent.headers()[CPPMHD_HTTP_HEADER_CONTENT_ENCODING], "gzip");
+        EXPECT_EQ(persistent.headers()[CPPMHD_HTTP_HEADER_CONTENT_LENGTH], std::to_string(persistent.body().length()));
+        EXPECT_EQ(gunzip(persistent.body()), body);
+    }
+
+    // the client takes no encoding we have
+    auto identity = curl("/persistent");
+    identity.addRequestHeader(CPPMHD_HTTP_HEADER_ACCEPT_ENCODING, "gzip;q=0, compress");
+    identity.perform();
+    EXPECT_EQ(identity.headers().count(CPPMHD_HTTP_HEADER_CONTENT_ENCODING), 0u);
+    EXPECT_EQ(identity.headers()[CPPMHD_HTTP_HEADER_VARY], CPPMHD_HTTP_HEADER_ACCEPT_ENCODING);
+    EXPECT_EQ(identity.body(), body);
+
+    for (auto path : {"/small", "/binary"}) {
+        auto c = curl(path);
+        c.addRequestHeader(CPPMHD_HTTP_HEADER_ACCEPT_ENCODING, "gzip");
+        c.perform();
+        EXPECT_EQ(c.headers().count(CPPMHD_HTTP_HEADER_CONTENT_ENCODING), 0u) << path;
+        EXPECT_EQ(c.headers().count(CPPMHD_HTTP_HEADER_VARY), 0u) << path;
+    }
+}
+
+TEST_F(HttpApp, compressionChanged)
+{
+    static std::string body = text();
+
+    add<TextCtrl>(HttpMethod::GET, myName, body, true, CPPMHD_HTTP_MIME_TEXT_PLAIN);
+    app->compression().enable = true;
+    start();
+
+    for (int i = 0; i < 2; i++) {
+        auto c = curl();
+        c.addRequestHeader(CPPMHD_HTTP_HEADER_ACCEPT_ENCODING, "gzip");
+        c.perform();
+        ASSERT_EQ(c.status(), k200OK);
+        EXPECT_EQ(c.headers()[CPPMHD_HTTP_HEADER_CONTENT_ENCODING], "gzip");
+        EXPECT_EQ(gunzip(c.body()), body) << i;
+
+        // the same address and size, other bytes: not the cached variant
+        body[0] = 'L';
+    }
+}
+
+#endif
@@ -0,0 +1,67 @@
+#include <future>
+
+#include "http_app.h"
+
+namespace
+{
+class SlowCtrl : public HttpController
+{
+  public:
+    virtual void onRequest(HttpRequestPtr, HttpResponsePtr& resp) override
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        resp = std::make_shared<HttpResponse>();
+        resp->status(k200OK);
+        resp->body("done");
+        resp->header(CPPMHD_HTTP_HEADER_CONTENT_TYPE) = CPPMHD_HTTP_MIME_TEXT_PLAIN;
+    }
+};
+}  // namespace
+
+TEST_F(HttpApp, drainInflight)
+{
+    add<SlowCtrl>(HttpMethod::GET, myName);
+    app->shutdown().drainTimeout = 5;
+    start();
+
+    auto slow = std::async(std::launch::async, [this]() {
+        auto c = curl();
+        c.perform();
+        return std::make_pair(c.status(), c.body());
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    app->drain();
+    auto result = slow.get();
+    EXPECT_EQ(result.first, k200OK);
+    EXPECT_EQ(result.second, "done");
+
+    thr.join();
+    EXPECT_FALSE(app->isRunning());
+
+    // nothing listens anymore
+    auto refused = curl();
+    refused.perform();
+    EXPECT_NE(refused.status(), k200OK);
+}
+
+TEST_F(HttpApp, drainTimeout)
+{
+    add<SlowCtrl>(HttpMethod::GET, myName);
+    app->shutdown().drainTimeout = 0;
+    start();
+
+    auto slow = std::async(std::launch::async, [this]() {
+        auto c = curl();
+        c.perform();
+        return c.status();
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    // cut off at once
+    auto begin = std::chrono::steady_clock::now();
+    app->drain();
+    thr.join();
+    EXPECT_LT(std::chrono::steady_clock::now() - begin, std::chrono::milliseconds(1000));
+    slow.get();
+}
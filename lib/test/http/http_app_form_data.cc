@@ -133,4 +133,17 @@ TEST_F(HttpApp, formData)
 #endif
 
     delete[] block;
-}
\ No newline at end of file
+}
+
+TEST_F(HttpApp, formDataTruncated)
+{
+    auto mock = add<FormCtrl>(HttpMethod::POST, myName, this);
+    DEFAULT_MOCK_REQUEST_TIMES(mock, 0);
+    start();
+
+    // the body ends inside a part, without the close delimiter
+    auto c = curl();
+    c.upload("--xYz\r\nContent-Disposition: form-data; name=\"a\"\r\n\r\n10", "multipart/form-data; boundary=xYz");
+    c.perform();
+    EXPECT_EQ(c.status(), k400BadRequest);
+}
@@ -0,0 +1,69 @@
+#include <cppmhd/json.h>
+
+#include "http_app.h"
+
+namespace
+{
+class JsonCtrl : public JsonController
+{
+  public:
+    std::string name;
+    int64_t count = 0;
+
+    explicit JsonCtrl(const JsonLimits& limits) : JsonController(limits) {}
+
+    virtual void onRequest(HttpRequestPtr, const JsonValue& body, HttpResponsePtr& resp) override
+    {
+        auto n = body.find("name");
+        name = n != nullptr ? n->str() : "";
+        auto items = body.find("items");
+        count = items != nullptr ? static_cast<int64_t>(items->size()) : -1;
+
+        resp = std::make_shared<HttpResponse>();
+        resp->status(k200OK);
+    }
+};
+}  // namespace
+
+TEST_F(HttpApp, json)
+{
+    auto mock = add<JsonCtrl>(HttpMethod::POST, myName, JsonLimits());
+    start();
+
+    std::string body = "{\"name\": \"cppmhd\", \"items\": [";
+    for (int i = 0; i < 10000; i++) {
+        body += i == 0 ? "1" : ",1";
+    }
+    body += "]}";
+
+    auto c = curl();
+    c.method(HttpMethod::POST);
+    c.upload(body, CPPMHD_HTTP_MIME_APPLICATION_JSON);
+    c.perform();
+    EXPECT_EQ(c.status(), k200OK);
+    EXPECT_EQ(mock->name, "cppmhd");
+    EXPECT_EQ(mock->count, 10000);
+}
+
+TEST_F(HttpApp, jsonBad)
+{
+    JsonLimits limits;
+    limits.maxDepth = 2;
+    add<JsonCtrl>(HttpMethod::POST, myName, limits);
+    start();
+
+    // rejected while streaming
+    auto c = curl();
+    c.method(HttpMethod::POST);
+    c.upload("[[[1]]]", CPPMHD_HTTP_MIME_APPLICATION_JSON);
+    c.perform();
+    EXPECT_EQ(c.status(), k400BadRequest);
+
+    // ends inside the document
+    auto t = curl();
+    t.method(HttpMethod::POST);
+    t.upload("{\"name\": ", CPPMHD_HTTP_MIME_APPLICATION_JSON);
+    t.perform();
+    EXPECT_EQ(t.status(), k400BadRequest);
+    EXPECT_EQ(t.body(), "incomplete document at byte 9");
+}
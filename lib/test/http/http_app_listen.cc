@@ -0,0 +1,76 @@
+#include <sys/un.h>
+
+#include "http_app.h"
+
+#define FORMAT_INETADDRESS
+#include "format.h"
+
+TEST_F(HttpApp, listenFd)
+{
+    auto get = add<TestCtrl>(HttpMethod::GET, myName);
+    DEFAULT_MOCK_CONNECTION(get);
+    DEFAULT_MOCK_REQUEST(get);
+
+    // bound by somebody else, on another port than the one of the App
+    InetAddress addr;
+    ASSERT_TRUE(InetAddress::parse(addr, host, port + 1));
+    auto fd = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_GE(fd, 0);
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    ASSERT_EQ(bind(fd, addr.getSocket(), addr.socketLen()), 0) << strerror(errno);
+    ASSERT_EQ(listen(fd, 16), 0);
+
+    app->listen().fds.push_back(fd);
+    start();
+
+    Curl c(host, port + 1, myName);
+    c.perform();
+    EXPECT_EQ(c.status(), k200OK);
+
+    // the address of the App is not bound
+    auto other = curl();
+    other.perform();
+    EXPECT_NE(other.status(), k200OK);
+
+    app->stop();
+    thr.join();
+    close(fd);
+}
+
+TEST_F(HttpApp, listenUnix)
+{
+    auto path = FORMAT("/tmp/cppmhd-{}.sock", getpid());
+    delete app;
+    app = new App("unix:" + path, 0);
+    app->threadCount(2);
+
+    auto get = add<TestCtrl>(HttpMethod::GET, myName);
+    DEFAULT_MOCK_CONNECTION(get);
+    DEFAULT_MOCK_REQUEST(get);
+    start();
+
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    auto sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    ASSERT_GE(sock, 0);
+    ASSERT_EQ(connect(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0) << strerror(errno);
+
+    auto req = FORMAT("GET {} HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n", myName);
+    ASSERT_EQ(req.length(), send(sock, req.data(), req.length(), 0));
+    std::string resp;
+    char buf[1024];
+    ssize_t n;
+    while ((n = recv(sock, buf, sizeof(buf), 0)) > 0) {
+        resp.append(buf, static_cast<size_t>(n));
+    }
+    close(sock);
+    EXPECT_EQ(resp.compare(0, 15, "HTTP/1.1 200 OK"), 0) << resp;
+
+    app->stop();
+    thr.join();
+    // removed with the App
+    EXPECT_NE(access(path.c_str(), F_OK), 0);
+}
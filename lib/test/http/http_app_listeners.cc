@@ -0,0 +1,124 @@
+#include <unistd.h>
+
+#include <fstream>
+#include <sstream>
+
+#include "http_app.h"
+
+namespace
+{
+class AdminCtrl : public HttpController
+{
+  public:
+    virtual std::vector<std::string> listeners() const override
+    {
+        return {"admin"};
+    }
+
+    virtual void onRequest(HttpRequestPtr, HttpResponsePtr& resp) override
+    {
+        resp = std::make_shared<HttpResponse>();
+        resp->status(k200OK);
+        resp->body("admin");
+    }
+};
+}  // namespace
+
+TEST_F(HttpApp, listenersAdd)
+{
+    EXPECT_TRUE(app->addListener("admin", host, port + 1));
+    EXPECT_FALSE(app->addListener("admin", host, port + 2));
+    EXPECT_FALSE(app->addListener(app->listen().name, host, port + 2));
+    ASSERT_EQ(app->listeners().size(), 1u);
+    EXPECT_EQ(app->listeners()[0].port, port + 1);
+}
+
+TEST_F(HttpApp, listenersRoutes)
+{
+    app->threadCount(2);
+    ASSERT_TRUE(app->addListener("admin", host, port + 1));
+    add<AdminCtrl>(HttpMethod::GET, "/admin");
+    auto get = add<TestCtrl>(HttpMethod::GET, myName);
+    DEFAULT_MOCK_CONNECTION(get);
+    DEFAULT_MOCK_REQUEST(get);
+    start();
+
+    // the routes of every listener
+    auto c = curl();
+    c.perform();
+    EXPECT_EQ(c.status(), k200OK);
+    Curl admin(host, port + 1, myName);
+    admin.perform();
+    EXPECT_EQ(admin.status(), k200OK);
+
+    // the admin ones
+    Curl a(host, port + 1, "/admin");
+    a.perform();
+    EXPECT_EQ(a.status(), k200OK);
+    EXPECT_EQ(a.body(), "admin");
+    auto hidden = curl("/admin");
+    hidden.perform();
+    EXPECT_EQ(hidden.status(), k404NotFound);
+}
+
+TEST_F(HttpApp, listenersUnknownName)
+{
+    add<AdminCtrl>(HttpMethod::GET, "/admin");
+    EXPECT_EQ(app->start(), CPPMHD_ROUTER_TREE_BUILD_FAILED);
+}
+
+TEST_F(HttpApp, listenersAdmission)
+{
+    // the acceptor thread runs the accept policy of the daemons while they count their connections
+    app->threadCount(2);
+    app->admission().maxConnections = 1000;
+    ASSERT_TRUE(app->addListener("admin", host, port + 1));
+    add<AdminCtrl>(HttpMethod::GET, "/admin");
+    start();
+
+    std::vector<std::thread> clients;
+    for (int t = 0; t < 8; t++) {
+        clients.emplace_back([this]() {
+            for (int i = 0; i < 50; i++) {
+                Curl a(host, port + 1, "/admin");
+                a.perform();
+                EXPECT_EQ(a.status(), k200OK);
+            }
+        });
+    }
+    for (auto& c : clients) {
+        c.join();
+    }
+
+    Curl a(host, port + 1, "/admin");
+    a.perform();
+    EXPECT_EQ(a.status(), k200OK);
+}
+
+TEST_F(HttpApp, listenersFamily)
+{
+    // an IPv6 listener of an IPv4 App: its clients are taken as what they are
+    char name[] = "/tmp/cppmhd-access-log-XXXXXX";
+    close(mkstemp(name));
+
+    ASSERT_TRUE(app->addListener("admin", "::1", port + 1));
+    add<AdminCtrl>(HttpMethod::GET, "/admin");
+    app->accessLog().path = name;
+    start();
+
+    Curl a("[::1]", port + 1, "/admin");
+    a.perform();
+    EXPECT_EQ(a.status(), k200OK);
+
+    app->stop();
+    thr.join();
+
+    std::ifstream in(name);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    auto log = ss.str();
+    EXPECT_NE(log.find("\"path\":\"/admin\""), std::string::npos) << log;
+    EXPECT_NE(log.find("\"client\":\"[::1]:"), std::string::npos) << log;
+
+    unlink(name);
+}
@@ -0,0 +1,70 @@
+#include "http_app.h"
+
+TEST_F(HttpApp, metrics)
+{
+    auto mock = add<TestCtrl>(HttpMethod::GET, "/user/{\\d+:id}");
+    app->metrics().enable = true;
+    start();
+
+    DEFAULT_MOCK_REQUEST(mock);
+    DEFAULT_MOCK_CONNECTION(mock);
+    DEFAULT_MOCK_REQUEST_TIMES(mock, 2);
+    DEFAULT_MOCK_CONNECTION_TIMES(mock, 2);
+
+    for (auto i = 0; i < 2; i++) {
+        Curl c = curl(FORMAT("/user/{}", i));
+        c.perform();
+        EXPECT_EQ(c.status(), k200OK);
+    }
+
+    Curl n = curl("/nothing");
+    n.perform();
+    EXPECT_EQ(n.status(), k404NotFound);
+
+    Curl m = curl("/metrics");
+    m.perform();
+    ASSERT_EQ(m.status(), k200OK);
+
+    auto body = m.body();
+    EXPECT_NE(body.find("cppmhd_request_duration_seconds_count{route=\"/user/{\\\\d+:id}\",method=\"GET\","
+                        "status=\"2xx\"} 2"),
+              std::string::npos)
+        << body;
+    EXPECT_NE(body.find("cppmhd_request_duration_seconds_count{route=\"\",method=\"GET\",status=\"4xx\"} 1"),
+              std::string::npos)
+        << body;
+}
+
+TEST_F(HttpApp, metricsRejected)
+{
+    auto mock = add<TestCtrl>(HttpMethod::GET, myName);
+    app->metrics().enable = true;
+    app->rateLimit().rate = 0.01;
+    app->rateLimit().burst = 1;
+    app->rateLimit().key = RateLimitKey::HEADER;
+    app->rateLimit().name = "X-Api-Key";
+    start();
+
+    DEFAULT_MOCK_REQUEST(mock);
+    DEFAULT_MOCK_CONNECTION(mock);
+    DEFAULT_MOCK_REQUEST_TIMES(mock, 1);
+    DEFAULT_MOCK_CONNECTION_TIMES(mock, 1);
+
+    for (auto i = 0; i < 2; i++) {
+        Curl c = curl();
+        c.addRequestHeader("X-Api-Key", "alice");
+        c.perform();
+        EXPECT_EQ(c.status(), i == 0 ? k200OK : k429TooManyRequests);
+    }
+
+    // the 429 went out before routing, still counted
+    Curl m = curl("/metrics");
+    m.perform();
+    ASSERT_EQ(m.status(), k200OK);
+
+    auto body = m.body();
+    EXPECT_NE(body.find("cppmhd_request_duration_seconds_count{route=\"\",method=\"GET\",status=\"4xx\"} 1"),
+              std::string::npos)
+        << body;
+    EXPECT_NE(body.find("\ncppmhd_requests_shed_total 0\n"), std::string::npos) << body;
+}
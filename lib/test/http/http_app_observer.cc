@@ -0,0 +1,61 @@
+#include "http_app.h"
+
+#ifdef ENABLE_REQUEST_TIMING
+
+namespace
+{
+class TimingRecorder : public RequestObserver
+{
+  public:
+    std::mutex mutex;
+    std::vector<RequestTiming> timings;
+
+    void onComplete(const HttpRequest&, const HttpResponse* resp, const RequestTiming& timing) override
+    {
+        EXPECT_NE(resp, nullptr);
+        std::lock_guard<std::mutex> _(mutex);
+        timings.push_back(timing);
+    }
+};
+}  // namespace
+
+TEST_F(HttpApp, requestObserver)
+{
+    auto mock = add<TestCtrl>(HttpMethod::GET, myName);
+    auto recorder = std::make_shared<TimingRecorder>();
+    app->observer(recorder);
+    start();
+
+    DEFAULT_MOCK_REQUEST(mock);
+    DEFAULT_MOCK_CONNECTION(mock);
+    DEFAULT_MOCK_REQUEST_TIMES(mock, 1);
+    DEFAULT_MOCK_CONNECTION_TIMES(mock, 1);
+
+    Curl c = curl();
+    c.perform();
+    EXPECT_EQ(c.status(), k200OK);
+
+    app->stop();
+    thr.join();
+
+    ASSERT_EQ(recorder->timings.size(), 1u);
+    const auto& t = recorder->timings[0];
+
+    RequestPhase passed[] = {RequestPhase::BEGIN,
+                             RequestPhase::METHOD_PARSED,
+                             RequestPhase::CHECKED,
+                             RequestPhase::ROUTED,
+                             RequestPhase::CONNECTION,
+                             RequestPhase::HANDLER,
+                             RequestPhase::HANDLED,
+                             RequestPhase::QUEUED,
+                             RequestPhase::COMPLETED};
+    for (auto i = 1u; i < sizeof(passed) / sizeof(passed[0]); i++) {
+        EXPECT_NE(t.of(passed[i]), 0u);
+        EXPECT_LE(t.of(passed[i - 1]), t.of(passed[i]));
+    }
+    EXPECT_EQ(t.of(RequestPhase::BODY_BEGIN), 0u);
+    EXPECT_EQ(t.dataRounds, 0u);
+}
+
+#endif
@@ -0,0 +1,123 @@
+#include <unistd.h>
+
+#include "http_app.h"
+
+namespace
+{
+const std::string kBody = "0123456789abcdefghijklmnopqrstuvwxyz";
+
+class BufferCtrl : public HttpController
+{
+  public:
+    virtual void onRequest(HttpRequestPtr, HttpResponsePtr& resp) override
+    {
+        resp = std::make_shared<HttpResponse>();
+        resp->status(k200OK);
+        resp->body(kBody.length(), kBody.data(), true);
+        resp->header(CPPMHD_HTTP_HEADER_CONTENT_TYPE) = CPPMHD_HTTP_MIME_TEXT_PLAIN;
+        resp->header(CPPMHD_HTTP_HEADER_ETAG) = "\"v1\"";
+    }
+};
+
+class FileCtrl : public HttpController
+{
+    std::string path_;
+
+  public:
+    explicit FileCtrl(const std::string& path) : path_(path) {}
+
+    virtual void onRequest(HttpRequestPtr, HttpResponsePtr& resp) override
+    {
+        resp = std::make_shared<HttpResponse>();
+        resp->status(k200OK);
+        resp->file(path_);
+    }
+};
+}  // namespace
+
+TEST_F(HttpApp, rangeBuffer)
+{
+    add<BufferCtrl>(HttpMethod::GET, myName);
+    start();
+
+    auto single = curl();
+    single.addRequestHeader(CPPMHD_HTTP_HEADER_RANGE, "bytes=10-15");
+    single.perform();
+    EXPECT_EQ(single.status(), k206PartialContent);
+    EXPECT_EQ(single.body(), "abcdef");
+    EXPECT_EQ(single.headers()[CPPMHD_HTTP_HEADER_CONTENT_RANGE], "bytes 10-15/36");
+
+    auto multi = curl();
+    multi.addRequestHeader(CPPMHD_HTTP_HEADER_RANGE, "bytes=0-1,-2");
+    multi.perform();
+    EXPECT_EQ(multi.status(), k206PartialContent);
+    auto type = multi.headers()[CPPMHD_HTTP_HEADER_CONTENT_TYPE];
+    auto prefix = std::string("multipart/byteranges; boundary=");
+    ASSERT_EQ(type.compare(0, prefix.length(), prefix), 0);
+    auto boundary = type.substr(prefix.length());
+    EXPECT_EQ(multi.body(),
+              "\r\n--" + boundary + "\r\nContent-Type: " CPPMHD_HTTP_MIME_TEXT_PLAIN
+                  "\r\nContent-Range: bytes 0-1/36\r\n\r\n01\r\n--" + boundary
+                  + "\r\nContent-Type: " CPPMHD_HTTP_MIME_TEXT_PLAIN "\r\nContent-Range: bytes 34-35/36\r\n\r\nyz\r\n--"
+                  + boundary + "--\r\n");
+
+    auto unsatisfiable = curl();
+    unsatisfiable.addRequestHeader(CPPMHD_HTTP_HEADER_RANGE, "bytes=100-");
+    unsatisfiable.perform();
+    EXPECT_EQ(unsatisfiable.status(), k416RangeNotSatisfiable);
+    EXPECT_EQ(unsatisfiable.body(), "");
+    EXPECT_EQ(unsatisfiable.headers()[CPPMHD_HTTP_HEADER_CONTENT_RANGE], "bytes */36");
+
+    // the representation changed, the whole body
+    auto changed = curl();
+    changed.addRequestHeader(CPPMHD_HTTP_HEADER_RANGE, "bytes=0-1");
+    changed.addRequestHeader(CPPMHD_HTTP_HEADER_IF_RANGE, "\"v0\"");
+    changed.perform();
+    EXPECT_EQ(changed.status(), k200OK);
+    EXPECT_EQ(changed.body(), kBody);
+
+    auto same = curl();
+    same.addRequestHeader(CPPMHD_HTTP_HEADER_RANGE, "bytes=0-1");
+    same.addRequestHeader(CPPMHD_HTTP_HEADER_IF_RANGE, "\"v1\"");
+    same.perform();
+    EXPECT_EQ(same.status(), k206PartialContent);
+    EXPECT_EQ(same.body(), "01");
+}
+
+TEST_F(HttpApp, rangeFile)
+{
+    char name[] = "/tmp/cppmhd-range-file-XXXXXX";
+    auto fd = mkstemp(name);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(write(fd, kBody.data(), kBody.length()), static_cast<ssize_t>(kBody.length()));
+    close(fd);
+
+    add<FileCtrl>(HttpMethod::GET, myName, name);
+    start();
+
+    auto whole = curl();
+    whole.perform();
+    EXPECT_EQ(whole.status(), k200OK);
+    EXPECT_EQ(whole.body(), kBody);
+    EXPECT_EQ(whole.headers()[CPPMHD_HTTP_HEADER_ACCEPT_RANGES], "bytes");
+    auto etag = whole.headers()[CPPMHD_HTTP_HEADER_ETAG];
+    EXPECT_NE(etag, "");
+
+    auto single = curl();
+    single.addRequestHeader(CPPMHD_HTTP_HEADER_RANGE, "bytes=-6");
+    single.addRequestHeader(CPPMHD_HTTP_HEADER_IF_RANGE, etag);
+    single.perform();
+    EXPECT_EQ(single.status(), k206PartialContent);
+    EXPECT_EQ(single.body(), "uvwxyz");
+    EXPECT_EQ(single.headers()[CPPMHD_HTTP_HEADER_CONTENT_RANGE], "bytes 30-35/36");
+
+    auto multi = curl();
+    multi.addRequestHeader(CPPMHD_HTTP_HEADER_RANGE, "bytes=0-0,10-10,20-");
+    multi.perform();
+    EXPECT_EQ(multi.status(), k206PartialContent);
+    auto body = multi.body();
+    EXPECT_NE(body.find("Content-Range: bytes 10-10/36\r\n\r\na\r\n"), std::string::npos);
+    EXPECT_NE(body.find("Content-Range: bytes 20-35/36\r\n\r\nklmnopqrstuvwxyz\r\n"), std::string::npos);
+
+    unlink(name);
+}
@@ -0,0 +1,62 @@
+#include "http_app.h"
+
+TEST_F(HttpApp, rateLimitHeader)
+{
+    auto mock = add<TestCtrl>(HttpMethod::GET, myName);
+    app->rateLimit().rate = 0.01;
+    app->rateLimit().burst = 2;
+    app->rateLimit().key = RateLimitKey::HEADER;
+    app->rateLimit().name = "X-Api-Key";
+    start();
+
+    DEFAULT_MOCK_CONNECTION(mock);
+    DEFAULT_MOCK_CONNECTION_TIMES(mock, 3);
+    DEFAULT_MOCK_REQUEST(mock);
+    DEFAULT_MOCK_REQUEST_TIMES(mock, 3);
+
+    for (auto i = 0; i < 3; i++) {
+        Curl c = curl();
+        c.addRequestHeader("X-Api-Key", "alice");
+        c.perform();
+        if (i < 2) {
+            EXPECT_EQ(c.status(), k200OK);
+        } else {
+            EXPECT_EQ(c.status(), k429TooManyRequests);
+            EXPECT_EQ(c.body(), "Too Many Requests");
+            // the preallocated response has the Date of this second too
+            EXPECT_NE(c.headers()[CPPMHD_HTTP_HEADER_DATE], "");
+        }
+    }
+
+    Curl other = curl();
+    other.addRequestHeader("X-Api-Key", "bob");
+    other.perform();
+    EXPECT_EQ(other.status(), k200OK);
+}
+
+TEST_F(HttpApp, rateLimitParam)
+{
+    auto mock = add<TestCtrl>(HttpMethod::GET, "/rateLimitParam/{\\w+:user}");
+    app->rateLimit().rate = 0.01;
+    app->rateLimit().burst = 1;
+    app->rateLimit().key = RateLimitKey::ROUTE_PARAM;
+    app->rateLimit().name = "user";
+    start();
+
+    DEFAULT_MOCK_CONNECTION(mock);
+    DEFAULT_MOCK_CONNECTION_TIMES(mock, 2);
+    DEFAULT_MOCK_REQUEST(mock);
+    DEFAULT_MOCK_REQUEST_TIMES(mock, 2);
+
+    Curl a = curl("/rateLimitParam/alice");
+    a.perform();
+    EXPECT_EQ(a.status(), k200OK);
+
+    Curl again = curl("/rateLimitParam/alice");
+    again.perform();
+    EXPECT_EQ(again.status(), k429TooManyRequests);
+
+    Curl b = curl("/rateLimitParam/bob");
+    b.perform();
+    EXPECT_EQ(b.status(), k200OK);
+}
@@ -0,0 +1,153 @@
+#include <cppmhd/sse.h>
+
+#include "http_app.h"
+
+#define FORMAT_INETADDRESS
+#include "format.h"
+
+namespace
+{
+class TopicCtrl : public SseController
+{
+  public:
+    explicit TopicCtrl(SseHubPtr hub) : SseController(hub) {}
+
+    virtual void onSubscribe(HttpRequestPtr req, std::vector<std::string>& topics, HttpResponsePtr& resp) override
+    {
+        auto topic = req->getHeader("X-Topic");
+        if (topic == nullptr) {
+            return;
+        }
+        if (strcmp(topic, "private") == 0) {
+            resp = std::make_shared<HttpResponse>();
+            resp->status(k403Forbidden);
+            return;
+        }
+        topics.push_back(topic);
+    }
+};
+}  // namespace
+
+TEST_F(HttpApp, sseRejected)
+{
+    auto hub = std::make_shared<SseHub>();
+    add<TopicCtrl>(HttpMethod::GET, myName, hub);
+    start();
+
+    auto none = curl();
+    none.perform();
+    EXPECT_EQ(none.status(), k404NotFound);
+
+    auto hidden = curl();
+    hidden.addRequestHeader("X-Topic", "private");
+    hidden.perform();
+    EXPECT_EQ(hidden.status(), k403Forbidden);
+}
+
+TEST_F(HttpApp, sseBroadcast)
+{
+    auto hub = std::make_shared<SseHub>();
+    add<TopicCtrl>(HttpMethod::GET, myName, hub);
+    app->admission().maxInflight = 1;
+    start();
+
+    InetAddress addr;
+    ASSERT_TRUE(InetAddress::parse(addr, host, port));
+
+    auto req = FORMAT(
+        "GET {} HTTP/1.1\r\n"
+        "Host: {}\r\n"
+        "X-Topic: quotes\r\n"
+        "\r\n",
+        myName,
+        host);
+
+    std::vector<int> socks;
+    for (int i = 0; i < 3; i++) {
+        auto sock = socket(AF_INET, SOCK_STREAM, 0);
+        ASSERT_GT(sock, 0) << fmt::format("socket(AF_INET, SOCK_STREAM, 0) failed: {}", strerror(errno));
+        ASSERT_EQ(connect(sock, addr.getSocket(), addr.socketLen()), 0)
+            << fmt::format("connect to {:a} failed: {}", addr, strerror(errno));
+        ASSERT_EQ(req.length(), send(sock, req.data(), req.length(), 0))
+            << fmt::format("send failed: {}", strerror(errno));
+        socks.push_back(sock);
+    }
+
+    // the subscribers do not count as in flight
+    for (int i = 0; i < 50 && hub->subscribers("quotes") != 3; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_EQ(hub->subscribers("quotes"), 3u);
+    EXPECT_EQ(hub->publish("quotes", "42", "price"), 3u);
+
+    for (auto sock : socks) {
+        std::string got;
+        char buf[1024];
+        while (got.find("data: 42\n\n") == std::string::npos) {
+            auto n = recv(sock, buf, sizeof(buf), 0);
+            ASSERT_GT(n, 0) << got;
+            got.append(buf, static_cast<size_t>(n));
+        }
+        EXPECT_EQ(got.compare(0, 15, "HTTP/1.1 200 OK"), 0) << got;
+        EXPECT_NE(got.find(CPPMHD_HTTP_MIME_TEXT_EVENT_STREAM), std::string::npos) << got;
+        EXPECT_NE(got.find("event: price\n"), std::string::npos) << got;
+        close(sock);
+    }
+
+    // the writes after the clients are gone end their connections
+    for (int i = 0; i < 50 && hub->subscribers("quotes") != 0; i++) {
+        hub->publish("quotes", "bye");
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    EXPECT_EQ(hub->subscribers("quotes"), 0u);
+}
+
+TEST_F(HttpApp, sseStopIdle)
+{
+    auto hub = std::make_shared<SseHub>();
+    add<TopicCtrl>(HttpMethod::GET, myName, hub);
+    start();
+
+    InetAddress addr;
+    ASSERT_TRUE(InetAddress::parse(addr, host, port));
+
+    auto req = FORMAT(
+        "GET {} HTTP/1.1\r\n"
+        "Host: {}\r\n"
+        "X-Topic: quotes\r\n"
+        "\r\n",
+        myName,
+        host);
+
+    auto sock = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_GT(sock, 0) << fmt::format("socket(AF_INET, SOCK_STREAM, 0) failed: {}", strerror(errno));
+    ASSERT_EQ(connect(sock, addr.getSocket(), addr.socketLen()), 0)
+        << fmt::format("connect to {:a} failed: {}", addr, strerror(errno));
+    ASSERT_EQ(req.length(), send(sock, req.data(), req.length(), 0)) << fmt::format("send failed: {}", strerror(errno));
+
+    for (int i = 0; i < 50 && hub->subscribers("quotes") != 1; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_EQ(hub->subscribers("quotes"), 1u);
+    // nothing is published, the connection of the subscriber stays suspended
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    app->stop();
+    thr.join();
+    EXPECT_FALSE(app->isRunning());
+
+    // the stream ended with the last chunk, then the connection closed
+    std::string got;
+    char buf[1024];
+    while (true) {
+        auto n = recv(sock, buf, sizeof(buf), 0);
+        if (n <= 0) {
+            break;
+        }
+        got.append(buf, static_cast<size_t>(n));
+    }
+    close(sock);
+    EXPECT_EQ(got.compare(0, 15, "HTTP/1.1 200 OK"), 0) << got;
+    EXPECT_NE(got.find("\r\n0\r\n\r\n"), std::string::npos) << got;
+    EXPECT_EQ(hub->subscribers("quotes"), 0u);
+}
@@ -0,0 +1,52 @@
+#include "http_app.h"
+#include "test.h"
+
+namespace
+{
+class TlsCtrl : public HttpController
+{
+  public:
+    virtual void onRequest(HttpRequestPtr req, HttpResponsePtr& resp) override
+    {
+        TlsInfo info;
+        resp = std::make_shared<HttpResponse>();
+        resp->status(k200OK);
+        resp->body(req->tls(info) ? FORMAT("{} {}", info.protocol, info.alpn) : std::string("clear"));
+    }
+};
+}  // namespace
+
+TEST_F(HttpApp, tls)
+{
+    TlsCertificate c;
+    if (!selfSignedCertificate("localhost", c.cert, c.key)) {
+        GTEST_SKIP() << "built without GnuTLS";
+    }
+    app->tls().certificates.push_back(c);
+    add<TlsCtrl>(HttpMethod::GET, myName);
+    start();
+
+    Curl c1(Curl::CurlSchema::HTTPS, host, port, myName);
+    c1.insecure();
+    c1.perform();
+    EXPECT_EQ(c1.status(), k200OK);
+    EXPECT_NE(c1.body().find("TLS1."), std::string::npos) << c1.body();
+    EXPECT_NE(c1.body().find("http/1.1"), std::string::npos) << c1.body();
+
+    // clear text is not served
+    auto clear = curl();
+    clear.perform();
+    EXPECT_NE(clear.status(), k200OK);
+}
+
+TEST_F(HttpApp, tlsBadCertificate)
+{
+    // without GnuTLS it is libmicrohttpd that fails
+    std::string cert, key;
+    if (!selfSignedCertificate("localhost", cert, key)) {
+        GTEST_SKIP() << "built without GnuTLS";
+    }
+    app->tls().certificates.push_back(TlsCertificate{"not a certificate", "not a key", "", "", ""});
+    add<TlsCtrl>(HttpMethod::GET, myName);
+    EXPECT_EQ(app->start(), CPPMHD_TLS_FAILED);
+}
@@ -0,0 +1,162 @@
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include "http_app.h"
+
+namespace
+{
+std::string readAll(const std::string& path)
+{
+    std::ifstream in(path, std::ios::binary);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+class UploadCtrl : public UploadController
+{
+  public:
+    UploadResult result;
+
+    explicit UploadCtrl(const UploadOptions& options) : UploadController(options) {}
+
+    virtual void onRequest(HttpRequestPtr, const UploadResult& r, HttpResponsePtr& resp) override
+    {
+        result = r;
+        resp = std::make_shared<HttpResponse>();
+        resp->status(k201Created);
+    }
+};
+
+// every part goes to one path, a pipe standing for a disk
+class PipeCtrl : public UploadCtrl
+{
+    const std::string path_;
+
+  public:
+    PipeCtrl(const UploadOptions& options, const std::string& path) : UploadCtrl(options), path_(path) {}
+
+    virtual std::string uploadPath(HttpRequestPtr, const std::string&, const std::string&) override
+    {
+        return path_;
+    }
+};
+}  // namespace
+
+TEST_F(HttpApp, uploadRaw)
+{
+    UploadOptions options;
+    options.chunkSize = 4096;
+    auto mock = add<UploadCtrl>(HttpMethod::PUT, myName, options);
+    start();
+
+    std::string body(100 * 1000 + 7, 'u');
+    auto c = curl();
+    c.method(HttpMethod::PUT);
+    c.upload(body, CPPMHD_HTTP_MIME_APPLICATION_OCTET);
+    c.perform();
+    ASSERT_EQ(c.status(), k201Created);
+
+    ASSERT_EQ(mock->result.files.size(), 1u);
+    auto& f = mock->result.files[0];
+    EXPECT_EQ(f.error, 0);
+    EXPECT_EQ(f.size, body.length());
+    EXPECT_EQ(f.contentType, CPPMHD_HTTP_MIME_APPLICATION_OCTET);
+    EXPECT_EQ(readAll(f.path), body);
+    unlink(f.path.c_str());
+}
+
+TEST_F(HttpApp, uploadForm)
+{
+    char name[] = "/tmp/cppmhd-upload-src-XXXXXX";
+    auto fd = mkstemp(name);
+    ASSERT_GE(fd, 0);
+    std::string content(300 * 1000, 'f');
+    ASSERT_EQ(write(fd, content.data(), content.length()), static_cast<ssize_t>(content.length()));
+    close(fd);
+
+    auto mock = add<UploadCtrl>(HttpMethod::POST, myName, UploadOptions());
+    start();
+
+    auto c = curl();
+    std::map<std::string, std::string> data = {{"a", "10"}, {"b", "bb"}};
+    c.mime_upload(data);
+    c.mime_uploadfile("sent.bin", name);
+    c.perform();
+    ASSERT_EQ(c.status(), k201Created);
+
+    EXPECT_TRUE(mock->result.complete);
+    EXPECT_EQ(mock->result.fields, data);
+    ASSERT_EQ(mock->result.files.size(), 1u);
+    auto& f = mock->result.files[0];
+    EXPECT_EQ(f.field, "file");
+    EXPECT_EQ(f.fileName, "sent.bin");
+    EXPECT_EQ(f.size, content.length());
+    EXPECT_EQ(readAll(f.path), content);
+
+    unlink(f.path.c_str());
+    unlink(name);
+}
+
+TEST_F(HttpApp, uploadStopStalled)
+{
+    // a disk which stalls: a pipe nobody reads
+    char dir[] = "/tmp/cppmhd-upload-XXXXXX";
+    ASSERT_NE(mkdtemp(dir), nullptr);
+    auto fifo = std::string(dir) + "/disk";
+    ASSERT_EQ(mkfifo(fifo.c_str(), 0600), 0);
+    auto disk = open(fifo.c_str(), O_RDONLY | O_NONBLOCK);
+    ASSERT_GE(disk, 0);
+
+    UploadOptions options;
+    options.chunkSize = 64 * 1024;
+    options.maxPending = 1;
+    add<PipeCtrl>(HttpMethod::PUT, myName, options, fifo);
+    start();
+
+    InetAddress addr;
+    ASSERT_TRUE(InetAddress::parse(addr, host, port));
+    auto sock = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_GT(sock, 0);
+    ASSERT_EQ(connect(sock, addr.getSocket(), addr.socketLen()), 0);
+
+    auto req = FORMAT("PUT {} HTTP/1.1\r\nHost: {}\r\nContent-Length: {}\r\n\r\n", myName, host, 1 << 30);
+    ASSERT_EQ(send(sock, req.data(), req.length(), 0), static_cast<ssize_t>(req.length()));
+    // until the request is paused behind the disk and the socket buffers are full
+    std::string chunk(64 * 1024, 'u');
+    while (send(sock, chunk.data(), chunk.length(), MSG_DONTWAIT) > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    // the suspended connection is resumed, the request fails instead of waiting
+    app->stop();
+    thr.join();
+    EXPECT_FALSE(app->isRunning());
+    close(sock);
+
+    // the I/O thread writes what was queued, then closes the file of the aborted request
+    char buf[64 * 1024];
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (std::chrono::steady_clock::now() < deadline) {
+        auto n = read(disk, buf, sizeof(buf));
+        if (n == 0) {
+            break;
+        }
+        if (n < 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    EXPECT_EQ(read(disk, buf, sizeof(buf)), 0);
+
+    close(disk);
+    unlink(fifo.c_str());
+    rmdir(dir);
+}
@@ -0,0 +1,110 @@
+#include <atomic>
+
+#include "http_app.h"
+
+namespace
+{
+class ConfigCtrl : public HttpController
+{
+    uint32_t ttl_;
+
+  public:
+    std::atomic<int> calls{0};
+    std::string body{"{\"version\": 1}"};
+
+    explicit ConfigCtrl(uint32_t ttl) : ttl_(ttl) {}
+
+    virtual uint32_t validatorTtl() const override
+    {
+        return ttl_;
+    }
+
+    virtual void onRequest(HttpRequestPtr, HttpResponsePtr& resp) override
+    {
+        calls++;
+        resp = std::make_shared<HttpResponse>();
+        resp->status(k200OK);
+        resp->body(body.length(), body.data(), true);
+        resp->header(CPPMHD_HTTP_HEADER_CONTENT_TYPE) = CPPMHD_HTTP_MIME_APPLICATION_JSON;
+        resp->header(CPPMHD_HTTP_HEADER_CACHE_CONTROL) = "no-cache";
+    }
+};
+
+class ModifiedCtrl : public HttpController
+{
+  public:
+    virtual void onRequest(HttpRequestPtr, HttpResponsePtr& resp) override
+    {
+        resp = std::make_shared<HttpResponse>();
+        resp->status(k200OK);
+        resp->body("content");
+        resp->header(CPPMHD_HTTP_HEADER_LAST_MODIFIED) = "Sun, 06 Nov 1994 08:49:37 GMT";
+    }
+};
+}  // namespace
+
+TEST_F(HttpApp, validatorCache)
+{
+    auto ctrl = add<ConfigCtrl>(HttpMethod::GET, "/config", 60);
+    start();
+
+    auto first = curl("/config");
+    first.perform();
+    ASSERT_EQ(first.status(), k200OK);
+    auto etag = first.headers()[CPPMHD_HTTP_HEADER_ETAG];
+    EXPECT_EQ(etag.length(), 18u);
+    EXPECT_EQ(ctrl->calls, 1);
+
+    // answered before the handler
+    auto second = curl("/config");
+    second.addRequestHeader(CPPMHD_HTTP_HEADER_IF_NONE_MATCH, etag);
+    second.perform();
+    EXPECT_EQ(second.status(), k304NotModified);
+    EXPECT_EQ(second.body(), "");
+    EXPECT_EQ(second.headers()[CPPMHD_HTTP_HEADER_ETAG], etag);
+    // the headers of the 200 a 304 repeats
+    EXPECT_EQ(second.headers()[CPPMHD_HTTP_HEADER_CACHE_CONTROL], "no-cache");
+    EXPECT_EQ(ctrl->calls, 1);
+
+    // the query is part of the URL, the handler answers and the body has not changed
+    auto query = curl("/config?v=2");
+    query.addRequestHeader(CPPMHD_HTTP_HEADER_IF_NONE_MATCH, etag);
+    query.perform();
+    EXPECT_EQ(query.status(), k304NotModified);
+    EXPECT_EQ(query.headers()[CPPMHD_HTTP_HEADER_CACHE_CONTROL], "no-cache");
+    EXPECT_EQ(ctrl->calls, 2);
+
+    auto stale = curl("/config");
+    stale.addRequestHeader(CPPMHD_HTTP_HEADER_IF_NONE_MATCH, "\"0000000000000000\"");
+    stale.perform();
+    EXPECT_EQ(stale.status(), k200OK);
+    EXPECT_EQ(stale.body(), ctrl->body);
+    EXPECT_EQ(ctrl->calls, 3);
+
+    // the persistent body changed in place, at the same address and of the same size
+    ctrl->body[12] = '2';
+    auto changed = curl("/config");
+    changed.perform();
+    EXPECT_EQ(changed.status(), k200OK);
+    EXPECT_EQ(changed.body(), "{\"version\": 2}");
+    EXPECT_NE(changed.headers()[CPPMHD_HTTP_HEADER_ETAG], etag);
+}
+
+TEST_F(HttpApp, validatorFromHandler)
+{
+    add<ModifiedCtrl>(HttpMethod::GET, myName);
+    start();
+
+    auto since = curl();
+    since.addRequestHeader(CPPMHD_HTTP_HEADER_IF_MODIFIED_SINCE, "Mon, 07 Nov 1994 08:49:37 GMT");
+    since.perform();
+    EXPECT_EQ(since.status(), k304NotModified);
+    EXPECT_EQ(since.headers()[CPPMHD_HTTP_HEADER_LAST_MODIFIED], "Sun, 06 Nov 1994 08:49:37 GMT");
+
+    auto before = curl();
+    before.addRequestHeader(CPPMHD_HTTP_HEADER_IF_MODIFIED_SINCE, "Sat, 05 Nov 1994 08:49:37 GMT");
+    before.perform();
+    EXPECT_EQ(before.status(), k200OK);
+    EXPECT_EQ(before.body(), "content");
+    EXPECT_EQ(before.headers().count(CPPMHD_HTTP_HEADER_ETAG), 0u);
+}
@@ -0,0 +1,141 @@
+#include <cppmhd/websocket.h>
+
+#include <atomic>
+
+#include "http_app.h"
+
+#define FORMAT_INETADDRESS
+#include "format.h"
+
+namespace
+{
+class EchoCtrl : public WebSocketController
+{
+  public:
+    std::atomic<int> opened{0};
+    std::atomic<int> closed{0};
+    std::atomic<int> code{0};
+
+    virtual void onOpen(WebSocketPtr, HttpRequestPtr) override
+    {
+        opened++;
+    }
+
+    virtual void onMessage(WebSocketPtr ws, const char* data, size_t size, bool binary) override
+    {
+        ws->send(data, size, binary);
+    }
+
+    virtual void onClose(WebSocketPtr, uint16_t c) override
+    {
+        code = c;
+        closed++;
+    }
+
+    virtual bool compression() const override
+    {
+        return false;
+    }
+};
+
+// a masked frame of the client
+std::string clientFrame(uint8_t first, const std::string& payload)
+{
+    const char key[] = {'\x01', '\x02', '\x03', '\x04'};
+    std::string f;
+    f += static_cast<char>(first);
+    f += static_cast<char>(0x80 | payload.length());
+    f.append(key, 4);
+    for (size_t i = 0; i < payload.length(); i++) {
+        f += static_cast<char>(payload[i] ^ key[i % 4]);
+    }
+    return f;
+}
+
+std::string receive(int sock, size_t size)
+{
+    std::string s;
+    char buf[1024];
+    while (s.length() < size) {
+        auto n = recv(sock, buf, std::min(sizeof(buf), size - s.length()), 0);
+        if (n <= 0) {
+            break;
+        }
+        s.append(buf, static_cast<size_t>(n));
+    }
+    return s;
+}
+}  // namespace
+
+TEST_F(HttpApp, webSocketRejected)
+{
+    add<EchoCtrl>(HttpMethod::GET, myName);
+    start();
+
+    auto plain = curl();
+    plain.perform();
+    EXPECT_EQ(plain.status(), k426UpgradeRequired);
+    EXPECT_EQ(plain.headers()[CPPMHD_HTTP_HEADER_SEC_WEBSOCKET_VERSION], "13");
+
+    auto noKey = curl();
+    noKey.addRequestHeader(CPPMHD_HTTP_HEADER_UPGRADE, "websocket");
+    noKey.addRequestHeader(CPPMHD_HTTP_HEADER_CONNECTION, "Upgrade");
+    noKey.addRequestHeader(CPPMHD_HTTP_HEADER_SEC_WEBSOCKET_VERSION, "13");
+    noKey.perform();
+    EXPECT_EQ(noKey.status(), k400BadRequest);
+}
+
+TEST_F(HttpApp, webSocketEcho)
+{
+    auto ctrl = add<EchoCtrl>(HttpMethod::GET, myName);
+    start();
+
+    InetAddress addr;
+    ASSERT_TRUE(InetAddress::parse(addr, host, port));
+
+    // the first frame arrives with the handshake
+    auto req = FORMAT(
+        "GET {} HTTP/1.1\r\n"
+        "Host: {}\r\n"
+        "Upgrade: websocket\r\n"
+        "Connection: Upgrade\r\n"
+        "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+        "Sec-WebSocket-Version: 13\r\n"
+        "\r\n",
+        myName,
+        host);
+    req += clientFrame(0x81, "hello");
+
+    auto sock = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_GT(sock, 0) << fmt::format("socket(AF_INET, SOCK_STREAM, 0) failed: {}", strerror(errno));
+    ASSERT_EQ(connect(sock, addr.getSocket(), addr.socketLen()), 0)
+        << fmt::format("connect to {:a} failed: {}", addr, strerror(errno));
+    ASSERT_EQ(req.length(), send(sock, req.data(), req.length(), 0)) << fmt::format("send failed: {}", strerror(errno));
+
+    std::string head;
+    while (head.find("\r\n\r\n") == std::string::npos) {
+        auto c = receive(sock, 1);
+        ASSERT_EQ(c.length(), 1u);
+        head += c;
+    }
+    EXPECT_EQ(head.compare(0, 12, "HTTP/1.1 101"), 0) << head;
+    EXPECT_NE(head.find("s3pPLMBiTxaQ9kYGzzhZRbK+xOo="), std::string::npos) << head;
+
+    EXPECT_EQ(receive(sock, 7), std::string("\x81\x05hello", 7));
+
+    auto ping = clientFrame(0x89, "p");
+    ASSERT_EQ(ping.length(), send(sock, ping.data(), ping.length(), 0));
+    EXPECT_EQ(receive(sock, 3), std::string("\x8a\x01p", 3));
+
+    auto bye = clientFrame(0x88, std::string("\x03\xe8", 2));
+    ASSERT_EQ(bye.length(), send(sock, bye.data(), bye.length(), 0));
+    EXPECT_EQ(receive(sock, 4), std::string("\x88\x02\x03\xe8", 4));
+    // the server ends its side after the Close frame
+    EXPECT_EQ(receive(sock, 1), "");
+    close(sock);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_EQ(ctrl->opened, 1);
+    EXPECT_EQ(ctrl->closed, 1);
+    EXPECT_EQ(ctrl->code, kWsNormalClosure);
+}
@@ -0,0 +1,224 @@
+#include <cppmhd/json.h>
+#include <gtest/gtest.h>
+
+using namespace cppmhd;
+
+namespace
+{
+// the events as text, to compare the parses of one document
+class Trace : public JsonHandler
+{
+  public:
+    std::string out;
+    size_t stopAt = 0;
+
+    bool add(const std::string& event)
+    {
+        out += event;
+        out += ' ';
+        return stopAt == 0 || --stopAt != 0;
+    }
+
+    virtual bool onNull() override
+    {
+        return add("null");
+    }
+    virtual bool onBool(bool value) override
+    {
+        return add(value ? "true" : "false");
+    }
+    virtual bool onNumber(const char* text, size_t length) override
+    {
+        return add("n:" + std::string(text, length));
+    }
+    virtual bool onString(const char* text, size_t length) override
+    {
+        return add("s:" + std::string(text, length));
+    }
+    virtual bool onKey(const char* text, size_t length) override
+    {
+        return add("k:" + std::string(text, length));
+    }
+    virtual bool onStartObject() override
+    {
+        return add("{");
+    }
+    virtual bool onEndObject() override
+    {
+        return add("}");
+    }
+    virtual bool onStartArray() override
+    {
+        return add("[");
+    }
+    virtual bool onEndArray() override
+    {
+        return add("]");
+    }
+};
+
+const std::string kDocument =
+    " {\"a\": [1, -2.5e+3, 0, true, false, null], "
+    "\"long string without escapes\": \"x\\\"y\\\\z\\u00e9\\ud83d\\ude00\","
+    " \"e\": {}, \"f\": [], \"g\": {\"h\": [[]]}} ";
+
+const std::string kTrace =
+    "{ k:a [ n:1 n:-2.5e+3 n:0 true false null ] k:long string without escapes s:x\"y\\z\xc3\xa9\xf0\x9f\x98\x80 "
+    "k:e { } k:f [ ] k:g { k:h [ [ ] ] } } ";
+
+std::string trace(const std::string& doc, JsonLimits limits = JsonLimits())
+{
+    Trace t;
+    JsonParser parser(t, limits);
+    if (!parser.parse(doc.data(), doc.length()) || !parser.finish()) {
+        return "error: " + parser.error();
+    }
+    return t.out;
+}
+}  // namespace
+
+TEST(Json, events)
+{
+    EXPECT_EQ(trace(kDocument), kTrace);
+    EXPECT_EQ(trace("123"), "n:123 ");
+    EXPECT_EQ(trace("\"s\""), "s:s ");
+    EXPECT_EQ(trace(" null\n"), "null ");
+}
+
+TEST(Json, split)
+{
+    for (size_t i = 0; i <= kDocument.length(); i++) {
+        for (size_t j = i; j <= kDocument.length(); j += 7) {
+            Trace t;
+            JsonParser parser(t, JsonLimits());
+            ASSERT_TRUE(parser.parse(kDocument.data(), i));
+            ASSERT_TRUE(parser.parse(kDocument.data() + i, j - i));
+            ASSERT_TRUE(parser.parse(kDocument.data() + j, kDocument.length() - j));
+            ASSERT_TRUE(parser.finish()) << parser.error();
+            EXPECT_EQ(t.out, kTrace) << i << " " << j;
+        }
+    }
+}
+
+TEST(Json, errors)
+{
+    const char* bad[] = {"",         "  ",         "{",         "[1,]",       "{\"a\" 1}",  "{\"a\":1,}", "[1 2]",
+                         "01",       "1.",         "-",         "1e",         "tru",        "nul1",       "\"abc",
+                         "\"\\x\"",  "\"\\u12g4\"", "\"\\ud800\"", "\"\\udc00\"", "\"a\tb\"", "{} {}",      "]",
+                         "{\"a\"}", "[}",          "{]"};
+    for (auto doc : bad) {
+        auto result = trace(doc);
+        EXPECT_EQ(result.find("error: "), 0u) << doc << " => " << result;
+    }
+}
+
+TEST(Json, utf8)
+{
+    EXPECT_EQ(trace("[\"\xc3\xa9\xf0\x9f\x98\x80\"]"), "[ s:\xc3\xa9\xf0\x9f\x98\x80 ] ");
+    // overlong, surrogate, truncated, stray continuation, in a value and in a key
+    for (auto doc : {"\"\xc0\xaf\"", "\"\xed\xa0\x80\"", "[\"a\xe2\x82\"]", "{\"\x80\": 1}"}) {
+        EXPECT_EQ(trace(doc).find("error: invalid UTF-8 in string"), 0u) << doc;
+    }
+
+    // a sequence split over the chunks
+    std::string doc("\"ab\xe2\x9c\x93\"");
+    for (size_t i = 1; i < doc.length(); i++) {
+        Trace t;
+        JsonParser parser(t, JsonLimits());
+        ASSERT_TRUE(parser.parse(doc.data(), i));
+        ASSERT_TRUE(parser.parse(doc.data() + i, doc.length() - i)) << i << " " << parser.error();
+        ASSERT_TRUE(parser.finish());
+        EXPECT_EQ(t.out, "s:ab\xe2\x9c\x93 ");
+    }
+    // and one the string ends in
+    Trace t;
+    JsonParser parser(t, JsonLimits());
+    ASSERT_TRUE(parser.parse(doc.data(), 4));
+    EXPECT_FALSE(parser.parse("\"", 1));
+    EXPECT_EQ(parser.error().find("invalid UTF-8 in string"), 0u);
+}
+
+TEST(Json, limits)
+{
+    JsonLimits limits;
+    limits.maxDepth = 3;
+    EXPECT_EQ(trace("[[[]]]", limits), "[ [ [ ] ] ] ");
+    EXPECT_EQ(trace("[[[[]]]]", limits), "error: nested too deep at byte 3");
+
+    limits = JsonLimits();
+    limits.maxToken = 4;
+    EXPECT_EQ(trace("[\"abcd\", 1234]", limits), "[ s:abcd n:1234 ] ");
+    EXPECT_EQ(trace("[\"abcde\"]", limits).find("error: token too long"), 0u);
+    EXPECT_EQ(trace("[12345]", limits).find("error: token too long"), 0u);
+
+    limits = JsonLimits();
+    limits.maxSize = 8;
+    EXPECT_EQ(trace("[1, 2]", limits), "[ n:1 n:2 ] ");
+    EXPECT_EQ(trace("[1, 2, 3]", limits), "error: document too large at byte 8");
+
+    // the handler stops the parser
+    Trace t;
+    t.stopAt = 2;
+    JsonParser parser(t, JsonLimits());
+    EXPECT_FALSE(parser.parse("[1, 2]", 6));
+    EXPECT_TRUE(parser.failed());
+}
+
+TEST(Json, document)
+{
+    JsonDocument doc;
+    JsonParser parser(doc, JsonLimits());
+    ASSERT_TRUE(parser.parse(kDocument.data(), kDocument.length()));
+    ASSERT_TRUE(parser.finish());
+
+    auto& root = doc.root();
+    ASSERT_TRUE(root.isObject());
+    EXPECT_EQ(root.size(), 5u);
+    EXPECT_STREQ(root.member(0).key, "a");
+
+    auto a = root.find("a");
+    ASSERT_NE(a, nullptr);
+    ASSERT_TRUE(a->isArray());
+    ASSERT_EQ(a->size(), 6u);
+    EXPECT_EQ((*a)[0].asInt64(), 1);
+    EXPECT_DOUBLE_EQ((*a)[1].asDouble(), -2500);
+    EXPECT_STREQ((*a)[1].c_str(), "-2.5e+3");
+    EXPECT_TRUE((*a)[3].asBool());
+    EXPECT_FALSE((*a)[4].asBool());
+    EXPECT_TRUE((*a)[5].isNull());
+    EXPECT_TRUE((*a)[6].isNull());
+
+    auto s = root.find("long string without escapes");
+    ASSERT_NE(s, nullptr);
+    EXPECT_EQ(s->str(), "x\"y\\z\xc3\xa9\xf0\x9f\x98\x80");
+
+    EXPECT_TRUE(root.find("e")->isObject());
+    EXPECT_EQ(root.find("e")->size(), 0u);
+    EXPECT_EQ(root.find("f")->size(), 0u);
+    EXPECT_TRUE((*root.find("g")->find("h"))[0].isArray());
+    EXPECT_EQ(root.find("missing"), nullptr);
+}
+
+TEST(Json, large)
+{
+    // enough values for several arena blocks
+    std::string doc = "[";
+    for (int i = 0; i < 20000; i++) {
+        doc += i == 0 ? "" : ",";
+        doc += "{\"id\":" + std::to_string(i) + ",\"name\":\"item " + std::to_string(i) + "\"}";
+    }
+    doc += "]";
+
+    JsonDocument document;
+    JsonLimits limits;
+    limits.maxSize = doc.length();
+    JsonParser parser(document, limits);
+    for (size_t i = 0; i < doc.length(); i += 1000) {
+        ASSERT_TRUE(parser.parse(doc.data() + i, std::min<size_t>(1000, doc.length() - i)));
+    }
+    ASSERT_TRUE(parser.finish());
+
+    ASSERT_EQ(document.root().size(), 20000u);
+    EXPECT_EQ(document.root()[19999].find("id")->asInt64(), 19999);
+    EXPECT_EQ(document.root()[12345].find("name")->str(), "item 12345");
+}
@@ -0,0 +1,169 @@
+#include "listen.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+
+using namespace cppmhd;
+
+namespace
+{
+int connectUnix(const std::string& path)
+{
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    auto fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+}  // namespace
+
+TEST(Listen, unixPath)
+{
+    EXPECT_EQ(unixPath("unix:/run/app.sock"), "/run/app.sock");
+    EXPECT_EQ(unixPath("127.0.0.1"), "");
+    EXPECT_EQ(unixPath("::1"), "");
+}
+
+TEST(Listen, systemd)
+{
+    // meant for another process
+    setenv("LISTEN_PID", std::to_string(getpid() + 1).c_str(), 1);
+    setenv("LISTEN_FDS", "2", 1);
+    EXPECT_TRUE(systemdSockets().empty());
+    EXPECT_EQ(getenv("LISTEN_PID"), nullptr);
+    EXPECT_EQ(getenv("LISTEN_FDS"), nullptr);
+
+    EXPECT_TRUE(systemdSockets().empty());
+}
+
+TEST(Listen, unixSocket)
+{
+    auto path = "/tmp/cppmhd-listen-test-" + std::to_string(getpid()) + ".sock";
+    unlink(path.c_str());
+
+    auto fd = listenUnix(path, 0600);
+    ASSERT_GE(fd, 0);
+    struct stat st;
+    ASSERT_EQ(stat(path.c_str(), &st), 0);
+    EXPECT_TRUE(S_ISSOCK(st.st_mode));
+    EXPECT_EQ(st.st_mode & 0777, 0600u);
+
+    auto client = connectUnix(path);
+    EXPECT_GE(client, 0);
+    close(client);
+
+    // somebody listens there
+    EXPECT_EQ(listenUnix(path, 0600), -1);
+
+    // the file of a socket that is gone is replaced
+    close(fd);
+    fd = listenUnix(path, 0660);
+    ASSERT_GE(fd, 0);
+
+    auto copy = dupListener(fd);
+    ASSERT_GE(copy, 0);
+    EXPECT_NE(fcntl(copy, F_GETFL) & O_NONBLOCK, 0);
+    EXPECT_NE(fcntl(copy, F_GETFD) & FD_CLOEXEC, 0);
+
+    close(copy);
+    close(fd);
+    unlink(path.c_str());
+}
+
+TEST(Listen, boundTo)
+{
+    InetAddress any, local, other;
+    ASSERT_TRUE(InetAddress::parse(any, "0.0.0.0", 18720));
+    ASSERT_TRUE(InetAddress::parse(local, "127.0.0.1", 18720));
+    ASSERT_TRUE(InetAddress::parse(other, "127.0.0.1", 18721));
+
+    sockaddr_storage ss;
+    memset(&ss, 0, sizeof(ss));
+    auto &in = reinterpret_cast<sockaddr_in &>(ss);
+    in.sin_family = AF_INET;
+    in.sin_port = htons(18720);
+    in.sin_addr.s_addr = inet_addr("127.0.0.1");
+
+    EXPECT_TRUE(boundTo(ss, "", local));
+    EXPECT_TRUE(boundTo(ss, "", any));
+    EXPECT_FALSE(boundTo(ss, "", other));
+    EXPECT_FALSE(boundTo(ss, "/tmp/x.sock", local));
+
+    in.sin_addr.s_addr = inet_addr("10.0.0.1");
+    EXPECT_FALSE(boundTo(ss, "", local));
+    EXPECT_TRUE(boundTo(ss, "", any));
+
+    memset(&ss, 0, sizeof(ss));
+    auto &un = reinterpret_cast<sockaddr_un &>(ss);
+    un.sun_family = AF_UNIX;
+    strcpy(un.sun_path, "/tmp/x.sock");
+    EXPECT_TRUE(boundTo(ss, "/tmp/x.sock", local));
+    EXPECT_FALSE(boundTo(ss, "/tmp/y.sock", local));
+    EXPECT_FALSE(boundTo(ss, "", any));
+}
+
+TEST(Listen, acceptor)
+{
+    InetAddress addr;
+    ASSERT_TRUE(InetAddress::parse(addr, "127.0.0.1", 18722));
+    auto tcp = listenInet(addr);
+    ASSERT_GE(tcp, 0);
+    EXPECT_NE(fcntl(tcp, F_GETFL) & O_NONBLOCK, 0);
+
+    auto path = "/tmp/cppmhd-acceptor-test-" + std::to_string(getpid()) + ".sock";
+    auto uds = listenUnix(path, 0600);
+    ASSERT_GE(uds, 0);
+    fcntl(uds, F_SETFL, fcntl(uds, F_GETFL) | O_NONBLOCK);
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<uint32_t> accepted;
+
+    Acceptor acceptor;
+    ASSERT_TRUE(acceptor.start({tcp, uds}, [&](int fd, const sockaddr *, socklen_t, uint32_t listener) {
+        sockaddr_storage local;
+        EXPECT_TRUE(localAddress(fd, local));
+        EXPECT_TRUE(boundTo(local, listener == 0 ? "" : path, addr));
+        close(fd);
+        std::lock_guard<std::mutex> lock(mutex);
+        accepted.push_back(listener);
+        cv.notify_all();
+    }));
+
+    auto client = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_EQ(connect(client, addr.getSocket(), static_cast<socklen_t>(addr.socketLen())), 0);
+    auto unixClient = connectUnix(path);
+    ASSERT_GE(unixClient, 0);
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait_for(lock, std::chrono::seconds(5), [&]() { return accepted.size() == 2; });
+        std::sort(accepted.begin(), accepted.end());
+        EXPECT_EQ(accepted, (std::vector<uint32_t>{0, 1}));
+    }
+
+    acceptor.stop();
+    close(client);
+    close(unixClient);
+    close(tcp);
+    close(uds);
+    unlink(path.c_str());
+}
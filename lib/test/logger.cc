@@ -0,0 +1,120 @@
+#include "logger.h"
+
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include "ring.h"
+
+#ifdef ON_UNIX
+#include <unistd.h>
+#endif
+
+using namespace cppmhd;
+
+TEST(Ring, pushAndWrap)
+{
+    SpscRing ring(1024);
+    ASSERT_EQ(ring.capacity(), 1024u);
+    ASSERT_TRUE(ring.empty());
+
+    std::string payload(100, 'a');
+    size_t produced = 0, consumed = 0;
+
+    for (int round = 0; round < 50; round++) {
+        while (true) {
+            payload[0] = static_cast<char>('a' + (produced % 26));
+            if (!ring.push(payload.data(), payload.size())) {
+                break;
+            }
+            produced++;
+        }
+
+        auto cursor = ring.begin();
+        const char* data;
+        size_t size;
+        while (ring.next(cursor, data, size)) {
+            ASSERT_EQ(size, payload.size());
+            ASSERT_EQ(data[0], static_cast<char>('a' + (consumed % 26)));
+            consumed++;
+        }
+        ring.release(cursor);
+        ASSERT_TRUE(ring.empty());
+    }
+
+    EXPECT_EQ(produced, consumed);
+    EXPECT_GT(produced, 50u * 5);
+    EXPECT_FALSE(ring.push(nullptr, ring.maxRecord() + 1));
+}
+
+#ifdef ON_UNIX
+TEST(AsyncLogger, output)
+{
+    char name[] = "/tmp/cppmhd-async-logger-XXXXXX";
+    auto fd = mkstemp(name);
+    ASSERT_GT(fd, 0);
+
+    const int threads = 4;
+    const int lines = 1000;
+
+    {
+        log::AsyncLogger logger(fd, log::OverflowPolicy::kBlock, 4096);
+        std::vector<std::thread> thr;
+        for (int t = 0; t < threads; t++) {
+            thr.emplace_back([&logger, t]() {
+                for (int i = 0; i < lines; i++) {
+                    logger.output(log::kError, __FILE__, "worker", t, FORMAT("line {} {}", t, i).c_str());
+                }
+            });
+        }
+        for (auto& t : thr) {
+            t.join();
+        }
+        logger.fflush();
+        EXPECT_EQ(logger.dropped(), 0u);
+    }
+
+    std::ifstream in(name);
+    std::string line;
+    int count = 0;
+    std::vector<int> next(threads, 0);
+    while (std::getline(in, line)) {
+        auto pos = line.find("line ");
+        ASSERT_NE(pos, std::string::npos) << line;
+        std::istringstream ss(line.substr(pos + 5));
+        int t, i;
+        ss >> t >> i;
+        ASSERT_LT(t, threads);
+        // records of one thread keep their order
+        EXPECT_EQ(next[t], i);
+        next[t] = i + 1;
+        count++;
+    }
+    EXPECT_EQ(count, threads * lines);
+
+    close(fd);
+    unlink(name);
+}
+
+TEST(AsyncLogger, dropOnOverflow)
+{
+    char name[] = "/tmp/cppmhd-async-logger-XXXXXX";
+    auto fd = mkstemp(name);
+    ASSERT_GT(fd, 0);
+
+    {
+        log::AsyncLogger logger(fd, log::OverflowPolicy::kDrop, 1024);
+        std::string big(400, 'x');
+        for (int i = 0; i < 10000; i++) {
+            logger.output(log::kError, __FILE__, __func__, __LINE__, big.c_str());
+        }
+        logger.fflush();
+        EXPECT_GT(logger.dropped(), 0u);
+    }
+
+    close(fd);
+    unlink(name);
+}
+#endif
@@ -0,0 +1,73 @@
+#include "method.h"
+
+#include <gtest/gtest.h>
+
+#define FORMAT_HTTP_METHOD
+#include "format.h"
+
+using namespace cppmhd;
+
+TEST(Method, standard)
+{
+    const std::map<std::string, HttpMethod> methods = {{"GET", HttpMethod::GET},
+                                                       {"HEAD", HttpMethod::HEAD},
+                                                       {"POST", HttpMethod::POST},
+                                                       {"PUT", HttpMethod::PUT},
+                                                       {"DELETE", HttpMethod::DELETE},
+                                                       {"OPTIONS", HttpMethod::OPTIONS},
+                                                       {"CONNECT", HttpMethod::CONNECT},
+                                                       {"TRACE", HttpMethod::TRACE},
+                                                       {"PATCH", HttpMethod::PATCH}};
+
+    for (const auto& m : methods) {
+        HttpMethod out;
+        ASSERT_TRUE(parseHttpMethod(out, m.first.c_str())) << m.first;
+        EXPECT_EQ(out, m.second) << m.first;
+        EXPECT_STREQ(httpMethodName(out), m.first.c_str());
+        EXPECT_EQ(FORMAT("{}", out), m.first);
+    }
+}
+
+TEST(Method, exact)
+{
+    const char* bad[] = {"", "GE", "GETX", "get", "POS", "POSTT", "DELET", "OPTION", "CONNECTS", "PATCHED", "G\0T"};
+    for (auto b : bad) {
+        HttpMethod out;
+        EXPECT_FALSE(parseHttpMethod(out, b)) << b;
+    }
+
+    HttpMethod out;
+    EXPECT_FALSE(parseHttpMethod(out, nullptr));
+}
+
+TEST(Method, extension)
+{
+    HttpMethod propfind, report, again, get;
+    HttpMethod out;
+
+    EXPECT_FALSE(parseHttpMethod(out, "PROPFIND"));
+
+    ASSERT_TRUE(registerHttpMethod("PROPFIND", propfind));
+    ASSERT_TRUE(registerHttpMethod("REPORT", report));
+    EXPECT_TRUE(isExtensionMethod(propfind));
+    EXPECT_NE(propfind, report);
+
+    ASSERT_TRUE(registerHttpMethod("PROPFIND", again));
+    EXPECT_EQ(propfind, again);
+
+    ASSERT_TRUE(registerHttpMethod("GET", get));
+    EXPECT_EQ(get, HttpMethod::GET);
+
+    ASSERT_TRUE(parseHttpMethod(out, "PROPFIND"));
+    EXPECT_EQ(out, propfind);
+    EXPECT_FALSE(parseHttpMethod(out, "PROPFINDX"));
+    EXPECT_STREQ(httpMethodName(report), "REPORT");
+    EXPECT_EQ(FORMAT("{}", propfind), "PROPFIND");
+
+    EXPECT_FALSE(registerHttpMethod("propfind", out));
+    EXPECT_FALSE(registerHttpMethod("A METHOD", out));
+    EXPECT_FALSE(registerHttpMethod("", out));
+    EXPECT_FALSE(registerHttpMethod(nullptr, out));
+
+    EXPECT_EQ(httpMethodName(static_cast<HttpMethod>(static_cast<int>(HttpMethod::EXTENSION_BEGIN) + 30)), nullptr);
+}
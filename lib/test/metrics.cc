@@ -0,0 +1,164 @@
+#include "metrics.h"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+
+using namespace cppmhd;
+
+TEST(Metrics, bucket)
+{
+    EXPECT_EQ(Metrics::bucket(0), 0u);
+    EXPECT_EQ(Metrics::bucket(1), 1u);
+
+    for (uint64_t v = 1; v < (1ULL << 31); v = v * 3 / 2 + 1) {
+        auto b = Metrics::bucket(v);
+        ASSERT_LT(b, Metrics::kBuckets - 1) << v;
+        EXPECT_LE(v, Metrics::upperBound(b)) << v;
+        if (b > 0) {
+            EXPECT_GT(v, Metrics::upperBound(b - 1)) << v;
+        }
+    }
+
+    // bucket boundaries are contiguous
+    for (auto b = 1u; b < Metrics::kBuckets - 1; b++) {
+        EXPECT_EQ(Metrics::bucket(Metrics::upperBound(b)), b);
+        EXPECT_EQ(Metrics::bucket(Metrics::upperBound(b - 1) + 1), b);
+    }
+
+    EXPECT_EQ(Metrics::bucket(~0ULL), Metrics::kBuckets - 1);
+}
+
+TEST(Metrics, format)
+{
+    std::vector<RouteInfo> routes = {
+        {0, HttpMethod::GET, "/a/{\\d+:id}", nullptr, RequestPriority::NORMAL, 0, 0, {}, {}},
+        {1, HttpMethod::POST, "/b", nullptr, RequestPriority::NORMAL, 0, 0, {}, {}}};
+    Metrics metrics(routes, 2);
+
+    std::vector<std::thread> thr;
+    for (int t = 0; t < 4; t++) {
+        thr.emplace_back([&]() {
+            for (int i = 0; i < 1000; i++) {
+                metrics.observe(&routes[0], HttpMethod::GET, 200, 100);
+            }
+            metrics.observe(&routes[1], HttpMethod::POST, 503, 3000000);
+        });
+    }
+    for (auto& t : thr) {
+        t.join();
+    }
+    metrics.observe(nullptr, HttpMethod::PUT, 404, 5);
+
+    fmt::memory_buffer out;
+    metrics.format(out);
+    auto text = fmt::to_string(out);
+
+    EXPECT_NE(text.find("# TYPE cppmhd_request_duration_seconds histogram\n"), std::string::npos);
+    EXPECT_NE(text.find("cppmhd_request_duration_seconds_count{route=\"/a/{\\\\d+:id}\",method=\"GET\",status=\"2xx\"} "
+                        "4000\n"),
+              std::string::npos)
+        << text;
+    EXPECT_NE(text.find("cppmhd_request_duration_seconds_sum{route=\"/a/{\\\\d+:id}\",method=\"GET\",status=\"2xx\"} "
+                        "0.4\n"),
+              std::string::npos)
+        << text;
+    EXPECT_NE(text.find("cppmhd_request_duration_seconds_bucket{route=\"/b\",method=\"POST\",status=\"5xx\","
+                        "le=\"+Inf\"} 4\n"),
+              std::string::npos)
+        << text;
+    EXPECT_NE(text.find("cppmhd_request_duration_seconds_count{route=\"\",method=\"PUT\",status=\"4xx\"} 1\n"),
+              std::string::npos)
+        << text;
+    EXPECT_EQ(text.find("status=\"3xx\""), std::string::npos);
+}
+
+TEST(Metrics, unknownMethod)
+{
+    std::vector<RouteInfo> routes;
+    Metrics metrics(routes, 1);
+
+    // the last extension method and a method parseHttpMethod does not know get a series each
+    auto last = static_cast<HttpMethod>(static_cast<size_t>(HttpMethod::EXTENSION_BEGIN) + kMaxExtensionMethods - 1);
+    metrics.observe(nullptr, last, 404, 5);
+    metrics.observe(nullptr, static_cast<HttpMethod>(0xffff), 405, 0);
+
+    fmt::memory_buffer out;
+    metrics.format(out);
+    auto text = fmt::to_string(out);
+
+    static const char series[] =
+        "cppmhd_request_duration_seconds_count{route=\"\",method=\"UNKNOWN\",status=\"4xx\"} 1\n";
+    auto first = text.find(series);
+    ASSERT_NE(first, std::string::npos) << text;
+    EXPECT_NE(text.find(series, first + 1), std::string::npos) << text;
+}
+
+TEST(Metrics, admission)
+{
+    std::vector<RouteInfo> routes;
+    Metrics metrics(routes, 1);
+
+    AdmissionOptions options;
+    options.maxConnections = 1;
+    options.maxInflight = 1;
+    Admission first(options), second(options);
+    metrics.addAdmission(&first);
+    metrics.addAdmission(&second);
+
+    EXPECT_TRUE(first.admit());
+    EXPECT_FALSE(first.admit());
+    EXPECT_TRUE(second.admit());
+    EXPECT_FALSE(second.admit());
+    second.connectionOpened();
+    EXPECT_FALSE(second.acceptConnection());
+
+    fmt::memory_buffer out;
+    metrics.format(out);
+    auto text = fmt::to_string(out);
+    EXPECT_NE(text.find("\ncppmhd_requests_shed_total 2\n"), std::string::npos) << text;
+    EXPECT_NE(text.find("\ncppmhd_connections_refused_total 1\n"), std::string::npos) << text;
+
+    // a stopped daemon leaves, its counts stay
+    metrics.removeAdmission(&second);
+    EXPECT_FALSE(second.admit());
+    out.clear();
+    metrics.format(out);
+    text = fmt::to_string(out);
+    EXPECT_NE(text.find("\ncppmhd_requests_shed_total 2\n"), std::string::npos) << text;
+    EXPECT_NE(text.find("\ncppmhd_connections_refused_total 1\n"), std::string::npos) << text;
+}
+
+TEST(Metrics, spans)
+{
+    RequestTiming timing;
+    memset(&timing, 0, sizeof(timing));
+    timing.at[static_cast<size_t>(RequestPhase::BEGIN)] = 1000000;
+    timing.at[static_cast<size_t>(RequestPhase::ROUTED)] = 1003000;
+    timing.at[static_cast<size_t>(RequestPhase::HANDLER)] = 1004000;
+    timing.at[static_cast<size_t>(RequestPhase::HANDLED)] = 1010000;
+
+    uint32_t spans[kTimingSpanCount];
+    spanMicros(timing, spans);
+    EXPECT_EQ(spans[0], 3u);
+    EXPECT_EQ(spans[1], 0u);
+    EXPECT_EQ(spans[2], 0u);
+    EXPECT_EQ(spans[3], 6u);
+    EXPECT_EQ(spans[4], 0u);
+
+    std::vector<RouteInfo> routes;
+    Metrics metrics(routes, 1);
+
+    fmt::memory_buffer empty;
+    metrics.format(empty);
+    EXPECT_EQ(fmt::to_string(empty).find("cppmhd_request_phase_seconds"), std::string::npos);
+
+    metrics.observeSpans(spans);
+    fmt::memory_buffer out;
+    metrics.format(out);
+    auto text = fmt::to_string(out);
+
+    EXPECT_NE(text.find("cppmhd_request_phase_seconds_count{phase=\"dispatch\"} 1\n"), std::string::npos) << text;
+    EXPECT_NE(text.find("cppmhd_request_phase_seconds_sum{phase=\"handler\"} 6e-06\n"), std::string::npos) << text;
+    EXPECT_EQ(text.find("phase=\"body\""), std::string::npos);
+}
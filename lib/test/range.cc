@@ -0,0 +1,109 @@
+#include "range.h"
+
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+using namespace cppmhd;
+
+namespace
+{
+std::string ranges(const char *value, uint64_t size)
+{
+    std::vector<ByteRange> r;
+    auto result = parseRange(value, size, r);
+    if (result == RangeResult::IGNORED) {
+        return "ignored";
+    }
+    if (result == RangeResult::UNSATISFIABLE) {
+        return "416";
+    }
+    std::string s;
+    for (auto &b : r) {
+        s += (s.length() == 0 ? "" : ",") + std::to_string(b.first) + "-" + std::to_string(b.last);
+    }
+    return s;
+}
+}  // namespace
+
+TEST(Range, parse)
+{
+    EXPECT_EQ(ranges("bytes=0-99", 1000), "0-99");
+    EXPECT_EQ(ranges("Bytes = 500-", 1000), "500-999");
+    EXPECT_EQ(ranges("bytes=-100", 1000), "900-999");
+    EXPECT_EQ(ranges("bytes=-2000", 1000), "0-999");
+    EXPECT_EQ(ranges("bytes=900-5000", 1000), "900-999");
+    EXPECT_EQ(ranges("bytes=0-0,-1", 1000), "0-0,999-999");
+    EXPECT_EQ(ranges("bytes= 0-9 , 20-29", 1000), "0-9,20-29");
+
+    // sorted, overlapping and adjacent ones merged
+    EXPECT_EQ(ranges("bytes=50-59,0-9,5-19,20-29", 1000), "0-29,50-59");
+    EXPECT_EQ(ranges("bytes=0-99,10-19", 1000), "0-99");
+
+    // the unsatisfiable ones are dropped
+    EXPECT_EQ(ranges("bytes=2000-,0-9", 1000), "0-9");
+    EXPECT_EQ(ranges("bytes=1000-", 1000), "416");
+    EXPECT_EQ(ranges("bytes=-0", 1000), "416");
+    EXPECT_EQ(ranges("bytes=0-", 0), "416");
+    EXPECT_EQ(ranges("bytes=99999999999999999999999-", 1000), "416");
+}
+
+TEST(Range, ignored)
+{
+    EXPECT_EQ(ranges(nullptr, 1000), "ignored");
+    EXPECT_EQ(ranges("", 1000), "ignored");
+    EXPECT_EQ(ranges("items=0-9", 1000), "ignored");
+    EXPECT_EQ(ranges("bytes=", 1000), "ignored");
+    EXPECT_EQ(ranges("bytes=-", 1000), "ignored");
+    EXPECT_EQ(ranges("bytes=9-0", 1000), "ignored");
+    EXPECT_EQ(ranges("bytes=a-9", 1000), "ignored");
+    EXPECT_EQ(ranges("bytes=0-9;", 1000), "ignored");
+
+    std::string many = "bytes=0-0";
+    for (size_t i = 1; i <= kMaxRanges; i++) {
+        many += "," + std::to_string(i * 2) + "-" + std::to_string(i * 2);
+    }
+    EXPECT_EQ(ranges(many.c_str(), 1000), "ignored");
+}
+
+TEST(Range, ifRange)
+{
+    HttpResponse resp;
+    EXPECT_TRUE(ifRangeHolds(nullptr, resp));
+    EXPECT_FALSE(ifRangeHolds("\"abc\"", resp));
+
+    resp.header(CPPMHD_HTTP_HEADER_ETAG) = "\"abc\"";
+    resp.header(CPPMHD_HTTP_HEADER_LAST_MODIFIED) = "Sun, 06 Nov 1994 08:49:37 GMT";
+    EXPECT_TRUE(ifRangeHolds("\"abc\"", resp));
+    EXPECT_FALSE(ifRangeHolds("\"abd\"", resp));
+    EXPECT_FALSE(ifRangeHolds("W/\"abc\"", resp));
+    EXPECT_TRUE(ifRangeHolds("Sun, 06 Nov 1994 08:49:37 GMT", resp));
+    // not before, exactly
+    EXPECT_FALSE(ifRangeHolds("Mon, 07 Nov 1994 08:49:37 GMT", resp));
+
+    resp.header(CPPMHD_HTTP_HEADER_ETAG) = "W/\"abc\"";
+    EXPECT_FALSE(ifRangeHolds("W/\"abc\"", resp));
+}
+
+TEST(Range, file)
+{
+    char name[] = "/tmp/cppmhd-range-XXXXXX";
+    auto fd = mkstemp(name);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(write(fd, "0123456789", 10), 10);
+    close(fd);
+
+    HttpResponse resp;
+    EXPECT_FALSE(resp.file("/tmp/cppmhd-range-none"));
+    EXPECT_EQ(resp.fd(), -1);
+
+    resp.body("buffer");
+    ASSERT_TRUE(resp.file(name));
+    EXPECT_GE(resp.fd(), 0);
+    EXPECT_EQ(resp.fileSize(), 10u);
+    EXPECT_EQ(std::get<0>(resp.body()), 0u);
+    EXPECT_EQ(resp.header(CPPMHD_HTTP_HEADER_ETAG).front(), '"');
+    EXPECT_EQ(resp.header(CPPMHD_HTTP_HEADER_LAST_MODIFIED).length(), 29u);
+    EXPECT_TRUE(ifRangeHolds(resp.header(CPPMHD_HTTP_HEADER_ETAG).c_str(), resp));
+    unlink(name);
+}
@@ -0,0 +1,151 @@
+#include "ratelimit.h"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+
+using namespace cppmhd;
+
+namespace
+{
+RateLimitOptions makeOptions(double rate, uint32_t burst, size_t capacity)
+{
+    RateLimitOptions options;
+    options.rate = rate;
+    options.burst = burst;
+    options.capacity = capacity;
+    return options;
+}
+}  // namespace
+
+TEST(RateLimiter, bucket)
+{
+    RateLimiter limiter(makeOptions(10, 3, 1024));
+    auto key = RateLimiter::keyOf("client", 6);
+
+    EXPECT_TRUE(limiter.available(key, 1000));
+    for (int i = 0; i < 3; i++) {
+        EXPECT_TRUE(limiter.acquire(key, 1000));
+    }
+    EXPECT_FALSE(limiter.acquire(key, 1000));
+    EXPECT_FALSE(limiter.available(key, 1050));
+
+    // 10 per second, one token every 100 ms
+    EXPECT_TRUE(limiter.acquire(key, 1100));
+    EXPECT_FALSE(limiter.acquire(key, 1150));
+    EXPECT_TRUE(limiter.acquire(key, 1200));
+
+    // never more than the burst
+    EXPECT_TRUE(limiter.available(key, 100000));
+    for (int i = 0; i < 3; i++) {
+        EXPECT_TRUE(limiter.acquire(key, 100000));
+    }
+    EXPECT_FALSE(limiter.acquire(key, 100000));
+
+    // a clock read before the last refill takes nothing extra
+    EXPECT_FALSE(limiter.acquire(key, 99000));
+
+    EXPECT_TRUE(limiter.acquire(RateLimiter::keyOf("other", 5), 100000));
+}
+
+TEST(RateLimiter, fraction)
+{
+    RateLimiter limiter(makeOptions(10, 1, 1024));
+    auto key = RateLimiter::keyOf("client", 6);
+
+    EXPECT_TRUE(limiter.acquire(key, 1000));
+    // a denied request every millisecond, the parts of a token credited in between add up
+    for (uint32_t now = 1001; now < 1100; now++) {
+        EXPECT_FALSE(limiter.acquire(key, now)) << now;
+    }
+    EXPECT_TRUE(limiter.acquire(key, 1100));
+
+    // 1 per 3 seconds, the third of a token is not rounded away
+    RateLimiter slow(makeOptions(1.0 / 3, 1, 1024));
+    EXPECT_TRUE(slow.acquire(key, 1000));
+    for (uint32_t now = 1001; now < 4000; now += 7) {
+        EXPECT_FALSE(slow.acquire(key, now)) << now;
+    }
+    EXPECT_TRUE(slow.acquire(key, 4001));
+}
+
+TEST(RateLimiter, address)
+{
+    sockaddr_in in;
+    memset(&in, 0, sizeof(in));
+    in.sin_family = AF_INET;
+    in.sin_port = htons(1000);
+    inet_pton(AF_INET, "10.0.0.1", &in.sin_addr);
+    auto v4 = RateLimiter::keyOf(reinterpret_cast<sockaddr *>(&in));
+
+    in.sin_port = htons(2000);
+    EXPECT_EQ(RateLimiter::keyOf(reinterpret_cast<sockaddr *>(&in)), v4);
+
+    sockaddr_in6 in6;
+    memset(&in6, 0, sizeof(in6));
+    in6.sin6_family = AF_INET6;
+    inet_pton(AF_INET6, "::ffff:10.0.0.1", &in6.sin6_addr);
+    EXPECT_EQ(RateLimiter::keyOf(reinterpret_cast<sockaddr *>(&in6)), v4);
+
+    inet_pton(AF_INET6, "fe80::1", &in6.sin6_addr);
+    EXPECT_NE(RateLimiter::keyOf(reinterpret_cast<sockaddr *>(&in6)), v4);
+}
+
+TEST(RateLimiter, eviction)
+{
+    RateLimiter limiter(makeOptions(1, 1, 64));
+    ASSERT_EQ(limiter.capacity(), 64u);
+
+    auto first = RateLimiter::keyOf("first", 5);
+    EXPECT_TRUE(limiter.acquire(first, 10));
+    EXPECT_FALSE(limiter.acquire(first, 10));
+
+    // the table stays bounded, the idle key is the first to go
+    for (uint32_t i = 0; i < 10000; i++) {
+        limiter.acquire(RateLimiter::keyOf(reinterpret_cast<const char *>(&i), sizeof(i)), 20);
+    }
+    EXPECT_TRUE(limiter.acquire(first, 30));
+}
+
+TEST(RateLimiter, recency)
+{
+    // one set, a token every 10 seconds
+    RateLimiter limiter(makeOptions(0.1, 1, RateLimiter::kWays));
+    auto flood = RateLimiter::keyOf("flood", 5);
+    EXPECT_TRUE(limiter.acquire(flood, 0));
+    for (uint32_t i = 1; i < RateLimiter::kWays; i++) {
+        EXPECT_TRUE(limiter.acquire(RateLimiter::keyOf(reinterpret_cast<const char *>(&i), sizeof(i)), i * 1024));
+    }
+
+    // denied, the key is used all the same
+    EXPECT_FALSE(limiter.acquire(flood, 4096));
+    uint32_t other = 100;
+    EXPECT_TRUE(limiter.acquire(RateLimiter::keyOf(reinterpret_cast<const char *>(&other), sizeof(other)), 5120));
+
+    // the one used longest ago went, not the flooding key
+    EXPECT_FALSE(limiter.acquire(flood, 6144));
+    uint32_t first = 1;
+    EXPECT_TRUE(limiter.acquire(RateLimiter::keyOf(reinterpret_cast<const char *>(&first), sizeof(first)), 7168));
+}
+
+TEST(RateLimiter, threads)
+{
+    RateLimiter limiter(makeOptions(1, 1000, 1024));
+    auto key = RateLimiter::keyOf("shared", 6);
+    std::atomic<int> granted(0);
+
+    std::vector<std::thread> thr;
+    for (int t = 0; t < 4; t++) {
+        thr.emplace_back([&]() {
+            for (int i = 0; i < 1000; i++) {
+                if (limiter.acquire(key, 5)) {
+                    granted++;
+                }
+            }
+        });
+    }
+    for (auto &t : thr) {
+        t.join();
+    }
+    EXPECT_EQ(granted, 1000);
+}
@@ -0,0 +1,118 @@
+#include "sse.h"
+
+#include <gtest/gtest.h>
+
+using namespace cppmhd;
+
+namespace
+{
+std::string readAll(SseStream &stream, size_t max)
+{
+    std::string s;
+    char buf[64];
+    while (true) {
+        auto n = stream.read(buf, std::min(sizeof(buf), max));
+        if (n <= 0) {
+            break;
+        }
+        s.append(buf, static_cast<size_t>(n));
+    }
+    return s;
+}
+}  // namespace
+
+TEST(Sse, serialize)
+{
+    EXPECT_EQ(serializeEvent("hello", "", ""), "data: hello\n\n");
+    EXPECT_EQ(serializeEvent("a\nb\r\nc\rd", "", ""), "data: a\ndata: b\ndata: c\ndata: d\n\n");
+    EXPECT_EQ(serializeEvent("", "", ""), "data: \n\n");
+    EXPECT_EQ(serializeEvent("x", "price\nid: 9", "42"), "id: 42\nevent: priceid: 9\ndata: x\n\n");
+}
+
+TEST(Sse, publish)
+{
+    SseOptions options;
+    options.heartbeat = 0;
+    auto hub = std::make_shared<SseHub>(options);
+
+    SseStream a(nullptr, hub, {"quotes"});
+    SseStream b(nullptr, hub, {"quotes", "news"});
+    hub->subscribe(&a, {"quotes"});
+    hub->subscribe(&b, {"quotes", "news"});
+    EXPECT_EQ(hub->subscribers("quotes"), 2u);
+    EXPECT_EQ(hub->subscribers("news"), 1u);
+    EXPECT_EQ(hub->subscribers("sports"), 0u);
+
+    EXPECT_EQ(hub->publish("quotes", "1"), 2u);
+    EXPECT_EQ(hub->publish("news", "2", "headline"), 1u);
+    EXPECT_EQ(hub->publish("sports", "3"), 0u);
+
+    // read in pieces smaller than an event
+    EXPECT_EQ(readAll(a, 5), "data: 1\n\n");
+    EXPECT_EQ(readAll(b, 64), "data: 1\n\nevent: headline\ndata: 2\n\n");
+    EXPECT_EQ(a.queued(), 0u);
+
+    hub->unsubscribe(&a, {"quotes"});
+    hub->unsubscribe(&b, {"quotes", "news"});
+    EXPECT_EQ(hub->subscribers("quotes"), 0u);
+    EXPECT_EQ(hub->publish("quotes", "1"), 0u);
+}
+
+TEST(Sse, evictSlow)
+{
+    SseOptions options;
+    options.heartbeat = 0;
+    options.maxQueued = 100;
+    auto hub = std::make_shared<SseHub>(options);
+
+    SseStream slow(nullptr, hub, {"t"});
+    SseStream fast(nullptr, hub, {"t"});
+    hub->subscribe(&slow, {"t"});
+    hub->subscribe(&fast, {"t"});
+
+    std::string data(20, 'x');
+    for (int i = 0; i < 3; i++) {
+        EXPECT_EQ(hub->publish("t", data), 2u);
+        readAll(fast, 64);
+    }
+    // 28 bytes each, the 4th does not fit the queue of the slow one
+    EXPECT_EQ(hub->publish("t", data), 1u);
+    EXPECT_EQ(hub->evicted(), 1u);
+    EXPECT_EQ(slow.read(nullptr, 0), MHD_CONTENT_READER_END_WITH_ERROR);
+    EXPECT_EQ(readAll(fast, 64), "data: " + data + "\n\n");
+
+    EXPECT_EQ(hub->publish("t", data), 1u);
+    EXPECT_EQ(hub->evicted(), 1u);
+
+    hub->unsubscribe(&slow, {"t"});
+    hub->unsubscribe(&fast, {"t"});
+}
+
+TEST(Sse, end)
+{
+    SseOptions options;
+    options.heartbeat = 0;
+    auto hub = std::make_shared<SseHub>(options);
+    SseStreams streams;
+
+    SseStream a(nullptr, hub, {"t"});
+    hub->subscribe(&a, {"t"});
+    streams.add(&a);
+    EXPECT_EQ(hub->publish("t", "1"), 1u);
+
+    // what is queued goes out first
+    streams.end();
+    char buf[64];
+    EXPECT_EQ(a.read(buf, sizeof(buf)), 9);
+    EXPECT_EQ(a.read(buf, sizeof(buf)), MHD_CONTENT_READER_END_OF_STREAM);
+
+    // a stream opened meanwhile ends at once
+    SseStream b(nullptr, hub, {"t"});
+    streams.add(&b);
+    EXPECT_EQ(b.read(buf, sizeof(buf)), MHD_CONTENT_READER_END_OF_STREAM);
+
+    streams.remove(&a);
+    streams.remove(&b);
+    EXPECT_EQ(streams.size(), 0u);
+    hub->unsubscribe(&a, {"t"});
+}
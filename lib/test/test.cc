@@ -1,5 +1,11 @@
 #include "test.h"
 
+#ifdef ENABLE_GNUTLS
+#include <gnutls/x509.h>
+#endif
+
+#include <ctime>
+
 
 uint8_t *generateRandom(size_t size)
 {
@@ -16,4 +22,50 @@ uint8_t *generateRandom(size_t size)
     }
 
     return ret;
-}
\ No newline at end of file
+}
+
+bool selfSignedCertificate(MAYBE_UNUSED const std::string &name,
+                           MAYBE_UNUSED std::string &cert,
+                           MAYBE_UNUSED std::string &key)
+{
+#ifdef ENABLE_GNUTLS
+    gnutls_x509_privkey_t pkey;
+    gnutls_x509_crt_t crt;
+    gnutls_x509_privkey_init(&pkey);
+    gnutls_x509_crt_init(&crt);
+
+    auto now = time(nullptr);
+    unsigned char serial[] = {1};
+    auto bits = GNUTLS_CURVE_TO_BITS(GNUTLS_ECC_CURVE_SECP256R1);
+    auto size = static_cast<unsigned>(name.length());
+    auto ok = gnutls_x509_privkey_generate(pkey, GNUTLS_PK_ECDSA, bits, 0) == 0
+              && gnutls_x509_crt_set_version(crt, 3) == 0
+              && gnutls_x509_crt_set_serial(crt, serial, sizeof(serial)) == 0
+              && gnutls_x509_crt_set_activation_time(crt, now - 3600) == 0
+              && gnutls_x509_crt_set_expiration_time(crt, now + 86400) == 0
+              && gnutls_x509_crt_set_dn_by_oid(crt, GNUTLS_OID_X520_COMMON_NAME, 0, name.c_str(), size) == 0
+              && gnutls_x509_crt_set_subject_alt_name(crt, GNUTLS_SAN_DNSNAME, name.c_str(), size, 0) == 0
+              && gnutls_x509_crt_set_key(crt, pkey) == 0
+              && gnutls_x509_crt_sign2(crt, crt, pkey, GNUTLS_DIG_SHA256, 0) == 0;
+
+    gnutls_datum_t out;
+    if (ok && gnutls_x509_crt_export2(crt, GNUTLS_X509_FMT_PEM, &out) == 0) {
+        cert.assign(reinterpret_cast<char *>(out.data), out.size);
+        gnutls_free(out.data);
+    } else {
+        ok = false;
+    }
+    if (ok && gnutls_x509_privkey_export2(pkey, GNUTLS_X509_FMT_PEM, &out) == 0) {
+        key.assign(reinterpret_cast<char *>(out.data), out.size);
+        gnutls_free(out.data);
+    } else {
+        ok = false;
+    }
+
+    gnutls_x509_crt_deinit(crt);
+    gnutls_x509_privkey_deinit(pkey);
+    return ok;
+#else
+    return false;
+#endif
+}
@@ -71,4 +71,7 @@ class TestRequest : public HttpRequest
     }
 };
 
-uint8_t* generateRandom(size_t size);
\ No newline at end of file
+uint8_t* generateRandom(size_t size);
+
+// a self-signed certificate for the DNS name and its key, PEM. false unless cppmhd is built with GnuTLS
+bool selfSignedCertificate(const std::string& name, std::string& cert, std::string& key);
@@ -0,0 +1,234 @@
+#include "tls.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#ifdef ENABLE_GNUTLS
+#include <gnutls/x509.h>
+#endif
+
+#include <cstdio>
+#include <thread>
+
+#include "test.h"
+
+using namespace cppmhd;
+
+TEST(Tls, loadFailed)
+{
+    TlsContext none{TlsOptions()};
+    EXPECT_FALSE(none.load());
+
+    TlsOptions options;
+    options.certificates.push_back(TlsCertificate{"", "", "/nonexistent/cert.pem", "/nonexistent/key.pem", ""});
+    TlsContext missing(options);
+    EXPECT_FALSE(missing.load());
+}
+
+TEST(Tls, loadFiles)
+{
+    std::string cert, key;
+    if (!selfSignedCertificate("a.example.com", cert, key)) {
+        GTEST_SKIP() << "built without GnuTLS";
+    }
+
+    auto certFile = "/tmp/cppmhd-tls-test-" + std::to_string(getpid()) + ".crt";
+    auto keyFile = "/tmp/cppmhd-tls-test-" + std::to_string(getpid()) + ".key";
+    for (auto f : {std::make_pair(certFile, cert), std::make_pair(keyFile, key)}) {
+        auto file = fopen(f.first.c_str(), "wb");
+        ASSERT_NE(file, nullptr);
+        fwrite(f.second.data(), 1, f.second.length(), file);
+        fclose(file);
+    }
+
+    TlsOptions options;
+    options.certificates.push_back(TlsCertificate{"", "", certFile, keyFile, ""});
+    TlsContext ctx(options);
+    EXPECT_TRUE(ctx.load());
+    EXPECT_EQ(ctx.cert(), cert);
+    EXPECT_EQ(ctx.key(), key);
+
+    // a key that is not the one of the certificate
+    std::string otherCert, otherKey;
+    ASSERT_TRUE(selfSignedCertificate("b.example.com", otherCert, otherKey));
+    options.certificates[0] = TlsCertificate{cert, otherKey, "", "", ""};
+    TlsContext mismatch(options);
+    EXPECT_FALSE(mismatch.load());
+
+    unlink(certFile.c_str());
+    unlink(keyFile.c_str());
+}
+
+#ifdef ENABLE_GNUTLS
+namespace
+{
+struct Handshake {
+    // the name of the certificate the client got
+    std::string certName;
+    std::string alpn;
+    bool resumed{false};
+    // to resume the session
+    std::string ticket;
+};
+
+bool handshake(const TlsContext &ctx, const char *serverName, const std::string &ticket, Handshake &out)
+{
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+        return false;
+    }
+
+    auto serverOk = false;
+    std::thread server([&]() {
+        gnutls_session_t s;
+        gnutls_init(&s, GNUTLS_SERVER);
+        gnutls_set_default_priority(s);
+        gnutls_transport_set_int(s, fds[0]);
+        int rc = ctx.prepare(s) ? GNUTLS_E_AGAIN : -1;
+        while (rc == GNUTLS_E_AGAIN || rc == GNUTLS_E_INTERRUPTED) {
+            rc = gnutls_handshake(s);
+        }
+        // the client reads the session ticket with it
+        serverOk = rc == 0 && gnutls_record_send(s, "ok", 2) == 2;
+        gnutls_bye(s, GNUTLS_SHUT_WR);
+        gnutls_deinit(s);
+    });
+
+    gnutls_certificate_credentials_t anyCert;
+    gnutls_certificate_allocate_credentials(&anyCert);
+    gnutls_session_t c;
+    gnutls_init(&c, GNUTLS_CLIENT);
+    gnutls_set_default_priority(c);
+    gnutls_credentials_set(c, GNUTLS_CRD_CERTIFICATE, anyCert);
+    gnutls_transport_set_int(c, fds[1]);
+    if (serverName != nullptr) {
+        gnutls_server_name_set(c, GNUTLS_NAME_DNS, serverName, strlen(serverName));
+    }
+    gnutls_datum_t protocols[] = {{reinterpret_cast<unsigned char *>(const_cast<char *>("h2")), 2},
+                                  {reinterpret_cast<unsigned char *>(const_cast<char *>("http/1.1")), 8}};
+    gnutls_alpn_set_protocols(c, protocols, 2, 0);
+    if (ticket.length() != 0) {
+        gnutls_session_set_data(c, ticket.data(), ticket.length());
+    }
+
+    int rc;
+    do {
+        rc = gnutls_handshake(c);
+    } while (rc == GNUTLS_E_AGAIN || rc == GNUTLS_E_INTERRUPTED);
+
+    // GNUTLS_E_AGAIN after each session ticket
+    char buf[16];
+    ssize_t n = rc;
+    while (rc == 0 && (n = gnutls_record_recv(c, buf, sizeof(buf))) == GNUTLS_E_AGAIN) {
+    }
+    auto ok = n == 2;
+    if (ok) {
+        unsigned int count = 0;
+        auto peers = gnutls_certificate_get_peers(c, &count);
+        gnutls_x509_crt_t crt;
+        gnutls_x509_crt_init(&crt);
+        char name[256];
+        size_t size = sizeof(name);
+        if (count != 0 && gnutls_x509_crt_import(crt, &peers[0], GNUTLS_X509_FMT_DER) == 0
+            && gnutls_x509_crt_get_dn_by_oid(crt, GNUTLS_OID_X520_COMMON_NAME, 0, 0, name, &size) == 0) {
+            out.certName.assign(name, size);
+        }
+        gnutls_x509_crt_deinit(crt);
+
+        gnutls_datum_t alpn;
+        if (gnutls_alpn_get_selected_protocol(c, &alpn) == 0) {
+            out.alpn.assign(reinterpret_cast<char *>(alpn.data), alpn.size);
+        }
+        out.resumed = gnutls_session_is_resumed(c) != 0;
+
+        gnutls_datum_t data;
+        if (gnutls_session_get_data2(c, &data) == 0) {
+            out.ticket.assign(reinterpret_cast<char *>(data.data), data.size);
+            gnutls_free(data.data);
+        }
+    }
+
+    gnutls_deinit(c);
+    gnutls_certificate_free_credentials(anyCert);
+    server.join();
+    close(fds[0]);
+    close(fds[1]);
+    return ok && serverOk;
+}
+}  // namespace
+
+TEST(Tls, session)
+{
+    TlsOptions options;
+    for (auto name : {"a.example.com", "b.example.com"}) {
+        TlsCertificate c;
+        ASSERT_TRUE(selfSignedCertificate(name, c.cert, c.key));
+        options.certificates.push_back(c);
+    }
+    TlsContext ctx(options);
+    ASSERT_TRUE(ctx.load());
+
+    // picked by SNI
+    Handshake b;
+    ASSERT_TRUE(handshake(ctx, "b.example.com", "", b));
+    EXPECT_EQ(b.certName, "b.example.com");
+    EXPECT_EQ(b.alpn, "http/1.1");
+    EXPECT_FALSE(b.resumed);
+
+    // the first one without SNI or for another name
+    Handshake none;
+    ASSERT_TRUE(handshake(ctx, nullptr, "", none));
+    EXPECT_EQ(none.certName, "a.example.com");
+    Handshake other;
+    ASSERT_TRUE(handshake(ctx, "c.example.com", "", other));
+    EXPECT_EQ(other.certName, "a.example.com");
+
+    // with the ticket of the first session
+    ASSERT_FALSE(b.ticket.empty());
+    Handshake resumed;
+    ASSERT_TRUE(handshake(ctx, "b.example.com", b.ticket, resumed));
+    EXPECT_TRUE(resumed.resumed);
+}
+
+TEST(Tls, reload)
+{
+    TlsOptions options;
+    TlsCertificate c;
+    ASSERT_TRUE(selfSignedCertificate("a.example.com", c.cert, c.key));
+    options.certificates.push_back(c);
+    TlsContext ctx(options);
+    ASSERT_TRUE(ctx.load());
+    Handshake first;
+    ASSERT_TRUE(handshake(ctx, "a.example.com", "", first));
+
+    // the credentials, ticket key and ALPN of the first load are replaced
+    ASSERT_TRUE(ctx.load());
+    EXPECT_EQ(ctx.cert(), c.cert);
+    Handshake second;
+    ASSERT_TRUE(handshake(ctx, "a.example.com", first.ticket, second));
+    EXPECT_EQ(second.certName, "a.example.com");
+    EXPECT_EQ(second.alpn, "http/1.1");
+    EXPECT_FALSE(second.resumed);
+}
+
+TEST(Tls, noTickets)
+{
+    TlsOptions options;
+    options.sessionTickets = false;
+    options.alpn.clear();
+    TlsCertificate c;
+    ASSERT_TRUE(selfSignedCertificate("a.example.com", c.cert, c.key));
+    options.certificates.push_back(c);
+    TlsContext ctx(options);
+    ASSERT_TRUE(ctx.load());
+
+    Handshake first;
+    ASSERT_TRUE(handshake(ctx, "a.example.com", "", first));
+    EXPECT_EQ(first.alpn, "");
+    Handshake second;
+    ASSERT_TRUE(handshake(ctx, "a.example.com", first.ticket, second));
+    EXPECT_FALSE(second.resumed);
+}
+#endif
@@ -0,0 +1,233 @@
+#include "upload.h"
+
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+using namespace cppmhd;
+
+namespace
+{
+std::string readAll(const std::string &path)
+{
+    std::ifstream in(path, std::ios::binary);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+std::string pattern(size_t size)
+{
+    std::string data(size, '\0');
+    for (size_t i = 0; i < size; i++) {
+        data[i] = static_cast<char>(i * 131 + i / 4096);
+    }
+    return data;
+}
+
+class Paused : public HttpRequest
+{
+  public:
+    bool pausable{true};
+    std::atomic<int> paused{0};
+    std::atomic<int> resumed{0};
+
+    virtual const char *getPath() const override
+    {
+        return "/";
+    }
+
+    virtual HttpMethod getMethod() const override
+    {
+        return HttpMethod::POST;
+    }
+
+    virtual const char *getHeader(const char *) const override
+    {
+        return nullptr;
+    }
+
+    virtual const std::string &getParam(const std::string &) const override
+    {
+        static const std::string empty;
+        return empty;
+    }
+
+    virtual bool pause() override
+    {
+        if (!pausable) {
+            return false;
+        }
+        paused++;
+        return true;
+    }
+
+    virtual bool resume() override
+    {
+        resumed++;
+        return true;
+    }
+};
+
+void writeFile(bool direct)
+{
+    UploadOptions options;
+    options.chunkSize = 5000;
+    options.maxPending = 2;
+    options.direct = direct;
+    UploadWriter writer(options);
+
+    int error = -1;
+    auto file = writer.open("/tmp/cppmhd-upload-XXXXXX", error);
+    ASSERT_TRUE(file);
+    EXPECT_EQ(error, 0);
+    EXPECT_EQ(file->path().find("XXXXXX"), std::string::npos);
+
+    // odd sized writes, crossing the chunks and leaving a tail which is not a whole block
+    auto data = pattern(100 * 1000 + 123);
+    for (size_t i = 0; i < data.length(); i += 777) {
+        ASSERT_TRUE(writer.write(*file, data.data() + i, std::min<size_t>(777, data.length() - i)));
+    }
+    EXPECT_EQ(writer.close(*file), 0);
+    EXPECT_EQ(file->size(), data.length());
+
+    EXPECT_EQ(readAll(file->path()), data);
+    unlink(file->path().c_str());
+}
+}  // namespace
+
+TEST(Upload, write)
+{
+    writeFile(false);
+}
+
+TEST(Upload, direct)
+{
+    writeFile(true);
+}
+
+TEST(Upload, files)
+{
+    UploadWriter writer(UploadOptions{});
+
+    int error = 0;
+    EXPECT_FALSE(writer.open("/nonexistent/cppmhd/upload", error));
+    EXPECT_EQ(error, ENOENT);
+
+    // several files share the I/O thread
+    auto a = writer.open("/tmp/cppmhd-upload-XXXXXX", error);
+    auto b = writer.open("/tmp/cppmhd-upload-XXXXXX", error);
+    ASSERT_TRUE(a && b);
+    EXPECT_NE(a->path(), b->path());
+
+    auto data = pattern(600 * 1000);
+    ASSERT_TRUE(writer.write(*a, data.data(), data.length()));
+    ASSERT_TRUE(writer.write(*b, "b", 1));
+    EXPECT_EQ(writer.close(*b), 0);
+    EXPECT_EQ(writer.close(*a), 0);
+
+    EXPECT_EQ(readAll(a->path()), data);
+    EXPECT_EQ(readAll(b->path()), "b");
+    unlink(a->path().c_str());
+    unlink(b->path().c_str());
+}
+
+TEST(Upload, pause)
+{
+    UploadOptions options;
+    options.chunkSize = 4096;
+    options.maxPending = 1;
+    UploadWriter writer(options);
+
+    int error = 0;
+    auto file = writer.open("/tmp/cppmhd-upload-XXXXXX", error);
+    ASSERT_TRUE(file);
+
+    // write never waits, the request is paused instead and resumed by the I/O thread
+    Paused req;
+    auto wait = [&req]() {
+        while (req.resumed != req.paused) {
+            std::this_thread::yield();
+        }
+    };
+    auto data = pattern(64 * 4096);
+    for (size_t i = 0; i < data.length(); i += 4096) {
+        ASSERT_TRUE(writer.write(*file, data.data() + i, 4096));
+        writer.pauseIfFull(*file, req);
+        wait();
+    }
+    writer.flush(*file);
+    writer.pause(*file, req, 0);
+    wait();
+
+    EXPECT_EQ(writer.close(*file), 0);
+    EXPECT_EQ(readAll(file->path()), data);
+    unlink(file->path().c_str());
+
+    // an aborted request leaves the file to the I/O thread
+    auto aborted = writer.open("/tmp/cppmhd-upload-XXXXXX", error);
+    ASSERT_TRUE(aborted);
+    auto path = aborted->path();
+    ASSERT_TRUE(writer.write(*aborted, data.data(), data.length()));
+    writer.discard(std::move(aborted));
+    unlink(path.c_str());
+}
+
+TEST(Upload, pauseFails)
+{
+    // a disk which stalls: a pipe nobody reads
+    char dir[] = "/tmp/cppmhd-upload-XXXXXX";
+    ASSERT_NE(mkdtemp(dir), nullptr);
+    auto fifo = std::string(dir) + "/disk";
+    ASSERT_EQ(mkfifo(fifo.c_str(), 0600), 0);
+    auto disk = open(fifo.c_str(), O_RDONLY | O_NONBLOCK);
+    ASSERT_GE(disk, 0);
+
+    UploadOptions options;
+    options.chunkSize = 4096;
+    options.maxPending = 1;
+    UploadWriter writer(options);
+
+    int error = 0;
+    auto file = writer.open(fifo, error);
+    ASSERT_TRUE(file);
+    auto data = pattern(64 * 4096);
+    ASSERT_TRUE(writer.write(*file, data.data(), data.length()));
+
+    // the request can not wait for the disk, as when the daemons stop
+    Paused req;
+    req.pausable = false;
+    EXPECT_FALSE(writer.pauseIfFull(*file, req));
+    EXPECT_FALSE(writer.pause(*file, req, 0));
+    req.pausable = true;
+    EXPECT_TRUE(writer.pauseIfFull(*file, req));
+
+    // the I/O thread writes the rest and closes the pipe
+    writer.discard(std::move(file));
+    std::string got;
+    char buf[4096];
+    while (true) {
+        auto n = read(disk, buf, sizeof(buf));
+        if (n == 0) {
+            break;
+        }
+        if (n < 0) {
+            ASSERT_EQ(errno, EAGAIN);
+            std::this_thread::yield();
+            continue;
+        }
+        got.append(buf, static_cast<size_t>(n));
+    }
+    EXPECT_EQ(got, data);
+    EXPECT_EQ(req.paused, 1);
+
+    close(disk);
+    unlink(fifo.c_str());
+    rmdir(dir);
+}
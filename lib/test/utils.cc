@@ -147,4 +147,18 @@ TEST(utils, RegexCapture)
     ASSERT_TRUE(Regex::compileRegex(emptyGroup, "^a+b*c$"));
     ASSERT_TRUE(emptyGroup.match("aac", result));
     ASSERT_EQ(result.size(), 0);
-}
\ No newline at end of file
+}
+
+TEST(utils, utf8)
+{
+    EXPECT_TRUE(validUtf8("", 0));
+    std::string ascii("plain ascii, longer than one word");
+    EXPECT_TRUE(validUtf8(ascii.data(), ascii.length()));
+    std::string mixed("κόσμε, ascii before and after ✓ 𝄞");
+    EXPECT_TRUE(validUtf8(mixed.data(), mixed.length()));
+
+    // overlong, surrogate, past U+10FFFF, truncated, stray continuation
+    for (auto bad : {"\xc0\xaf", "\xe0\x80\xaf", "\xed\xa0\x80", "\xf4\x90\x80\x80", "abcdefgh\xe2\x82", "\x80"}) {
+        EXPECT_FALSE(validUtf8(bad, strlen(bad))) << bad;
+    }
+}
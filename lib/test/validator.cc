@@ -0,0 +1,99 @@
+#include "validator.h"
+
+#include <gtest/gtest.h>
+
+using namespace cppmhd;
+
+TEST(Validator, xxh64)
+{
+    EXPECT_EQ(xxh64("", 0), 0xEF46DB3751D8E999ULL);
+    EXPECT_EQ(xxh64("abc", 3), 0x44BC2CF5AD770999ULL);
+
+    // over 32 bytes, the four lanes
+    std::string s = "Nobody inspects the spammish repetition";
+    EXPECT_EQ(xxh64(s.data(), s.length()), 0xFBCEA83C8A378BF1ULL);
+
+    EXPECT_NE(xxh64(s.data(), s.length(), 1), xxh64(s.data(), s.length()));
+    EXPECT_EQ(etagOf("abc", 3), "\"44bc2cf5ad770999\"");
+}
+
+TEST(Validator, etagMatches)
+{
+    std::string etag = "\"abc\"";
+    EXPECT_TRUE(etagMatches("\"abc\"", etag));
+    EXPECT_TRUE(etagMatches("W/\"abc\"", etag));
+    EXPECT_TRUE(etagMatches("\"x\", \"abc\"", etag));
+    EXPECT_TRUE(etagMatches("*", etag));
+    EXPECT_TRUE(etagMatches("\"abc\"", "W/\"abc\""));
+    EXPECT_TRUE(etagMatches("bad, \"abc\"", etag));
+
+    EXPECT_FALSE(etagMatches(nullptr, etag));
+    EXPECT_FALSE(etagMatches("\"abcd\"", etag));
+    EXPECT_FALSE(etagMatches("\"ab\"", etag));
+    EXPECT_FALSE(etagMatches("\"abc", etag));
+    EXPECT_FALSE(etagMatches("\"abc\"", ""));
+}
+
+TEST(Validator, httpDate)
+{
+    int64_t t;
+    ASSERT_TRUE(parseHttpDate("Sun, 06 Nov 1994 08:49:37 GMT", t));
+    EXPECT_EQ(t, 784111777);
+    ASSERT_TRUE(parseHttpDate("Thu, 01 Jan 1970 00:00:00 GMT", t));
+    EXPECT_EQ(t, 0);
+    ASSERT_TRUE(parseHttpDate("Tue, 29 Feb 2028 23:59:59 GMT", t));
+    EXPECT_EQ(t, 1835481599);
+
+    EXPECT_FALSE(parseHttpDate(nullptr, t));
+    EXPECT_FALSE(parseHttpDate("Sunday, 06-Nov-94 08:49:37 GMT", t));
+    EXPECT_FALSE(parseHttpDate("Sun Nov  6 08:49:37 1994", t));
+    EXPECT_FALSE(parseHttpDate("Sun, 06 Nox 1994 08:49:37 GMT", t));
+    EXPECT_FALSE(parseHttpDate("Sun, 06 Nov 1994 08:49:37 UTC", t));
+}
+
+TEST(Validator, notModified)
+{
+    std::string etag = "\"e\"";
+    std::string modified = "Sun, 06 Nov 1994 08:49:37 GMT";
+
+    EXPECT_FALSE(notModified(nullptr, nullptr, etag, modified));
+    EXPECT_TRUE(notModified("\"e\"", nullptr, etag, ""));
+    EXPECT_FALSE(notModified("\"f\"", nullptr, etag, modified));
+
+    EXPECT_TRUE(notModified(nullptr, "Sun, 06 Nov 1994 08:49:37 GMT", etag, modified));
+    EXPECT_TRUE(notModified(nullptr, "Mon, 07 Nov 1994 08:49:37 GMT", etag, modified));
+    EXPECT_FALSE(notModified(nullptr, "Sat, 05 Nov 1994 08:49:37 GMT", etag, modified));
+    EXPECT_FALSE(notModified(nullptr, "Mon, 07 Nov 1994 08:49:37 GMT", etag, ""));
+
+    // If-None-Match wins
+    EXPECT_FALSE(notModified("\"f\"", "Mon, 07 Nov 1994 08:49:37 GMT", etag, modified));
+}
+
+TEST(Validator, cache)
+{
+    auto now = ValidatorCache::Clock::now();
+    ValidatorCache cache(2);
+    ValidatorCache::Validators v;
+
+    EXPECT_FALSE(cache.lookup(1, now, v));
+    cache.store(1, {"\"1\"", "", {{"Vary", "Accept"}}, now + std::chrono::seconds(10)});
+    ASSERT_TRUE(cache.lookup(1, now, v));
+    EXPECT_EQ(v.etag, "\"1\"");
+    ASSERT_EQ(v.headers.size(), 1u);
+    EXPECT_EQ(v.headers[0].second, "Accept");
+
+    EXPECT_FALSE(cache.lookup(1, now + std::chrono::seconds(10), v));
+
+    cache.store(2, {"\"2\"", "", {}, now + std::chrono::seconds(10)});
+    cache.lookup(1, now, v);
+    cache.store(3, {"\"3\"", "", {}, now + std::chrono::seconds(10)});
+    EXPECT_EQ(cache.size(), 2u);
+    EXPECT_TRUE(cache.lookup(1, now, v));
+    EXPECT_FALSE(cache.lookup(2, now, v));
+
+    // replaced in place
+    cache.store(3, {"\"4\"", "", {}, now + std::chrono::seconds(10)});
+    ASSERT_TRUE(cache.lookup(3, now, v));
+    EXPECT_EQ(v.etag, "\"4\"");
+    EXPECT_EQ(cache.size(), 2u);
+}
@@ -0,0 +1,49 @@
+#include "websocket.h"
+
+#include <gtest/gtest.h>
+
+using namespace cppmhd;
+
+TEST(WebSocket, accept)
+{
+    // RFC 6455 1.3
+    EXPECT_EQ(webSocketAccept("dGhlIHNhbXBsZSBub25jZQ=="), "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=");
+}
+
+TEST(WebSocket, unmask)
+{
+    const uint8_t key[] = {0x37, 0xfa, 0x21, 0x3d};
+    // RFC 6455 5.7, a masked "Hello"
+    char hello[] = {'\x7f', '\x9f', '\x4d', '\x51', '\x58'};
+    unmask(hello, sizeof(hello), key);
+    EXPECT_EQ(std::string(hello, sizeof(hello)), "Hello");
+
+    // the word loop and the tail agree, at every length
+    std::string plain;
+    for (int i = 0; i < 67; i++) {
+        plain += static_cast<char>('a' + i % 26);
+    }
+    for (size_t n = 0; n <= plain.length(); n++) {
+        std::string masked = plain.substr(0, n);
+        for (size_t i = 0; i < n; i++) {
+            masked[i] = static_cast<char>(masked[i] ^ key[i % 4]);
+        }
+        unmask(&masked[0], n, key);
+        EXPECT_EQ(masked, plain.substr(0, n));
+    }
+}
+
+TEST(WebSocket, frameHeader)
+{
+    std::string h;
+    appendFrameHeader(h, 0x81, 5);
+    EXPECT_EQ(h, std::string("\x81\x05", 2));
+
+    h.clear();
+    appendFrameHeader(h, 0x82, 256);
+    EXPECT_EQ(h, std::string("\x82\x7e\x01\x00", 4));
+
+    h.clear();
+    appendFrameHeader(h, 0x82, 65536);
+    EXPECT_EQ(h, std::string("\x82\x7f\x00\x00\x00\x00\x00\x01\x00\x00", 10));
+}